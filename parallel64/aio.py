@@ -0,0 +1,74 @@
+# SPDX-FileCopyrightText: 2022 Alec Delaney
+#
+# SPDX-License-Identifier: MIT
+
+"""
+`parallel64.aio`
+
+Support for the ``asyncio`` variants of the port methods.  The operations
+run on the completion thread of the port's backend, which polls every port
+in turn and resolves the futures of the event loops waiting on them, so one
+event loop can drive many ports without a thread for each.
+
+
+* Author(s): Alec Delaney
+
+"""
+
+import asyncio
+import atexit
+from typing import Any
+from parallel64.backend import Backend, CtypesBackend, native
+
+
+def _resolve(future: asyncio.Future, result: Any) -> None:
+    """Resolves a future with the result of an operation, cancelling it if
+    the operation was cancelled
+
+    :param asyncio.Future future: The future to resolve
+    :param result: The result of the operation, or None if it was cancelled
+    """
+
+    if future.done():
+        return
+    if result is None:
+        future.cancel()
+    else:
+        future.set_result(result)
+
+
+async def complete_operation(backend: Backend, submit_name: str, *args: Any) -> Any:
+    """Runs an operation on the completion thread of a backend and waits for
+    its result.  Cancelling the wait cancels the operation.
+
+    :param backend: The backend of the port
+    :param str submit_name: The name of the backend function queueing the
+        operation, such as ``"submit_wait_bits"``
+    :param args: The arguments of the operation, without the callback
+    :return: The result of the operation
+    :raises asyncio.CancelledError: If the operation was cancelled
+    """
+
+    loop = asyncio.get_running_loop()
+    future = loop.create_future()
+
+    def callback(result: Any) -> None:
+        try:
+            loop.call_soon_threadsafe(_resolve, future, result)
+        except RuntimeError:
+            # The event loop was closed while the operation ran
+            pass
+
+    operation_id = getattr(backend, submit_name)(*args, callback)
+    try:
+        return await future
+    except asyncio.CancelledError:
+        backend.cancel_operation(operation_id)
+        raise
+
+
+# The completion threads call into Python, so they must stop before the
+# interpreter does
+atexit.register(CtypesBackend.shutdown_completer)
+if native is not None:
+    atexit.register(native.shutdown_completer)
@@ -0,0 +1,902 @@
+# SPDX-FileCopyrightText: 2022 Alec Delaney
+#
+# SPDX-License-Identifier: MIT
+
+"""
+`parallel64.backend`
+
+Register access backends used by the port classes.  The compiled
+``parallel64._native`` extension is used when it is available, and
+``ctypes`` is used otherwise.  Both expose the same interface.
+
+
+* Author(s): Alec Delaney
+
+"""
+
+import sys
+import os
+import ctypes
+import struct
+import threading
+import time
+from types import ModuleType
+from typing import Any, Dict, List, Optional, Tuple, Union
+from parallel64.completion import CtypesCompletions
+from parallel64.metrics import CtypesMetrics
+from parallel64.mmio import CtypesMmio
+from parallel64.sampler import CtypesSampler
+from parallel64.streaming import CtypesStreamer
+from parallel64.transfers import CtypesTransfers
+
+INPOUT_FOLDER = os.path.abspath(os.path.join(os.path.dirname(__file__), "inpoutdlls"))
+"""The folder containing the DLLs included in this package"""
+
+if sys.maxsize > 2**32:
+    DEFAULT_WINDLL_LOCATION = os.path.join(INPOUT_FOLDER, "inpoutx64.dll")
+else:
+    DEFAULT_WINDLL_LOCATION = os.path.join(INPOUT_FOLDER, "inpout32.dll")
+
+
+def _import_native() -> Optional[ModuleType]:
+    """Imports the native extension, which links against the DLL included
+    in this package, if it was built
+
+    :return: The native extension module, or None if it is unavailable
+    :rtype: module|None
+    """
+
+    if not hasattr(os, "add_dll_directory"):
+        return None
+    try:
+        with os.add_dll_directory(INPOUT_FOLDER):
+            # pylint: disable=import-outside-toplevel
+            from parallel64 import _native
+    except (ImportError, OSError):
+        return None
+    return _native
+
+
+native = _import_native()
+"""The native extension module, or None if it is unavailable"""
+
+
+# pylint: disable=invalid-name
+class CtypesBackend(CtypesCompletions, CtypesTransfers, CtypesMmio, CtypesMetrics):
+    """
+    Register access using ``ctypes``, used when the native extension is
+    unavailable or a different DLL is requested.  It exposes the same
+    functions as ``parallel64._native``, with the ECP and EPP block
+    transfers provided by ``CtypesTransfers``, the asynchronous
+    operations by ``CtypesCompletions``, memory-mapped registers by
+    ``CtypesMmio`` and the register access metrics by ``CtypesMetrics``.
+
+    :param str windll_location: The location of the DLL
+    """
+
+    _wait_spin_ns = 50000
+    _wait_yield_ns = 1000000
+    _wait_stats = [0, 0, 0, 0]
+    _wait_stats_lock = threading.Lock()
+
+    def __init__(self, windll_location: str) -> None:
+        self._bind_dll(ctypes.WinDLL(windll_location))
+
+    def _bind_dll(self, dll: Any) -> None:
+        """Uses the register functions of a DLL, or of an object providing
+        the same functions such as ``SimulatedRegisters``
+
+        :param dll: The loaded DLL
+        """
+
+        self._dll = dll
+        self.DlPortReadPortUchar = dll.DlPortReadPortUchar
+        self.DlPortWritePortUchar = dll.DlPortWritePortUchar
+        self.DlPortReadPortUshort = dll.DlPortReadPortUshort
+        self.DlPortWritePortUshort = dll.DlPortWritePortUshort
+        self.DlPortReadPortUlong = dll.DlPortReadPortUlong
+        self.DlPortWritePortUlong = dll.DlPortWritePortUlong
+        self.IsInpOutDriverOpen = dll.IsInpOutDriverOpen
+        self._instrument_registers()
+
+    # pylint: disable=too-many-arguments
+    def Sampler(
+        self,
+        spp_base_address: int,
+        channels: int,
+        capacity: int,
+        period_ns: int,
+        trigger_mask: int = 0,
+        trigger_value: int = 0,
+    ) -> CtypesSampler:
+        """Create a sampler for the SPP registers, see ``CtypesSampler``
+
+        :rtype: CtypesSampler
+        """
+
+        return CtypesSampler(
+            self.DlPortReadPortUchar,
+            spp_base_address,
+            channels,
+            capacity,
+            period_ns,
+            trigger_mask,
+            trigger_value,
+            self.get_wait_policy,
+        )
+
+    # pylint: disable=too-many-arguments
+    def Streamer(
+        self,
+        engine: str,
+        address: int,
+        buffer_count: int,
+        buffer_size: int,
+        timeout: Optional[float],
+        control: int = 0,
+        setup_ns: int = 0,
+        pulse_ns: int = 0,
+        hold_ns: int = 0,
+        fifo_depth: int = 16,
+        threshold: int = 8,
+    ) -> CtypesStreamer:
+        """Create an output stream, see ``CtypesStreamer``.  The ``"spp"``
+        engine uses the SPP handshake at the SPP base address, and the
+        ``"fifo"`` engine feeds the FIFO at the ECP base address.
+
+        :rtype: CtypesStreamer
+        """
+
+        if engine == "spp":
+
+            def send(data: memoryview) -> Tuple[int, bool]:
+                return self.spp_write_buffer(
+                    address, control, data, timeout, False, setup_ns, pulse_ns, hold_ns
+                )
+
+            def finish() -> bool:
+                return self.wait_port_bits(address + 1, 0b10000000, 0b10000000, timeout)
+
+        elif engine == "fifo":
+            if not 0 < threshold <= fifo_depth:
+                raise ValueError(
+                    "FIFO depth and threshold must be positive, with threshold <= depth"
+                )
+
+            def send(data: memoryview) -> Tuple[int, bool]:
+                # The stream feeds the FIFO a byte at a time
+                return self.ecp_write_fifo(
+                    address, data, fifo_depth, threshold, 1, timeout
+                )
+
+            def finish() -> bool:
+                # ecp_write_fifo() already waits for each buffer to drain
+                return True
+
+        else:
+            raise ValueError(f"unknown stream engine '{engine}'")
+        return CtypesStreamer(send, finish, buffer_count, buffer_size)
+
+    def write_port_buffer(
+        self, port: int, data: Union[bytes, bytearray, memoryview]
+    ) -> None:
+        """Write every byte of a bytes-like object to the given port, in order
+
+        :param int port: The port address
+        :param data: The data to write
+        :type data: bytes|bytearray|memoryview
+        """
+
+        write_port = self.DlPortWritePortUchar
+        for value in memoryview(data).cast("B"):
+            write_port(port, value)
+
+    def read_port_buffer(self, port: int, length: int) -> bytes:
+        """Read the given port the given number of times
+
+        :param int port: The port address
+        :param int length: The number of reads to perform
+        :return: The results of the reads
+        :rtype: bytes
+        """
+
+        buffer = bytearray(length)
+        self.read_port_into(port, buffer)
+        return bytes(buffer)
+
+    def read_port_into(self, port: int, buffer: Union[bytearray, memoryview]) -> None:
+        """Read the given port once for each byte of the buffer, storing the
+        results in it
+
+        :param int port: The port address
+        :param buffer: The buffer to fill
+        :type buffer: bytearray|memoryview
+        """
+
+        read_port = self.DlPortReadPortUchar
+        view = memoryview(buffer).cast("B")
+        for index in range(len(view)):
+            view[index] = read_port(port)
+
+    def wait_port_bits(
+        self, port: int, mask: int, value: int, timeout: Optional[float]
+    ) -> bool:
+        """Poll the given port until the masked bits equal the value
+
+        :param int port: The port address
+        :param int mask: The bits to check
+        :param int value: The value to wait for the masked bits to equal
+        :param float|None timeout: The timeout in seconds, or None to wait
+            indefinitely
+        :return: Whether the bits matched before the timeout
+        :rtype: bool
+        """
+
+        read_port = self.DlPortReadPortUchar
+        # A wait the first poll satisfies is not counted in the wait stats
+        if read_port(port) & mask == value:
+            self._record_port_wait(port, 0, True)
+            return True
+        start = time.perf_counter_ns()
+        spin_end = start + self._wait_spin_ns
+        yield_end = spin_end + self._wait_yield_ns
+        deadline = None if timeout is None else start + int(timeout * 1e9)
+        while True:
+            if read_port(port) & mask == value:
+                matched = True
+                break
+            now = time.perf_counter_ns()
+            if deadline is not None and now >= deadline:
+                matched = read_port(port) & mask == value
+                break
+            if now >= yield_end:
+                time.sleep(0.001)
+            elif now >= spin_end:
+                time.sleep(0)
+        waited_ns = time.perf_counter_ns() - start
+        self._record_wait(waited_ns, matched)
+        self._record_port_wait(port, waited_ns, matched)
+        return matched
+
+    def play_writes(
+        self,
+        addresses: Union[bytes, bytearray, memoryview],
+        values: Union[bytes, bytearray, memoryview],
+        writes_per_step: int,
+        period_ns: int,
+    ) -> Tuple[int, int, int, int]:
+        """Write each value to the matching port address, in steps of
+        ``writes_per_step`` writes that start ``period_ns`` apart
+
+        :param addresses: The 16-bit port address of each write
+        :type addresses: bytes|bytearray|memoryview
+        :param values: The value of each write
+        :type values: bytes|bytearray|memoryview
+        :param int writes_per_step: The number of writes in each step
+        :param int period_ns: The time between the starts of the steps in
+            nanoseconds
+        :return: The number of steps, the time taken and the latest and total
+            lateness of the steps, in nanoseconds
+        :rtype: tuple
+        """
+
+        addresses = memoryview(addresses).cast("B").cast("H")
+        values = memoryview(values).cast("B")
+        if len(addresses) != len(values):
+            raise ValueError("there must be one 16-bit address for each value")
+        if writes_per_step <= 0 or len(values) % writes_per_step:
+            raise ValueError("the values must divide evenly into steps")
+        if period_ns < 0:
+            raise ValueError("durations must be non-negative")
+        write_port = self.DlPortWritePortUchar
+        perf_counter_ns = time.perf_counter_ns
+        steps = len(values) // writes_per_step
+        max_late = total_late = 0
+        start = perf_counter_ns()
+        for step in range(steps):
+            due = start + period_ns * step
+            now = perf_counter_ns()
+            while now < due:
+                now = perf_counter_ns()
+            late = now - due
+            max_late = max(max_late, late)
+            total_late += late
+            for index in range(step * writes_per_step, (step + 1) * writes_per_step):
+                write_port(addresses[index], values[index])
+        return steps, perf_counter_ns() - start, max_late, total_late
+
+    # pylint: disable=too-many-arguments,too-many-locals
+    def shift_bytes(
+        self,
+        out_port: int,
+        state: int,
+        clock_mask: int,
+        clock_invert: int,
+        data_out_mask: int,
+        data_out_invert: int,
+        in_port: int,
+        data_in_mask: int,
+        data_in_invert: int,
+        mode: int,
+        bits: int,
+        half_period_ns: int,
+        data: Union[bytes, bytearray, memoryview],
+    ) -> Tuple[bytes, int]:
+        """Clock bits of each byte out and in, with one port write per clock
+        edge
+
+        :param int out_port: The register with the clock and data out lines
+        :param int state: The current value of that register
+        :param int clock_mask: The clock line's bit
+        :param int clock_invert: The clock line's inversion mask
+        :param int data_out_mask: The data out line's bit, or 0 for none
+        :param int data_out_invert: The data out line's inversion mask
+        :param int in_port: The register with the data in line
+        :param int data_in_mask: The data in line's bit, or 0 for none
+        :param int data_in_invert: The data in line's inversion mask
+        :param int mode: Bit 0 is CPOL, bit 1 is CPHA and bit 2 shifts LSB
+            first.  Bit 3 changes the data out line in a write of its own
+            after each clock edge, as I2C needs.
+        :param int bits: The number of bits of each byte to shift, 1-8
+        :param int half_period_ns: The time each clock edge is held in
+            nanoseconds
+        :param data: The bytes to shift out
+        :type data: bytes|bytearray|memoryview
+        :return: The bytes read in, and the final value of the output register
+        :rtype: tuple
+        """
+
+        if not 1 <= bits <= 8:
+            raise ValueError("bits must be 1-8")
+        write_port = self.DlPortWritePortUchar
+        read_port = self.DlPortReadPortUchar
+        delay_ns = self.delay_ns
+        cpol = bool(mode & 0b001)
+        cpha = bool(mode & 0b010)
+        separate_data = bool(mode & 0b1000)
+        positions = range(bits) if mode & 0b100 else range(7, 7 - bits, -1)
+
+        def edge(clock: bool, bit: bool) -> None:
+            nonlocal state
+            clocked = (state & ~clock_mask) | (
+                (clock_mask if clock else 0) ^ clock_invert
+            )
+            state = clocked
+            if data_out_mask:
+                state = (state & ~data_out_mask) | (
+                    (data_out_mask if bit else 0) ^ data_out_invert
+                )
+            if separate_data and state != clocked:
+                write_port(out_port, clocked)
+                delay_ns(half_period_ns // 2)
+                write_port(out_port, state)
+                delay_ns(half_period_ns - half_period_ns // 2)
+            else:
+                write_port(out_port, state)
+                delay_ns(half_period_ns)
+
+        def sample() -> int:
+            if not data_in_mask:
+                return 0
+            return int(bool((read_port(in_port) ^ data_in_invert) & data_in_mask))
+
+        received = bytearray()
+        for value in memoryview(data).cast("B"):
+            in_value = 0
+            for position in positions:
+                bit = bool((value >> position) & 1)
+                edge(cpol if not cpha else not cpol, bit)
+                edge(not cpol if not cpha else cpol, bit)
+                in_value |= sample() << position
+            received.append(in_value)
+        idle_state = (state & ~clock_mask) | (
+            (clock_mask if cpol else 0) ^ clock_invert
+        )
+        if idle_state != state:
+            state = idle_state
+            write_port(out_port, state)
+            delay_ns(half_period_ns)
+        return bytes(received), state
+
+    def run_program(
+        self, program: Union[bytes, bytearray, memoryview]
+    ) -> Tuple[bytes, int]:
+        """Run a compiled port program
+
+        :param program: The compiled program, as 16-byte instructions in the
+            struct format ``"<BBHBBxxq"``
+        :type program: bytes|bytearray|memoryview
+        :return: The value of each read, and the index of the wait that timed
+            out or -1 if the program ran to the end
+        :rtype: tuple
+        """
+
+        if len(memoryview(program).cast("B")) % 16:
+            raise ValueError("programs must be a whole number of instructions")
+        instructions = list(struct.iter_unpack("<BBHBBxxq", program))
+        # The loops that are not inside a later loop, which a loop must
+        # contain if they end inside its body
+        loops: List[int] = []
+        for index, (opcode, _, port, _, _, arg) in enumerate(instructions):
+            if opcode == 4 and arg < 0:
+                raise ValueError(f"instruction {index} has a negative delay")
+            if opcode == 5:
+                if port > index or arg < 1:
+                    raise ValueError(f"instruction {index} is not a valid loop")
+                while loops and loops[-1] >= port:
+                    if instructions[loops[-1]][2] < port:
+                        raise ValueError(
+                            f"instruction {index} is a loop crossing the one at "
+                            f"instruction {loops[-1]}"
+                        )
+                    loops.pop()
+                loops.append(index)
+            if opcode not in (1, 2, 3, 4, 5):
+                raise ValueError(f"instruction {index} has unknown opcode {opcode}")
+        results = bytearray()
+        iterations = [0] * len(instructions)
+        index = 0
+        while index < len(instructions):
+            opcode, _, port, value_a, value_b, arg = instructions[index]
+            if opcode == 1:
+                self.DlPortWritePortUchar(port, value_a)
+            elif opcode == 2:
+                results.append(self.DlPortReadPortUchar(port))
+            elif opcode == 3:
+                timeout = None if arg < 0 else arg / 1e9
+                if not self.wait_port_bits(port, value_a, value_b, timeout):
+                    return bytes(results), index
+            elif opcode == 4:
+                self.delay_ns(arg)
+            else:
+                iterations[index] += 1
+                if iterations[index] < arg:
+                    index = port
+                    continue
+                iterations[index] = 0
+            index += 1
+        return bytes(results), -1
+
+    @classmethod
+    def _record_wait(cls, waited_ns: int, matched: bool) -> None:
+        """Adds a wait to the wait counters
+
+        :param int waited_ns: How long the wait took in nanoseconds
+        :param bool matched: Whether the wait ended before its timeout
+        """
+
+        with cls._wait_stats_lock:
+            stats = cls._wait_stats
+            stats[0] += 1
+            stats[1] += not matched
+            stats[2] += waited_ns
+            stats[3] = max(stats[3], waited_ns)
+
+    @classmethod
+    def set_wait_policy(cls, spin_ns: int, yield_ns: int) -> None:
+        """Set how long waits spin, then yield, before sleeping between polls
+
+        :param int spin_ns: How long to poll without yielding, in nanoseconds
+        :param int yield_ns: How long to then poll while yielding, in
+            nanoseconds
+        """
+
+        if spin_ns < 0 or yield_ns < 0:
+            raise ValueError("durations must be non-negative")
+        cls._wait_spin_ns = spin_ns
+        cls._wait_yield_ns = yield_ns
+
+    @classmethod
+    def get_wait_policy(cls) -> Tuple[int, int]:
+        """Returns the wait policy
+
+        :return: The spin and yield durations in nanoseconds
+        :rtype: tuple
+        """
+        return cls._wait_spin_ns, cls._wait_yield_ns
+
+    @classmethod
+    def wait_stats(cls) -> Tuple[int, int, int, int]:
+        """Returns the wait counters
+
+        :return: The number of waits, how many timed out, and the total and
+            longest time waited in nanoseconds, since the counters were reset
+        :rtype: tuple
+        """
+
+        with cls._wait_stats_lock:
+            return tuple(cls._wait_stats)
+
+    @classmethod
+    def reset_wait_stats(cls) -> None:
+        """Reset the wait counters"""
+
+        with cls._wait_stats_lock:
+            cls._wait_stats[:] = [0, 0, 0, 0]
+
+    def _wait_not_busy(self, status_port: int, timeout: Optional[float]) -> bool:
+        """Waits for the BUSY line to indicate the peripheral is ready
+
+        :param int status_port: The address of the Status register
+        :param float|None timeout: The timeout in seconds, or None to wait
+            indefinitely
+        :return: Whether the peripheral became ready before the timeout
+        :rtype: bool
+        """
+
+        return self.wait_port_bits(status_port, 0b10000000, 0b10000000, timeout)
+
+    @staticmethod
+    def delay_ns(ns: int) -> None:
+        """Spin for at least the given number of nanoseconds
+
+        :param int ns: The delay in nanoseconds
+        """
+
+        start = time.perf_counter_ns()
+        while time.perf_counter_ns() - start < ns:
+            pass
+
+    @staticmethod
+    def timer_resolution_ns() -> int:
+        """Returns the resolution of the delay timer in nanoseconds
+
+        :rtype: int
+        """
+
+        return max(int(time.get_clock_info("perf_counter").resolution * 1e9), 1)
+
+    def write_port_at(self, port: int, value: int, release_ns: int) -> int:
+        """Waits until ``time.perf_counter_ns()`` reaches the release time and
+        then writes a byte to a port.  The wait yields between polls so that
+        other threads waiting to write can run.
+
+        :param int port: The port to write
+        :param int value: The byte to write
+        :param int release_ns: When to write, in ``time.perf_counter_ns()``
+            nanoseconds
+        :return: How late the write started, in nanoseconds
+        :rtype: int
+        """
+
+        now = time.perf_counter_ns()
+        while now < release_ns:
+            time.sleep(0)
+            now = time.perf_counter_ns()
+        self.DlPortWritePortUchar(port, value)
+        return now - release_ns
+
+    @staticmethod
+    def set_thread_affinity(mask: int) -> int:
+        """Restricts the calling thread to the processors set in the mask
+
+        :param int mask: The affinity mask
+        :return: The previous affinity mask of the thread
+        :rtype: int
+        :raises ValueError: If the mask selects no processors
+        :raises OSError: If the affinity could not be set
+        """
+
+        if mask <= 0:
+            raise ValueError("the affinity mask must select at least one processor")
+        kernel32 = ctypes.windll.kernel32
+        kernel32.GetCurrentThread.restype = ctypes.c_void_p
+        kernel32.SetThreadAffinityMask.argtypes = (ctypes.c_void_p, ctypes.c_size_t)
+        kernel32.SetThreadAffinityMask.restype = ctypes.c_size_t
+        previous = kernel32.SetThreadAffinityMask(kernel32.GetCurrentThread(), mask)
+        if previous == 0:
+            raise ctypes.WinError()
+        return previous
+
+    @staticmethod
+    def enable_direct_io(base: int, count: int, probe_port: int) -> bool:
+        """Direct port I/O needs the native extension, so the ports keep
+        using the DLL
+
+        :param int base: The first port
+        :param int count: The number of ports
+        :param int probe_port: The port that would be read to test access
+        :return: Whether direct I/O was enabled, which is always False
+        :rtype: bool
+        """
+
+        # pylint: disable=unused-argument
+        return False
+
+    @staticmethod
+    def disable_direct_io(base: int, count: int) -> None:
+        """Returns ports to access through the DLL, which they always are
+
+        :param int base: The first port
+        :param int count: The number of ports
+        """
+
+    @staticmethod
+    def direct_io_enabled(port: int) -> bool:
+        """Returns whether the port is accessed with the in and out
+        instructions, which is never the case with ``ctypes``
+
+        :param int port: The port
+        :rtype: bool
+        """
+
+        # pylint: disable=unused-argument
+        return False
+
+    @staticmethod
+    def set_thread_priority(priority: int) -> int:
+        """Sets the priority of the calling thread
+
+        :param int priority: A ``THREAD_PRIORITY_*`` value
+        :return: The previous priority of the thread
+        :rtype: int
+        :raises OSError: If the priority could not be set
+        """
+
+        kernel32 = ctypes.windll.kernel32
+        kernel32.GetCurrentThread.restype = ctypes.c_void_p
+        kernel32.GetThreadPriority.argtypes = (ctypes.c_void_p,)
+        kernel32.SetThreadPriority.argtypes = (ctypes.c_void_p, ctypes.c_int)
+        thread = kernel32.GetCurrentThread()
+        previous = kernel32.GetThreadPriority(thread)
+        if previous == 0x7FFFFFFF or not kernel32.SetThreadPriority(thread, priority):
+            raise ctypes.WinError()
+        return previous
+
+    @staticmethod
+    def join_mmcss_task(task: str) -> int:
+        """Registers the calling thread with an MMCSS task
+
+        :param str task: The name of the task, such as ``"Pro Audio"``
+        :return: The handle to pass to ``leave_mmcss_task()``
+        :rtype: int
+        :raises OSError: If the thread could not be registered
+        """
+
+        avrt = ctypes.windll.avrt
+        avrt.AvSetMmThreadCharacteristicsW.argtypes = (
+            ctypes.c_wchar_p,
+            ctypes.POINTER(ctypes.c_ulong),
+        )
+        avrt.AvSetMmThreadCharacteristicsW.restype = ctypes.c_void_p
+        index = ctypes.c_ulong(0)
+        handle = avrt.AvSetMmThreadCharacteristicsW(task, ctypes.byref(index))
+        if not handle:
+            raise ctypes.WinError()
+        return handle
+
+    @staticmethod
+    def leave_mmcss_task(handle: int) -> None:
+        """Removes the calling thread from the MMCSS task it joined
+
+        :param int handle: The handle returned by ``join_mmcss_task()``
+        :raises OSError: If the thread could not be removed
+        """
+
+        avrt = ctypes.windll.avrt
+        avrt.AvRevertMmThreadCharacteristics.argtypes = (ctypes.c_void_p,)
+        if not avrt.AvRevertMmThreadCharacteristics(handle):
+            raise ctypes.WinError()
+
+    @staticmethod
+    def begin_timer_period(ms: int) -> None:
+        """Requests a system timer resolution, which shortens sleeps
+
+        :param int ms: The resolution in milliseconds
+        :raises ValueError: If the resolution is not supported
+        """
+
+        if ctypes.windll.winmm.timeBeginPeriod(ms) != 0:
+            raise ValueError(f"a timer period of {ms} ms is not supported")
+
+    @staticmethod
+    def end_timer_period(ms: int) -> None:
+        """Releases a timer resolution requested with
+        ``begin_timer_period()``
+
+        :param int ms: The resolution in milliseconds
+        :raises ValueError: If the resolution was not requested
+        """
+
+        if ctypes.windll.winmm.timeEndPeriod(ms) != 0:
+            raise ValueError(f"a timer period of {ms} ms was not requested")
+
+    @staticmethod
+    def measure_jitter(samples: int, period_ns: int) -> Tuple[int, int, int]:
+        """Spins until each of a series of deadlines ``period_ns`` apart and
+        accumulates how late the thread saw them.  Each deadline is counted
+        from when the previous one was seen.
+
+        :param int samples: The number of deadlines
+        :param int period_ns: The time between deadlines in nanoseconds
+        :return: The number of samples, and the maximum and total time they
+            were seen late in nanoseconds
+        :rtype: tuple
+        """
+
+        max_late = 0
+        total_late = 0
+        seen = time.perf_counter_ns()
+        for _ in range(samples):
+            due = seen + period_ns
+            seen = time.perf_counter_ns()
+            while seen < due:
+                seen = time.perf_counter_ns()
+            max_late = max(max_late, seen - due)
+            total_late += seen - due
+        return samples, max_late, total_late
+
+    # pylint: disable=too-many-arguments
+    def spp_strobe_byte(
+        self,
+        base_address: int,
+        control: int,
+        value: int,
+        setup_ns: int,
+        pulse_ns: int,
+        hold_ns: int,
+    ) -> None:
+        """Put a byte on the data lines and pulse STROBE with the given timing
+
+        :param int base_address: The SPP base address
+        :param int control: The idle state of the Control register
+        :param int value: The byte to send
+        :param int setup_ns: The data setup time in nanoseconds
+        :param int pulse_ns: The STROBE pulse width in nanoseconds
+        :param int hold_ns: The data hold time in nanoseconds
+        """
+
+        control_port = base_address + 2
+        control &= 0b11111110
+        start = time.perf_counter_ns()
+        self.DlPortWritePortUchar(base_address, value)
+        while time.perf_counter_ns() - start < setup_ns:
+            pass
+        start = time.perf_counter_ns()
+        self.DlPortWritePortUchar(control_port, control | 0b00000001)
+        while time.perf_counter_ns() - start < pulse_ns:
+            pass
+        start = time.perf_counter_ns()
+        self.DlPortWritePortUchar(control_port, control)
+        while time.perf_counter_ns() - start < hold_ns:
+            pass
+
+    # pylint: disable=too-many-arguments
+    def spp_write_buffer(
+        self,
+        base_address: int,
+        control: int,
+        data: Union[bytes, bytearray, memoryview],
+        timeout: Optional[float],
+        hold_while_busy: bool,
+        setup_ns: int,
+        pulse_ns: int,
+        hold_ns: int,
+    ) -> Tuple[int, bool]:
+        """Send a bytes-like object using the SPP handshake
+
+        :param int base_address: The SPP base address
+        :param int control: The idle state of the Control register
+        :param data: The data to send
+        :type data: bytes|bytearray|memoryview
+        :param float|None timeout: How long to wait for the peripheral to
+            be ready for each byte in seconds, or None to wait indefinitely
+        :param bool hold_while_busy: Whether to wait for the peripheral to
+            be ready after the last byte
+        :param int setup_ns: The data setup time in nanoseconds
+        :param int pulse_ns: The STROBE pulse width in nanoseconds
+        :param int hold_ns: The data hold time in nanoseconds
+        :return: The number of bytes sent, and whether the transfer
+            completed before the timeout
+        :rtype: tuple
+        """
+
+        status_port = base_address + 1
+        sent = 0
+        for value in memoryview(data).cast("B"):
+            if not self._wait_not_busy(status_port, timeout):
+                return sent, False
+            self.spp_strobe_byte(
+                base_address, control, value, setup_ns, pulse_ns, hold_ns
+            )
+            sent += 1
+        if hold_while_busy and not self._wait_not_busy(status_port, timeout):
+            return sent, False
+        return sent, True
+
+    # pylint: disable=too-many-arguments
+    def spp_measure_strobe(
+        self,
+        base_address: int,
+        control: int,
+        setup_ns: int,
+        pulse_ns: int,
+        hold_ns: int,
+        iterations: int,
+    ) -> Tuple[int, int, int]:
+        """Measure the mean achieved setup, pulse and hold times by running
+        the strobe sequence without changing any lines
+
+        :param int base_address: The SPP base address
+        :param int control: The current state of the Control register
+        :param int setup_ns: The data setup time in nanoseconds
+        :param int pulse_ns: The STROBE pulse width in nanoseconds
+        :param int hold_ns: The data hold time in nanoseconds
+        :param int iterations: The number of times to run the sequence
+        :return: The mean achieved setup, pulse and hold times in
+            nanoseconds
+        :rtype: tuple
+        """
+
+        control_port = base_address + 2
+        totals = [0, 0, 0]
+        for _ in range(iterations):
+            marks = []
+            for duration in (setup_ns, pulse_ns, hold_ns):
+                start = time.perf_counter_ns()
+                marks.append(start)
+                self.DlPortWritePortUchar(control_port, control)
+                while time.perf_counter_ns() - start < duration:
+                    pass
+            marks.append(time.perf_counter_ns())
+            for index in range(3):
+                totals[index] += marks[index + 1] - marks[index]
+        if not iterations:
+            return 0, 0, 0
+        return tuple(total // iterations for total in totals)
+
+
+Backend = Union[ModuleType, CtypesBackend]
+
+
+_ctypes_backends: Dict[str, CtypesBackend] = {}
+_ctypes_backends_lock = threading.Lock()
+
+
+def load_backend(windll_location: Optional[str] = None) -> Backend:
+    """Get the backend to use for the given DLL.  The native extension is
+    only used for the DLL included in this package, as that is what it
+    links against.  Other DLLs are loaded the first time they are used, and
+    the same ``CtypesBackend`` is returned for each later use of the path.
+
+    :param str|None windll_location: (optional) The location of the DLL,
+        default is to use the one included in this package
+    :return: The native extension module if it can be used, or a
+        CtypesBackend otherwise
+    :rtype: module|CtypesBackend
+    """
+
+    if windll_location is None:
+        windll_location = DEFAULT_WINDLL_LOCATION
+    key = _backend_key(windll_location)
+    if native is not None and key == os.path.normcase(DEFAULT_WINDLL_LOCATION):
+        return native
+    with _ctypes_backends_lock:
+        backend = _ctypes_backends.get(key)
+        if backend is None:
+            backend = CtypesBackend(windll_location)
+            _ctypes_backends[key] = backend
+        return backend
+
+
+def register_backend(windll_location: str, backend: CtypesBackend) -> None:
+    """Makes ``load_backend()`` return the given backend for a DLL location,
+    in place of loading the DLL.  This is how a ``SimulatedBackend`` is
+    used by the port classes.
+
+    :param str windll_location: The location the ports will be given
+    :param CtypesBackend backend: The backend to use for it
+    """
+
+    with _ctypes_backends_lock:
+        _ctypes_backends[_backend_key(windll_location)] = backend
+
+
+def _backend_key(windll_location: str) -> str:
+    """Returns the normalised DLL location that backends are cached by
+
+    :param str windll_location: The location of the DLL
+    :rtype: str
+    """
+
+    return os.path.normcase(os.path.abspath(windll_location))
@@ -0,0 +1,296 @@
+# SPDX-FileCopyrightText: 2022 Alec Delaney
+#
+# SPDX-License-Identifier: MIT
+
+"""
+`parallel64.base`
+
+The base class for all ports, including JSON configuration handling
+
+
+* Author(s): Alec Delaney
+
+"""
+
+import json
+from typing import Any, Optional, Sequence, Dict, List, Tuple, Union
+from parallel64.backend import DEFAULT_WINDLL_LOCATION, load_backend, native
+from parallel64.capabilities import EcpCapabilities
+from parallel64.constants import ThreadPriority
+from parallel64.metrics import RegisterMetrics
+from parallel64.realtime import RealtimeScope
+
+
+# pylint: disable=too-few-public-methods
+class _BasePort:
+    """
+    Base class for all ports
+
+    Register access goes through the ``parallel64._native`` extension when it
+    has been built and the DLL included in this package is used, and through
+    ``ctypes`` otherwise.
+
+    :param str|None windll_location: (optional) The location of the DLL required
+        to use the parallel port, default is to use the one included in this package
+    """
+
+    def __init__(self, windll_location: Optional[str] = None) -> None:
+
+        if windll_location is None:
+            windll_location = DEFAULT_WINDLL_LOCATION
+        self._windll_location = windll_location
+        self._port = load_backend(windll_location)
+
+    @property
+    def uses_native(self) -> bool:
+        """Returns whether the port is using the native extension for register
+        access, as opposed to ``ctypes``
+        """
+        return native is not None and self._port is native
+
+    def _register_ranges(self) -> List[Tuple[int, int, int]]:
+        """Returns the registers of the port, as ranges for direct I/O and
+        memory mapping
+
+        :return: The first address, the number of addresses and an address
+            that can be read without side effects, for each range
+        :rtype: list
+        """
+        raise NotImplementedError("Must be implemented in subclass")
+
+    def use_direct_io(self, enable: bool = True) -> bool:
+        """Selects whether the registers of the port are accessed with the
+        ``in`` and ``out`` instructions directly, rather than through the
+        InpOut driver, avoiding a kernel transition for each access.  This
+        needs the native extension and a process with I/O privilege for the
+        registers, such as granted by a helper driver.  Access is tested by
+        reading a register without side effects, and the port falls back to
+        the driver if it fails.
+
+        The selection is made for the register addresses, so it applies to
+        every port object using them in this process.  Memory-mapped
+        registers keep using their mapping.
+
+        :param bool enable: (optional) Whether to use direct I/O, default is
+            to use it (True)
+        :return: Whether direct I/O is used for all the registers
+        :rtype: bool
+        """
+
+        ranges = self._register_ranges()
+        if self.uses_mmio:
+            return False
+        if enable and all(self._port.enable_direct_io(*entry) for entry in ranges):
+            return True
+        for base, count, _ in ranges:
+            self._port.disable_direct_io(base, count)
+        return False
+
+    @property
+    def uses_direct_io(self) -> bool:
+        """Returns whether the registers of the port are accessed with the
+        ``in`` and ``out`` instructions, as selected with ``use_direct_io()``
+        """
+        return all(
+            self._port.direct_io_enabled(base) for base, _, _ in self._register_ranges()
+        )
+
+    def _map_registers(self, mmio_address: int, origin: int) -> None:
+        """Maps the registers of the port from physical memory, so they are
+        accessed with loads and stores instead of driver calls.  The register
+        at ``origin`` is at ``mmio_address``, and the others at the same
+        offsets from it as their addresses.
+
+        :param int mmio_address: The physical address of the register at
+            ``origin``
+        :param int origin: The address of the register at ``mmio_address``
+        :raises ValueError: If the registers are already mapped to different
+            physical addresses
+        :raises OSError: If the registers could not be mapped
+        """
+
+        for base, count, _ in self._register_ranges():
+            self._port.map_mmio(base, count, mmio_address + base - origin)
+
+    @property
+    def uses_mmio(self) -> bool:
+        """Returns whether the registers of the port are memory mapped, as
+        requested with ``mmio_address``
+        """
+        return all(
+            self._port.mmio_mapped(base) for base, _, _ in self._register_ranges()
+        )
+
+    def realtime(
+        self,
+        cpu: Optional[int] = None,
+        priority: Optional[ThreadPriority] = ThreadPriority.TIME_CRITICAL,
+        mmcss_task: Optional[str] = None,
+        timer_resolution_ms: Optional[int] = 1,
+    ) -> RealtimeScope:
+        """Creates a scope that raises the scheduling of the calling thread
+        for the transfers run inside it, restoring it on exit.  See
+        :class:`parallel64.RealtimeScope` for the parameters.
+
+        :rtype: RealtimeScope
+        """
+
+        return RealtimeScope(self._port, cpu, priority, mmcss_task, timer_resolution_ms)
+
+    @property
+    def metrics_enabled(self) -> bool:
+        """Returns whether the register access metrics are recorded, which
+        requires the native extension to be built with ``PARALLEL64_METRICS``
+        set, or that variable to be set when using a different DLL
+        """
+        return self._port.metrics_enabled()
+
+    def metrics(self) -> Dict[int, RegisterMetrics]:
+        """Returns the accesses to the registers of the port and the waits
+        on them since the metrics were last reset
+
+        :return: The metrics of each register that has been used, keyed by
+            its address
+        :rtype: dict
+        :raises RuntimeError: If the metrics are not enabled
+        """
+
+        results = {}
+        for base, count, _ in self._register_ranges():
+            for address in range(base, base + count):
+                values = self._port.register_metrics(address)
+                if values is not None:
+                    results[address] = RegisterMetrics(*values)
+        return results
+
+    def reset_metrics(self) -> None:
+        """Resets the metrics of the registers of the port
+
+        :raises RuntimeError: If the metrics are not enabled
+        """
+
+        for base, count, _ in self._register_ranges():
+            for address in range(base, base + count):
+                self._port.reset_register_metrics(address)
+
+    @staticmethod
+    def _load_json(json_filepath: str) -> Dict[str, Any]:
+        """Loads the contents of a JSON configuration file
+
+        :param str json_filepath: The path to the JSON file
+        :rtype: dict
+        """
+
+        with open(json_filepath, mode="r", encoding="utf-8") as json_file:
+            return json.load(json_file)
+
+    @staticmethod
+    def _parse_json_dict(
+        json_contents: Dict[str, Any],
+        port_params: List[str],
+        optional_params: Sequence[str] = (),
+    ) -> Dict[str, Union[int, str]]:
+        """
+        Parses the contents of a JSON configuration for the given parameters
+
+        :param dict json_contents: The contents of the JSON configuration
+        :param list port_params: A list of the parameters to get from
+            the JSON file as strings
+        :param list optional_params: (optional) A list of the parameters to
+            get from the JSON file as strings if they are present
+        :return: A dictionary containing the contents of the JSON file
+            that can be used to instance a _BasePort object
+        :rtype: dict
+        :raises KeyError: If an expected key is missing in the JSON
+            file
+        :raises TypeError: If the ports are not written as hex
+            strings
+        """
+
+        json_params = {}
+        present_optional = [key for key in optional_params if key in json_contents]
+        for key in (*port_params, *present_optional):
+            try:
+                json_params[key] = int(json_contents[key], 16)
+            except KeyError as err:
+                raise KeyError(
+                    f"Unable to find {key} parameter in the JSON file, "
+                    "see reference documentation"
+                ) from err
+            except (ValueError, TypeError) as err:
+                raise TypeError(
+                    "Ports must be hex strings (e.g. '0x1C64'), see reference documentation"
+                ) from err
+        json_params["windll_location"] = json_contents.get("windll_location", None)
+        if "ecp_base_address" in json_params and "ecp_capabilities" in json_contents:
+            json_params["ecp_capabilities"] = EcpCapabilities.from_json_dict(
+                json_contents["ecp_capabilities"]
+            )
+
+        return json_params
+
+    @classmethod
+    def _create_from_json_dict(
+        cls,
+        json_contents: Dict[str, Any],
+        port_params: List[str],
+        optional_params: Sequence[str] = (),
+    ) -> "_BasePort":
+        """Create a _BasePort from the contents of a JSON configuration
+        containing the given parameters
+
+        :param dict json_contents: The contents of the JSON configuration
+        :param list port_params: A list of the params to get from the
+            JSON file as strings
+        :param list optional_params: (optional) A list of the params to get
+            from the JSON file as strings if they are present
+        :return: An instance of a _BasePort
+        :rtype: _BasePort
+        """
+
+        json_params = cls._parse_json_dict(json_contents, port_params, optional_params)
+        return cls(**json_params)
+
+    @classmethod
+    def from_json(cls, json_filepath: str) -> "_BasePort":
+        """Factory method for creating and instance of a port from a JSON
+        file containing the necessary information
+
+        :param str json_filepath: Filepath to the JSON
+        :return: An instance of the port
+        :rtype: _BasePort
+        """
+        return cls.from_json_dict(cls._load_json(json_filepath))
+
+    @classmethod
+    def from_json_dict(cls, json_contents: Dict[str, Any]) -> "_BasePort":
+        """Factory method for creating an instance of a port from the
+        contents of a JSON configuration, such as one entry of a
+        :class:`parallel64.PortGroup` configuration
+
+        :param dict json_contents: The contents of the JSON configuration
+        :return: An instance of the port
+        :rtype: _BasePort
+        """
+        raise NotImplementedError("Must be implemented in subclass")
+
+    def _json_contents(self) -> Dict[str, Any]:
+        """Returns the configuration of the port in the form used by
+        ``from_json()``
+
+        :rtype: dict
+        """
+
+        if self._windll_location == DEFAULT_WINDLL_LOCATION:
+            return {}
+        return {"windll_location": self._windll_location}
+
+    def save_json(self, json_filepath: str) -> None:
+        """Saves the configuration of the port, including any detected
+        capabilities, to a JSON file that can be used with ``from_json()``
+
+        :param str json_filepath: Filepath to the JSON
+        """
+
+        with open(json_filepath, mode="w", encoding="utf-8") as json_file:
+            json.dump(self._json_contents(), json_file, indent=4)
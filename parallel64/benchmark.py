@@ -0,0 +1,441 @@
+# SPDX-FileCopyrightText: 2022 Alec Delaney
+#
+# SPDX-License-Identifier: MIT
+
+"""
+`parallel64.benchmark`
+
+Benchmarks of register access, pin toggling, snapshots and the SPP, EPP and
+ECP transfers, run against a port or the simulator.  The results are
+written as JSON, so that they can be compared between releases:
+
+.. code-block:: shell
+
+    python -m parallel64.benchmark --simulate --latency-ns 1000 -o results.json
+    python -m parallel64.benchmark --spp-base 0x378 --ecp-base 0x778
+
+The transfer benchmarks need a peripheral that follows the handshakes;
+those that fail are recorded with their error rather than stopping the
+run.  On systems other than Windows, set ``PARALLEL64_SIMULATOR`` in the
+environment to run against the simulator.
+
+
+* Author(s): Alec Delaney
+
+"""
+
+import argparse
+import datetime
+import json
+import platform
+import sys
+import time
+from importlib import metadata
+from typing import Any, Callable, Dict, List, NamedTuple, Optional, Sequence
+from parallel64.backend import CtypesBackend, load_backend
+from parallel64.enhanced import EnhancedPort
+from parallel64.extended import ExtendedPort
+from parallel64.gpio import GPIOPort
+from parallel64.simulator import (
+    SimulatedBackend,
+    SimulatedPeripheral,
+    SimulatedRegisters,
+)
+from parallel64.standard import StandardPort
+
+SCHEMA_VERSION = 1
+"""The version of the layout of the JSON results, increased whenever a
+field changes meaning"""
+
+
+class BenchmarkConfig(NamedTuple):
+    """The port and sizes the benchmarks are run with
+
+    :param int spp_base_address: The SPP base address
+    :param int|None ecp_base_address: The ECP base address, or None to skip
+        the benchmarks needing the FIFO
+    :param str|None windll_location: The location of the DLL, or None for
+        the one included in this package
+    :param int iterations: The number of calls timed for each latency
+    :param int transfer_size: The number of bytes in each transfer
+    :param int transfers: The number of transfers timed for each throughput
+    """
+
+    spp_base_address: int = 0x378
+    ecp_base_address: Optional[int] = None
+    windll_location: Optional[str] = None
+    iterations: int = 10000
+    transfer_size: int = 4096
+    transfers: int = 16
+
+
+def time_calls(function: Callable[[], Any], iterations: int) -> Dict[str, float]:
+    """Times each of a number of calls to a function
+
+    :param function: The function to call
+    :param int iterations: The number of calls
+    :return: The mean, minimum, median, 99th percentile and maximum time of
+        a call in nanoseconds, and the calls per second
+    :rtype: dict
+    """
+
+    clock = time.perf_counter_ns
+    samples = [0] * iterations
+    total_start = clock()
+    for index in range(iterations):
+        start = clock()
+        function()
+        samples[index] = clock() - start
+    total_ns = clock() - total_start
+    samples.sort()
+    return {
+        "iterations": iterations,
+        "mean_ns": total_ns / iterations,
+        "min_ns": samples[0],
+        "p50_ns": samples[iterations // 2],
+        "p99_ns": samples[min(iterations * 99 // 100, iterations - 1)],
+        "max_ns": samples[-1],
+        "calls_per_second": iterations * 1e9 / total_ns if total_ns else 0.0,
+    }
+
+
+def time_transfers(
+    transfer: Callable[[], Any], size: int, transfers: int
+) -> Dict[str, float]:
+    """Times a number of transfers of the same size
+
+    :param transfer: The function doing one transfer
+    :param int size: The number of bytes in each transfer
+    :param int transfers: The number of transfers
+    :return: The bytes moved, the time taken and the throughput
+    :rtype: dict
+    """
+
+    start = time.perf_counter_ns()
+    for _ in range(transfers):
+        transfer()
+    elapsed_ns = time.perf_counter_ns() - start
+    return {
+        "transfers": transfers,
+        "bytes": size * transfers,
+        "seconds": elapsed_ns / 1e9,
+        "bytes_per_second": size * transfers * 1e9 / elapsed_ns if elapsed_ns else 0.0,
+    }
+
+
+def _read_latency(config: BenchmarkConfig) -> Dict[str, Any]:
+    port = StandardPort(
+        config.spp_base_address, config.windll_location, bidirectional=True
+    )
+    return time_calls(port.read_status_register, config.iterations)
+
+
+def _write_latency(config: BenchmarkConfig) -> Dict[str, Any]:
+    port = StandardPort(
+        config.spp_base_address, config.windll_location, bidirectional=True
+    )
+    return time_calls(lambda: port.write_data_register(0x55), config.iterations)
+
+
+def _gpio_toggle(config: BenchmarkConfig) -> Dict[str, Any]:
+    port = GPIOPort(config.spp_base_address, config.windll_location, bidirectional=True)
+    pin = port.pins.D0
+    state = [False]
+
+    def toggle() -> None:
+        state[0] = not state[0]
+        port.write_pin(pin, state[0])
+
+    return time_calls(toggle, config.iterations)
+
+
+def _snapshot(config: BenchmarkConfig) -> Dict[str, Any]:
+    port = GPIOPort(
+        config.spp_base_address,
+        config.windll_location,
+        clear_gpio=False,
+        bidirectional=True,
+    )
+    return time_calls(port.snapshot, config.iterations)
+
+
+def _spp_write(config: BenchmarkConfig) -> Dict[str, Any]:
+    port = StandardPort(
+        config.spp_base_address, config.windll_location, bidirectional=True
+    )
+    size = config.transfer_size
+    data = bytes(range(256)) * (size // 256) + bytes(size % 256)
+    return time_transfers(
+        lambda: port.write_spp_buffer(data), len(data), config.transfers
+    )
+
+
+def _spp_fifo_write(config: BenchmarkConfig) -> Dict[str, Any]:
+    port = StandardPort(
+        config.spp_base_address,
+        config.windll_location,
+        ecp_base_address=config.ecp_base_address,
+        bidirectional=True,
+    )
+    data = bytes(config.transfer_size)
+    return time_transfers(
+        lambda: port.write_spp_buffer(data), len(data), config.transfers
+    )
+
+
+def _epp_write(config: BenchmarkConfig) -> Dict[str, Any]:
+    port = EnhancedPort(
+        config.spp_base_address, config.windll_location, bidirectional=True
+    )
+    data = bytes(config.transfer_size)
+    return time_transfers(
+        lambda: port.write_epp_block(data), len(data), config.transfers
+    )
+
+
+def _epp_read(config: BenchmarkConfig) -> Dict[str, Any]:
+    port = EnhancedPort(
+        config.spp_base_address, config.windll_location, bidirectional=True
+    )
+    buffer = bytearray(config.transfer_size)
+    return time_transfers(
+        lambda: port.read_epp_block_into(buffer), len(buffer), config.transfers
+    )
+
+
+def _ecp_port(config: BenchmarkConfig) -> ExtendedPort:
+    return ExtendedPort(
+        config.ecp_base_address, config.windll_location, config.spp_base_address
+    )
+
+
+def _ecp_write(config: BenchmarkConfig) -> Dict[str, Any]:
+    port = _ecp_port(config)
+    data = bytes(config.transfer_size)
+    return time_transfers(
+        lambda: port.write_ecp_buffer(data), len(data), config.transfers
+    )
+
+
+def _ecp_read(config: BenchmarkConfig) -> Dict[str, Any]:
+    port = _ecp_port(config)
+    buffer = bytearray(config.transfer_size)
+    return time_transfers(
+        lambda: port.read_ecp_buffer_into(buffer), len(buffer), config.transfers
+    )
+
+
+BENCHMARKS: Dict[str, Callable[[BenchmarkConfig], Dict[str, Any]]] = {
+    "read_latency": _read_latency,
+    "write_latency": _write_latency,
+    "gpio_toggle": _gpio_toggle,
+    "snapshot": _snapshot,
+    "spp_write": _spp_write,
+    "spp_fifo_write": _spp_fifo_write,
+    "epp_write": _epp_write,
+    "epp_read": _epp_read,
+    "ecp_write": _ecp_write,
+    "ecp_read": _ecp_read,
+}
+"""The benchmarks that can be run, by name"""
+
+_NEEDS_ECP = ("spp_fifo_write", "ecp_write", "ecp_read")
+
+# The usual offset of the ECP registers from the SPP base address
+_ECP_OFFSET = 0x400
+
+
+def run_benchmarks(
+    config: BenchmarkConfig, names: Optional[Sequence[str]] = None
+) -> Dict[str, Dict[str, Any]]:
+    """Runs benchmarks, recording the error of any that fails
+
+    :param BenchmarkConfig config: The port and sizes to use
+    :param list|None names: (optional) The benchmarks to run, as named in
+        ``BENCHMARKS``, default is to run them all
+    :return: The results of each benchmark, holding ``skipped`` or
+        ``error`` if it was not run or failed
+    :rtype: dict
+    :raises KeyError: If a benchmark name is unknown
+    """
+
+    if names is None:
+        names = list(BENCHMARKS)
+    results: Dict[str, Dict[str, Any]] = {}
+    for name in names:
+        benchmark = BENCHMARKS[name]
+        if name in _NEEDS_ECP and config.ecp_base_address is None:
+            results[name] = {"skipped": "no ECP base address was given"}
+            continue
+        try:
+            results[name] = benchmark(config)
+        except (OSError, ValueError) as err:
+            results[name] = {"error": f"{type(err).__name__}: {err}"}
+    return results
+
+
+def simulate(config: BenchmarkConfig, latency_ns: int = 0) -> BenchmarkConfig:
+    """Creates a ``SimulatedBackend`` with a port at the addresses of the
+    configuration, whose peripheral answers every handshake at once and
+    always has data to send.  The simulated port always has an ECR, at the
+    usual offset of 0x400 from the SPP base address unless the
+    configuration gives an ECP base address, so the ECP benchmarks run.
+
+    :param BenchmarkConfig config: The configuration to simulate
+    :param int latency_ns: (optional) How long each register access takes
+        in nanoseconds, default is 0
+    :return: The configuration using the simulator
+    :rtype: BenchmarkConfig
+    """
+
+    if config.ecp_base_address is None:
+        config = config._replace(ecp_base_address=config.spp_base_address + _ECP_OFFSET)
+    simulator = SimulatedBackend(SimulatedRegisters(latency_ns))
+    simulator.registers.add_port(
+        config.spp_base_address,
+        config.ecp_base_address,
+        SimulatedPeripheral(busy_reads=0, ack_reads=0, fill_byte=0x55),
+    )
+    return config._replace(windll_location=simulator.windll_location)
+
+
+def _backend_name(config: BenchmarkConfig) -> str:
+    """Returns the name of the backend the configuration uses
+
+    :param BenchmarkConfig config: The configuration
+    :rtype: str
+    """
+
+    backend = load_backend(config.windll_location)
+    if isinstance(backend, SimulatedBackend):
+        return "simulator"
+    return "ctypes" if isinstance(backend, CtypesBackend) else "native"
+
+
+def report(
+    config: BenchmarkConfig,
+    results: Dict[str, Dict[str, Any]],
+    latency_ns: Optional[int] = None,
+) -> Dict[str, Any]:
+    """Returns the JSON report of a run
+
+    :param BenchmarkConfig config: The configuration the run used
+    :param dict results: The results from ``run_benchmarks()``
+    :param int|None latency_ns: (optional) The simulated access latency, or
+        None if the run was not simulated, default is None
+    :rtype: dict
+    """
+
+    try:
+        package_version: Optional[str] = metadata.version("parallel64")
+    except metadata.PackageNotFoundError:
+        package_version = None
+    return {
+        "schema": SCHEMA_VERSION,
+        "timestamp": datetime.datetime.now(datetime.timezone.utc).isoformat(),
+        "parallel64": package_version,
+        "python": platform.python_version(),
+        "platform": platform.platform(),
+        "backend": _backend_name(config),
+        "metrics_enabled": load_backend(config.windll_location).metrics_enabled(),
+        "config": {
+            "spp_base_address": config.spp_base_address,
+            "ecp_base_address": config.ecp_base_address,
+            "iterations": config.iterations,
+            "transfer_size": config.transfer_size,
+            "transfers": config.transfers,
+            "simulated_latency_ns": latency_ns,
+        },
+        "results": results,
+    }
+
+
+def _address(text: str) -> int:
+    """Parses an address given in decimal, or in hexadecimal with ``0x``
+
+    :param str text: The address
+    :rtype: int
+    """
+    return int(text, 0)
+
+
+def _parse_args(argv: Optional[List[str]]) -> argparse.Namespace:
+    """Parses the command line arguments
+
+    :param list|None argv: The arguments, or None for those of the process
+    :rtype: argparse.Namespace
+    """
+
+    parser = argparse.ArgumentParser(
+        prog="python -m parallel64.benchmark", description="Benchmark parallel64"
+    )
+    parser.add_argument(
+        "--spp-base", type=_address, default=0x378, help="SPP base address"
+    )
+    parser.add_argument(
+        "--ecp-base",
+        type=_address,
+        help="ECP base address (default none, or SPP base + 0x400 when simulated)",
+    )
+    parser.add_argument(
+        "--windll-location", help="DLL to use instead of the included one"
+    )
+    parser.add_argument("--simulate", action="store_true", help="use the simulator")
+    parser.add_argument(
+        "--latency-ns", type=int, default=0, help="simulated register access latency"
+    )
+    parser.add_argument(
+        "--iterations", type=int, default=10000, help="calls per latency"
+    )
+    parser.add_argument("--size", type=int, default=4096, help="bytes per transfer")
+    parser.add_argument(
+        "--transfers", type=int, default=16, help="transfers per throughput"
+    )
+    parser.add_argument(
+        "--only",
+        nargs="+",
+        choices=list(BENCHMARKS),
+        help="benchmarks to run (default all)",
+    )
+    parser.add_argument(
+        "-o", "--output", help="file to write the JSON to (default stdout)"
+    )
+    return parser.parse_args(argv)
+
+
+def main(argv: Optional[List[str]] = None) -> int:
+    """Runs the benchmarks from the command line
+
+    :param list|None argv: (optional) The arguments, default is those of
+        the process
+    :return: The exit status, 1 if any benchmark failed
+    :rtype: int
+    """
+
+    args = _parse_args(argv)
+    if args.iterations < 1 or args.size < 1 or args.transfers < 1:
+        raise SystemExit("The iterations, size and transfers must be positive")
+    config = BenchmarkConfig(
+        args.spp_base,
+        args.ecp_base,
+        args.windll_location,
+        args.iterations,
+        args.size,
+        args.transfers,
+    )
+    latency_ns = None
+    if args.simulate:
+        latency_ns = args.latency_ns
+        config = simulate(config, latency_ns)
+    results = run_benchmarks(config, args.only)
+    contents = json.dumps(report(config, results, latency_ns), indent=4)
+    if args.output is None:
+        print(contents)
+    else:
+        with open(args.output, mode="w", encoding="utf-8") as output_file:
+            output_file.write(contents + "\n")
+    return int(any("error" in result for result in results.values()))
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,141 @@
+# SPDX-FileCopyrightText: 2022 Alec Delaney
+#
+# SPDX-License-Identifier: MIT
+
+"""
+`parallel64.capabilities`
+
+Hardware capabilities detected for a port, which can be saved to and
+loaded from the JSON configuration used by ``from_json()``, and the
+process-wide cache of detection results
+
+
+* Author(s): Alec Delaney
+
+"""
+
+import threading
+from typing import Any, Callable, NamedTuple, Optional, Dict, Tuple, TypeVar, Union
+
+_T = TypeVar("_T")
+
+_CONFIG_A_PWORD_SIZES = {0b000: 2, 0b001: 1, 0b010: 4}
+_CONFIG_B_IRQS = {
+    0b001: 7,
+    0b010: 9,
+    0b011: 10,
+    0b100: 11,
+    0b101: 14,
+    0b110: 15,
+    0b111: 5,
+}
+_CONFIG_B_DMAS = {0b001: 1, 0b010: 2, 0b011: 3, 0b101: 5, 0b110: 6, 0b111: 7}
+
+
+class EcpCapabilities(NamedTuple):
+    """The capabilities of a port's ECP FIFO, as detected using the FIFO
+    test and configuration modes of the ECR.  The defaults are
+    conservative values that are safe for any ECP FIFO.
+
+    Used with :class:`parallel64.ExtendedPort`
+
+    :param int fifo_depth: The depth of the FIFO in bytes, default is 16
+    :param int pword_size: The size of a PWord (the FIFO width) in bytes,
+        default is 1
+    :param int write_threshold: The number of bytes free in the FIFO when
+        it requests service during writes, default is 1
+    :param int read_threshold: The number of bytes available in the FIFO
+        when it requests service during reads, default is 1
+    :param int|None irq: The IRQ reported by the port, or None if it is
+        jumpered or unknown
+    :param int|None dma: The DMA channel reported by the port, or None if
+        it is jumpered or unknown
+    """
+
+    fifo_depth: int = 16
+    pword_size: int = 1
+    write_threshold: int = 1
+    read_threshold: int = 1
+    irq: Optional[int] = None
+    dma: Optional[int] = None
+
+    @staticmethod
+    def decode_config(config_a: int, config_b: int) -> Dict[str, Optional[int]]:
+        """Decodes the contents of the cnfgA and cnfgB registers
+
+        :param int config_a: The contents of the cnfgA register
+        :param int config_b: The contents of the cnfgB register
+        :return: The PWord size, IRQ and DMA channel, keyed by field name
+        :rtype: dict
+        """
+
+        return {
+            "pword_size": _CONFIG_A_PWORD_SIZES.get((config_a >> 4) & 0b111, 1),
+            "irq": _CONFIG_B_IRQS.get((config_b >> 3) & 0b111),
+            "dma": _CONFIG_B_DMAS.get(config_b & 0b111),
+        }
+
+    def to_json_dict(self) -> Dict[str, Optional[int]]:
+        """Returns the capabilities in the form stored in JSON files
+
+        :rtype: dict
+        """
+        return self._asdict()
+
+    @classmethod
+    def from_json_dict(
+        cls, json_dict: Dict[str, Union[int, None]]
+    ) -> "EcpCapabilities":
+        """Creates capabilities from the form stored in JSON files
+
+        :param dict json_dict: The stored capabilities
+        :return: The capabilities
+        :rtype: EcpCapabilities
+        :raises KeyError: If an unknown capability is present
+        """
+
+        unknown_keys = set(json_dict) - set(cls._fields)
+        if unknown_keys:
+            raise KeyError(
+                f"Unknown ECP capabilities in the JSON file: {', '.join(sorted(unknown_keys))}"
+            )
+        return cls(**json_dict)
+
+
+_MISSING = object()
+_detected: Dict[Tuple[Any, ...], Any] = {}
+_detected_lock = threading.RLock()
+
+
+def cached_detection(
+    key: Tuple[Any, ...], detect: Callable[[], _T], probe: bool = False
+) -> _T:
+    """Returns the result of a hardware detection, such as whether a port is
+    bidirectional, running it only the first time it is needed in this
+    process.  Detections are run one at a time, so ports created together
+    do not probe the same registers at once.
+
+    :param tuple key: What is detected, and the base addresses it is for
+    :param detect: The function running the detection
+    :param bool probe: (optional) Whether to run the detection again even if
+        a result is cached, default is to use a cached result (False)
+    :return: The cached or detected result
+    """
+
+    with _detected_lock:
+        if not probe:
+            result = _detected.get(key, _MISSING)
+            if result is not _MISSING:
+                return result
+        result = detect()
+        _detected[key] = result
+        return result
+
+
+def clear_capability_cache() -> None:
+    """Discards the cached detection results, so the next port created for
+    each base address probes the hardware again
+    """
+
+    with _detected_lock:
+        _detected.clear()
@@ -0,0 +1,389 @@
+# SPDX-FileCopyrightText: 2022 Alec Delaney
+#
+# SPDX-License-Identifier: MIT
+
+"""
+`parallel64.completion`
+
+The completion thread used for asynchronous operations when the native
+extension is unavailable.  Like the native one, a single thread advances
+every operation in turn, so any number of ports can be polled without a
+thread each, but it needs the GIL to do so and polls much more slowly.
+
+
+* Author(s): Alec Delaney
+
+"""
+
+import threading
+import time
+import traceback
+from typing import Callable, Generator, List, Optional, Tuple, Union
+
+Operation = Generator[bool, None, object]
+"""An operation, which yields whether each step made progress and returns
+its result
+"""
+
+CompletionCallback = Callable[[object], None]
+
+
+class CtypesCompleter:
+    """
+    A thread that advances operations until they finish and then calls
+    their callbacks with their results, or with None if they were
+    cancelled.  It backs off as set by the wait policy while no operation is
+    making progress.
+
+    :param policy: A function returning the spin and yield times of the
+        wait policy, in nanoseconds
+    """
+
+    def __init__(self, policy: Callable[[], Tuple[int, int]]) -> None:
+        self._policy = policy
+        self._condition = threading.Condition()
+        self._incoming: List[Tuple[int, Operation, CompletionCallback]] = []
+        self._cancels: List[int] = []
+        self._pending = 0
+        self._next_id = 1
+        self._stop_requested = False
+        self._thread: Optional[threading.Thread] = None
+
+    @property
+    def pending(self) -> int:
+        """The number of operations that have not finished"""
+        with self._condition:
+            return self._pending
+
+    def submit(self, operation: Operation, callback: CompletionCallback) -> int:
+        """Queues an operation, starting the thread if needed
+
+        :param operation: The operation to run
+        :param callback: The function to call with its result
+        :return: The id of the operation
+        :rtype: int
+        """
+
+        with self._condition:
+            if self._thread is None:
+                self._stop_requested = False
+                self._thread = threading.Thread(target=self._run, daemon=True)
+                self._thread.start()
+            operation_id = self._next_id
+            self._next_id += 1
+            self._incoming.append((operation_id, operation, callback))
+            self._pending += 1
+            self._condition.notify()
+        return operation_id
+
+    def cancel(self, operation_id: int) -> None:
+        """Stops an operation, whose callback is then called with None
+
+        :param int operation_id: The id of the operation
+        """
+
+        with self._condition:
+            self._cancels.append(operation_id)
+            self._condition.notify()
+
+    def shutdown(self) -> None:
+        """Stops the thread, cancelling the operations still running"""
+
+        with self._condition:
+            thread = self._thread
+            if thread is None:
+                return
+            self._stop_requested = True
+            self._condition.notify()
+        if thread is not threading.current_thread():
+            thread.join()
+
+    def _run(self) -> None:
+        """Advances the operations until asked to stop"""
+
+        active: List[Tuple[int, Operation, CompletionCallback]] = []
+        idle_since = time.perf_counter_ns()
+        while True:
+            with self._condition:
+                if not active:
+                    self._condition.wait_for(
+                        lambda: self._stop_requested or self._incoming
+                    )
+                if self._incoming:
+                    idle_since = time.perf_counter_ns()
+                active.extend(self._incoming)
+                self._incoming.clear()
+                cancels, self._cancels = self._cancels, []
+                if self._stop_requested:
+                    self._thread = None
+                    break
+            progressed = False
+            still_active = []
+            for operation_id, operation, callback in active:
+                if operation_id in cancels:
+                    operation.close()
+                    self._complete(callback, None)
+                    progressed = True
+                    continue
+                try:
+                    progressed = next(operation) or progressed
+                except StopIteration as finished:
+                    self._complete(callback, finished.value)
+                    progressed = True
+                    continue
+                still_active.append((operation_id, operation, callback))
+            active = still_active
+            if progressed:
+                idle_since = time.perf_counter_ns()
+            elif active:
+                self._back_off(time.perf_counter_ns() - idle_since)
+        for _, operation, callback in active:
+            operation.close()
+            self._complete(callback, None)
+
+    def _back_off(self, idle_ns: int) -> None:
+        """Waits before the next pass once no operation has made progress
+        for a while
+
+        :param int idle_ns: How long no operation has made progress, in
+            nanoseconds
+        """
+
+        spin_ns, yield_ns = self._policy()
+        if idle_ns < spin_ns:
+            return
+        if idle_ns < spin_ns + yield_ns:
+            time.sleep(0)
+            return
+        with self._condition:
+            self._condition.wait_for(
+                lambda: self._stop_requested or self._incoming or self._cancels, 0.001
+            )
+
+    def _complete(self, callback: CompletionCallback, result: object) -> None:
+        """Calls the callback of a finished operation
+
+        :param callback: The callback
+        :param result: The result of the operation
+        """
+
+        try:
+            callback(result)
+        except Exception:  # pylint: disable=broad-except
+            traceback.print_exc()
+        with self._condition:
+            self._pending -= 1
+
+
+class CtypesCompletions:
+    """
+    The asynchronous operations of ``CtypesBackend``, which share one
+    ``CtypesCompleter`` across every port.  They mirror the ``submit_*``
+    functions of ``parallel64._native``: each queues an operation, returns
+    its id and later calls the callback with its result.
+    """
+
+    _completer: Optional[CtypesCompleter] = None
+    _completer_lock = threading.Lock()
+
+    # Provided by CtypesBackend
+    DlPortReadPortUchar: Callable[[int], int]
+    get_wait_policy: Callable[[], Tuple[int, int]]
+    _record_wait: Callable[[int, bool], None]
+    spp_strobe_byte: Callable[..., None]
+    epp_write_regs: Callable[..., bool]
+    epp_read_regs: Callable[..., Tuple[bytes, bool]]
+
+    @classmethod
+    def _shared_completer(cls) -> CtypesCompleter:
+        """Returns the completer shared by every port, creating it if needed
+
+        :rtype: CtypesCompleter
+        """
+
+        with cls._completer_lock:
+            if CtypesCompletions._completer is None:
+                CtypesCompletions._completer = CtypesCompleter(cls.get_wait_policy)
+            return CtypesCompletions._completer
+
+    @classmethod
+    def cancel_operation(cls, operation_id: int) -> None:
+        """Stops an operation, whose callback is then called with None
+
+        :param int operation_id: The id of the operation
+        """
+        cls._shared_completer().cancel(operation_id)
+
+    @classmethod
+    def pending_operations(cls) -> int:
+        """Returns the number of operations that have not finished
+
+        :rtype: int
+        """
+        return cls._shared_completer().pending
+
+    @classmethod
+    def shutdown_completer(cls) -> None:
+        """Stops the completion thread, cancelling the operations still
+        running.  It is started again by the next operation.
+        """
+        cls._shared_completer().shutdown()
+
+    def submit_wait_bits(
+        self,
+        port: int,
+        mask: int,
+        value: int,
+        timeout: Optional[float],
+        callback: CompletionCallback,
+    ) -> int:
+        """Polls the port until the masked bits equal the value, then calls
+        the callback with whether they did before the timeout
+
+        :rtype: int
+        """
+
+        return self._shared_completer().submit(
+            self._wait_bits(port, mask, value, timeout), callback
+        )
+
+    # pylint: disable=too-many-arguments
+    def submit_spp_write(
+        self,
+        base_address: int,
+        control: int,
+        data: Union[bytes, bytearray, memoryview],
+        timeout: Optional[float],
+        hold_while_busy: bool,
+        setup_ns: int,
+        pulse_ns: int,
+        hold_ns: int,
+        callback: CompletionCallback,
+    ) -> int:
+        """Sends a bytes-like object using the SPP handshake, then calls the
+        callback with the result ``spp_write_buffer()`` returns
+
+        :rtype: int
+        """
+
+        return self._shared_completer().submit(
+            self._spp_write(
+                base_address,
+                control,
+                memoryview(data).cast("B"),
+                timeout,
+                hold_while_busy,
+                (setup_ns, pulse_ns, hold_ns),
+            ),
+            callback,
+        )
+
+    def submit_epp_write_regs(
+        self,
+        spp_base_address: int,
+        address: int,
+        data: Union[bytes, bytearray, memoryview],
+        width: int,
+        callback: CompletionCallback,
+    ) -> int:
+        """Runs ``epp_write_regs()`` on the completion thread, then calls the
+        callback with its result
+
+        :rtype: int
+        """
+
+        return self._shared_completer().submit(
+            self._run_once(self.epp_write_regs, spp_base_address, address, data, width),
+            callback,
+        )
+
+    def submit_epp_read_regs(
+        self,
+        spp_base_address: int,
+        address: int,
+        length: int,
+        width: int,
+        control: Optional[int],
+        callback: CompletionCallback,
+    ) -> int:
+        """Runs ``epp_read_regs()`` on the completion thread, then calls the
+        callback with its result
+
+        :rtype: int
+        """
+
+        return self._shared_completer().submit(
+            self._run_once(
+                self.epp_read_regs, spp_base_address, address, length, width, control
+            ),
+            callback,
+        )
+
+    @staticmethod
+    def _run_once(function: Callable[..., object], *args: object) -> Operation:
+        """An operation that calls a function once and finishes with its
+        result
+        """
+
+        return function(*args)
+        yield  # pylint: disable=unreachable
+
+    def _wait_bits(
+        self, port: int, mask: int, value: int, timeout: Optional[float]
+    ) -> Operation:
+        """An operation polling the port until the masked bits equal the
+        value, finishing with whether they did before the timeout
+        """
+
+        read_port = self.DlPortReadPortUchar
+        start = time.perf_counter_ns()
+        deadline = None if timeout is None else start + int(timeout * 1e9)
+        first_poll = True
+        while True:
+            if read_port(port) & mask == value:
+                matched = True
+                break
+            if deadline is not None and time.perf_counter_ns() >= deadline:
+                matched = read_port(port) & mask == value
+                break
+            first_poll = False
+            yield False
+        # As with wait_port_bits(), a wait its first poll satisfied is not
+        # counted
+        if not first_poll:
+            self._record_wait(time.perf_counter_ns() - start, matched)
+        return matched
+
+    # pylint: disable=too-many-arguments
+    def _spp_write(
+        self,
+        base_address: int,
+        control: int,
+        data: memoryview,
+        timeout: Optional[float],
+        hold_while_busy: bool,
+        timing: Tuple[int, int, int],
+    ) -> Operation:
+        """An operation sending the data with the SPP handshake, finishing
+        with the number of bytes sent and whether the transfer completed
+        before the peripheral stayed busy past the timeout
+        """
+
+        status_port = base_address + 1
+        read_port = self.DlPortReadPortUchar
+        timeout_ns = None if timeout is None else int(timeout * 1e9)
+        sent = 0
+        while sent < len(data) or hold_while_busy:
+            deadline = (
+                None if timeout_ns is None else time.perf_counter_ns() + timeout_ns
+            )
+            while not read_port(status_port) & 0b10000000:
+                if deadline is not None and time.perf_counter_ns() >= deadline:
+                    return sent, False
+                yield False
+            if sent == len(data):
+                break
+            self.spp_strobe_byte(base_address, control, data[sent], *timing)
+            sent += 1
+            yield True
+        return sent, True
@@ -13,7 +13,7 @@ parrallel port
 
 """
 
-from enum import Enum
+from enum import Enum, IntEnum
 
 
 class Direction(Enum):
@@ -36,8 +36,46 @@ class CommMode(Enum):
 
     SPP = 0
     BYTE = 1
-    # SPP_FIFO = 2
-    # ECP_FIFO = 3
+    SPP_FIFO = 2
+    ECP_FIFO = 3
     EPP = 4
-    # FIFO_TEST = 6
-    # CONFIG = 7
+    FIFO_TEST = 6
+    CONFIG = 7
+
+
+class Ieee1284Mode(IntEnum):
+    """Enum class representing the IEEE 1284 reverse-channel modes, with
+    the extensibility byte used to negotiate each
+
+    Used with :class:`parallel64.StandardPort`
+    """
+
+    NIBBLE = 0x00
+    BYTE = 0x01
+
+
+class ThreadPriority(IntEnum):
+    """Enum class representing thread priorities, with the values of the
+    Windows ``THREAD_PRIORITY_*`` constants
+
+    Used with :class:`parallel64.RealtimeScope`
+    """
+
+    NORMAL = 0
+    ABOVE_NORMAL = 1
+    HIGHEST = 2
+    TIME_CRITICAL = 15
+
+
+class Register(IntEnum):
+    """Enum class representing the registers of the port, as offsets
+    from the SPP base address
+
+    Used with :class:`parallel64.PortProgram`
+    """
+
+    DATA = 0
+    STATUS = 1
+    CONTROL = 2
+    EPP_ADDRESS = 3
+    EPP_DATA = 4
@@ -0,0 +1,448 @@
+# SPDX-FileCopyrightText: 2022 Alec Delaney
+#
+# SPDX-License-Identifier: MIT
+
+"""
+`parallel64.enhanced`
+
+The EPP port
+
+
+* Author(s): Alec Delaney
+
+"""
+
+from types import TracebackType
+from typing import Optional, Literal, Type, Union
+from parallel64.aio import complete_operation
+from parallel64.capabilities import EcpCapabilities
+from parallel64.constants import Direction
+from parallel64.exceptions import EppTimeoutError
+from parallel64.standard import StandardPort
+
+
+class EnhancedPort(StandardPort):
+    """
+    The class for representing the EPP port.  It is an extension of the
+    StandardPort (SPP), so its methods can be used as well.
+
+    :param int spp_base_address: The base address for the port, representing
+        the SPP port data register
+    :param str|None windll_location: (optional) The location of the DLL
+        required to use the parallel port, default is to use the one
+        included in this package
+    :param int|None ecp_base_address: (optional) The ECP base address for the
+        port, used for SPP writes through the Parallel Port FIFO, default is
+        to not use it
+    :param EcpCapabilities|None ecp_capabilities: (optional) The capabilities of
+        the ECP FIFO, default is to detect them if the port has an ECR
+    :param int epp_io_width: (optional) The widest I/O access, in bytes, that
+        the chipset splits into multiple EPP data cycles, used for block
+        transfers.  Must be 1, 2 or 4; default is 4, as allowed by the EPP
+        specification.  Use 1 for chipsets that only support byte accesses.
+    :param bool shadow_registers: (optional) Whether to keep a write-through
+        copy of the Control register, so that setting the direction only needs
+        to write to the port, default is to read it from the port (False)
+    :param bool|None bidirectional: (optional) Whether the port is
+        bidirectional, default is to detect it
+    :param bool probe: (optional) Whether to detect the capabilities that
+        are not given even if they were already detected for these base
+        addresses in this process, default is to reuse the earlier results
+        (False)
+    :param int|None mmio_address: (optional) For cards exposing their
+        registers through an MMIO BAR, the physical address of the SPP Data
+        register, default is to use I/O space
+    """
+
+    # pylint: disable=too-many-arguments
+    def __init__(
+        self,
+        spp_base_address: int,
+        windll_location: Optional[str] = None,
+        ecp_base_address: Optional[int] = None,
+        ecp_capabilities: Optional[EcpCapabilities] = None,
+        epp_io_width: Literal[1, 2, 4] = 4,
+        shadow_registers: bool = False,
+        bidirectional: Optional[bool] = None,
+        probe: bool = False,
+        mmio_address: Optional[int] = None,
+    ) -> None:
+        super().__init__(
+            spp_base_address,
+            windll_location,
+            ecp_base_address=ecp_base_address,
+            ecp_capabilities=ecp_capabilities,
+            shadow_registers=shadow_registers,
+            bidirectional=bidirectional,
+            probe=probe,
+            mmio_address=mmio_address,
+        )
+        if epp_io_width not in (1, 2, 4):
+            raise ValueError("The EPP I/O width must be 1, 2 or 4 bytes")
+        self._epp_address_address = spp_base_address + 3
+        self._epp_data_address = spp_base_address + 4
+        self._epp_io_width = epp_io_width
+
+    @property
+    def epp_io_width(self) -> int:
+        """The widest I/O access, in bytes, used for EPP block transfers"""
+        return self._epp_io_width
+
+    def write_epp_address(self, address: int) -> None:
+        """Write data to the EPP Address register (Address Write Cycle)
+
+        :param address: The information to write
+        :type address: int
+        """
+
+        self.spp_handshake_control_reset()
+        self.direction = Direction.FORWARD
+        self._port.DlPortWritePortUchar(self._epp_address_address, address)
+        self._forget_shadows(control=False)
+
+    def read_epp_address(self) -> int:
+        """Read data from the EPP Address register (Address Read Cycle)
+
+        :return: The information read
+        :rtype: int
+        """
+
+        self.spp_handshake_control_reset()
+        self.direction = Direction.REVERSE
+        return self._port.DlPortReadPortUchar(self._epp_address_address)
+
+    def write_epp_data(self, data: int) -> None:
+        """Write data to the EPP Data register (Data Write Cycle)
+
+        :param data: The information to write
+        :type data: int
+        """
+
+        self.spp_handshake_control_reset()
+        self.direction = Direction.FORWARD
+        self._port.DlPortWritePortUchar(self._epp_data_address, data)
+        self._forget_shadows(control=False)
+
+    def read_epp_data(self) -> int:
+        """Read data from the EPP Data register (Data Read Cycle)
+
+        :return: The information read
+        :rtype: int
+        """
+        self.spp_handshake_control_reset()
+        self.direction = Direction.REVERSE
+        return self._port.DlPortReadPortUchar(self._epp_data_address)
+
+    def write_epp_block(self, data: Union[bytes, bytearray, memoryview]) -> None:
+        """Write a buffer of data to the EPP Data register (Data Write Cycles),
+        using I/O accesses of up to ``epp_io_width`` bytes so that each one
+        moves several bytes.  Any bytes left over are written with narrower
+        accesses.
+
+        :param data: The information to write
+        :type data: bytes|bytearray|memoryview
+        """
+
+        self.spp_handshake_control_reset()
+        self.direction = Direction.FORWARD
+        self._port.epp_write_block(self._epp_data_address, data, self._epp_io_width)
+        self._forget_shadows(control=False)
+
+    def read_epp_block(self, length: int) -> bytes:
+        """Read a buffer of data from the EPP Data register (Data Read Cycles),
+        using I/O accesses of up to ``epp_io_width`` bytes so that each one
+        moves several bytes.  Any bytes left over are read with narrower
+        accesses.
+
+        :param int length: The number of bytes to read
+        :return: The information read
+        :rtype: bytes
+        """
+
+        self.spp_handshake_control_reset()
+        self.direction = Direction.REVERSE
+        return self._port.epp_read_block(
+            self._epp_data_address, length, self._epp_io_width
+        )
+
+    def read_epp_block_into(self, buffer: Union[bytearray, memoryview]) -> int:
+        """Fills a buffer from the EPP Data register (Data Read Cycles), as
+        ``read_epp_block()`` does, without allocating a new ``bytes``
+
+        :param buffer: The writable buffer to fill, such as a ``bytearray``,
+            ``memoryview`` or NumPy array
+        :type buffer: bytearray|memoryview
+        :return: The number of bytes read
+        :rtype: int
+        """
+
+        self.spp_handshake_control_reset()
+        self.direction = Direction.REVERSE
+        self._port.epp_read_block_into(
+            self._epp_data_address, buffer, self._epp_io_width
+        )
+        return memoryview(buffer).nbytes
+
+    def epp_session(self, switch_direction: bool = True) -> "EppSession":
+        """Starts a session of EPP register transfers, which sets up the Control
+        register once rather than for every cycle.  It can be used as a context
+        manager:
+
+        .. code-block::
+
+            import parallel64
+            port = parallel64.EnhancedPort(0x1234)
+            with port.epp_session() as epp:
+                epp.write_reg(0x10, 0xFF)
+                status = epp.read_reg(0x11)
+
+        :param bool switch_direction: (optional) Whether the session should set
+            the direction bit of the Control register for reads, as
+            ``read_epp_data()`` does and some chipsets need.  Each read does
+            its address cycle forward and reverses the port for its data
+            cycles, and the Control register is otherwise only written when
+            the direction changes.  Default
+            is to set it (True); pass False to leave the direction to the EPP
+            hardware.
+        :return: The session
+        :rtype: EppSession
+        """
+        return EppSession(self, switch_direction)
+
+
+class EppSession:
+    """
+    A session of EPP register transfers on an ``EnhancedPort``, created with
+    ``EnhancedPort.epp_session()``.  The Control register is set up when the
+    session is opened, and each transfer is then an address cycle followed
+    by data cycles, with the EPP timeout bit checked once per transfer.
+
+    :param EnhancedPort port: The port to use
+    :param bool switch_direction: (optional) Whether reads should set the
+        direction bit of the Control register, default is to (True)
+    """
+
+    def __init__(self, port: EnhancedPort, switch_direction: bool = True) -> None:
+        self._port = port
+        self._backend = port._port  # pylint: disable=protected-access
+        self._base_address = port._spp_data_address  # pylint: disable=protected-access
+        self._switch_direction = switch_direction
+        self._control_byte: Optional[int] = None
+
+    def __enter__(self) -> "EppSession":
+        self.open()
+        return self
+
+    def __exit__(
+        self,
+        exc_type: Optional[Type[BaseException]],
+        exc_value: Optional[BaseException],
+        traceback: Optional[TracebackType],
+    ) -> None:
+        self.close()
+
+    def open(self) -> None:
+        """Sets up the Control register for the session, with the port in the
+        forward direction
+        """
+
+        self._port.spp_handshake_control_reset()
+        self._control_byte = self._port.read_control_register() & 0b11011111
+        self._port.write_control_register(self._control_byte)
+
+    def close(self) -> None:
+        """Ends the session, leaving the port in the forward direction"""
+
+        self._set_direction(Direction.FORWARD)
+        self._control_byte = None
+
+    def _set_direction(self, direction: Direction) -> None:
+        """Sets the direction bit of the Control register if the session
+        switches direction and it is not already set that way
+
+        :param Direction direction: The direction to set
+        :raises OSError: If the session is not open
+        """
+
+        if self._control_byte is None:
+            raise OSError("The EPP session is not open")
+        if not self._switch_direction:
+            return
+        new_control_byte = (self._control_byte & 0b11011111) | (direction.value << 5)
+        if new_control_byte != self._control_byte:
+            self._port.write_control_register(new_control_byte)
+            self._control_byte = new_control_byte
+
+    def _read_control(self) -> Optional[int]:
+        """Sets the port forward for the address cycle of a read, and
+        returns the Control register value that reverses it for the data
+        cycles, if the session switches direction
+
+        :return: The Control register value to write between the cycles,
+            or None to leave the Control register alone
+        :rtype: int|None
+        :raises OSError: If the session is not open
+        """
+
+        self._set_direction(Direction.FORWARD)
+        if not self._switch_direction:
+            return None
+        self._control_byte |= Direction.REVERSE.value << 5
+        return self._control_byte
+
+    @staticmethod
+    def _check_completed(completed: bool, address: int) -> None:
+        """Raises an error if the EPP timeout bit was set during a transfer
+
+        :param bool completed: Whether the timeout bit stayed clear
+        :param int address: The EPP address of the transfer
+        :raises EppTimeoutError: If the timeout bit was set
+        """
+
+        if not completed:
+            raise EppTimeoutError(
+                f"EPP timeout during transfer at address {hex(address)}"
+            )
+
+    def write_reg(self, address: int, value: int) -> None:
+        """Writes a value to an EPP address
+
+        :param int address: The EPP address
+        :param int value: The value to write
+        :raises EppTimeoutError: If the peripheral did not complete the cycles
+        """
+
+        self._set_direction(Direction.FORWARD)
+        completed = self._backend.epp_write_reg(self._base_address, address, value)
+        self._port._forget_shadows(control=False)  # pylint: disable=protected-access
+        self._check_completed(completed, address)
+
+    def read_reg(self, address: int) -> int:
+        """Reads a value from an EPP address
+
+        :param int address: The EPP address
+        :return: The value read
+        :rtype: int
+        :raises EppTimeoutError: If the peripheral did not complete the cycles
+        """
+
+        value, completed = self._backend.epp_read_reg(
+            self._base_address, address, self._read_control()
+        )
+        self._check_completed(completed, address)
+        return value
+
+    def write_regs(
+        self, address: int, data: Union[bytes, bytearray, memoryview]
+    ) -> None:
+        """Writes a buffer of data to an EPP address, with one address cycle
+        followed by data cycles using I/O accesses of up to the port's
+        ``epp_io_width``
+
+        :param int address: The EPP address
+        :param data: The data to write
+        :type data: bytes|bytearray|memoryview
+        :raises EppTimeoutError: If the peripheral did not complete the cycles
+        """
+
+        self._set_direction(Direction.FORWARD)
+        completed = self._backend.epp_write_regs(
+            self._base_address, address, data, self._port.epp_io_width
+        )
+        self._port._forget_shadows(control=False)  # pylint: disable=protected-access
+        self._check_completed(completed, address)
+
+    def read_regs(self, address: int, length: int) -> bytes:
+        """Reads a buffer of data from an EPP address, with one address cycle
+        followed by data cycles using I/O accesses of up to the port's
+        ``epp_io_width``
+
+        :param int address: The EPP address
+        :param int length: The number of bytes to read
+        :return: The data read
+        :rtype: bytes
+        :raises EppTimeoutError: If the peripheral did not complete the cycles
+        """
+
+        data, completed = self._backend.epp_read_regs(
+            self._base_address,
+            address,
+            length,
+            self._port.epp_io_width,
+            self._read_control(),
+        )
+        self._check_completed(completed, address)
+        return data
+
+    def read_regs_into(self, address: int, buffer: Union[bytearray, memoryview]) -> int:
+        """Fills a buffer from an EPP address, as ``read_regs()`` does,
+        without allocating a new ``bytes``
+
+        :param int address: The EPP address
+        :param buffer: The writable buffer to fill, such as a ``bytearray``,
+            ``memoryview`` or NumPy array
+        :type buffer: bytearray|memoryview
+        :return: The number of bytes read
+        :rtype: int
+        :raises EppTimeoutError: If the peripheral did not complete the cycles
+        """
+
+        completed = self._backend.epp_read_regs_into(
+            self._base_address,
+            address,
+            buffer,
+            self._port.epp_io_width,
+            self._read_control(),
+        )
+        self._check_completed(completed, address)
+        return memoryview(buffer).nbytes
+
+    async def write_regs_async(
+        self, address: int, data: Union[bytes, bytearray, memoryview]
+    ) -> None:
+        """The ``asyncio`` variant of ``write_regs()``, which runs the transfer
+        on the completion thread so the event loop is free meanwhile
+
+        :param int address: The EPP address
+        :param data: The data to write
+        :type data: bytes|bytearray|memoryview
+        :raises EppTimeoutError: If the peripheral did not complete the cycles
+        """
+
+        self._set_direction(Direction.FORWARD)
+        try:
+            completed = await complete_operation(
+                self._backend,
+                "submit_epp_write_regs",
+                self._base_address,
+                address,
+                data,
+                self._port.epp_io_width,
+            )
+        finally:
+            # pylint: disable=protected-access
+            self._port._forget_shadows(control=False)
+        self._check_completed(completed, address)
+
+    async def read_regs_async(self, address: int, length: int) -> bytes:
+        """The ``asyncio`` variant of ``read_regs()``, which runs the transfer
+        on the completion thread so the event loop is free meanwhile
+
+        :param int address: The EPP address
+        :param int length: The number of bytes to read
+        :return: The data read
+        :rtype: bytes
+        :raises EppTimeoutError: If the peripheral did not complete the cycles
+        """
+
+        data, completed = await complete_operation(
+            self._backend,
+            "submit_epp_read_regs",
+            self._base_address,
+            address,
+            length,
+            self._port.epp_io_width,
+            self._read_control(),
+        )
+        self._check_completed(completed, address)
+        return data
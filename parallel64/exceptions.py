@@ -0,0 +1,48 @@
+# SPDX-FileCopyrightText: 2022 Alec Delaney
+#
+# SPDX-License-Identifier: MIT
+
+"""
+`parallel64.exceptions`
+
+Exceptions raised during parallel port transfers
+
+
+* Author(s): Alec Delaney
+
+"""
+
+from typing import Optional
+
+
+class TransferTimeoutError(TimeoutError):
+    """Raised when a peripheral does not complete a handshake in time
+    during a transfer
+
+    :param str message: The error message
+    :param int bytes_transferred: The number of bytes transferred before
+        the timeout occurred
+    :param bytes|None data: (optional) For reads, the data received before
+        the timeout occurred
+
+    :ivar bytes_transferred: The number of bytes transferred before the
+        timeout occurred
+    :vartype bytes_transferred: int
+    :ivar data: For reads, the data received before the timeout occurred,
+        otherwise None
+    :vartype data: bytes|None
+    """
+
+    def __init__(
+        self, message: str, bytes_transferred: int, data: Optional[bytes] = None
+    ) -> None:
+        super().__init__(message)
+        self.bytes_transferred = bytes_transferred
+        self.data = data
+
+
+class EppTimeoutError(OSError):
+    """Raised when the EPP timeout bit is set after a transfer, meaning
+    the peripheral did not complete at least one of its EPP cycles.  The
+    timeout bit is cleared before this is raised.
+    """
@@ -0,0 +1,601 @@
+# SPDX-FileCopyrightText: 2022 Alec Delaney
+#
+# SPDX-License-Identifier: MIT
+
+"""
+`parallel64.extended`
+
+The ECP port, including the Extended Capabilities Register and FIFO transfers
+
+
+* Author(s): Alec Delaney
+
+"""
+
+import threading
+from typing import Any, Callable, Optional, Dict, List, Tuple, Union
+from parallel64.base import _BasePort
+from parallel64.capabilities import EcpCapabilities, cached_detection
+from parallel64.constants import Direction, CommMode
+from parallel64.exceptions import TransferTimeoutError
+from parallel64.streaming import OutputStream
+
+
+class ExtendedPort(_BasePort):
+    """
+    The class for representing the ECP port.  It works with the Extended
+    Capabilities Register, and can transfer data through the ECP data FIFO.
+    Note that ECP transfers expect the peripheral to already be in ECP mode.
+
+    :param int ecp_base_address: The base address for the port, representing the
+        ECP port data register
+    :param str|None windll_location: (optional) The location of the DLL required
+        to use the parallel port, default is to use the one included in this
+        package
+    :param int|None spp_base_address: (optional) The SPP base address for the
+        port, which is needed to change the direction for FIFO reads, default
+        is not to use it
+    :param EcpCapabilities|None ecp_capabilities: (optional) The capabilities of
+        the ECP FIFO, used to size FIFO bursts, such as those saved with
+        ``save_json()``.  Default is to detect them using
+        ``probe_capabilities()`` if the ECR is found, or use conservative
+        defaults otherwise.
+    :param bool probe: (optional) Whether to detect the capabilities even if
+        they were already detected for these base addresses in this process,
+        default is to reuse the earlier result (False)
+    :param int|None mmio_address: (optional) For cards exposing their
+        registers through an MMIO BAR, the physical address of the ECP FIFO
+        register.  The registers are mapped once and accessed through the
+        mapping, at the same offsets from it as from ``ecp_base_address``
+        (including the SPP registers), which then only names the registers.
+        Default is to use I/O space.
+    """
+
+    _PROBE_LIMIT = 1024
+
+    def __init__(
+        self,
+        ecp_base_address: int,
+        windll_location: Optional[str] = None,
+        spp_base_address: Optional[int] = None,
+        ecp_capabilities: Optional[EcpCapabilities] = None,
+        probe: bool = False,
+        mmio_address: Optional[int] = None,
+    ) -> None:
+        super().__init__(windll_location)
+        self._ecp_fifo_address = ecp_base_address
+        self._config_b_address = ecp_base_address + 1
+        self._ecr_address = ecp_base_address + 2
+        self._spp_base_address = spp_base_address
+        self._spp_control_address = (
+            None if spp_base_address is None else spp_base_address + 2
+        )
+        self._spp_control_lock = threading.RLock()
+        self._mmio_address = mmio_address
+        if mmio_address is not None:
+            self._map_registers(mmio_address, ecp_base_address)
+        if ecp_capabilities is None:
+            ecp_capabilities = self.detect_fifo(probe)
+        self.ecp_capabilities = (
+            EcpCapabilities() if ecp_capabilities is None else ecp_capabilities
+        )
+
+    @classmethod
+    def from_json_dict(cls, json_contents: Dict[str, Any]) -> "ExtendedPort":
+        """Factory method for creating and instance of ExtendedPort from the
+        contents of a JSON configuration, as used by ``from_json()``
+
+        :param dict json_contents: The contents of the JSON configuration
+        :return: An instance of ExtendedPort
+        :rtype: ExtendedPort
+        """
+
+        port_params = ["ecp_base_address"]
+        optional_params = ["spp_base_address", "mmio_address"]
+
+        return cls._create_from_json_dict(json_contents, port_params, optional_params)
+
+    def ecp_json_contents(self) -> Dict[str, Any]:
+        """Returns the ECP base address and capabilities in the form used
+        by ``from_json()``
+
+        :rtype: dict
+        """
+
+        return {
+            "ecp_base_address": hex(self._ecp_fifo_address),
+            "ecp_capabilities": self.ecp_capabilities.to_json_dict(),
+        }
+
+    def _json_contents(self) -> Dict[str, Any]:
+        """Returns the configuration of the port in the form used by
+        ``from_json()``
+
+        :rtype: dict
+        """
+
+        json_contents = super()._json_contents()
+        json_contents.update(self.ecp_json_contents())
+        if self._spp_base_address is not None:
+            json_contents["spp_base_address"] = hex(self._spp_base_address)
+        if self._mmio_address is not None:
+            json_contents["mmio_address"] = hex(self._mmio_address)
+        return json_contents
+
+    def _register_ranges(self) -> List[Tuple[int, int, int]]:
+        """Returns the ECP registers, and the SPP ones if the SPP base address
+        is known, as ranges for direct I/O
+
+        :rtype: list
+        """
+
+        ranges = [(self._ecp_fifo_address, 3, self._ecr_address)]
+        if self._spp_base_address is not None:
+            ranges.append((self._spp_base_address, 3, self._spp_base_address + 1))
+        return ranges
+
+    @property
+    def comm_mode(self) -> CommMode:
+        """The communication mode in the ECR"""
+        mode = self.read_ecr_register()
+        return CommMode(mode >> 5)
+
+    @comm_mode.setter
+    def comm_mode(self, mode: CommMode) -> None:
+        self.write_ecr_register(mode.value << 5)
+
+    def write_ecr_register(self, data: int) -> None:
+        """Write data to the Extended Capabilities Register (ECR)
+
+        :param data: The data to write to the register
+        :type data: int
+        """
+        self._port.DlPortWritePortUchar(self._ecr_address, data)
+
+    def read_ecr_register(self) -> int:
+        """Read data in the Extended Capabilities Register (ECR)
+
+        :return: The data in the register
+        :rtype: int
+        """
+        return self._port.DlPortReadPortUchar(self._ecr_address)
+
+    def test_fifo_support(self) -> bool:
+        """Tests whether the port has an ECR, and therefore FIFO support, at
+        the expected address.  The ECR is restored afterwards.
+
+        :return: Whether the port has an ECR
+        :rtype: bool
+        """
+
+        ecr_byte = self.read_ecr_register()
+        if ecr_byte & 0b00000011 != 0b00000001:
+            return False
+        self.write_ecr_register(0b00110100)
+        has_ecr = self.read_ecr_register() == 0b00110101
+        self.write_ecr_register(ecr_byte)
+        return has_ecr
+
+    def detect_fifo(self, probe: bool = False) -> Optional[EcpCapabilities]:
+        """Detects whether the port has an ECP FIFO and its capabilities,
+        using ``test_fifo_support()`` and ``probe_capabilities()``.  The
+        result is cached for the base addresses, so later ports do not probe
+        the hardware again.
+
+        :param bool probe: (optional) Whether to probe the hardware even if a
+            result is cached, default is to use the cached result (False)
+        :return: The capabilities of the FIFO, or None if the port has no ECR
+        :rtype: EcpCapabilities|None
+        """
+
+        return cached_detection(
+            ("ecp", self._ecp_fifo_address, self._spp_base_address),
+            lambda: self.probe_capabilities() if self.test_fifo_support() else None,
+            probe,
+        )
+
+    def probe_capabilities(self) -> EcpCapabilities:
+        """Detects the capabilities of the ECP FIFO.  The configuration mode
+        is used to read the PWord size, IRQ and DMA channel from the cnfgA and
+        cnfgB registers, and the FIFO test mode is used to count the FIFO
+        depth and service thresholds.  Detecting the read threshold needs the
+        SPP base address; without it, the default is used.  The ECR mode is
+        restored afterwards.
+
+        :return: The detected capabilities
+        :rtype: EcpCapabilities
+        :raises OSError: If the FIFO never reports being full
+        """
+
+        previous_mode = self.comm_mode
+        try:
+            self._switch_mode(CommMode.CONFIG)
+            config = EcpCapabilities.decode_config(
+                self._port.DlPortReadPortUchar(self._ecp_fifo_address),
+                self._port.DlPortReadPortUchar(self._config_b_address),
+            )
+            pword_size = config["pword_size"]
+            self._enter_fifo_mode(CommMode.FIFO_TEST, Direction.FORWARD)
+            fifo_words = self._count_test_fifo_writes(0b00000010, pword_size)
+            if fifo_words >= self._PROBE_LIMIT:
+                raise OSError("The ECP FIFO never reported being full")
+            write_words = self._count_test_fifo_reads(fifo_words, pword_size)
+            read_words = 1
+            if self._spp_control_address is not None:
+                self._enter_fifo_mode(CommMode.FIFO_TEST, Direction.REVERSE)
+                read_words = self._count_test_fifo_writes(0b00000100, pword_size)
+        finally:
+            self._enter_fifo_mode(CommMode.BYTE, Direction.FORWARD)
+            self._switch_mode(previous_mode)
+        return EcpCapabilities(
+            fifo_depth=fifo_words * pword_size,
+            pword_size=pword_size,
+            write_threshold=max(write_words, 1) * pword_size,
+            read_threshold=max(min(read_words, fifo_words), 1) * pword_size,
+            irq=config["irq"],
+            dma=config["dma"],
+        )
+
+    def _count_test_fifo_writes(self, stop_bit: int, pword_size: int) -> int:
+        """Writes PWords to the FIFO in test mode (with serviceIntr re-armed)
+        until the given ECR bit is set
+
+        :param int stop_bit: The ECR bit to stop at
+        :param int pword_size: The PWord size in bytes, which is the width of
+            each FIFO access
+        :return: The number of PWords written
+        :rtype: int
+        """
+
+        write_fifo = {
+            1: self._port.DlPortWritePortUchar,
+            2: self._port.DlPortWritePortUshort,
+            4: self._port.DlPortWritePortUlong,
+        }[pword_size]
+        self.comm_mode = CommMode.FIFO_TEST
+        count = 0
+        while not self.read_ecr_register() & stop_bit and count < self._PROBE_LIMIT:
+            write_fifo(self._ecp_fifo_address, 0)
+            count += 1
+        return count
+
+    def _count_test_fifo_reads(self, limit: int, pword_size: int) -> int:
+        """Reads PWords from a full FIFO in test mode (with serviceIntr
+        re-armed) until the FIFO requests service, which gives the write
+        threshold
+
+        :param int limit: The most PWords to read
+        :param int pword_size: The PWord size in bytes, which is the width of
+            each FIFO access
+        :return: The number of PWords read
+        :rtype: int
+        """
+
+        read_fifo = {
+            1: self._port.DlPortReadPortUchar,
+            2: self._port.DlPortReadPortUshort,
+            4: self._port.DlPortReadPortUlong,
+        }[pword_size]
+        self.comm_mode = CommMode.FIFO_TEST
+        count = 0
+        while not self.read_ecr_register() & 0b00000100 and count < limit:
+            read_fifo(self._ecp_fifo_address)
+            count += 1
+        return count
+
+    def _switch_mode(self, mode: CommMode) -> None:
+        """Switches the ECR to the given mode for programmed I/O, going through
+        the PS/2 mode first if switching from another mode that is not SPP or
+        PS/2, as required by the ECP specification
+
+        :param CommMode mode: The mode to switch to
+        """
+
+        current_mode = self.comm_mode
+        if current_mode not in (mode, CommMode.SPP, CommMode.BYTE):
+            self.comm_mode = CommMode.BYTE
+        self.comm_mode = mode
+
+    def _enter_fifo_mode(self, mode: CommMode, direction: Direction) -> None:
+        """Switches the ECR to a mode with the port in the given
+        direction.  The ECP specification only allows the direction to change
+        in the SPP and PS/2 modes, so if it needs to change, the ECR goes
+        through PS/2 mode first and the direction is set there.
+
+        :param CommMode mode: The mode to switch to
+        :param Direction direction: The direction to set
+        :raises OSError: If the direction needs to be reversed but the SPP
+            base address is not known
+        """
+
+        if self._spp_control_address is None:
+            self._set_fifo_direction(direction)
+        else:
+            control_byte = self._port.DlPortReadPortUchar(self._spp_control_address)
+            if Direction((control_byte >> 5) & 1) != direction:
+                self._switch_mode(CommMode.BYTE)
+                self._set_fifo_direction(direction)
+        self._switch_mode(mode)
+
+    def _set_fifo_direction(self, direction: Direction) -> None:
+        """Sets the direction of the port for FIFO transfers using the SPP
+        Control register, which must only be done in the SPP or PS/2 mode
+
+        :param Direction direction: The direction to set
+        :raises OSError: If the direction needs to be reversed but the SPP
+            base address is not known
+        """
+
+        if self._spp_control_address is None:
+            if direction == Direction.REVERSE:
+                raise OSError(
+                    "The SPP base address is needed to read from the FIFO, "
+                    "see reference documentation"
+                )
+            return
+        with self._spp_control_lock:
+            control_byte = self._port.DlPortReadPortUchar(self._spp_control_address)
+            new_control_byte = (control_byte & 0b11011111) | (direction.value << 5)
+            self._port.DlPortWritePortUchar(self._spp_control_address, new_control_byte)
+
+    def write_ecp_buffer(
+        self,
+        data: Union[bytes, bytearray, memoryview],
+        timeout: Optional[float] = 1.0,
+    ) -> int:
+        """Writes a buffer of data through the ECP data FIFO, in bursts sized
+        from the FIFO state, and waits for the FIFO to drain.  This switches
+        the ECR to ``CommMode.ECP_FIFO``.
+
+        :param data: The data to be transmitted
+        :type data: bytes|bytearray|memoryview
+        :param float|None timeout: (optional) How long the FIFO may stop
+            accepting data or draining in seconds, or None to wait indefinitely,
+            default is 1 second
+        :return: The number of bytes sent
+        :rtype: int
+        :raises ValueError: If the data is not a whole number of PWords
+        :raises TransferTimeoutError: If the FIFO stalls for longer than the
+            timeout, with the number of bytes queued stored as
+            ``bytes_transferred``
+        """
+
+        self._enter_fifo_mode(CommMode.ECP_FIFO, Direction.FORWARD)
+        sent, completed = self._port.ecp_write_fifo(
+            self._ecp_fifo_address,
+            data,
+            self.ecp_capabilities.fifo_depth,
+            self.ecp_capabilities.write_threshold,
+            self.ecp_capabilities.pword_size,
+            timeout,
+        )
+        if not completed:
+            raise TransferTimeoutError(
+                f"ECP FIFO stalled after {sent} bytes were queued", sent
+            )
+        return sent
+
+    def write_spp_fifo_buffer(
+        self,
+        data: Union[bytes, bytearray, memoryview],
+        timeout: Optional[float] = 1.0,
+    ) -> int:
+        """Writes a buffer of data through the Parallel Port FIFO, in bursts
+        sized from the FIFO state, and waits for the FIFO to drain.  The
+        STROBE/BUSY handshake is done by the port hardware.  This switches the
+        ECR to ``CommMode.SPP_FIFO`` for the transfer, and back afterwards.
+
+        :param data: The data to be transmitted
+        :type data: bytes|bytearray|memoryview
+        :param float|None timeout: (optional) How long the FIFO may stop
+            accepting data or draining in seconds, or None to wait indefinitely,
+            default is 1 second
+        :return: The number of bytes sent
+        :rtype: int
+        :raises ValueError: If the data is not a whole number of PWords
+        :raises TransferTimeoutError: If the FIFO stalls for longer than the
+            timeout, with the number of bytes queued stored as
+            ``bytes_transferred``
+        """
+
+        previous_mode = self.comm_mode
+        self._enter_fifo_mode(CommMode.SPP_FIFO, Direction.FORWARD)
+        try:
+            sent, completed = self._port.ecp_write_fifo(
+                self._ecp_fifo_address,
+                data,
+                self.ecp_capabilities.fifo_depth,
+                self.ecp_capabilities.write_threshold,
+                self.ecp_capabilities.pword_size,
+                timeout,
+            )
+        finally:
+            self._switch_mode(previous_mode)
+        if not completed:
+            raise TransferTimeoutError(
+                f"Parallel Port FIFO stalled after {sent} bytes were queued", sent
+            )
+        return sent
+
+    def open_ecp_stream(
+        self,
+        buffer_count: int = 4,
+        buffer_size: int = 4096,
+        timeout: Optional[float] = 1.0,
+    ) -> OutputStream:
+        """Opens a stream that feeds the ECP data FIFO from a background
+        thread, so the FIFO keeps draining while the next buffer is written.
+        This switches the ECR to ``CommMode.ECP_FIFO``.
+
+        :param int buffer_count: (optional) The number of buffers in the ring,
+            default is 4
+        :param int buffer_size: (optional) The size of each buffer in bytes,
+            default is 4096
+        :param float|None timeout: (optional) How long the FIFO may stop
+            accepting data or draining in seconds, or None to wait indefinitely,
+            default is 1 second
+        :return: The stream, which is not started
+        :rtype: OutputStream
+        :raises ValueError: If the FIFO has PWords wider than a byte, which
+            streams do not support
+        """
+
+        self._check_stream_pword()
+        self._enter_fifo_mode(CommMode.ECP_FIFO, Direction.FORWARD)
+        return self._open_fifo_stream(buffer_count, buffer_size, timeout)
+
+    def open_spp_fifo_stream(
+        self,
+        buffer_count: int = 4,
+        buffer_size: int = 4096,
+        timeout: Optional[float] = 1.0,
+        on_close: Optional[Callable[[], None]] = None,
+    ) -> OutputStream:
+        """Opens a stream that feeds the Parallel Port FIFO from a background
+        thread, with the STROBE/BUSY handshake done by the port hardware.
+        This switches the ECR to ``CommMode.SPP_FIFO`` until the stream is
+        closed or aborted, and back afterwards.
+
+        :param int buffer_count: (optional) The number of buffers in the ring,
+            default is 4
+        :param int buffer_size: (optional) The size of each buffer in bytes,
+            default is 4096
+        :param float|None timeout: (optional) How long the FIFO may stop
+            accepting data or draining in seconds, or None to wait indefinitely,
+            default is 1 second
+        :param on_close: (optional) A function to call once the stream has
+            stopped and the mode is restored
+        :return: The stream, which is not started
+        :rtype: OutputStream
+        :raises ValueError: If the FIFO has PWords wider than a byte, which
+            streams do not support
+        """
+
+        self._check_stream_pword()
+        previous_mode = self.comm_mode
+        self._enter_fifo_mode(CommMode.SPP_FIFO, Direction.FORWARD)
+
+        def restore_mode() -> None:
+            self._switch_mode(previous_mode)
+            if on_close is not None:
+                on_close()
+
+        try:
+            return self._open_fifo_stream(
+                buffer_count, buffer_size, timeout, restore_mode
+            )
+        except BaseException:
+            self._switch_mode(previous_mode)
+            raise
+
+    def _check_stream_pword(self) -> None:
+        """Raises ValueError if the FIFO has PWords wider than a byte, as the
+        stream engines feed the FIFO a byte at a time
+        """
+
+        if self.ecp_capabilities.pword_size != 1:
+            raise ValueError(
+                f"Streams need an 8-bit FIFO, this one has "
+                f"{self.ecp_capabilities.pword_size * 8}-bit PWords"
+            )
+
+    def _open_fifo_stream(
+        self,
+        buffer_count: int,
+        buffer_size: int,
+        timeout: Optional[float],
+        on_close: Optional[Callable[[], None]] = None,
+    ) -> OutputStream:
+        """Creates a stream feeding the FIFO in the current mode
+
+        :param int buffer_count: The number of buffers in the ring
+        :param int buffer_size: The size of each buffer in bytes
+        :param float|None timeout: How long the FIFO may stall in seconds, or
+            None to wait indefinitely
+        :param on_close: (optional) A function to call once the stream has
+            stopped
+        :rtype: OutputStream
+        """
+
+        return OutputStream(
+            self._port.Streamer(
+                "fifo",
+                self._ecp_fifo_address,
+                buffer_count,
+                buffer_size,
+                timeout,
+                fifo_depth=self.ecp_capabilities.fifo_depth,
+                threshold=self.ecp_capabilities.write_threshold,
+            ),
+            on_close,
+        )
+
+    def read_ecp_buffer(self, length: int, timeout: Optional[float] = 1.0) -> bytes:
+        """Reads a buffer of data through the ECP data FIFO, in bursts sized
+        from the FIFO state.  This switches the ECR to ``CommMode.ECP_FIFO``.
+
+        :param int length: The number of bytes to read
+        :param float|None timeout: (optional) How long the FIFO may stay empty
+            in seconds, or None to wait indefinitely, default is 1 second
+        :return: The data read
+        :rtype: bytes
+        :raises OSError: If the SPP base address is not known
+        :raises ValueError: If the length is not a whole number of PWords
+        :raises TransferTimeoutError: If the FIFO stays empty for longer than
+            the timeout, with the data received stored as ``data``
+        """
+
+        self._enter_fifo_mode(CommMode.ECP_FIFO, Direction.REVERSE)
+        received, completed = self._port.ecp_read_fifo(
+            self._ecp_fifo_address,
+            length,
+            self.ecp_capabilities.fifo_depth,
+            self.ecp_capabilities.read_threshold,
+            self.ecp_capabilities.pword_size,
+            timeout,
+        )
+        if not completed:
+            raise TransferTimeoutError(
+                f"ECP FIFO stayed empty after {len(received)} bytes were read",
+                len(received),
+                received,
+            )
+        return received
+
+    def read_ecp_buffer_into(
+        self,
+        buffer: Union[bytearray, memoryview],
+        timeout: Optional[float] = 1.0,
+    ) -> int:
+        """Fills a buffer through the ECP data FIFO, as ``read_ecp_buffer()``
+        does, without allocating a new ``bytes``.  This switches the ECR to
+        ``CommMode.ECP_FIFO``.
+
+        :param buffer: The writable buffer to fill, such as a ``bytearray``,
+            ``memoryview`` or NumPy array
+        :type buffer: bytearray|memoryview
+        :param float|None timeout: (optional) How long the FIFO may stay empty
+            in seconds, or None to wait indefinitely, default is 1 second
+        :return: The number of bytes read
+        :rtype: int
+        :raises OSError: If the SPP base address is not known
+        :raises ValueError: If the length is not a whole number of PWords
+        :raises TransferTimeoutError: If the FIFO stays empty for longer than
+            the timeout, with the number of bytes stored in the buffer as
+            ``bytes_transferred``
+        """
+
+        self._enter_fifo_mode(CommMode.ECP_FIFO, Direction.REVERSE)
+        received, completed = self._port.ecp_read_fifo_into(
+            self._ecp_fifo_address,
+            buffer,
+            self.ecp_capabilities.fifo_depth,
+            self.ecp_capabilities.read_threshold,
+            self.ecp_capabilities.pword_size,
+            timeout,
+        )
+        if not completed:
+            raise TransferTimeoutError(
+                f"ECP FIFO stayed empty after {received} bytes were read", received
+            )
+        return received
@@ -0,0 +1,452 @@
+# SPDX-FileCopyrightText: 2022 Alec Delaney
+#
+# SPDX-License-Identifier: MIT
+
+"""
+`parallel64.gpio`
+
+GPIO-like access to the individual pins of a port
+
+
+* Author(s): Alec Delaney
+
+"""
+
+import array
+from typing import Dict, Iterable, List, Mapping, Optional, Sequence, Tuple, Union
+from parallel64.aio import complete_operation
+from parallel64.capabilities import EcpCapabilities
+from parallel64.constants import Direction
+from parallel64.pins import Pins, Pin, PortSnapshot
+from parallel64.standard import StandardPort
+from parallel64.timing import PlaybackStats
+from parallel64.watcher import Edge, PinCallback, PinWatcher, Subscription
+
+
+class GPIOPort(StandardPort):
+    """
+    The class for representing GPIO-like functionality of the port, useful for
+    interacting with connected devices in ways outside of established parallel port
+    communication protocols.  It inherits from the StandardPort class, however, so
+    those methods are available as well.
+
+    :param int spp_base_address: The base address for the port, representing the
+        SPP port data register
+    :param str|None windll_location: (optional) The location of the DLL required
+        to use the parallel port, default is to use the one included in this
+        package
+    :param bool clear_gpio: (optional) Whether to clear pins and reset to low
+        upon initialization, default is to reset pins (True)
+    :param bool reset_control: (optional) Whether to reset the control register
+        (according to SPP handshake protocol) upon initialization, default is
+        not to reset the register (False). Note this takes place BEFORE clearing
+        the pins via the ``clear_gpio`` argument.
+    :param int|None ecp_base_address: (optional) The ECP base address for the
+        port, used for SPP writes through the Parallel Port FIFO, default is
+        to not use it
+    :param EcpCapabilities|None ecp_capabilities: (optional) The capabilities of
+        the ECP FIFO, default is to detect them if the port has an ECR
+    :param bool shadow_registers: (optional) Whether to keep a write-through
+        copy of the Control register (and of the Data register if the port is
+        not bidirectional), so that ``write_pin()`` only needs to write to the
+        port, default is to read the registers from the port (False)
+    :param bool|None bidirectional: (optional) Whether the port is
+        bidirectional, default is to detect it
+    :param bool probe: (optional) Whether to detect the capabilities that
+        are not given even if they were already detected for these base
+        addresses in this process, default is to reuse the earlier results
+        (False)
+    :param int|None mmio_address: (optional) For cards exposing their
+        registers through an MMIO BAR, the physical address of the SPP Data
+        register, default is to use I/O space
+    """
+
+    DEFAULT_WATCH_PERIOD_US = 5000
+    """The default time between the samples of ``on_change()``, in
+    microseconds"""
+
+    # pylint: disable=too-many-arguments
+    def __init__(
+        self,
+        spp_base_address: int,
+        windll_location: Optional[str] = None,
+        clear_gpio: bool = True,
+        reset_control: bool = False,
+        ecp_base_address: Optional[int] = None,
+        ecp_capabilities: Optional[EcpCapabilities] = None,
+        shadow_registers: bool = False,
+        bidirectional: Optional[bool] = None,
+        probe: bool = False,
+        mmio_address: Optional[int] = None,
+    ) -> None:
+        super().__init__(
+            spp_base_address,
+            windll_location,
+            reset_control,
+            ecp_base_address=ecp_base_address,
+            ecp_capabilities=ecp_capabilities,
+            shadow_registers=shadow_registers,
+            bidirectional=bidirectional,
+            probe=probe,
+            mmio_address=mmio_address,
+        )
+        self.pins = Pins(
+            self._spp_data_address, self.is_bidirectional, self._register_locks
+        )
+        self._watcher: Optional[PinWatcher] = None
+        self._watch_period_ns = self.DEFAULT_WATCH_PERIOD_US * 1000
+        if clear_gpio:
+            self.write_data_register(0)
+            self.reset_control_pins()
+
+    def read_pin(self, pin: Pin) -> bool:
+        """Read the state of the given pin
+
+        :param pin: The pin to read
+        :type pin: Pin
+        :return: The state of the pin
+        :rtype: bool
+        :raises OSError: If the pin is output-only
+        """
+
+        if pin.input_allowed:
+            register_byte = self._port.DlPortReadPortUchar(pin.register)
+            return bool((register_byte ^ pin.inversion_mask) & pin.bit_mask)
+        raise OSError("Input not allowed on pin " + str(pin.pin_number))
+
+    def write_pin(self, pin: Pin, value: bool) -> None:
+        """Set the state of the given pin
+
+        :param Pin pin: The pin to set
+        :param bool value: The state to set the pin
+        :raises OSError: If the pin is input-only
+        """
+
+        if pin.output_allowed:
+            with self._register_locks[pin.register]:
+                register_byte = self._read_latched_register(pin.register)
+                current_value = (register_byte ^ pin.inversion_mask) & pin.bit_mask
+                if bool(current_value) != value:
+                    self._write_latched_register(
+                        pin.register, register_byte ^ pin.bit_mask
+                    )
+        else:
+            raise OSError("Output not allowed on pin " + str(pin.pin_number))
+
+    def read_pins(self, pins: Iterable[Pin]) -> Dict[Pin, bool]:
+        """Read the states of several pins, reading each register they are on
+        only once so the states are sampled together
+
+        .. code-block::
+
+            import parallel64
+            gpio = parallel64.GPIOPort(0x1234)
+            states = gpio.read_pins((gpio.pins.ACK, gpio.pins.BUSY))
+            busy = states[gpio.pins.BUSY]
+
+        :param pins: The pins to read
+        :type pins: Iterable[Pin]
+        :return: The state of each pin
+        :rtype: dict
+        :raises OSError: If any of the pins is output-only
+        """
+
+        pins = tuple(pins)
+        for pin in pins:
+            if not pin.input_allowed:
+                raise OSError("Input not allowed on pin " + str(pin.pin_number))
+        registers: Dict[int, int] = {}
+        for pin in pins:
+            if pin.register not in registers:
+                registers[pin.register] = self._port.DlPortReadPortUchar(pin.register)
+        return {
+            pin: bool((registers[pin.register] ^ pin.inversion_mask) & pin.bit_mask)
+            for pin in pins
+        }
+
+    def write_pins(self, values: Mapping[Pin, bool]) -> None:
+        """Set the states of several pins, with one write to each register they
+        are on, so pins on the same register change together
+
+        .. code-block::
+
+            import parallel64
+            gpio = parallel64.GPIOPort(0x1234)
+            gpio.write_pins({gpio.pins.D0: True, gpio.pins.D1: False})
+
+        :param values: The state to set each pin
+        :type values: Mapping[Pin, bool]
+        :raises OSError: If any of the pins is input-only
+        """
+
+        for pin in values:
+            if not pin.output_allowed:
+                raise OSError("Output not allowed on pin " + str(pin.pin_number))
+        masks: Dict[int, List[int]] = {}
+        for pin, value in values.items():
+            register_masks = masks.setdefault(pin.register, [0, 0])
+            register_masks[0] |= pin.bit_mask
+            register_masks[1] |= (pin.bit_mask if value else 0) ^ pin.inversion_mask
+        with self._lock_registers(masks):
+            for register, (change_mask, set_mask) in masks.items():
+                register_byte = self._read_latched_register(register)
+                byte_result = (register_byte & ~change_mask) | set_mask
+                if byte_result != register_byte:
+                    self._write_latched_register(register, byte_result)
+
+    def wait_for_pin(
+        self, pin: Pin, value: bool, timeout: Optional[float] = 1.0
+    ) -> None:
+        """Wait for the given pin to reach a state, backing off as set by
+        ``set_wait_policy()``
+
+        :param Pin pin: The pin to wait on
+        :param bool value: The state to wait for
+        :param float|None timeout: (optional) How long to wait in seconds, or
+            None to wait indefinitely, default is 1 second
+        :raises OSError: If the pin is output-only
+        :raises TimeoutError: If the pin does not reach the state before the
+            timeout
+        """
+
+        expected = self._expected_pin_bits(pin, value)
+        if not self._port.wait_port_bits(pin.register, pin.bit_mask, expected, timeout):
+            raise TimeoutError(f"Pin {pin.pin_number} did not become {value}")
+
+    async def wait_for_pin_async(
+        self, pin: Pin, value: bool, timeout: Optional[float] = 1.0
+    ) -> None:
+        """The ``asyncio`` variant of ``wait_for_pin()``.  The pin is polled on
+        the completion thread, so the event loop is free while waiting.
+
+        :param Pin pin: The pin to wait on
+        :param bool value: The state to wait for
+        :param float|None timeout: (optional) How long to wait in seconds, or
+            None to wait indefinitely, default is 1 second
+        :raises OSError: If the pin is output-only
+        :raises TimeoutError: If the pin does not reach the state before the
+            timeout
+        """
+
+        expected = self._expected_pin_bits(pin, value)
+        if not await complete_operation(
+            self._port,
+            "submit_wait_bits",
+            pin.register,
+            pin.bit_mask,
+            expected,
+            timeout,
+        ):
+            raise TimeoutError(f"Pin {pin.pin_number} did not become {value}")
+
+    @staticmethod
+    def _expected_pin_bits(pin: Pin, value: bool) -> int:
+        """Returns the register bits of an input pin in the given state
+
+        :param Pin pin: The pin
+        :param bool value: The state of the pin
+        :rtype: int
+        :raises OSError: If the pin is output-only
+        """
+
+        if not pin.input_allowed:
+            raise OSError("Input not allowed on pin " + str(pin.pin_number))
+        return (pin.bit_mask if value else 0) ^ pin.inversion_mask
+
+    def snapshot(self) -> PortSnapshot:
+        """Read the states of all the pins at once, with one read of each of
+        the Data, Status and Control registers
+
+        .. code-block::
+
+            import parallel64
+            gpio = parallel64.GPIOPort(0x1234)
+            states = gpio.snapshot()
+            busy = states.pin(11)
+
+        :return: The states of the pins
+        :rtype: PortSnapshot
+        """
+
+        return PortSnapshot.from_registers(
+            self._port.DlPortReadPortUchar(self._spp_data_address),
+            self._port.DlPortReadPortUchar(self._status_address),
+            self._port.DlPortReadPortUchar(self._control_address),
+        )
+
+    def on_change(
+        self,
+        pin: Pin,
+        callback: PinCallback,
+        edge: Edge = "both",
+        debounce_us: float = 0,
+    ) -> Subscription:
+        """Calls a function when the given pin changes state.  Every watched
+        pin is served by one background sampler, which reads each register
+        with a watched pin once every ``watch_period_us``, and the callbacks
+        are called from a single worker thread.  Changes shorter than the
+        period can be missed.
+
+        .. code-block::
+
+            import parallel64
+            gpio = parallel64.GPIOPort(0x1234)
+
+            def acknowledged(pin, value, timestamp_ns):
+                print("ACK at", timestamp_ns)
+
+            subscription = gpio.on_change(gpio.pins.ACK, acknowledged, "falling")
+            ...
+            subscription.cancel()
+
+        :param Pin pin: The pin to watch
+        :param callback: The function to call with the pin, its new state and
+            the time of the change in nanoseconds since sampling started
+        :param str edge: (optional) Which changes to report: "rising" (to
+            True), "falling" (to False) or "both", default is both
+        :param float debounce_us: (optional) How long a new state must be
+            stable, in microseconds, before it is reported, default is no
+            debouncing (0)
+        :return: The subscription, which can be cancelled
+        :rtype: Subscription
+        :raises OSError: If the pin is output-only
+        :raises ValueError: If the edge is not valid
+        """
+
+        if not pin.input_allowed:
+            raise OSError("Input not allowed on pin " + str(pin.pin_number))
+        if edge not in ("rising", "falling", "both"):
+            raise ValueError('The edge must be "rising", "falling" or "both"')
+        if self._watcher is None:
+            self._watcher = PinWatcher(self, self._watch_period_ns)
+        return self._watcher.subscribe(pin, callback, edge, round(debounce_us * 1000))
+
+    @property
+    def watch_period_us(self) -> float:
+        """The time between the samples used by ``on_change()``, in
+        microseconds, default is ``DEFAULT_WATCH_PERIOD_US`` (5 milliseconds).
+        Changing it restarts the sampler of any pins being watched.
+
+        The sampling thread sleeps between samples until only the spin and
+        yield windows of the ``WaitPolicy`` are left (about a millisecond by
+        default), then yields, then spins.  At the default period it sleeps
+        for most of each period, but periods shorter than about two
+        milliseconds never sleep and keep a core busy while any pin is
+        watched.
+        """
+        return self._watch_period_ns / 1000
+
+    @watch_period_us.setter
+    def watch_period_us(self, period_us: float) -> None:
+
+        if period_us <= 0:
+            raise ValueError("The watch period must be positive")
+        self._watch_period_ns = round(period_us * 1000)
+        if self._watcher is not None:
+            self._watcher.set_period(self._watch_period_ns)
+
+    def stop_watching(self) -> None:
+        """Cancels every subscription made with ``on_change()``"""
+
+        if self._watcher is not None:
+            self._watcher.stop()
+
+    def play(
+        self,
+        pattern: Union[bytes, bytearray, memoryview],
+        period_ns: int,
+        control: Optional[Union[bytes, bytearray, memoryview]] = None,
+    ) -> PlaybackStats:
+        """Plays a pattern on the Data pins, writing one byte every
+        ``period_ns`` on a fixed schedule.  When the native extension is used
+        the schedule is kept without the GIL, so the output does not pick up
+        the jitter of a Python loop.  A step that starts late does not delay
+        the ones after it.
+
+        .. code-block::
+
+            import parallel64
+            gpio = parallel64.GPIOPort(0x1234)
+            stats = gpio.play(bytes((0x01, 0x00) * 1000), 10000)
+            print(stats.achieved_rate_hz, stats.max_late_ns)
+
+        :param pattern: The Data register value for each step
+        :type pattern: bytes|bytearray|memoryview
+        :param int period_ns: The time between steps in nanoseconds
+        :param control: (optional) The raw Control register value for each
+            step, written straight after the Data register, default is to
+            leave the Control register as it is
+        :type control: bytes|bytearray|memoryview|None
+        :return: The timing achieved
+        :rtype: PlaybackStats
+        :raises ValueError: If the Control pattern is not the same length as
+            the Data pattern
+        """
+
+        pattern = memoryview(pattern).cast("B")
+        if self.is_bidirectional:
+            self.direction = Direction.FORWARD
+        if control is None:
+            addresses = array.array("H", (self._spp_data_address,)) * len(pattern)
+            values = pattern
+        else:
+            control = memoryview(control).cast("B")
+            if len(control) != len(pattern):
+                raise ValueError(
+                    "The Control pattern must be the same length as the Data pattern"
+                )
+            addresses = array.array(
+                "H", (self._spp_data_address, self._control_address)
+            ) * len(pattern)
+            values = bytearray(len(pattern) * 2)
+            values[0::2] = pattern
+            values[1::2] = control
+        try:
+            result = self._port.play_writes(
+                addresses, values, 1 if control is None else 2, period_ns
+            )
+        finally:
+            self._forget_shadows(control=control is not None)
+        return PlaybackStats(*result)
+
+    def play_writes(
+        self, writes: Sequence[Tuple[int, int]], period_ns: int
+    ) -> PlaybackStats:
+        """Plays a sequence of register writes, one every ``period_ns`` on a
+        fixed schedule, in the same way as ``play()``
+
+        :param writes: The address of the register (the Data or Control
+            register, such as ``Pin.register``) and the raw value for each step
+        :type writes: Sequence[Tuple[int, int]]
+        :param int period_ns: The time between steps in nanoseconds
+        :return: The timing achieved
+        :rtype: PlaybackStats
+        :raises ValueError: If a write is not to the Data or Control register
+        """
+
+        addresses = array.array("H", (address for address, _ in writes))
+        for address in set(addresses):
+            if address not in (self._spp_data_address, self._control_address):
+                raise ValueError(f"{hex(address)} is not the Data or Control register")
+        values = bytes(value for _, value in writes)
+        if self.is_bidirectional:
+            self.direction = Direction.FORWARD
+        try:
+            result = self._port.play_writes(addresses, values, 1, period_ns)
+        finally:
+            self._forget_shadows()
+        return PlaybackStats(*result)
+
+    def reset_data_pins(self) -> None:
+        """Reset the data pins (to low)"""
+        self.write_spp_data(0)
+
+    def reset_control_pins(self) -> None:
+        """Reset the control pins (to low)"""
+
+        with self._register_locks[self._control_address]:
+            control_byte = self.read_control_register()
+            bidir_control_byte = 0b11110000 if self._is_bidir else 0b11010000
+            pre_control_byte = bidir_control_byte & control_byte
+            new_control_byte = 0b00000100 | pre_control_byte
+            self.write_control_register(new_control_byte)
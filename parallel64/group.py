@@ -0,0 +1,459 @@
+# SPDX-FileCopyrightText: 2022 Alec Delaney
+#
+# SPDX-License-Identifier: MIT
+
+"""
+`parallel64.group`
+
+Several ports driven concurrently, each from its own I/O worker thread
+
+
+* Author(s): Alec Delaney
+
+"""
+
+import json
+import queue
+import threading
+import time
+from concurrent.futures import Future
+from typing import (
+    Any,
+    Callable,
+    Dict,
+    Iterator,
+    List,
+    Optional,
+    Sequence,
+    Type,
+    TypeVar,
+)
+from parallel64.constants import Register
+from parallel64.enhanced import EnhancedPort
+from parallel64.gpio import GPIOPort
+from parallel64.standard import StandardPort
+
+_T = TypeVar("_T")
+
+_PORT_TYPES: Dict[str, Type[StandardPort]] = {
+    port_type.__name__: port_type
+    for port_type in (StandardPort, EnhancedPort, GPIOPort)
+}
+
+
+class PortBarrier:
+    """
+    Releases the I/O worker threads of a :class:`PortGroup` together, so
+    that each can write to its port at the same moment.  Once every party
+    has called ``wait()``, a release time ``lead_ns`` in the future is
+    chosen, which gives the threads time to get back the GIL and start
+    spinning on it before it arrives.
+
+    :param int parties: The number of threads that wait on the barrier
+    :param int lead_ns: (optional) How far after the last thread arrives the
+        release time is, in nanoseconds, default is 1 millisecond
+    """
+
+    def __init__(self, parties: int, lead_ns: int = 1000000) -> None:
+        self._lead_ns = lead_ns
+        self._release_ns = 0
+        self._barrier = threading.Barrier(parties, action=self._choose_release)
+
+    @property
+    def parties(self) -> int:
+        """The number of threads that wait on the barrier"""
+        return self._barrier.parties
+
+    def _choose_release(self) -> None:
+        """Sets the release time, called by the last thread to arrive"""
+        self._release_ns = time.perf_counter_ns() + self._lead_ns
+
+    def wait(self, timeout: Optional[float] = None) -> int:
+        """Waits for every party to arrive
+
+        :param float|None timeout: (optional) The time to wait in seconds,
+            default is to wait indefinitely
+        :return: The release time, in ``time.perf_counter_ns()`` nanoseconds
+        :rtype: int
+        :raises threading.BrokenBarrierError: If the wait timed out, or the
+            barrier was aborted
+        """
+
+        self._barrier.wait(timeout)
+        return self._release_ns
+
+    def abort(self) -> None:
+        """Breaks the barrier, so that the threads waiting on it raise
+        ``threading.BrokenBarrierError``
+        """
+        self._barrier.abort()
+
+    def write(
+        self,
+        port: StandardPort,
+        address: int,
+        value: int,
+        timeout: Optional[float] = None,
+    ) -> int:
+        """Waits for every party to arrive and then writes a byte to the
+        Data or Control register of the port at the release time, meant to
+        be called from the port's I/O worker thread.  The register's lock is
+        held throughout.
+
+        :param StandardPort port: The port to write to
+        :param int address: The address of the register
+        :param int value: The byte to write
+        :param float|None timeout: (optional) The time to wait for the other
+            parties in seconds, default is to wait indefinitely
+        :return: How late the write started, in nanoseconds
+        :rtype: int
+        :raises threading.BrokenBarrierError: If the wait timed out, or the
+            barrier was aborted
+        """
+
+        # pylint: disable=protected-access
+        try:
+            with port.register_lock(address):
+                release_ns = self.wait(timeout)
+                late_ns = port._port.write_port_at(address, value, release_ns)
+                port._latched_register_written(address, value)
+        except BaseException:
+            self.abort()
+            raise
+        return late_ns
+
+
+# pylint: disable=too-many-arguments
+def _write_register(
+    port: StandardPort,
+    barrier: PortBarrier,
+    register: Register,
+    value: int,
+    timeout: Optional[float],
+) -> int:
+    """Writes a register of a port at the release time of a barrier, see
+    ``PortBarrier.write()``
+
+    :rtype: int
+    """
+
+    address = port._spp_data_address + register  # pylint: disable=protected-access
+    return barrier.write(port, address, value, timeout)
+
+
+class _PortWorker:
+    """
+    A thread that runs the operations submitted for one port in order
+
+    :param StandardPort port: The port the operations are for
+    :param int|None cpu: The processor to run the thread on, or None to let
+        it run on any
+    :param str name: The name of the thread
+    """
+
+    def __init__(self, port: StandardPort, cpu: Optional[int], name: str) -> None:
+        self.port = port
+        self.cpu = cpu
+        self._queue: "queue.SimpleQueue[Optional[tuple]]" = queue.SimpleQueue()
+        started: Future = Future()
+        self._thread = threading.Thread(
+            target=self._run, args=(started,), name=name, daemon=True
+        )
+        self._thread.start()
+        try:
+            started.result()
+        except BaseException:
+            self._thread.join()
+            raise
+
+    def submit(
+        self, function: Callable[..., _T], *args: Any, **kwargs: Any
+    ) -> "Future[_T]":
+        """Queues a function to be called by the thread
+
+        :return: A future for the result of the function
+        :rtype: concurrent.futures.Future
+        """
+
+        future: Future = Future()
+        self._queue.put((future, function, args, kwargs))
+        return future
+
+    def shutdown(self) -> None:
+        """Stops the thread once the queued operations have run"""
+
+        if self._thread.is_alive():
+            self._queue.put(None)
+            self._thread.join()
+
+    def _run(self, started: Future) -> None:
+        """Runs the queued operations until shut down
+
+        :param concurrent.futures.Future started: Resolved once the thread
+            is running on its processor
+        """
+
+        try:
+            if self.cpu is not None:
+                # pylint: disable=protected-access
+                self.port._port.set_thread_affinity(1 << self.cpu)
+        except BaseException as err:  # pylint: disable=broad-except
+            started.set_exception(err)
+            return
+        started.set_result(None)
+        while True:
+            item = self._queue.get()
+            if item is None:
+                return
+            future, function, args, kwargs = item
+            if not future.set_running_or_notify_cancel():
+                continue
+            try:
+                result = function(*args, **kwargs)
+            except BaseException as err:  # pylint: disable=broad-except
+                future.set_exception(err)
+            else:
+                future.set_result(result)
+
+
+class PortGroup:
+    """
+    Several ports, each driven from its own I/O worker thread so that long
+    operations on different ports run concurrently.  The bulk transfers
+    release the GIL while they run, so the ports only contend for it
+    between operations.
+
+    Operations are submitted as functions called with the port, and return
+    futures:
+
+    .. code-block::
+
+        import parallel64
+        with parallel64.PortGroup.from_addresses([0x3000, 0x3010]) as group:
+            futures = group.submit_all(parallel64.StandardPort.write_spp_data, 0x55)
+            group.write_together([0x01, 0x02])
+
+    :param ports: The ports in the group
+    :param cpus: (optional) The processor to run each port's worker thread
+        on, with None letting it run on any, default is to let them all run
+        on any
+    :raises ValueError: If there is not one processor for each port
+    :raises OSError: If a worker thread could not be moved to its processor
+    """
+
+    def __init__(
+        self,
+        ports: Sequence[StandardPort],
+        cpus: Optional[Sequence[Optional[int]]] = None,
+    ) -> None:
+        if cpus is None:
+            cpus = [None] * len(ports)
+        if len(cpus) != len(ports):
+            raise ValueError("There must be one processor given for each port")
+        self._workers: List[_PortWorker] = []
+        try:
+            for index, (port, cpu) in enumerate(zip(ports, cpus)):
+                self._workers.append(_PortWorker(port, cpu, f"parallel64-port-{index}"))
+        except BaseException:
+            self.close()
+            raise
+
+    @classmethod
+    def from_addresses(
+        cls,
+        spp_base_addresses: Sequence[int],
+        port_type: Type[StandardPort] = StandardPort,
+        cpus: Optional[Sequence[Optional[int]]] = None,
+        **port_kwargs: Any,
+    ) -> "PortGroup":
+        """Factory method for creating a group of ports of the same type
+
+        :param spp_base_addresses: The SPP base address of each port
+        :param type port_type: (optional) The class of the ports, default is
+            StandardPort
+        :param cpus: (optional) The processor to run each port's worker
+            thread on, see :class:`PortGroup`
+        :param port_kwargs: Further arguments for creating each port
+        :rtype: PortGroup
+        """
+
+        ports = [port_type(address, **port_kwargs) for address in spp_base_addresses]
+        return cls(ports, cpus)
+
+    @classmethod
+    def from_json(cls, json_filepath: str) -> "PortGroup":
+        """Factory method for creating a group from a JSON file.  The file
+        contains a list of ports under ``ports``, each in the form used by
+        the ``from_json()`` method of its port type, and optionally a
+        ``cpu`` for its worker thread and a ``port_type`` of "StandardPort",
+        "EnhancedPort" or "GPIOPort".  A ``port_type`` at the top level
+        sets the default, which is otherwise "StandardPort".
+
+        :param str json_filepath: Filepath to the JSON
+        :rtype: PortGroup
+        :raises KeyError: If an expected key is missing in the JSON file
+        :raises ValueError: If a port type is unknown
+        """
+
+        with open(json_filepath, mode="r", encoding="utf-8") as json_file:
+            json_contents: Dict[str, Any] = json.load(json_file)
+        try:
+            port_entries: List[Dict[str, Any]] = json_contents["ports"]
+        except KeyError as err:
+            raise KeyError(
+                "Unable to find ports parameter in the JSON file, see reference documentation"
+            ) from err
+        default_type = json_contents.get("port_type", StandardPort.__name__)
+        ports = []
+        cpus = []
+        for entry in port_entries:
+            type_name = entry.get("port_type", default_type)
+            try:
+                port_type = _PORT_TYPES[type_name]
+            except KeyError as err:
+                raise ValueError(
+                    f"Unknown port type in the JSON file: {type_name}"
+                ) from err
+            ports.append(port_type.from_json_dict(entry))
+            cpus.append(entry.get("cpu"))
+        return cls(ports, cpus)
+
+    def save_json(self, json_filepath: str) -> None:
+        """Saves the configuration of every port in the group, and the
+        processor of its worker thread, to a JSON file that can be used with
+        ``from_json()``
+
+        :param str json_filepath: Filepath to the JSON
+        """
+
+        port_entries = []
+        for worker in self._workers:
+            # pylint: disable=protected-access
+            entry = {
+                "port_type": type(worker.port).__name__,
+                **worker.port._json_contents(),
+            }
+            if worker.cpu is not None:
+                entry["cpu"] = worker.cpu
+            port_entries.append(entry)
+        with open(json_filepath, mode="w", encoding="utf-8") as json_file:
+            json.dump({"ports": port_entries}, json_file, indent=4)
+
+    @property
+    def ports(self) -> List[StandardPort]:
+        """The ports in the group"""
+        return [worker.port for worker in self._workers]
+
+    def __len__(self) -> int:
+        return len(self._workers)
+
+    def __getitem__(self, index: int) -> StandardPort:
+        return self._workers[index].port
+
+    def __iter__(self) -> Iterator[StandardPort]:
+        return iter(self.ports)
+
+    def __enter__(self) -> "PortGroup":
+        return self
+
+    def __exit__(self, *exc_info: Any) -> None:
+        self.close()
+
+    def submit(
+        self, index: int, function: Callable[..., _T], *args: Any, **kwargs: Any
+    ) -> "Future[_T]":
+        """Queues an operation on one port, to be run by its worker thread
+        after the operations already queued for it
+
+        :param int index: The index of the port in the group
+        :param function: The function to call, with the port followed by the
+            remaining arguments
+        :return: A future for the result of the function
+        :rtype: concurrent.futures.Future
+        """
+
+        worker = self._workers[index]
+        return worker.submit(function, worker.port, *args, **kwargs)
+
+    def submit_all(
+        self, function: Callable[..., _T], *args: Any, **kwargs: Any
+    ) -> "List[Future[_T]]":
+        """Queues the same operation on every port
+
+        :param function: The function to call, with each port followed by
+            the remaining arguments
+        :return: A future for each port, in order
+        :rtype: list
+        """
+
+        return [
+            self.submit(index, function, *args, **kwargs)
+            for index in range(len(self._workers))
+        ]
+
+    def barrier(self, lead_ns: int = 1000000) -> PortBarrier:
+        """Creates a barrier for every port's worker thread, for use in
+        submitted operations that should act at the same moment
+
+        :param int lead_ns: (optional) See :class:`PortBarrier`
+        :rtype: PortBarrier
+        """
+        return PortBarrier(len(self._workers), lead_ns)
+
+    def write_together(
+        self,
+        values: Sequence[Optional[int]],
+        register: Register = Register.DATA,
+        lead_ns: int = 1000000,
+        timeout: Optional[float] = None,
+    ) -> List[Optional[int]]:
+        """Writes a byte to the same register of each port at the same
+        moment, once the operations already queued for the ports have run
+
+        :param values: The byte to write to each port, or None to leave a
+            port unchanged
+        :param Register register: (optional) The register to write, either
+            ``Register.DATA`` or ``Register.CONTROL``, default is the Data
+            register
+        :param int lead_ns: (optional) See :class:`PortBarrier`
+        :param float|None timeout: (optional) The time the worker threads
+            wait for each other in seconds, default is to wait indefinitely
+        :return: How late each write started after the release time in
+            nanoseconds, or None for ports that were left unchanged
+        :rtype: list
+        :raises ValueError: If there is not one value for each port, or the
+            register is not writable
+        :raises threading.BrokenBarrierError: If the worker threads timed out
+            waiting for each other
+        """
+
+        if len(values) != len(self._workers):
+            raise ValueError("There must be one value given for each port")
+        if register not in (Register.DATA, Register.CONTROL):
+            raise ValueError(
+                "Only the Data and Control registers can be written together"
+            )
+        writes = [
+            (index, value) for index, value in enumerate(values) if value is not None
+        ]
+        if not writes:
+            return [None] * len(values)
+        barrier = PortBarrier(len(writes), lead_ns)
+        futures = {
+            index: self.submit(
+                index, _write_register, barrier, register, value, timeout
+            )
+            for index, value in writes
+        }
+        return [
+            futures[index].result() if index in futures else None
+            for index in range(len(self._workers))
+        ]
+
+    def close(self) -> None:
+        """Stops the worker threads once the operations queued for them have
+        run
+        """
+
+        for worker in self._workers:
+            worker.shutdown()
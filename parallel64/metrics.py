@@ -0,0 +1,233 @@
+# SPDX-FileCopyrightText: 2022 Alec Delaney
+#
+# SPDX-License-Identifier: MIT
+
+"""
+`parallel64.metrics`
+
+Instrumentation of register accesses and waits.  The native extension
+records them when built with ``PARALLEL64_METRICS`` set in the environment,
+and ``CtypesBackend`` when it is set while ``parallel64`` is imported.
+Otherwise nothing is recorded and there is no overhead.
+
+
+* Author(s): Alec Delaney
+
+"""
+
+import os
+import time
+from typing import Any, Callable, Dict, List, NamedTuple, Optional, Tuple
+
+BUCKET_COUNT = 32
+"""The number of buckets in each histogram.  Bucket ``i`` counts durations
+from ``2**i`` up to ``2**(i + 1)`` nanoseconds, with bucket 0 also counting
+shorter ones and the last bucket longer ones."""
+
+_ENABLED = bool(os.environ.get("PARALLEL64_METRICS"))
+
+
+def _bucket(ns: int) -> int:
+    """Returns the histogram bucket for a duration
+
+    :param int ns: The duration in nanoseconds
+    :rtype: int
+    """
+    return min(max(ns.bit_length() - 1, 0), BUCKET_COUNT - 1)
+
+
+class RegisterMetrics(NamedTuple):
+    """The accesses to a register and the waits on it since the metrics
+    were last reset, as returned by a port's ``metrics()``
+
+    :param int reads: The number of reads
+    :param int writes: The number of writes
+    :param int waits: The number of waits for bits of the register, such as
+        handshake waits on the Status register
+    :param int wait_timeouts: The number of those waits that timed out
+    :param int wait_ns: The total time spent waiting, in nanoseconds
+    :param tuple read_latency: The histogram of read durations, see
+        ``BUCKET_COUNT``
+    :param tuple write_latency: The histogram of write durations
+    :param tuple wait_time: The histogram of wait durations
+    :param bool shared: Whether the counters are shared with other
+        registers, which happens once enough registers have been used
+    """
+
+    reads: int
+    writes: int
+    waits: int
+    wait_timeouts: int
+    wait_ns: int
+    read_latency: Tuple[int, ...]
+    write_latency: Tuple[int, ...]
+    wait_time: Tuple[int, ...]
+    shared: bool = False
+
+    @property
+    def mean_wait_ns(self) -> float:
+        """The mean time spent per wait, in nanoseconds"""
+        return self.wait_ns / self.waits if self.waits else 0.0
+
+    @staticmethod
+    def percentile_ns(histogram: Tuple[int, ...], fraction: float) -> int:
+        """Returns an upper bound on a percentile of a histogram, as the end
+        of the bucket it falls in
+
+        :param tuple histogram: One of the histograms
+        :param float fraction: The percentile as a fraction, such as 0.99
+        :return: The upper bound in nanoseconds, or 0 for an empty histogram
+        :rtype: int
+        """
+
+        total = sum(histogram)
+        if total == 0:
+            return 0
+        needed = fraction * total
+        seen = 0
+        for bucket, count in enumerate(histogram):
+            seen += count
+            if seen >= needed:
+                return 2 ** (bucket + 1)
+        return 2**BUCKET_COUNT
+
+
+class CtypesMetrics:
+    """
+    The register access metrics of ``CtypesBackend``, mirroring the
+    ``metrics_enabled()``, ``register_metrics()`` and ``reset_*metrics()``
+    functions of ``parallel64._native``.  When enabled, the register
+    functions are replaced with ones that time each access.
+    """
+
+    # Provided by CtypesBackend
+    DlPortReadPortUchar: Callable[[int], int]
+    DlPortWritePortUchar: Callable[[int, int], None]
+    DlPortReadPortUshort: Callable[[int], int]
+    DlPortWritePortUshort: Callable[[int, int], None]
+    DlPortReadPortUlong: Callable[[int], int]
+    DlPortWritePortUlong: Callable[[int, int], None]
+
+    # The counters of each register: reads, writes, waits, wait timeouts,
+    # wait time and the read, write and wait histograms
+    _metrics: Optional[Dict[int, List[Any]]] = None
+
+    def metrics_enabled(self) -> bool:
+        """Returns whether the register access metrics are recorded
+
+        :rtype: bool
+        """
+        return _ENABLED
+
+    def register_metrics(self, port: int) -> Optional[Tuple[Any, ...]]:
+        """Returns the metrics of a register, in the form of
+        ``RegisterMetrics``
+
+        :param int port: The register address
+        :return: The metrics, or None if the register has not been used
+        :rtype: tuple|None
+        :raises RuntimeError: If the metrics are not enabled
+        """
+
+        self._check_metrics_enabled()
+        counters = self._metrics.get(port)
+        if counters is None:
+            return None
+        return (*counters[:5], *(tuple(histogram) for histogram in counters[5:]), False)
+
+    def reset_register_metrics(self, port: int) -> None:
+        """Resets the metrics of a register
+
+        :param int port: The register address
+        :raises RuntimeError: If the metrics are not enabled
+        """
+
+        self._check_metrics_enabled()
+        self._metrics.pop(port, None)
+
+    def reset_metrics(self) -> None:
+        """Resets the metrics of every register
+
+        :raises RuntimeError: If the metrics are not enabled
+        """
+
+        self._check_metrics_enabled()
+        self._metrics.clear()
+
+    def _check_metrics_enabled(self) -> None:
+        """Raises RuntimeError if the metrics are not enabled"""
+
+        if self._metrics is None:
+            raise RuntimeError(
+                "PARALLEL64_METRICS was not set when parallel64 was imported"
+            )
+
+    def _counters(self, port: int) -> List[Any]:
+        """Returns the counters of a register, creating them if needed
+
+        :param int port: The register address
+        :rtype: list
+        """
+
+        counters = self._metrics.get(port)
+        if counters is None:
+            counters = [0, 0, 0, 0, 0] + [[0] * BUCKET_COUNT for _ in range(3)]
+            self._metrics[port] = counters
+        return counters
+
+    def _instrument_registers(self) -> None:
+        """Wraps the register functions with ones that time each access,
+        if the metrics are enabled
+        """
+
+        if not _ENABLED:
+            return
+        if self._metrics is None:
+            self._metrics = {}
+        counters_of = self._counters
+
+        def make_read(read_port: Callable[[int], int]):
+            def read(port: int) -> int:
+                start = time.perf_counter_ns()
+                value = read_port(port)
+                counters = counters_of(port)
+                counters[0] += 1
+                counters[5][_bucket(time.perf_counter_ns() - start)] += 1
+                return value
+
+            return read
+
+        def make_write(write_port: Callable[[int, int], None]):
+            def write(port: int, value: int) -> None:
+                start = time.perf_counter_ns()
+                write_port(port, value)
+                counters = counters_of(port)
+                counters[1] += 1
+                counters[6][_bucket(time.perf_counter_ns() - start)] += 1
+
+            return write
+
+        # pylint: disable=invalid-name
+        self.DlPortReadPortUchar = make_read(self.DlPortReadPortUchar)
+        self.DlPortWritePortUchar = make_write(self.DlPortWritePortUchar)
+        self.DlPortReadPortUshort = make_read(self.DlPortReadPortUshort)
+        self.DlPortWritePortUshort = make_write(self.DlPortWritePortUshort)
+        self.DlPortReadPortUlong = make_read(self.DlPortReadPortUlong)
+        self.DlPortWritePortUlong = make_write(self.DlPortWritePortUlong)
+
+    def _record_port_wait(self, port: int, waited_ns: int, matched: bool) -> None:
+        """Records a wait on a register, if the metrics are enabled
+
+        :param int port: The register address
+        :param int waited_ns: How long the wait took in nanoseconds
+        :param bool matched: Whether the wait ended before timing out
+        """
+
+        if self._metrics is None:
+            return
+        counters = self._counters(port)
+        counters[2] += 1
+        if not matched:
+            counters[3] += 1
+        counters[4] += waited_ns
+        counters[7][_bucket(waited_ns)] += 1
@@ -0,0 +1,176 @@
+# SPDX-FileCopyrightText: 2022 Alec Delaney
+#
+# SPDX-License-Identifier: MIT
+
+"""
+`parallel64.mmio`
+
+The memory-mapped register access of ``CtypesBackend``, used when the
+native extension is unavailable.  InpOut documents ``MapPhysToLin`` as
+untested and likely not to work, especially on x64, so mapping raises
+``OSError`` where it fails and the ports are left in I/O space.
+
+
+* Author(s): Alec Delaney
+
+"""
+
+import atexit
+import ctypes
+import threading
+from typing import Any, Callable, Dict, List, Optional, Tuple
+
+_mmio_lock = threading.Lock()
+
+
+class CtypesMmio:
+    """
+    The memory-mapped register access of ``CtypesBackend``, mirroring the
+    ``map_mmio()`` and ``mmio_mapped()`` functions of ``parallel64._native``.
+    Once registers are mapped, the register functions are replaced with ones
+    that access mapped ports through the mapping and the others through the
+    DLL, and instrumented again if the metrics are enabled.
+    """
+
+    # Provided by CtypesBackend
+    _dll: Any
+    DlPortReadPortUchar: Callable[[int], int]
+    DlPortWritePortUchar: Callable[[int, int], None]
+    DlPortReadPortUshort: Callable[[int], int]
+    DlPortWritePortUshort: Callable[[int, int], None]
+    DlPortReadPortUlong: Callable[[int], int]
+    DlPortWritePortUlong: Callable[[int, int], None]
+    _instrument_registers: Callable[[], None]
+
+    # The linear and physical addresses of each mapped port
+    _mmio_linear: Optional[Dict[int, int]] = None
+    _mmio_physical: Optional[Dict[int, int]] = None
+    # The handle and linear address of each mapping, unmapped at exit
+    _mmio_mappings: Optional[List[Tuple[ctypes.c_void_p, int]]] = None
+
+    def map_mmio(self, base: int, count: int, physical_address: int) -> None:
+        """Maps registers at a physical address and accesses them as the
+        given ports.  The mapping is kept until the interpreter exits.
+
+        :param int base: The first port
+        :param int count: The number of registers
+        :param int physical_address: The physical address of the first
+            register
+        :raises ValueError: If the ports or address are out of range, or the
+            ports are already mapped to a different address
+        :raises OSError: If the registers could not be mapped
+        """
+
+        if count <= 0 or base < 0 or base + count > 0x10000 or physical_address <= 0:
+            raise ValueError("the ports or physical address are out of range")
+        with _mmio_lock:
+            if self._mmio_linear is None:
+                self._mmio_linear = {}
+                self._mmio_physical = {}
+                self._mmio_mappings = []
+                self._route_registers()
+                atexit.register(self._unmap_mmio)
+            ports = range(base, base + count)
+            for offset, port in enumerate(ports):
+                current = self._mmio_physical.get(port)
+                if current is not None and current != physical_address + offset:
+                    raise ValueError(
+                        "the ports are already mapped to a different physical address"
+                    )
+            if all(port in self._mmio_physical for port in ports):
+                return
+            self._dll.MapPhysToLin.argtypes = (
+                ctypes.c_void_p,
+                ctypes.c_ulong,
+                ctypes.POINTER(ctypes.c_void_p),
+            )
+            self._dll.MapPhysToLin.restype = ctypes.c_void_p
+            handle = ctypes.c_void_p()
+            linear = self._dll.MapPhysToLin(
+                physical_address, count, ctypes.byref(handle)
+            )
+            if not linear:
+                raise OSError("the InpOut driver could not map the registers")
+            self._mmio_mappings.append((handle, linear))
+            for offset, port in enumerate(ports):
+                if port not in self._mmio_physical:
+                    self._mmio_physical[port] = physical_address + offset
+                    self._mmio_linear[port] = linear + offset
+
+    def mmio_mapped(self, port: int) -> bool:
+        """Returns whether the port is accessed through a memory mapping
+
+        :param int port: The port
+        :rtype: bool
+        """
+
+        return self._mmio_linear is not None and port in self._mmio_linear
+
+    def _unmap_mmio(self) -> None:
+        """Routes the mapped ports back to the DLL, then unmaps the
+        registers
+        """
+
+        with _mmio_lock:
+            self._mmio_linear.clear()
+            self._mmio_physical.clear()
+            self._dll.UnmapPhysicalMemory.argtypes = (ctypes.c_void_p, ctypes.c_void_p)
+            self._dll.UnmapPhysicalMemory.restype = ctypes.c_int
+            for handle, linear in self._mmio_mappings:
+                self._dll.UnmapPhysicalMemory(handle, linear)
+            self._mmio_mappings.clear()
+
+    def _route_registers(self) -> None:
+        """Replaces the register functions with ones that access mapped
+        ports through their mapping.  Wider accesses only use the mapping if
+        all their addresses are mapped contiguously.
+        """
+
+        linear = self._mmio_linear
+        dll = self._dll
+
+        def mapped(port: int, width: int) -> Optional[int]:
+            address = linear.get(port)
+            if address is None or width == 1:
+                return address
+            if linear.get(port + width - 1) != address + width - 1:
+                return None
+            return address
+
+        def make_read(width: int, ctype: Any, dll_read: Callable[[int], int]):
+            def read(port: int) -> int:
+                address = mapped(port, width)
+                if address is None:
+                    return dll_read(port)
+                return ctype.from_address(address).value
+
+            return read
+
+        def make_write(width: int, ctype: Any, dll_write: Callable[[int, int], None]):
+            def write(port: int, value: int) -> None:
+                address = mapped(port, width)
+                if address is None:
+                    dll_write(port, value)
+                else:
+                    ctype.from_address(address).value = value
+
+            return write
+
+        # pylint: disable=invalid-name
+        self.DlPortReadPortUchar = make_read(1, ctypes.c_uint8, dll.DlPortReadPortUchar)
+        self.DlPortWritePortUchar = make_write(
+            1, ctypes.c_uint8, dll.DlPortWritePortUchar
+        )
+        self.DlPortReadPortUshort = make_read(
+            2, ctypes.c_uint16, dll.DlPortReadPortUshort
+        )
+        self.DlPortWritePortUshort = make_write(
+            2, ctypes.c_uint16, dll.DlPortWritePortUshort
+        )
+        self.DlPortReadPortUlong = make_read(
+            4, ctypes.c_uint32, dll.DlPortReadPortUlong
+        )
+        self.DlPortWritePortUlong = make_write(
+            4, ctypes.c_uint32, dll.DlPortWritePortUlong
+        )
+        self._instrument_registers()
@@ -14,18 +14,50 @@ of a GPIO port
 """
 
 import threading
-from typing import List, Tuple
+from typing import Dict, List, NamedTuple, Optional, Tuple
 
 
 class Pin:
-    """Class representing a pin"""
+    """Class representing a pin
+
+    :ivar int bit_mask: The mask of the pin's bit in its register
+    :ivar int inversion_mask: The mask to XOR with the register to undo the
+        pin's hardware inversion (0 if it is not inverted)
+    :ivar register_lock: The lock for the pin's register, shared by the pins
+        on the same register of the same port and useful for making I/O safe
+        code
+    :vartype register_lock: threading.RLock
+    """
 
+    __slots__ = (
+        "pin_number",
+        "bit_index",
+        "register",
+        "bit_mask",
+        "inversion_mask",
+        "register_lock",
+        "_hw_inverted",
+        "_allow_input",
+        "_allow_output",
+    )
+
+    # pylint: disable=too-many-arguments
     def __init__(
-        self, pin_number: int, bit_index: int, register: int, hw_inverted: bool = False
+        self,
+        pin_number: int,
+        bit_index: int,
+        register: int,
+        hw_inverted: bool = False,
+        register_lock: Optional[threading.RLock] = None,
     ) -> None:
         self.pin_number = pin_number
         self.bit_index = bit_index
         self.register = register
+        self.bit_mask = 1 << bit_index
+        self.inversion_mask = self.bit_mask if hw_inverted else 0
+        self.register_lock = (
+            threading.RLock() if register_lock is None else register_lock
+        )
         self._hw_inverted = hw_inverted
         self._allow_input = None
         self._allow_output = None
@@ -47,58 +79,58 @@ class Pin:
 
 
 class DataPin(Pin):
-    """Class representing an individual data pin, including a
-    class-wide threading.Lock for I/O operations
-
-    :ivar register_lock: A class-wide thread lock useful for
-        making I/O safe code
-    :vartype register_lock: threading.Lock
-    """
+    """Class representing an individual data pin"""
 
-    register_lock = threading.Lock()
+    __slots__ = ()
 
+    # pylint: disable=too-many-arguments
     def __init__(
-        self, pin_number: int, bit_index: int, register: int, is_bidir: bool
+        self,
+        pin_number: int,
+        bit_index: int,
+        register: int,
+        is_bidir: bool,
+        register_lock: Optional[threading.RLock] = None,
     ) -> None:
-        super().__init__(pin_number, bit_index, register, False)
+        super().__init__(pin_number, bit_index, register, False, register_lock)
         self._allow_input = is_bidir
         self._allow_output = True
 
 
 class StatusPin(Pin):
-    """Class representing an individual status pin, including a
-    class-wide threading.Lock for I/O operations
-
-    :ivar register_lock: A class-wide thread lock useful for
-        making I/O safe code
-    :vartype register_lock: threading.Lock
-    """
+    """Class representing an individual status pin"""
 
-    register_lock = threading.Lock()
+    __slots__ = ()
 
+    # pylint: disable=too-many-arguments
     def __init__(
-        self, pin_number: int, bit_index: int, register: int, hw_inverted: bool = False
+        self,
+        pin_number: int,
+        bit_index: int,
+        register: int,
+        hw_inverted: bool = False,
+        register_lock: Optional[threading.RLock] = None,
     ) -> None:
-        super().__init__(pin_number, bit_index, register, hw_inverted)
+        super().__init__(pin_number, bit_index, register, hw_inverted, register_lock)
         self._allow_input = True
         self._allow_output = False
 
 
 class ControlPin(Pin):
-    """Class representing an individual control pin, including a
-    class-wide threading.Lock for I/O operations
-
-    :ivar register_lock: A class-wide thread lock useful for
-        making I/O safe code
-    :vartype register_lock: threading.Lock
-    """
+    """Class representing an individual control pin"""
 
-    register_lock = threading.Lock()
+    __slots__ = ()
 
+    # pylint: disable=too-many-arguments
     def __init__(
-        self, pin_number: int, bit_index: int, register: int, hw_inverted: bool = False
+        self,
+        pin_number: int,
+        bit_index: int,
+        register: int,
+        hw_inverted: bool = False,
+        register_lock: Optional[threading.RLock] = None,
     ) -> None:
-        super().__init__(pin_number, bit_index, register, hw_inverted)
+        super().__init__(pin_number, bit_index, register, hw_inverted, register_lock)
         self._allow_input = True
         self._allow_output = True
 
@@ -124,37 +156,62 @@ class Pins:
 
     Control Pins:
     STROBE, AUTO_LINEFEED, INITIALIZE, SELECT_PRINTER
+
+    :param int data_address: The SPP base address of the port
+    :param bool is_bidir: Whether the port is bidirectional
+    :param dict|None register_locks: (optional) The lock of each register of
+        the port, by address, so the pins share their port's locks.  Default
+        is to create a lock for each register.
     """
 
-    def __init__(self, data_address: int, is_bidir: bool) -> None:
-        self.STROBE = ControlPin(1, 0, data_address + 2, True)
-        self.AUTO_LINEFEED = ControlPin(14, 1, data_address + 2, True)
-        self.INITIALIZE = ControlPin(16, 2, data_address + 2)
-        self.SELECT_PRINTER = ControlPin(17, 3, data_address + 2, True)
-
-        self.ACK = StatusPin(10, 6, data_address + 1)
-        self.BUSY = StatusPin(11, 7, data_address + 1, True)
-        self.PAPER_OUT = StatusPin(12, 5, data_address + 1)
-        self.SELECT_IN = StatusPin(13, 4, data_address + 1)
-        self.ERROR = StatusPin(15, 3, data_address + 1)
-
-        self.D0 = DataPin(2, 0, data_address, is_bidir)
-        self.D1 = DataPin(3, 1, data_address, is_bidir)
-        self.D2 = DataPin(4, 2, data_address, is_bidir)
-        self.D3 = DataPin(5, 3, data_address, is_bidir)
-        self.D4 = DataPin(6, 4, data_address, is_bidir)
-        self.D5 = DataPin(7, 5, data_address, is_bidir)
-        self.D6 = DataPin(8, 6, data_address, is_bidir)
-        self.D7 = DataPin(9, 7, data_address, is_bidir)
+    def __init__(
+        self,
+        data_address: int,
+        is_bidir: bool,
+        register_locks: Optional[Dict[int, threading.RLock]] = None,
+    ) -> None:
+        if register_locks is None:
+            register_locks = {
+                data_address + offset: threading.RLock() for offset in range(3)
+            }
+        data_lock = register_locks[data_address]
+        status_lock = register_locks[data_address + 1]
+        control_lock = register_locks[data_address + 2]
+
+        self.STROBE = ControlPin(1, 0, data_address + 2, True, control_lock)
+        self.AUTO_LINEFEED = ControlPin(14, 1, data_address + 2, True, control_lock)
+        self.INITIALIZE = ControlPin(16, 2, data_address + 2, False, control_lock)
+        self.SELECT_PRINTER = ControlPin(17, 3, data_address + 2, True, control_lock)
+
+        self.ACK = StatusPin(10, 6, data_address + 1, False, status_lock)
+        self.BUSY = StatusPin(11, 7, data_address + 1, True, status_lock)
+        self.PAPER_OUT = StatusPin(12, 5, data_address + 1, False, status_lock)
+        self.SELECT_IN = StatusPin(13, 4, data_address + 1, False, status_lock)
+        self.ERROR = StatusPin(15, 3, data_address + 1, False, status_lock)
+
+        self.D0 = DataPin(2, 0, data_address, is_bidir, data_lock)
+        self.D1 = DataPin(3, 1, data_address, is_bidir, data_lock)
+        self.D2 = DataPin(4, 2, data_address, is_bidir, data_lock)
+        self.D3 = DataPin(5, 3, data_address, is_bidir, data_lock)
+        self.D4 = DataPin(6, 4, data_address, is_bidir, data_lock)
+        self.D5 = DataPin(7, 5, data_address, is_bidir, data_lock)
+        self.D6 = DataPin(8, 6, data_address, is_bidir, data_lock)
+        self.D7 = DataPin(9, 7, data_address, is_bidir, data_lock)
+
+        self._pin_list: Tuple[Tuple[str, Pin], ...] = tuple(
+            (pin_name, pin)
+            for pin_name, pin in self.__dict__.items()
+            if isinstance(pin, Pin)
+        )
+        by_number: List[Optional[Pin]] = [None] * 18
+        for _, pin in self._pin_list:
+            by_number[pin.pin_number] = pin
+        self._by_number = tuple(by_number)
 
     @property
     def pin_list(self) -> List[Tuple[str, Pin]]:
         """Returns a list of pins and their names"""
-        return [
-            (pin_name, pin)
-            for pin_name, pin in self.__dict__.items()
-            if isinstance(pin, Pin)
-        ]
+        return list(self._pin_list)
 
     def get_pin_number(self, pin_number: int) -> Pin:
         """Returns a pin based off of the pin number
@@ -163,4 +220,88 @@ class Pins:
         """
         if not 1 <= pin_number <= 17:
             raise ValueError("Only pins 1-17 are accessible")
-        return [pin for _, pin in self.pin_list if pin.pin_number == pin_number][0]
+        return self._by_number[pin_number]
+
+
+# Register (0 for Data, 1 for Status, 2 for Control) and bit index of each
+# pin, by pin number
+_SNAPSHOT_PIN_BITS = {
+    1: (2, 0),
+    2: (0, 0),
+    3: (0, 1),
+    4: (0, 2),
+    5: (0, 3),
+    6: (0, 4),
+    7: (0, 5),
+    8: (0, 6),
+    9: (0, 7),
+    10: (1, 6),
+    11: (1, 7),
+    12: (1, 5),
+    13: (1, 4),
+    14: (2, 1),
+    15: (1, 3),
+    16: (2, 2),
+    17: (2, 3),
+}
+
+
+class PortSnapshot(NamedTuple):
+    """The states of all the pins of a port, read together with
+    ``GPIOPort.snapshot()``.  The register values have already had the
+    hardware inversion of BUSY, STROBE, AUTO_LINEFEED and SELECT_PRINTER
+    undone, so every bit is the logical state of its pin.
+
+    :param int data: The states of the Data pins
+    :param int status: The states of the Status pins
+    :param int control: The states of the Control pins
+    """
+
+    data: int
+    status: int
+    control: int
+
+    STATUS_INVERSION_MASK = 0b10000000
+    CONTROL_INVERSION_MASK = 0b00001011
+
+    @classmethod
+    def from_registers(cls, data: int, status: int, control: int) -> "PortSnapshot":
+        """Creates a snapshot from the values read from the registers
+
+        :param int data: The value of the Data register
+        :param int status: The value of the Status register
+        :param int control: The value of the Control register
+        :rtype: PortSnapshot
+        """
+
+        return cls(
+            data,
+            status ^ cls.STATUS_INVERSION_MASK,
+            control ^ cls.CONTROL_INVERSION_MASK,
+        )
+
+    def pin(self, pin_number: int) -> bool:
+        """Returns the state of a pin based off of the pin number
+
+        :param int pin_number: The pin number
+        :rtype: bool
+        :raises ValueError: If the pin number is not 1-17
+        """
+
+        try:
+            register_index, bit_index = _SNAPSHOT_PIN_BITS[pin_number]
+        except KeyError as err:
+            raise ValueError("Only pins 1-17 are accessible") from err
+        return bool((self[register_index] >> bit_index) & 1)
+
+    @property
+    def packed(self) -> int:
+        """The states of pins 1-17 packed into an integer, with the state of
+        pin N at bit N - 1
+        """
+
+        packed = self.data << 1
+        for pin_number, (register_index, bit_index) in _SNAPSHOT_PIN_BITS.items():
+            if register_index:
+                packed |= ((self[register_index] >> bit_index) & 1) << (pin_number - 1)
+        return packed
@@ -0,0 +1,186 @@
+# SPDX-FileCopyrightText: 2022 Alec Delaney
+#
+# SPDX-License-Identifier: MIT
+
+"""
+`parallel64.program`
+
+Port programs: fixed lists of register writes, reads, waits, delays and
+loops that run in a single call, without Python between the steps when
+the native extension is used
+
+
+* Author(s): Alec Delaney
+
+"""
+
+import struct
+from contextlib import contextmanager
+from typing import Dict, Iterator, List, NamedTuple, Optional, Tuple
+from parallel64.constants import Register
+
+_INSTRUCTION = struct.Struct("<BBHBBxxq")
+
+_OP_WRITE = 1
+_OP_READ = 2
+_OP_WAIT = 3
+_OP_DELAY = 4
+_OP_LOOP = 5
+
+
+class ProgramResult(NamedTuple):
+    """The result of running a ``PortProgram``
+
+    :param bytes reads: The value of each read, in the order they ran
+    """
+
+    reads: bytes
+
+
+class PortProgram:
+    """
+    A list of register operations built once and run with
+    ``StandardPort.execute()``.  Registers are given relative to the SPP base
+    address, so the same program can be run on any port.  For example, an SPP
+    handshake for one byte:
+
+    .. code-block::
+
+        import parallel64
+        from parallel64 import Register
+
+        port = parallel64.StandardPort(0x1234)
+        control = port.read_control_register() & 0b11011110
+        program = parallel64.PortProgram()
+        program.wait_bit(Register.STATUS, 0b10000000, 0b10000000, timeout=1.0)
+        program.write(Register.DATA, 0x41)
+        program.delay_ns(500)
+        program.write(Register.CONTROL, control | 0b00000001)
+        program.delay_ns(1000)
+        program.write(Register.CONTROL, control)
+        program.read(Register.STATUS)
+        status = port.execute(program).reads[0]
+
+    Every method returns the program, so calls can be chained.
+    """
+
+    def __init__(self) -> None:
+        self._instructions: List[Tuple[int, int, int, int, int]] = []
+        self._compiled: Dict[int, bytes] = {}
+
+    def __len__(self) -> int:
+        return len(self._instructions)
+
+    def _append(
+        self, opcode: int, register: int, value_a: int, value_b: int, arg: int
+    ) -> None:
+        """Adds an instruction, discarding any compiled copies"""
+
+        if not 0 <= register <= Register.EPP_DATA:
+            raise ValueError(f"{register} is not a register offset")
+        self._instructions.append((opcode, register, value_a, value_b, arg))
+        self._compiled.clear()
+
+    def write(self, register: Register, value: int) -> "PortProgram":
+        """Adds a write to a register
+
+        :param Register register: The register
+        :param int value: The value to write
+        :rtype: PortProgram
+        """
+
+        if not 0 <= value <= 0xFF:
+            raise ValueError("The value must be a byte")
+        self._append(_OP_WRITE, register, value, 0, 0)
+        return self
+
+    def read(self, register: Register) -> "PortProgram":
+        """Adds a read of a register, stored in ``ProgramResult.reads``
+
+        :param Register register: The register
+        :rtype: PortProgram
+        """
+
+        self._append(_OP_READ, register, 0, 0, 0)
+        return self
+
+    def wait_bit(
+        self, register: Register, mask: int, value: int, timeout: Optional[float] = 1.0
+    ) -> "PortProgram":
+        """Adds a wait for the masked bits of a register to equal a value,
+        backing off as set by ``set_wait_policy()``.  The program stops if
+        the wait times out.
+
+        :param Register register: The register
+        :param int mask: The bits to check
+        :param int value: The value to wait for the masked bits to equal
+        :param float|None timeout: (optional) How long to wait in seconds, or
+            None to wait indefinitely, default is 1 second
+        :rtype: PortProgram
+        """
+
+        if not 0 <= mask <= 0xFF or not 0 <= value <= 0xFF:
+            raise ValueError("The mask and value must be bytes")
+        timeout_ns = -1 if timeout is None else round(timeout * 1e9)
+        self._append(_OP_WAIT, register, mask, value & mask, timeout_ns)
+        return self
+
+    def delay_ns(self, ns: int) -> "PortProgram":
+        """Adds a delay
+
+        :param int ns: The delay in nanoseconds
+        :rtype: PortProgram
+        """
+
+        if ns < 0:
+            raise ValueError("The delay must be non-negative")
+        self._append(_OP_DELAY, 0, 0, 0, ns)
+        return self
+
+    @contextmanager
+    def loop(self, count: int) -> Iterator["PortProgram"]:
+        """Repeats the instructions added inside the ``with`` block:
+
+        .. code-block::
+
+            with program.loop(100):
+                program.write(Register.DATA, 0xFF)
+                program.write(Register.DATA, 0x00)
+
+        :param int count: The number of times to run the instructions
+        """
+
+        if count < 1:
+            raise ValueError("A loop must run at least once")
+        start = len(self._instructions)
+        yield self
+        if len(self._instructions) == start:
+            return
+        if start > 0xFFFF:
+            raise ValueError("The program is too long to loop")
+        self._instructions.append((_OP_LOOP, start, 0, 0, count))
+        self._compiled.clear()
+
+    def compile(self, spp_base_address: int) -> bytes:
+        """Returns the program as the instructions run by the backend, with
+        the registers of the given port
+
+        :param int spp_base_address: The SPP base address of the port
+        :rtype: bytes
+        """
+
+        compiled = self._compiled.get(spp_base_address)
+        if compiled is None:
+            compiled = b"".join(
+                _INSTRUCTION.pack(
+                    opcode,
+                    0,
+                    register if opcode == _OP_LOOP else spp_base_address + register,
+                    value_a,
+                    value_b,
+                    arg,
+                )
+                for opcode, register, value_a, value_b, arg in self._instructions
+            )
+            self._compiled[spp_base_address] = compiled
+        return compiled
@@ -0,0 +1,472 @@
+# SPDX-FileCopyrightText: 2022 Alec Delaney
+#
+# SPDX-License-Identifier: MIT
+
+"""
+`parallel64.protocols`
+
+Bit-banged SPI, I2C and shift register protocols using the pins of a
+GPIO port.  The bits of each byte are clocked by the native extension
+when it is available, with one port write per clock edge.
+
+
+* Author(s): Alec Delaney
+
+"""
+
+from typing import TYPE_CHECKING, Optional, Tuple, Union
+from parallel64.constants import Direction
+from parallel64.pins import Pin
+
+if TYPE_CHECKING:
+    from parallel64.gpio import GPIOPort
+
+Buffer = Union[bytes, bytearray, memoryview]
+
+# The shift engine mode bit that changes the data line in a write of its own
+# after each clock edge, so it never changes while the clock is high
+_MODE_SEPARATE_DATA = 0b1000
+
+
+class _ShiftEngine:
+    """
+    Clocks bytes out and in using a clock pin and optional data pins, where
+    the clock and data out pins must be on the same register so each clock
+    edge is one write
+
+    :param GPIOPort gpio: The port the pins are on
+    :param Pin clock: The clock pin
+    :param Pin|None data_out: The data out pin, if any
+    :param Pin|None data_in: The data in pin, if any
+    :param int mode: Bit 0 is the clock polarity, bit 1 the clock phase,
+        bit 2 shifts the least significant bit first and bit 3 changes the
+        data out pin in a write of its own after each clock edge
+    :param int half_period_ns: How long each clock edge is held
+    """
+
+    # pylint: disable=too-many-arguments
+    def __init__(
+        self,
+        gpio: "GPIOPort",
+        clock: Pin,
+        data_out: Optional[Pin],
+        data_in: Optional[Pin],
+        mode: int,
+        half_period_ns: int,
+    ) -> None:
+        if not clock.output_allowed:
+            raise OSError("Output not allowed on pin " + str(clock.pin_number))
+        if data_out is not None:
+            if not data_out.output_allowed:
+                raise OSError("Output not allowed on pin " + str(data_out.pin_number))
+            if data_out.register != clock.register:
+                raise ValueError(
+                    "The clock and data out pins must be on the same register"
+                )
+        if data_in is not None:
+            if not data_in.input_allowed:
+                raise OSError("Input not allowed on pin " + str(data_in.pin_number))
+            if data_in.register == clock.register:
+                raise ValueError("The data in pin must not be on the output register")
+        self._gpio = gpio
+        self._clock = clock
+        self._data_out = data_out
+        self._data_in = data_in
+        self.mode = mode
+        self.half_period_ns = half_period_ns
+
+    def shift(self, data: Buffer, bits: int = 8) -> bytes:
+        """Shifts bytes out and in
+
+        :param data: The bytes to shift out
+        :type data: bytes|bytearray|memoryview
+        :param int bits: (optional) The number of bits of each byte to shift,
+            default is 8
+        :return: The bytes shifted in, with the bits in the same positions
+        :rtype: bytes
+        """
+
+        gpio = self._gpio
+        # pylint: disable=protected-access
+        if gpio.is_bidirectional and self._clock.register == gpio._spp_data_address:
+            gpio.direction = Direction.FORWARD
+        out_register = self._clock.register
+        data_out = self._data_out
+        data_in = self._data_in
+        with gpio.register_lock(out_register):
+            received, state = gpio._port.shift_bytes(
+                out_register,
+                gpio._read_latched_register(out_register),
+                self._clock.bit_mask,
+                self._clock.inversion_mask,
+                0 if data_out is None else data_out.bit_mask,
+                0 if data_out is None else data_out.inversion_mask,
+                out_register if data_in is None else data_in.register,
+                0 if data_in is None else data_in.bit_mask,
+                0 if data_in is None else data_in.inversion_mask,
+                self.mode,
+                bits,
+                self.half_period_ns,
+                data,
+            )
+            gpio._latched_register_written(out_register, state)
+        return received
+
+    def delay(self) -> None:
+        """Waits for one clock edge"""
+        # pylint: disable=protected-access
+        self._gpio._port.delay_ns(self.half_period_ns)
+
+
+class SoftSPI:
+    """
+    A bit-banged SPI controller using the pins of a GPIO port.  The clock and
+    MOSI pins must be on the same register, and MISO must be on another one
+    (such as a Status pin).
+
+    .. code-block::
+
+        import parallel64
+        gpio = parallel64.GPIOPort(0x1234)
+        pins = gpio.pins
+        spi = parallel64.SoftSPI(gpio, pins.D0, pins.D1, pins.ACK, cs=pins.D2)
+        result = bytearray(2)
+        spi.write_readinto(bytes((0x80, 0x00)), result)
+
+    :param GPIOPort gpio: The port the pins are on
+    :param Pin sck: The clock pin
+    :param Pin|None mosi: (optional) The controller out pin, default is none
+    :param Pin|None miso: (optional) The controller in pin, default is none
+    :param Pin|None cs: (optional) An active low chip select pin asserted
+        around each transfer, default is none
+    :param int polarity: (optional) The idle level of the clock, default is 0
+    :param int phase: (optional) The clock edge data is sampled on, where 0
+        is the leading edge, default is 0
+    :param bool lsb_first: (optional) Whether to shift the least significant
+        bit first, default is the most significant bit first (False)
+    :param int baudrate: (optional) The clock rate in Hz, which is a maximum
+        since each edge is at least one port write, default is 100 kHz
+    """
+
+    # pylint: disable=too-many-arguments
+    def __init__(
+        self,
+        gpio: "GPIOPort",
+        sck: Pin,
+        mosi: Optional[Pin] = None,
+        miso: Optional[Pin] = None,
+        cs: Optional[Pin] = None,
+        polarity: int = 0,
+        phase: int = 0,
+        lsb_first: bool = False,
+        baudrate: int = 100000,
+    ) -> None:
+        mode = (bool(polarity) << 0) | (bool(phase) << 1) | (bool(lsb_first) << 2)
+        self._engine = _ShiftEngine(
+            gpio, sck, mosi, miso, mode, _half_period_ns(baudrate)
+        )
+        self._gpio = gpio
+        self._cs = cs
+        gpio.write_pin(sck, bool(polarity))
+        if cs is not None:
+            gpio.write_pin(cs, True)
+
+    def _transfer(self, data: Buffer) -> bytes:
+        """Transfers bytes with the chip select asserted"""
+
+        if self._cs is None:
+            return self._engine.shift(data)
+        self._gpio.write_pin(self._cs, False)
+        try:
+            return self._engine.shift(data)
+        finally:
+            self._gpio.write_pin(self._cs, True)
+
+    def write(self, buffer: Buffer) -> None:
+        """Writes bytes, ignoring the bytes read
+
+        :param buffer: The bytes to write
+        :type buffer: bytes|bytearray|memoryview
+        """
+        self._transfer(buffer)
+
+    def readinto(
+        self, buffer: Union[bytearray, memoryview], write_value: int = 0
+    ) -> None:
+        """Reads bytes into a buffer while writing a fixed value
+
+        :param buffer: The buffer to fill
+        :type buffer: bytearray|memoryview
+        :param int write_value: (optional) The value written for each byte
+            read, default is 0
+        """
+
+        received = self._transfer(bytes((write_value,)) * len(buffer))
+        memoryview(buffer).cast("B")[:] = received
+
+    def write_readinto(
+        self, out_buffer: Buffer, in_buffer: Union[bytearray, memoryview]
+    ) -> None:
+        """Writes bytes while reading the same number into a buffer
+
+        :param out_buffer: The bytes to write
+        :type out_buffer: bytes|bytearray|memoryview
+        :param in_buffer: The buffer to fill, the same length as out_buffer
+        :type in_buffer: bytearray|memoryview
+        :raises ValueError: If the buffers are different lengths
+        """
+
+        in_view = memoryview(in_buffer).cast("B")
+        if len(memoryview(out_buffer).cast("B")) != len(in_view):
+            raise ValueError("The buffers must be the same length")
+        in_view[:] = self._transfer(out_buffer)
+
+    def transfer(self, data: Buffer) -> bytes:
+        """Writes bytes, returning the bytes read at the same time
+
+        :param data: The bytes to write
+        :type data: bytes|bytearray|memoryview
+        :rtype: bytes
+        """
+        return self._transfer(data)
+
+
+class SoftI2C:
+    """
+    A bit-banged I2C controller using the pins of a GPIO port.  The port's
+    outputs are push-pull, so the bus needs open-collector buffers (or
+    similar) driven by ``scl`` and ``sda_out``, with the SDA line read back on
+    ``sda_in``.  ``scl`` and ``sda_out`` must be on the same register.  Within
+    a byte, SDA only changes in its own write once SCL is low, so it cannot be
+    taken for a start or stop condition.  Clock stretching is not supported.
+
+    .. code-block::
+
+        import parallel64
+        gpio = parallel64.GPIOPort(0x1234)
+        pins = gpio.pins
+        i2c = parallel64.SoftI2C(gpio, pins.D0, pins.D1, pins.ACK)
+        i2c.writeto(0x50, bytes((0x00, 0x00)))
+        data = bytearray(16)
+        i2c.readfrom_into(0x50, data)
+
+    :param GPIOPort gpio: The port the pins are on
+    :param Pin scl: The pin driving the clock line
+    :param Pin sda_out: The pin driving the data line, where True releases it
+    :param Pin sda_in: The pin reading the data line
+    :param int frequency: (optional) The clock rate in Hz, default is
+        100 kHz
+    """
+
+    def __init__(
+        self,
+        gpio: "GPIOPort",
+        scl: Pin,
+        sda_out: Pin,
+        sda_in: Pin,
+        frequency: int = 100000,
+    ) -> None:
+        self._engine = _ShiftEngine(
+            gpio, scl, sda_out, sda_in, _MODE_SEPARATE_DATA, _half_period_ns(frequency)
+        )
+        self._gpio = gpio
+        self._scl = scl
+        self._sda_out = sda_out
+        gpio.write_pins({scl: True, sda_out: True})
+
+    def _set_lines(self, scl: bool, sda: bool) -> None:
+        """Sets the clock and data lines together, then waits for an edge"""
+
+        self._gpio.write_pins({self._scl: scl, self._sda_out: sda})
+        self._engine.delay()
+
+    def _start(self) -> None:
+        """Sends a start (or repeated start) condition"""
+
+        self._set_lines(False, True)
+        self._set_lines(True, True)
+        self._set_lines(True, False)
+        self._set_lines(False, False)
+
+    def _stop(self) -> None:
+        """Sends a stop condition"""
+
+        self._set_lines(False, False)
+        self._set_lines(True, False)
+        self._set_lines(True, True)
+
+    def _write_bytes(self, data: Buffer) -> int:
+        """Writes bytes, stopping at the first that is not acknowledged
+
+        :return: The number of bytes acknowledged
+        :rtype: int
+        """
+
+        acknowledged = 0
+        for value in memoryview(data).cast("B"):
+            self._engine.shift(bytes((value,)))
+            if self._engine.shift(b"\x80", 1)[0] & 0x80:
+                break
+            acknowledged += 1
+        return acknowledged
+
+    def _read_bytes(self, buffer: Union[bytearray, memoryview]) -> None:
+        """Reads bytes into a buffer, acknowledging all but the last"""
+
+        view = memoryview(buffer).cast("B")
+        for index in range(len(view)):
+            view[index] = self._engine.shift(b"\xff")[0]
+            self._engine.shift(b"\x80" if index == len(view) - 1 else b"\x00", 1)
+
+    def _address(self, address: int, read: bool) -> None:
+        """Sends a start condition and the address
+
+        :raises OSError: If no device acknowledges the address
+        """
+
+        self._start()
+        if not self._write_bytes(bytes(((address << 1) | read,))):
+            self._stop()
+            raise OSError(f"No I2C device acknowledged address {hex(address)}")
+
+    def scan(self) -> Tuple[int, ...]:
+        """Returns the addresses of the devices that acknowledge their
+        address
+
+        :rtype: tuple
+        """
+
+        found = []
+        for address in range(0x08, 0x78):
+            self._start()
+            if self._write_bytes(bytes((address << 1,))):
+                found.append(address)
+            self._stop()
+        return tuple(found)
+
+    def writeto(self, address: int, buffer: Buffer, stop: bool = True) -> None:
+        """Writes bytes to a device
+
+        :param int address: The 7-bit address of the device
+        :param buffer: The bytes to write
+        :type buffer: bytes|bytearray|memoryview
+        :param bool stop: (optional) Whether to send a stop condition after
+            the bytes, default is to send one (True)
+        :raises OSError: If the device does not acknowledge every byte
+        """
+
+        self._address(address, False)
+        length = len(memoryview(buffer).cast("B"))
+        acknowledged = self._write_bytes(buffer)
+        if stop or acknowledged != length:
+            self._stop()
+        if acknowledged != length:
+            raise OSError(
+                f"The I2C device acknowledged {acknowledged} of {length} bytes"
+            )
+
+    def readfrom_into(
+        self, address: int, buffer: Union[bytearray, memoryview], stop: bool = True
+    ) -> None:
+        """Reads bytes from a device into a buffer
+
+        :param int address: The 7-bit address of the device
+        :param buffer: The buffer to fill
+        :type buffer: bytearray|memoryview
+        :param bool stop: (optional) Whether to send a stop condition after
+            the bytes, default is to send one (True)
+        :raises OSError: If the device does not acknowledge its address
+        """
+
+        self._address(address, True)
+        self._read_bytes(buffer)
+        if stop:
+            self._stop()
+
+    def writeto_then_readfrom(
+        self, address: int, out_buffer: Buffer, in_buffer: Union[bytearray, memoryview]
+    ) -> None:
+        """Writes bytes to a device, then reads bytes from it into a buffer
+        after a repeated start
+
+        :param int address: The 7-bit address of the device
+        :param out_buffer: The bytes to write
+        :type out_buffer: bytes|bytearray|memoryview
+        :param in_buffer: The buffer to fill
+        :type in_buffer: bytearray|memoryview
+        :raises OSError: If the device does not acknowledge every byte
+        """
+
+        self.writeto(address, out_buffer, stop=False)
+        self.readfrom_into(address, in_buffer)
+
+
+class ShiftRegister:
+    """
+    A chain of serial-in, parallel-out shift registers (such as 74HC595s)
+    driven by the pins of a GPIO port.  The clock and data pins must be on
+    the same register.
+
+    .. code-block::
+
+        import parallel64
+        gpio = parallel64.GPIOPort(0x1234)
+        pins = gpio.pins
+        chain = parallel64.ShiftRegister(gpio, pins.D0, pins.D1, pins.D2)
+        chain.write(bytes((0xFF, 0x01)))
+
+    :param GPIOPort gpio: The port the pins are on
+    :param Pin clock: The shift clock pin (SRCLK)
+    :param Pin data: The serial data pin (SER)
+    :param Pin|None latch: (optional) The storage clock pin (RCLK) pulsed
+        after each write, default is none
+    :param bool lsb_first: (optional) Whether to shift the least significant
+        bit first, default is the most significant bit first (False)
+    :param int half_period_ns: (optional) How long each clock edge is held,
+        default is 1 microsecond
+    """
+
+    # pylint: disable=too-many-arguments
+    def __init__(
+        self,
+        gpio: "GPIOPort",
+        clock: Pin,
+        data: Pin,
+        latch: Optional[Pin] = None,
+        lsb_first: bool = False,
+        half_period_ns: int = 1000,
+    ) -> None:
+        self._engine = _ShiftEngine(
+            gpio, clock, data, None, lsb_first << 2, half_period_ns
+        )
+        self._gpio = gpio
+        self._latch = latch
+        gpio.write_pin(clock, False)
+        if latch is not None:
+            gpio.write_pin(latch, False)
+
+    def write(self, buffer: Buffer) -> None:
+        """Shifts bytes into the chain, with the first byte ending up furthest
+        along it, then pulses the latch
+
+        :param buffer: The bytes to shift in
+        :type buffer: bytes|bytearray|memoryview
+        """
+
+        self._engine.shift(buffer)
+        if self._latch is not None:
+            self._gpio.write_pin(self._latch, True)
+            self._engine.delay()
+            self._gpio.write_pin(self._latch, False)
+
+
+def _half_period_ns(frequency: int) -> int:
+    """Returns the half period of a clock rate
+
+    :param int frequency: The clock rate in Hz
+    :rtype: int
+    """
+
+    if frequency <= 0:
+        raise ValueError("The clock rate must be positive")
+    return 500000000 // frequency
@@ -0,0 +1,138 @@
+# SPDX-FileCopyrightText: 2022 Alec Delaney
+#
+# SPDX-License-Identifier: MIT
+
+"""
+`parallel64.realtime`
+
+Scoped scheduling controls for running timing-sensitive transfers with
+less jitter
+
+
+* Author(s): Alec Delaney
+
+"""
+
+import threading
+from contextlib import ExitStack
+from typing import Any, Optional
+from parallel64.constants import ThreadPriority
+from parallel64.timing import JitterStats
+
+
+class RealtimeScope:
+    """
+    Raises the scheduling of the calling thread for timing-sensitive
+    transfers, such as strobed buffers, pattern playback and programs, and
+    restores it when the scope exits.  Created with ``realtime()`` on a
+    port:
+
+    .. code-block::
+
+        with port.realtime(cpu=3) as scope:
+            print(scope.measure_jitter())
+            port.write_spp_buffer(data)
+
+    The settings apply to the thread that enters the scope, which is the one
+    the transfers inside it run on, so the scope must be exited by the same
+    thread.  Threads started by the native extension, such as those of
+    ``InputSampler`` and ``OutputStream``, are not affected.
+
+    :param backend: The backend of the port
+    :param int|None cpu: (optional) The processor to pin the thread to, or
+        None to leave its affinity unchanged, default is None
+    :param ThreadPriority|None priority: (optional) The priority to give the
+        thread, or None to leave it unchanged, default is
+        ``ThreadPriority.TIME_CRITICAL``
+    :param str|None mmcss_task: (optional) The name of an MMCSS task to
+        register the thread with, such as ``"Pro Audio"``, or None not to,
+        default is None
+    :param int|None timer_resolution_ms: (optional) The system timer
+        resolution to request in milliseconds, which shortens the sleeps at
+        the end of a ``WaitPolicy``, or None not to, default is 1 ms
+
+    :ivar jitter: The result of the last ``measure_jitter()``, or None if
+        none has been measured
+    :vartype jitter: JitterStats|None
+    """
+
+    # pylint: disable=too-many-arguments
+    def __init__(
+        self,
+        backend: Any,
+        cpu: Optional[int] = None,
+        priority: Optional[ThreadPriority] = ThreadPriority.TIME_CRITICAL,
+        mmcss_task: Optional[str] = None,
+        timer_resolution_ms: Optional[int] = 1,
+    ) -> None:
+        if cpu is not None and cpu < 0:
+            raise ValueError("The processor number cannot be negative")
+        self._backend = backend
+        self.cpu = cpu
+        self.priority = None if priority is None else ThreadPriority(priority)
+        self.mmcss_task = mmcss_task
+        self.timer_resolution_ms = timer_resolution_ms
+        self.jitter: Optional[JitterStats] = None
+        self._stack: Optional[ExitStack] = None
+        self._thread_id: Optional[int] = None
+
+    @property
+    def active(self) -> bool:
+        """Whether the scope has been entered and not yet exited"""
+        return self._stack is not None
+
+    def __enter__(self) -> "RealtimeScope":
+        if self._stack is not None:
+            raise RuntimeError("The scope is already active")
+        backend = self._backend
+        stack = ExitStack()
+        try:
+            if self.cpu is not None:
+                previous = backend.set_thread_affinity(1 << self.cpu)
+                stack.callback(backend.set_thread_affinity, previous)
+            # MMCSS sets the priority itself, so an explicit priority is
+            # applied after joining the task
+            if self.mmcss_task is not None:
+                handle = backend.join_mmcss_task(self.mmcss_task)
+                stack.callback(backend.leave_mmcss_task, handle)
+            if self.priority is not None:
+                previous = backend.set_thread_priority(self.priority.value)
+                stack.callback(backend.set_thread_priority, previous)
+            if self.timer_resolution_ms is not None:
+                backend.begin_timer_period(self.timer_resolution_ms)
+                stack.callback(backend.end_timer_period, self.timer_resolution_ms)
+        except BaseException:
+            stack.close()
+            raise
+        self._stack = stack
+        self._thread_id = threading.get_ident()
+        return self
+
+    def __exit__(self, *exc_info: Any) -> None:
+        if self._stack is None:
+            return
+        if threading.get_ident() != self._thread_id:
+            raise RuntimeError("The scope must be exited by the thread that entered it")
+        stack, self._stack = self._stack, None
+        stack.close()
+
+    def measure_jitter(
+        self, samples: int = 1000, period_ns: int = 10000
+    ) -> JitterStats:
+        """Measures the scheduling jitter of the calling thread, by spinning
+        until each of a series of deadlines and recording how late each was
+        seen.  Measured inside the scope, this is how late a strobe or
+        pattern step could start with the settings applied.
+
+        :param int samples: (optional) The number of deadlines, default is
+            1000
+        :param int period_ns: (optional) The time between deadlines in
+            nanoseconds, default is 10 microseconds
+        :return: The measured jitter, which is also stored as ``jitter``
+        :rtype: JitterStats
+        """
+
+        if samples < 0 or period_ns < 0:
+            raise ValueError("The samples and period cannot be negative")
+        self.jitter = JitterStats(*self._backend.measure_jitter(samples, period_ns))
+        return self.jitter
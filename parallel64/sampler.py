@@ -0,0 +1,352 @@
+# SPDX-FileCopyrightText: 2022 Alec Delaney
+#
+# SPDX-License-Identifier: MIT
+
+"""
+`parallel64.sampler`
+
+Background sampling of the port registers, for catching edges on the
+input pins that polling from Python would miss
+
+
+* Author(s): Alec Delaney
+
+"""
+
+import collections
+import struct
+import sys
+import threading
+import time
+from enum import IntFlag
+from types import TracebackType
+from typing import Callable, List, NamedTuple, Optional, Tuple, Type, Union
+
+SAMPLE_FORMAT = "<QBBB5x"
+"""The struct format of each sample returned by ``InputSampler.drain()``"""
+
+SAMPLE_SIZE = struct.calcsize(SAMPLE_FORMAT)
+"""The size of each sample returned by ``InputSampler.drain()``, in bytes"""
+
+SAMPLE_DTYPE = [
+    ("timestamp_ns", "<u8"),
+    ("data", "u1"),
+    ("status", "u1"),
+    ("control", "u1"),
+    ("reserved", "V5"),
+]
+"""A NumPy dtype description of each sample, for use with
+``numpy.frombuffer(sampler.drain(), dtype=SAMPLE_DTYPE)``"""
+
+
+class SamplerChannel(IntFlag):
+    """Flag class representing the registers read by an ``InputSampler``
+
+    Used with :class:`parallel64.StandardPort`
+    """
+
+    DATA = 0b001
+    STATUS = 0b010
+    CONTROL = 0b100
+
+
+class Sample(NamedTuple):
+    """A single sample of the registers, with the raw register values.
+    Registers that were not sampled are 0.
+
+    :param int timestamp_ns: The time of the sample in nanoseconds since the
+        sampler was started
+    :param int data: The value of the Data register
+    :param int status: The value of the Status register
+    :param int control: The value of the Control register
+    """
+
+    timestamp_ns: int
+    data: int
+    status: int
+    control: int
+
+
+class CtypesSampler:
+    """
+    Samples the SPP registers from a background Python thread, used when the
+    native extension is unavailable.  It exposes the same interface as
+    ``parallel64._native.Sampler``, but the thread needs the GIL so it
+    samples much more slowly.
+
+    :param read_port: The function used to read a port
+    :param int spp_base_address: The SPP base address
+    :param int channels: The registers to read, where bit 0 is the Data
+        register, bit 1 the Status register and bit 2 the Control register
+    :param int capacity: How many samples can wait to be drained
+    :param int period_ns: The time between samples in nanoseconds, or 0 to
+        sample as fast as possible
+    :param int trigger_mask: The Status register bits that must match before
+        samples are kept, or 0 to keep them from the start
+    :param int trigger_value: The value the masked bits must match
+    :param get_wait_policy: (optional) The function returning the spin and
+        yield durations of the wait policy, which paces the thread between
+        samples, default is to spin
+    """
+
+    SAMPLE_STRUCT = struct.Struct(SAMPLE_FORMAT)
+
+    # pylint: disable=too-many-arguments,too-many-instance-attributes
+    def __init__(
+        self,
+        read_port: Callable[[int], int],
+        spp_base_address: int,
+        channels: int,
+        capacity: int,
+        period_ns: int,
+        trigger_mask: int = 0,
+        trigger_value: int = 0,
+        get_wait_policy: Optional[Callable[[], Tuple[int, int]]] = None,
+    ) -> None:
+        if capacity <= 0:
+            raise ValueError("capacity must be positive")
+        if period_ns < 0:
+            raise ValueError("durations must be non-negative")
+        if trigger_mask and not channels & 0b010:
+            raise ValueError("triggers need the status channel")
+        self._read_port = read_port
+        self._addresses = (spp_base_address, spp_base_address + 1, spp_base_address + 2)
+        self._channels = channels
+        self._capacity = capacity
+        self._period_ns = period_ns
+        self._trigger_mask = trigger_mask
+        self._trigger_value = trigger_value & trigger_mask
+        self._get_wait_policy = get_wait_policy
+        self._samples = collections.deque()
+        self._thread: Optional[threading.Thread] = None
+        self._stop_requested = threading.Event()
+        self.triggered = not trigger_mask
+        self.dropped = 0
+        self.overruns = 0
+
+    @property
+    def running(self) -> bool:
+        """Whether the sampling thread is running"""
+        return self._thread is not None
+
+    @property
+    def pending(self) -> int:
+        """Samples waiting to be drained"""
+        return len(self._samples)
+
+    def start(self) -> None:
+        """Start the sampling thread"""
+
+        if self._thread is not None:
+            raise RuntimeError("the sampler is already running")
+        self._stop_requested.clear()
+        self._thread = threading.Thread(target=self._run, daemon=True)
+        self._thread.start()
+
+    def stop(self) -> None:
+        """Stop the sampling thread and wait for it to finish"""
+
+        if self._thread is None:
+            return
+        self._stop_requested.set()
+        self._thread.join()
+        self._thread = None
+
+    def drain(self, max_samples: Optional[int] = None) -> bytes:
+        """Remove samples from the ring
+
+        :param int|None max_samples: The most samples to remove, or None to
+            remove all of them
+        :return: The samples as 16-byte records in the struct format
+            ``"<QBBB5x"``
+        :rtype: bytes
+        """
+
+        count = len(self._samples)
+        if max_samples is not None:
+            count = min(count, max_samples)
+        popleft = self._samples.popleft
+        return b"".join(popleft() for _ in range(count))
+
+    def drain_into(self, buffer: Union[bytearray, memoryview]) -> int:
+        """Remove as many samples as fit from the ring into a buffer
+
+        :param buffer: The writable buffer to fill with 16-byte records in
+            the struct format ``"<QBBB5x"``
+        :type buffer: bytearray|memoryview
+        :return: The number of samples removed
+        :rtype: int
+        """
+
+        view = memoryview(buffer).cast("B")
+        count = min(len(self._samples), len(view) // SAMPLE_SIZE)
+        popleft = self._samples.popleft
+        for offset in range(0, count * SAMPLE_SIZE, SAMPLE_SIZE):
+            view[offset : offset + SAMPLE_SIZE] = popleft()
+        return count
+
+    def _wait_until(self, target_ns: int) -> None:
+        """Waits until the performance counter reaches the target, sleeping
+        until only the spin and yield windows of the wait policy are left,
+        then yielding until only the spin window is left
+
+        :param int target_ns: The performance counter value to wait for
+        """
+
+        if self._get_wait_policy is None:
+            spin_ns, yield_ns = sys.maxsize, 0
+        else:
+            spin_ns, yield_ns = self._get_wait_policy()
+        while True:
+            left_ns = target_ns - time.perf_counter_ns()
+            if left_ns <= 0:
+                return
+            if left_ns > spin_ns + yield_ns:
+                time.sleep(0.001)
+            elif left_ns > spin_ns:
+                time.sleep(0)
+
+    def _run(self) -> None:
+        """Samples the registers until asked to stop"""
+
+        read_port = self._read_port
+        data_address, status_address, control_address = self._addresses
+        pack = self.SAMPLE_STRUCT.pack
+        start = time.perf_counter_ns()
+        next_sample = start
+        while not self._stop_requested.is_set():
+            if self._period_ns:
+                self._wait_until(next_sample)
+                next_sample += self._period_ns
+                now = time.perf_counter_ns()
+                if now >= next_sample:
+                    self.overruns += 1
+                    next_sample = now + self._period_ns
+            timestamp = time.perf_counter_ns() - start
+            status = read_port(status_address) if self._channels & 0b010 else 0
+            data = read_port(data_address) if self._channels & 0b001 else 0
+            control = read_port(control_address) if self._channels & 0b100 else 0
+            if not self.triggered:
+                if status & self._trigger_mask != self._trigger_value:
+                    continue
+                self.triggered = True
+            if len(self._samples) >= self._capacity:
+                self.dropped += 1
+            else:
+                self._samples.append(pack(timestamp, data, status, control))
+
+
+class InputSampler:
+    """
+    Samples the registers of a port from a background thread into a ring of
+    samples that can be drained in batches, created with
+    ``StandardPort.create_sampler()``.  When the native extension is used, the
+    thread does not need the GIL.  It can be used as a context manager that
+    starts and stops sampling:
+
+    .. code-block::
+
+        import parallel64
+        port = parallel64.StandardPort(0x1234)
+        with port.create_sampler() as sampler:
+            ...
+            for sample in sampler.samples():
+                print(sample.timestamp_ns, sample.status)
+
+    :param backend_sampler: The sampler created by the port's backend
+    """
+
+    def __init__(self, backend_sampler) -> None:
+        self._sampler = backend_sampler
+
+    def __enter__(self) -> "InputSampler":
+        self.start()
+        return self
+
+    def __exit__(
+        self,
+        exc_type: Optional[Type[BaseException]],
+        exc_value: Optional[BaseException],
+        traceback: Optional[TracebackType],
+    ) -> None:
+        self.stop()
+
+    def start(self) -> None:
+        """Starts sampling
+
+        :raises RuntimeError: If the sampler is already running
+        """
+        self._sampler.start()
+
+    def stop(self) -> None:
+        """Stops sampling, waiting for the sampling thread to finish.  Samples
+        that have not been drained are kept.
+        """
+        self._sampler.stop()
+
+    @property
+    def running(self) -> bool:
+        """Whether the sampler is running"""
+        return self._sampler.running
+
+    @property
+    def triggered(self) -> bool:
+        """Whether the trigger condition has been met, after which samples
+        are kept
+        """
+        return self._sampler.triggered
+
+    @property
+    def dropped(self) -> int:
+        """The number of samples lost because the ring was full"""
+        return self._sampler.dropped
+
+    @property
+    def overruns(self) -> int:
+        """The number of sample periods missed because the sampling thread
+        fell behind
+        """
+        return self._sampler.overruns
+
+    @property
+    def pending(self) -> int:
+        """The number of samples waiting to be drained"""
+        return self._sampler.pending
+
+    def drain(self, max_samples: Optional[int] = None) -> memoryview:
+        """Removes samples from the ring as raw records in ``SAMPLE_FORMAT``,
+        which can be used directly with NumPy using ``SAMPLE_DTYPE``
+
+        :param int|None max_samples: (optional) The most samples to remove,
+            default is to remove all of them
+        :return: The samples
+        :rtype: memoryview
+        """
+        return memoryview(self._sampler.drain(max_samples))
+
+    def drain_into(self, buffer: Union[bytearray, memoryview]) -> int:
+        """Removes as many samples as fit from the ring into a buffer, as raw
+        records in ``SAMPLE_FORMAT``, without allocating a new ``bytes``.  A
+        NumPy array with the dtype ``SAMPLE_DTYPE`` can be filled directly.
+
+        :param buffer: The writable buffer to fill, such as a ``bytearray``,
+            ``memoryview`` or NumPy array
+        :type buffer: bytearray|memoryview
+        :return: The number of samples removed
+        :rtype: int
+        """
+        return self._sampler.drain_into(buffer)
+
+    def samples(self, max_samples: Optional[int] = None) -> List[Sample]:
+        """Removes samples from the ring
+
+        :param int|None max_samples: (optional) The most samples to remove,
+            default is to remove all of them
+        :return: The samples
+        :rtype: list
+        """
+
+        return [
+            Sample(*record)
+            for record in struct.iter_unpack(SAMPLE_FORMAT, self.drain(max_samples))
+        ]
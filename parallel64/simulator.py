@@ -0,0 +1,578 @@
+# SPDX-FileCopyrightText: 2022 Alec Delaney
+#
+# SPDX-License-Identifier: MIT
+
+"""
+`parallel64.simulator`
+
+An in-memory model of parallel port registers and a scripted peripheral,
+used in place of the InpOut DLL to run the port classes, and benchmark
+them, without hardware.  On systems other than Windows, set
+``PARALLEL64_SIMULATOR`` in the environment to import ``parallel64``
+for use with the simulator.
+
+
+* Author(s): Alec Delaney
+
+"""
+
+import threading
+import time
+from typing import Dict, List, Optional, Tuple
+from parallel64.backend import CtypesBackend, register_backend
+
+SIMULATED_WINDLL_LOCATION = "<parallel64 simulator>"
+"""The DLL location that ports are given to use a ``SimulatedBackend``
+created with the default location"""
+
+# The Status register with the peripheral idle: not busy, nAck high,
+# selected and not faulted
+_STATUS_IDLE = 0b11011000
+_STATUS_BUSY = 0b01011000
+_STATUS_ACK = 0b10011000
+_STATUS_EPP_TIMEOUT = 0b00000001
+
+_CONTROL_STROBE = 0b00000001
+_CONTROL_DIRECTION = 0b00100000
+
+# The ECR modes, as in CommMode
+_MODE_SPP = 0
+_MODE_BYTE = 1
+_MODE_SPP_FIFO = 2
+_MODE_ECP_FIFO = 3
+_MODE_FIFO_TEST = 6
+_MODE_CONFIG = 7
+
+_ECR_EMPTY = 0b00000001
+_ECR_FULL = 0b00000010
+_ECR_SERVICE = 0b00000100
+
+
+class SimulatedPeripheral:
+    """
+    A scripted peripheral attached to a ``SimulatedPort``, answering the
+    SPP BUSY/ACK handshake, EPP cycles and the ECP FIFO.  Its timing is
+    counted in register accesses rather than in time, so that runs are
+    reproducible.
+
+    :param int busy_reads: (optional) The number of Status register reads
+        for which BUSY stays high after each strobed byte, default is 1
+    :param int ack_reads: (optional) The number of Status register reads
+        for which nAck stays low once BUSY falls, default is 1
+    :param int fifo_drain: (optional) The number of bytes the peripheral
+        takes from the FIFO, or puts into it when reversed, each time the
+        ECR is read, default is 16
+    :param bool epp_present: (optional) Whether the peripheral answers EPP
+        cycles; if not, each cycle sets the EPP timeout bit, default is True
+    :param int|None fill_byte: (optional) The byte the peripheral sends
+        once ``transmit`` is empty, or None to send nothing so that reads
+        time out, default is None
+
+    :ivar bytearray received: The bytes received through strobes and the
+        FIFO
+    :ivar bytearray transmit: The bytes queued to send to the host through
+        the FIFO
+    :ivar bytearray epp_registers: The EPP registers, by EPP address
+    :ivar int data_lines: The state the peripheral drives the data lines
+        to when the port is reversed
+    """
+
+    # pylint: disable=too-many-arguments
+    def __init__(
+        self,
+        busy_reads: int = 1,
+        ack_reads: int = 1,
+        fifo_drain: int = 16,
+        epp_present: bool = True,
+        fill_byte: Optional[int] = None,
+    ) -> None:
+        if busy_reads < 0 or ack_reads < 0 or fifo_drain < 1:
+            raise ValueError(
+                "The handshake reads cannot be negative, nor the FIFO drain zero"
+            )
+        self.busy_reads = busy_reads
+        self.ack_reads = ack_reads
+        self.fifo_drain = fifo_drain
+        self.epp_present = epp_present
+        self.fill_byte = fill_byte
+        self.received = bytearray()
+        self.transmit = bytearray()
+        self.epp_registers = bytearray(256)
+        self.epp_address = 0
+        self.data_lines = 0
+        self._busy_left = 0
+        self._ack_left = 0
+
+    def strobe(self, value: int) -> None:
+        """Latches a byte strobed by the host and starts the handshake
+
+        :param int value: The byte on the data lines
+        """
+
+        self.received.append(value)
+        self._busy_left = self.busy_reads
+        self._ack_left = self.ack_reads
+
+    def status(self) -> int:
+        """Returns the status lines, advancing the handshake by one read
+
+        :return: The Status register bits driven by the peripheral
+        :rtype: int
+        """
+
+        if self._busy_left:
+            self._busy_left -= 1
+            return _STATUS_BUSY
+        if self._ack_left:
+            self._ack_left -= 1
+            return _STATUS_ACK
+        return _STATUS_IDLE
+
+    def produce(self, count: int) -> bytes:
+        """Returns up to the given number of bytes to send to the host
+
+        :param int count: The most bytes to send
+        :rtype: bytes
+        """
+
+        if len(self.transmit) < count and self.fill_byte is not None:
+            self.transmit.extend(
+                bytes((self.fill_byte,)) * (count - len(self.transmit))
+            )
+        data = bytes(self.transmit[:count])
+        del self.transmit[:count]
+        return data
+
+
+class SimulatedPort:
+    """
+    The Data, Status and Control registers of a simulated port, its EPP
+    address and data registers, and optionally its ECP registers with the
+    FIFO, cnfgA and cnfgB.  Created with ``SimulatedRegisters.add_port()``.
+
+    :param int spp_base_address: The SPP base address
+    :param int|None ecp_base_address: (optional) The ECP base address, or
+        None for a port without an ECR, default is None
+    :param SimulatedPeripheral|None peripheral: (optional) The attached
+        peripheral, default is a new ``SimulatedPeripheral``
+    :param bool bidirectional: (optional) Whether the direction bit of the
+        Control register can be set, default is True
+    :param int fifo_depth: (optional) The depth of the FIFO in bytes,
+        default is 16
+    :param int write_threshold: (optional) The free bytes at which the FIFO
+        requests service during writes, default is 8
+    :param int read_threshold: (optional) The bytes available at which the
+        FIFO requests service during reads, default is 8
+    :param int config_a: (optional) The contents of cnfgA, default reports
+        8-bit PWords
+    :param int config_b: (optional) The contents of cnfgB, default reports
+        jumpered IRQ and DMA settings
+    """
+
+    # pylint: disable=too-many-arguments,too-many-instance-attributes
+    def __init__(
+        self,
+        spp_base_address: int,
+        ecp_base_address: Optional[int] = None,
+        peripheral: Optional[SimulatedPeripheral] = None,
+        bidirectional: bool = True,
+        fifo_depth: int = 16,
+        write_threshold: int = 8,
+        read_threshold: int = 8,
+        config_a: int = 0b00010000,
+        config_b: int = 0,
+    ) -> None:
+        if not (0 < write_threshold <= fifo_depth and 0 < read_threshold <= fifo_depth):
+            raise ValueError("The FIFO thresholds must be between 1 and the FIFO depth")
+        self.spp_base_address = spp_base_address
+        self.ecp_base_address = ecp_base_address
+        self.peripheral = SimulatedPeripheral() if peripheral is None else peripheral
+        self.bidirectional = bidirectional
+        self.fifo_depth = fifo_depth
+        self.write_threshold = write_threshold
+        self.read_threshold = read_threshold
+        self.config_a = config_a
+        self.config_b = config_b
+        self.data = 0
+        self.control = 0
+        self.epp_timeout = False
+        self.fifo = bytearray()
+        self._ecr = 0
+
+    @property
+    def _reversed(self) -> bool:
+        """Whether the direction bit of the Control register is set"""
+        return bool(self.control & _CONTROL_DIRECTION)
+
+    @property
+    def _mode(self) -> int:
+        """The mode in the ECR"""
+        return self._ecr >> 5
+
+    def read_spp(self, offset: int) -> int:
+        """Reads a register relative to the SPP base address
+
+        :param int offset: The register offset, from 0 to 7
+        :rtype: int
+        """
+
+        peripheral = self.peripheral
+        if offset == 0:
+            return peripheral.data_lines if self._reversed else self.data
+        if offset == 1:
+            return peripheral.status() | (
+                _STATUS_EPP_TIMEOUT if self.epp_timeout else 0
+            )
+        if offset == 2:
+            return self.control
+        if not peripheral.epp_present:
+            self.epp_timeout = True
+            return 0xFF
+        if offset == 3:
+            return peripheral.epp_address
+        return peripheral.epp_registers[peripheral.epp_address]
+
+    def write_spp(self, offset: int, value: int) -> None:
+        """Writes a register relative to the SPP base address.  Releasing
+        STROBE strobes the Data register into the peripheral, and writing
+        the EPP timeout bit of the Status register clears it.  EPP write
+        cycles with the port reversed do not reach the peripheral, as the
+        data drivers are off.  With an ECR, the direction bit only changes
+        in the SPP and PS/2 modes, as in the ECP specification.
+
+        :param int offset: The register offset, from 0 to 7
+        :param int value: The byte to write
+        """
+
+        peripheral = self.peripheral
+        if offset == 0:
+            self.data = value
+        elif offset == 1:
+            if value & _STATUS_EPP_TIMEOUT:
+                self.epp_timeout = False
+        elif offset == 2:
+            released = self.control & _CONTROL_STROBE and not value & _CONTROL_STROBE
+            fixed_direction = self._mode not in (_MODE_SPP, _MODE_BYTE)
+            if self.ecp_base_address is not None and fixed_direction:
+                direction = self.control & _CONTROL_DIRECTION
+                value = (value & ~_CONTROL_DIRECTION) | direction
+            self.control = value & (0b00111111 if self.bidirectional else 0b00011111)
+            if released and not self._reversed:
+                peripheral.strobe(self.data)
+        elif not peripheral.epp_present:
+            self.epp_timeout = True
+        elif self._reversed:
+            return
+        elif offset == 3:
+            peripheral.epp_address = value
+        else:
+            peripheral.epp_registers[peripheral.epp_address] = value
+            peripheral.received.append(value)
+
+    def read_ecp(self, offset: int) -> int:
+        """Reads a register relative to the ECP base address
+
+        :param int offset: The register offset, from 0 to 2
+        :rtype: int
+        """
+
+        mode = self._mode
+        if offset == 2:
+            return self._read_ecr()
+        if mode == _MODE_CONFIG:
+            return self.config_a if offset == 0 else self.config_b
+        if offset == 0 and mode in (_MODE_ECP_FIFO, _MODE_FIFO_TEST) and self.fifo:
+            value = self.fifo[0]
+            del self.fifo[0]
+            return value
+        return 0xFF
+
+    def write_ecp(self, offset: int, value: int) -> None:
+        """Writes a register relative to the ECP base address.  Switching the
+        ECR to the SPP or PS/2 mode empties the FIFO, and writes to a full
+        FIFO are lost.
+
+        :param int offset: The register offset, from 0 to 2
+        :param int value: The byte to write
+        """
+
+        if offset == 2:
+            self._ecr = value & 0b11111100
+            if self._mode in (_MODE_SPP, _MODE_BYTE):
+                self.fifo.clear()
+        elif offset == 0:
+            if self._mode in (_MODE_SPP_FIFO, _MODE_ECP_FIFO, _MODE_FIFO_TEST):
+                if len(self.fifo) < self.fifo_depth:
+                    self.fifo.append(value)
+
+    def _read_ecr(self) -> int:
+        """Lets the peripheral service the FIFO, then returns the ECR with
+        the FIFO state and serviceIntr, which is set once the FIFO crosses
+        its threshold while armed
+
+        :rtype: int
+        """
+
+        mode = self._mode
+        peripheral = self.peripheral
+        if mode in (_MODE_SPP_FIFO, _MODE_ECP_FIFO):
+            if not self._reversed:
+                peripheral.received.extend(self.fifo[: peripheral.fifo_drain])
+                del self.fifo[: peripheral.fifo_drain]
+            elif mode == _MODE_ECP_FIFO:
+                free = self.fifo_depth - len(self.fifo)
+                self.fifo.extend(peripheral.produce(min(free, peripheral.fifo_drain)))
+        if not self._ecr & _ECR_SERVICE and mode in (
+            _MODE_SPP_FIFO,
+            _MODE_ECP_FIFO,
+            _MODE_FIFO_TEST,
+        ):
+            if self._reversed:
+                requesting = len(self.fifo) >= self.read_threshold
+            else:
+                requesting = self.fifo_depth - len(self.fifo) >= self.write_threshold
+            if requesting:
+                self._ecr |= _ECR_SERVICE
+        ecr = self._ecr
+        if not self.fifo:
+            ecr |= _ECR_EMPTY
+        elif len(self.fifo) >= self.fifo_depth:
+            ecr |= _ECR_FULL
+        return ecr
+
+
+class SimulatedRegisters:
+    """
+    The register functions of the InpOut DLL, backed by ``SimulatedPort``
+    objects.  Addresses that do not belong to a port behave as plain
+    memory.  Wider accesses are split into byte accesses of consecutive
+    addresses, as the port hardware does, but are delayed only once.
+
+    :param int latency_ns: (optional) How long each register access takes
+        in nanoseconds, spent spinning, default is 0.  About 1000 matches
+        a legacy ISA port.
+    """
+
+    def __init__(self, latency_ns: int = 0) -> None:
+        if latency_ns < 0:
+            raise ValueError("The latency cannot be negative")
+        self.latency_ns = latency_ns
+        self._memory = bytearray(0x10000)
+        self._registers: Dict[int, Tuple[SimulatedPort, bool, int]] = {}
+        self._lock = threading.Lock()
+
+    # pylint: disable=too-many-arguments
+    def add_port(
+        self,
+        spp_base_address: int,
+        ecp_base_address: Optional[int] = None,
+        peripheral: Optional[SimulatedPeripheral] = None,
+        bidirectional: bool = True,
+        **ecp_options: int,
+    ) -> SimulatedPort:
+        """Adds a port at the given addresses.  See ``SimulatedPort`` for the
+        parameters, including the FIFO options.
+
+        :return: The added port
+        :rtype: SimulatedPort
+        :raises ValueError: If the addresses overlap those of another port
+        """
+
+        port = SimulatedPort(
+            spp_base_address, ecp_base_address, peripheral, bidirectional, **ecp_options
+        )
+        addresses = {
+            spp_base_address + offset: (port, False, offset) for offset in range(8)
+        }
+        if ecp_base_address is not None:
+            addresses.update(
+                {ecp_base_address + offset: (port, True, offset) for offset in range(3)}
+            )
+        with self._lock:
+            if any(address in self._registers for address in addresses):
+                raise ValueError("The port overlaps the addresses of another port")
+            self._registers.update(addresses)
+        return port
+
+    def _delay(self) -> None:
+        """Spins for the access latency"""
+
+        if self.latency_ns:
+            end = time.perf_counter_ns() + self.latency_ns
+            while time.perf_counter_ns() < end:
+                pass
+
+    def _read(self, address: int) -> int:
+        """Reads a byte from a register or plain memory
+
+        :param int address: The address
+        :rtype: int
+        """
+
+        register = self._registers.get(address)
+        if register is None:
+            return self._memory[address]
+        port, is_ecp, offset = register
+        return port.read_ecp(offset) if is_ecp else port.read_spp(offset)
+
+    def _write(self, address: int, value: int) -> None:
+        """Writes a byte to a register or plain memory
+
+        :param int address: The address
+        :param int value: The byte to write
+        """
+
+        register = self._registers.get(address)
+        if register is None:
+            self._memory[address] = value
+            return
+        port, is_ecp, offset = register
+        if is_ecp:
+            port.write_ecp(offset, value)
+        else:
+            port.write_spp(offset, value)
+
+    def _wide_addresses(self, address: int, width: int) -> List[int]:
+        """Returns the address of each byte of a wide access, least
+        significant first.  A wide access to an ECP FIFO moves a whole PWord
+        through the FIFO, so every byte goes to the FIFO address.
+
+        :param int address: The first address
+        :param int width: The number of bytes
+        :rtype: list
+        """
+
+        register = self._registers.get(address)
+        if register is not None and register[1] and register[2] == 0:
+            return [address] * width
+        return [(address + index) & 0xFFFF for index in range(width)]
+
+    def _read_wide(self, address: int, width: int) -> int:
+        """Does one access reading consecutive bytes, least significant
+        first
+
+        :param int address: The first address
+        :param int width: The number of bytes
+        :rtype: int
+        """
+
+        self._delay()
+        with self._lock:
+            addresses = self._wide_addresses(address, width)
+            return sum(
+                self._read(byte_address) << (8 * index)
+                for index, byte_address in enumerate(addresses)
+            )
+
+    def _write_wide(self, address: int, value: int, width: int) -> None:
+        """Does one access writing consecutive bytes, least significant
+        first
+
+        :param int address: The first address
+        :param int value: The value to write
+        :param int width: The number of bytes
+        """
+
+        self._delay()
+        with self._lock:
+            for index, byte_address in enumerate(self._wide_addresses(address, width)):
+                self._write(byte_address, (value >> (8 * index)) & 0xFF)
+
+    # pylint: disable=invalid-name
+    def DlPortReadPortUchar(self, port: int) -> int:
+        """Reads a byte from a register, as the DLL function of that name
+
+        :param int port: The register address
+        :rtype: int
+        """
+        return self._read_wide(port, 1)
+
+    def DlPortWritePortUchar(self, port: int, value: int) -> None:
+        """Writes a byte to a register, as the DLL function of that name
+
+        :param int port: The register address
+        :param int value: The byte to write
+        """
+        self._write_wide(port, value, 1)
+
+    def DlPortReadPortUshort(self, port: int) -> int:
+        """Reads two bytes from consecutive registers, as the DLL function
+        of that name
+
+        :param int port: The first register address
+        :rtype: int
+        """
+        return self._read_wide(port, 2)
+
+    def DlPortWritePortUshort(self, port: int, value: int) -> None:
+        """Writes two bytes to consecutive registers, as the DLL function
+        of that name
+
+        :param int port: The first register address
+        :param int value: The value to write
+        """
+        self._write_wide(port, value, 2)
+
+    def DlPortReadPortUlong(self, port: int) -> int:
+        """Reads four bytes from consecutive registers, as the DLL function
+        of that name
+
+        :param int port: The first register address
+        :rtype: int
+        """
+        return self._read_wide(port, 4)
+
+    def DlPortWritePortUlong(self, port: int, value: int) -> None:
+        """Writes four bytes to consecutive registers, as the DLL function
+        of that name
+
+        :param int port: The first register address
+        :param int value: The value to write
+        """
+        self._write_wide(port, value, 4)
+
+    def IsInpOutDriverOpen(self) -> int:
+        """Returns that the driver is open, as the DLL function of that name
+
+        :rtype: int
+        """
+        return 1
+
+
+class SimulatedBackend(CtypesBackend):
+    """
+    A ``CtypesBackend`` whose registers are ``SimulatedRegisters`` rather
+    than those of the InpOut driver.  It is used by the ports given its
+    ``windll_location``:
+
+    .. code-block::
+
+        import parallel64
+        simulator = parallel64.SimulatedBackend()
+        simulator.registers.add_port(0x378, 0x778)
+        port = parallel64.StandardPort(
+            0x378, windll_location=simulator.windll_location, ecp_base_address=0x778
+        )
+
+    Memory-mapped registers and direct I/O are not simulated.  Detected
+    capabilities are cached by base address, so call
+    ``clear_capability_cache()`` before using a new simulator with
+    different capabilities at the same addresses.
+
+    :param SimulatedRegisters|None registers: (optional) The simulated
+        registers, default is new ones without latency
+    :param str windll_location: (optional) The DLL location to give ports
+        to use this backend, replacing any backend used for it before,
+        default is ``SIMULATED_WINDLL_LOCATION``
+    """
+
+    def __init__(
+        self,
+        registers: Optional[SimulatedRegisters] = None,
+        windll_location: str = SIMULATED_WINDLL_LOCATION,
+    ) -> None:
+        # pylint: disable=super-init-not-called
+        self.registers = SimulatedRegisters() if registers is None else registers
+        self.windll_location = windll_location
+        self._bind_dll(self.registers)
+        register_backend(windll_location, self)
@@ -0,0 +1,942 @@
+# SPDX-FileCopyrightText: 2022 Alec Delaney
+#
+# SPDX-License-Identifier: MIT
+
+"""
+`parallel64.standard`
+
+The SPP port, and the base for ports built on the SPP registers
+
+
+* Author(s): Alec Delaney
+
+"""
+
+import asyncio
+import threading
+from contextlib import ExitStack
+from typing import Any, Optional, Dict, Iterable, List, Tuple, Union
+from parallel64.aio import complete_operation
+from parallel64.base import _BasePort
+from parallel64.capabilities import EcpCapabilities, cached_detection
+from parallel64.constants import Direction, Ieee1284Mode
+from parallel64.exceptions import TransferTimeoutError
+from parallel64.extended import ExtendedPort
+from parallel64.program import PortProgram, ProgramResult
+from parallel64.sampler import InputSampler, SamplerChannel
+from parallel64.streaming import OutputStream
+from parallel64.timing import StrobeTiming
+
+
+class StandardPort(_BasePort):
+    """
+    The class for representing the SPP port
+
+    :param int spp_base_address: The base address for the port, representing the
+        SPP port data register
+    :param str|None windll_location: (optional) The location of the DLL required
+        to use the parallel port, default is to use the one included in this package
+    :param bool reset_control: (optional) Whether the control register should be
+        reset upon initialization, default is to reset it (True)
+    :param StrobeTiming|None strobe_timing: (optional) The timing of the STROBE
+        pulse used for SPP transfers, default is to use the IEEE 1284 minimums
+    :param int|None ecp_base_address: (optional) The ECP base address for the
+        port.  If given and the port has an ECR with FIFO support, SPP writes
+        use the Parallel Port FIFO mode so the handshake is done in hardware.
+        Default is to not use it.
+    :param EcpCapabilities|None ecp_capabilities: (optional) The capabilities of
+        the ECP FIFO, such as those saved with ``save_json()``, in which case
+        the port is taken to have one.  Default is to detect them if the port
+        has an ECR.
+    :param bool shadow_registers: (optional) Whether to keep a write-through
+        copy of the Control register (and of the Data register if the port is
+        not bidirectional) so that changing part of it does not need to read
+        it back from the port first.  Use ``resync()`` if something else may
+        have written to the port.  Default is to always read the registers
+        from the port (False).
+    :param bool|None bidirectional: (optional) Whether the port is
+        bidirectional, such as saved with ``save_json()``, default is to
+        detect it
+    :param bool probe: (optional) Whether to detect the capabilities that
+        are not given even if they were already detected for these base
+        addresses in this process.  Default is to reuse the earlier results
+        (False), so only the first port created for each address probes the
+        hardware.
+    :param int|None mmio_address: (optional) For cards exposing their
+        registers through an MMIO BAR, the physical address of the SPP Data
+        register.  The registers are mapped once and accessed through the
+        mapping, at the same offsets from it as from ``spp_base_address``
+        (including the ECP registers), which then only names the registers.
+        Default is to use I/O space.  InpOut warns that its mapping may not
+        work, especially on x64; if it fails, ``OSError`` is raised and the
+        port can be opened without ``mmio_address`` instead.
+    """
+
+    _STROBE_MEASURE_ITERATIONS = 64
+
+    # pylint: disable=too-many-arguments
+    def __init__(
+        self,
+        spp_base_address: int,
+        windll_location: Optional[str] = None,
+        reset_control: bool = True,
+        strobe_timing: Optional[StrobeTiming] = None,
+        ecp_base_address: Optional[int] = None,
+        ecp_capabilities: Optional[EcpCapabilities] = None,
+        shadow_registers: bool = False,
+        bidirectional: Optional[bool] = None,
+        probe: bool = False,
+        mmio_address: Optional[int] = None,
+    ) -> None:
+        super().__init__(windll_location)
+        self._spp_data_address = spp_base_address
+        self._status_address = spp_base_address + 1
+        self._control_address = spp_base_address + 2
+        self._fifo_port = None
+        self._mmio_address = mmio_address
+        if mmio_address is not None:
+            self._map_registers(mmio_address, spp_base_address)
+        self._register_locks = {
+            self._spp_data_address: threading.RLock(),
+            self._status_address: threading.RLock(),
+            self._control_address: threading.RLock(),
+        }
+        self._shadow_registers = False
+        self._control_shadow: Optional[int] = None
+        self._data_shadow: Optional[int] = None
+        if bidirectional is None:
+            bidirectional = cached_detection(
+                ("bidirectional", spp_base_address), self._test_bidirectional, probe
+            )
+        self._is_bidir = bidirectional
+        self._shadow_registers = shadow_registers
+        self.resync()
+        if reset_control:
+            self.spp_handshake_control_reset()
+        self.strobe_timing = StrobeTiming() if strobe_timing is None else strobe_timing
+        self._ieee1284_mode: Optional[Ieee1284Mode] = None
+        if ecp_base_address is not None:
+            fifo_port = ExtendedPort(
+                ecp_base_address,
+                windll_location,
+                spp_base_address,
+                EcpCapabilities() if ecp_capabilities is None else ecp_capabilities,
+                mmio_address=(
+                    None
+                    if mmio_address is None
+                    else mmio_address + ecp_base_address - spp_base_address
+                ),
+            )
+            if ecp_capabilities is None:
+                ecp_capabilities = fifo_port.detect_fifo(probe)
+            if ecp_capabilities is not None:
+                fifo_port.ecp_capabilities = ecp_capabilities
+                control_lock = self._register_locks[self._control_address]
+                # pylint: disable=protected-access
+                fifo_port._spp_control_lock = control_lock
+                self._fifo_port = fifo_port
+
+    @classmethod
+    def from_json_dict(cls, json_contents: Dict[str, Any]) -> "StandardPort":
+        """Factory method for creating and instance of StandardPort from the
+        contents of a JSON configuration, as used by ``from_json()``
+
+        :param dict json_contents: The contents of the JSON configuration
+        :return: An instance of StandardPort
+        :rtype: StandardPort
+        """
+
+        port_params = ["spp_base_address"]
+        optional_params = ["ecp_base_address", "mmio_address"]
+
+        json_params = cls._parse_json_dict(json_contents, port_params, optional_params)
+        if "bidirectional" in json_contents:
+            json_params["bidirectional"] = bool(json_contents["bidirectional"])
+        return cls(**json_params)
+
+    def _json_contents(self) -> Dict[str, Any]:
+        """Returns the configuration of the port in the form used by
+        ``from_json()``
+
+        :rtype: dict
+        """
+
+        json_contents = super()._json_contents()
+        json_contents["spp_base_address"] = hex(self._spp_data_address)
+        json_contents["bidirectional"] = self._is_bidir
+        if self._mmio_address is not None:
+            json_contents["mmio_address"] = hex(self._mmio_address)
+        if self._fifo_port is not None:
+            json_contents.update(self._fifo_port.ecp_json_contents())
+        return json_contents
+
+    def _register_ranges(self) -> List[Tuple[int, int, int]]:
+        """Returns the SPP and EPP registers, and those of the ECP FIFO if it
+        is used, as ranges for direct I/O
+
+        :rtype: list
+        """
+
+        ranges = [(self._spp_data_address, 8, self._status_address)]
+        if self._fifo_port is not None:
+            # pylint: disable=protected-access
+            ranges.extend(self._fifo_port._register_ranges())
+        return ranges
+
+    @property
+    def direction(self) -> Direction:
+        """Get the current direction of the port"""
+
+        control_byte = self.read_control_register()
+        direction_byte = (1 << 5) & control_byte
+        return Direction(direction_byte >> 5)
+
+    @direction.setter
+    def direction(self, direction: Direction) -> None:
+
+        with self._register_locks[self._control_address]:
+            control_byte = self.read_control_register()
+            new_control_byte = (control_byte & 0b11011111) | (direction.value << 5)
+            self.write_control_register(new_control_byte)
+
+    def _test_bidirectional(self) -> bool:
+        """Tests whether the port has bidirectional support, which it has if
+        the direction bit of the Control register can be set
+
+        :return: Whether the port is bidirectional
+        :rtype: bool
+        """
+
+        curr_dir = self.direction
+        self.direction = Direction.REVERSE
+        is_bidir = self.direction is Direction.REVERSE
+        self.direction = curr_dir
+        return is_bidir
+
+    @property
+    def strobe_timing(self) -> StrobeTiming:
+        """The timing of the STROBE pulse used for SPP transfers.  The timing
+        actually achieved is available from ``achieved_strobe_timing``.
+        """
+        return self._strobe_timing
+
+    @strobe_timing.setter
+    def strobe_timing(self, timing: StrobeTiming) -> None:
+
+        self._strobe_timing = StrobeTiming(*timing)
+        self._achieved_strobe_timing: Optional[StrobeTiming] = None
+
+    @property
+    def achieved_strobe_timing(self) -> StrobeTiming:
+        """The STROBE timing achieved on this machine for the configured
+        ``strobe_timing``, as measured the first time it is read after the
+        timing is set
+        """
+        if self._achieved_strobe_timing is None:
+            self._achieved_strobe_timing = self.measure_strobe_timing()
+        return self._achieved_strobe_timing
+
+    def measure_strobe_timing(self, iterations: Optional[int] = None) -> StrobeTiming:
+        """Measures the STROBE timing achieved for the configured
+        ``strobe_timing`` by running the strobe sequence without changing
+        any lines
+
+        :param int|None iterations: (optional) The number of times to run the
+            sequence, default is 64
+        :return: The mean achieved timing
+        :rtype: StrobeTiming
+        """
+
+        if iterations is None:
+            iterations = self._STROBE_MEASURE_ITERATIONS
+        achieved = self._port.spp_measure_strobe(
+            self._spp_data_address,
+            self.read_control_register(),
+            *self._strobe_timing,
+            iterations,
+        )
+        return StrobeTiming(*achieved)
+
+    @property
+    def shadow_registers(self) -> bool:
+        """Returns whether the port keeps a write-through copy of its Control
+        register (and of its Data register if it is not bidirectional)
+        """
+        return self._shadow_registers
+
+    def resync(self) -> None:
+        """Reloads the copies of the registers kept when ``shadow_registers``
+        is used from the port, for use after something other than this object
+        (another program, or a transfer mode that drives the lines in
+        hardware) may have changed them.  This does nothing if the registers
+        are not shadowed.
+        """
+
+        self._forget_shadows()
+        if not self._shadow_registers:
+            return
+        self._control_shadow = self._port.DlPortReadPortUchar(self._control_address)
+        if not self._is_bidir:
+            self._data_shadow = self._port.DlPortReadPortUchar(self._spp_data_address)
+
+    def _forget_shadows(self, control: bool = True) -> None:
+        """Discards the shadowed register values, so they are read from the
+        port the next time they are needed
+
+        :param bool control: (optional) Whether to discard the Control register
+            as well as the Data register, default is to discard both (True)
+        """
+
+        self._data_shadow = None
+        if control:
+            self._control_shadow = None
+
+    def register_lock(self, address: int) -> threading.RLock:
+        """Returns the lock this port holds while it reads and modifies one of
+        its SPP registers, which can be held to make a sequence of operations
+        on the register atomic.  Each port, and each register of it, has its
+        own lock, so threads using different registers or ports do not
+        contend.
+
+        :param int address: The address of the Data, Status or Control
+            register, such as ``Pin.register``
+        :rtype: threading.RLock
+        :raises KeyError: If the address is not one of those registers
+        """
+        return self._register_locks[address]
+
+    def _lock_registers(self, addresses: Iterable[int]) -> ExitStack:
+        """Acquires the locks of several registers, in address order so that
+        threads locking overlapping registers cannot deadlock
+
+        :param addresses: The addresses of the registers
+        :return: A context manager releasing the locks
+        :rtype: contextlib.ExitStack
+        """
+
+        stack = ExitStack()
+        for address in sorted(set(addresses)):
+            stack.enter_context(self._register_locks[address])
+        return stack
+
+    def _read_latched_register(self, address: int) -> int:
+        """Reads a register for a read-modify-write, using the shadowed value
+        if there is one
+
+        :param int address: The address of the register
+        :return: The value of the register
+        :rtype: int
+        """
+
+        if address == self._control_address:
+            return self.read_control_register()
+        if address == self._spp_data_address and self._data_shadow is not None:
+            return self._data_shadow
+        return self._port.DlPortReadPortUchar(address)
+
+    def _write_latched_register(self, address: int, value: int) -> None:
+        """Writes a register, keeping any shadowed value up to date
+
+        :param int address: The address of the register
+        :param int value: The value to write
+        """
+
+        if address == self._control_address:
+            self.write_control_register(value)
+        elif address == self._spp_data_address:
+            self.write_data_register(value)
+        else:
+            self._port.DlPortWritePortUchar(address, value)
+
+    def execute(self, program: PortProgram) -> ProgramResult:
+        """Runs a port program on this port in a single call.  When the native
+        extension is used, the steps run without Python between them.
+
+        :param PortProgram program: The program to run
+        :return: The values read by the program
+        :rtype: ProgramResult
+        :raises TransferTimeoutError: If a wait in the program times out, with
+            the values read before it stored as ``data``
+        :raises MemoryError: If the values the program reads cannot be stored
+        """
+
+        reads, failed = self._port.run_program(program.compile(self._spp_data_address))
+        self._forget_shadows()
+        if failed >= 0:
+            raise TransferTimeoutError(
+                f"Instruction {failed} of the program timed out", len(reads), reads
+            )
+        return ProgramResult(reads)
+
+    def _latched_register_written(self, address: int, value: int) -> None:
+        """Records a value written to a register by a native routine, keeping
+        any shadowed value up to date
+
+        :param int address: The address of the register
+        :param int value: The value that was written
+        """
+
+        if not self._shadow_registers:
+            return
+        if address == self._control_address:
+            self._control_shadow = value
+        elif address == self._spp_data_address and not self._is_bidir:
+            self._data_shadow = value
+
+    # pylint: disable=too-many-arguments
+    def create_sampler(
+        self,
+        channels: SamplerChannel = SamplerChannel.STATUS,
+        capacity: int = 65536,
+        period_ns: int = 0,
+        trigger_mask: int = 0,
+        trigger_value: int = 0,
+    ) -> InputSampler:
+        """Creates a sampler that reads the registers of the port from a
+        background thread
+
+        :param SamplerChannel channels: (optional) The registers to sample,
+            default is the Status register
+        :param int capacity: (optional) How many samples can wait to be
+            drained before new ones are dropped, which the native extension
+            rounds up to a power of two, default is 65536
+        :param int period_ns: (optional) The time between samples in
+            nanoseconds, default is to sample as fast as possible (0), which
+            keeps a core busy.  Between timed samples the thread backs off as
+            set by the ``WaitPolicy`` in reverse, sleeping and then yielding
+            until only ``spin_ns`` of the period is left.
+        :param int trigger_mask: (optional) The bits of the raw Status
+            register that must equal ``trigger_value`` before samples are
+            kept, default is to keep them from the start (0)
+        :param int trigger_value: (optional) The value the masked bits must
+            equal, default is 0
+        :return: The sampler, which is not started
+        :rtype: InputSampler
+        """
+
+        return InputSampler(
+            self._port.Sampler(
+                self._spp_data_address,
+                int(channels),
+                capacity,
+                period_ns,
+                trigger_mask,
+                trigger_value,
+            )
+        )
+
+    def open_stream(
+        self,
+        buffer_count: int = 4,
+        buffer_size: int = 4096,
+        timeout: Optional[float] = 1.0,
+    ) -> OutputStream:
+        """Opens a stream that sends data via SPP from a background thread,
+        so the peripheral keeps receiving data while the next buffer is
+        written, for long jobs such as plotting.  The handshake is done as in
+        ``write_spp_buffer()``, through the Parallel Port FIFO if the port
+        supports it.  The Control register is set up once for the whole
+        stream.
+
+        :param int buffer_count: (optional) The number of buffers in the ring,
+            default is 4
+        :param int buffer_size: (optional) The size of each buffer in bytes,
+            default is 4096
+        :param float|None timeout: (optional) How long to wait for the device to
+            be ready to receive each byte (or for the FIFO to accept data) in
+            seconds, or None to wait indefinitely, default is 1 second
+        :return: The stream, which is not started
+        :rtype: OutputStream
+        """
+
+        self.spp_handshake_control_reset()
+        if self._fifo_port is not None:
+            return self._fifo_port.open_spp_fifo_stream(
+                buffer_count, buffer_size, timeout, self._forget_shadows
+            )
+        control_byte = self._spp_buffer_control()
+        return OutputStream(
+            self._port.Streamer(
+                "spp",
+                self._spp_data_address,
+                buffer_count,
+                buffer_size,
+                timeout,
+                control_byte,
+                *self._strobe_timing,
+            ),
+            lambda: self._forget_shadows(control=False),
+        )
+
+    @property
+    def uses_hardware_fifo(self) -> bool:
+        """Returns whether SPP writes use the Parallel Port FIFO mode of the
+        ECR, based on the test performed during ``__init__()``
+        """
+        return self._fifo_port is not None
+
+    @property
+    def is_bidirectional(self) -> bool:
+        """Returns whether the port is bidirectional, based on the test performed
+        during ``__init__()``
+        """
+        return self._is_bidir
+
+    def write_data_register(self, data_byte: int) -> None:
+        """Writes to the Data register
+
+        :param data_byte: A byte of data
+        :type data_byte: int
+        """
+        self._port.DlPortWritePortUchar(self._spp_data_address, data_byte)
+        if self._shadow_registers and not self._is_bidir:
+            self._data_shadow = data_byte
+
+    def read_data_register(self) -> int:
+        """Reads from the data register
+
+        :return: The information in the Data register
+        :rtype: int
+        :raises OSError: If the port is not bidirectional
+        """
+
+        if self._is_bidir:
+            return self._port.DlPortReadPortUchar(self._spp_data_address)
+
+        raise OSError(
+            "This port was detected not to be bidirectional, data cannot be "
+            "read using the data register/pins"
+        )
+
+    def write_control_register(self, control_byte: int) -> None:
+        """Writes to the Control register
+
+        :param control_byte: A byte of data
+        :type control_byte: int
+        """
+        self._port.DlPortWritePortUchar(self._control_address, control_byte)
+        if self._shadow_registers:
+            self._control_shadow = control_byte
+
+    def read_control_register(self) -> int:
+        """Reads from the Control register, or from its shadowed value if
+        ``shadow_registers`` is used
+
+        :return: The information in the Control register
+        :rtype: int
+        """
+
+        if self._control_shadow is not None:
+            return self._control_shadow
+        control_byte = self._port.DlPortReadPortUchar(self._control_address)
+        if self._shadow_registers:
+            self._control_shadow = control_byte
+        return control_byte
+
+    def read_status_register(self) -> int:
+        """Reads from the Status register
+
+        :return: The information in the Status register
+        :rtype: int
+        """
+        return self._port.DlPortReadPortUchar(self._status_address)
+
+    def write_spp_data(
+        self, data: int, hold_while_busy: bool = True, timeout: Optional[float] = 1.0
+    ) -> None:
+        """Writes data via SPP, using the Parallel Port FIFO if the port
+        supports it
+
+        :param int data: The data to be transmitted
+        :param bool hold_while_busy: Whether code should be blocked until the Busy
+            line communicates the device is done receiving the data, default
+            behavior is blocking (True)
+        :param float|None timeout: (optional) How long to wait for the device
+            once the data is sent in seconds, or None to wait indefinitely,
+            default is 1 second.  The wait backs off as set by
+            ``set_wait_policy()``.
+        :raises OSError: If the port is busy
+        :raises TransferTimeoutError: If the device stays busy for longer than
+            the timeout after the data is sent
+        """
+
+        self.spp_handshake_control_reset()
+        if self.is_bidirectional:
+            self.direction = Direction.FORWARD
+        if not bool((self.read_status_register() & (1 << 7)) >> 7):
+            raise OSError("Port is busy")
+        if self._fifo_port is not None:
+            self._write_spp_fifo(bytes((data,)), hold_while_busy, timeout)
+            return
+        curr_control = self.read_control_register()
+        self._port.spp_strobe_byte(
+            self._spp_data_address, curr_control, data, *self._strobe_timing
+        )
+        if self._shadow_registers and not self._is_bidir:
+            self._data_shadow = data
+        if hold_while_busy and not self._port.wait_port_bits(
+            self._status_address, 0b10000000, 0b10000000, timeout
+        ):
+            raise TransferTimeoutError("Port stayed busy after the data was sent", 1)
+
+    def write_spp_buffer(
+        self,
+        data: Union[bytes, bytearray, memoryview],
+        hold_while_busy: bool = True,
+        timeout: Optional[float] = 1.0,
+    ) -> int:
+        """Writes a buffer of data via SPP, performing the handshake for each
+        byte.  The Control register is set up once for the whole transfer.  If
+        the port supports it, the data is written through the Parallel Port
+        FIFO, so the handshake is done in hardware (with its own timing rather
+        than ``strobe_timing``).
+
+        :param data: The data to be transmitted
+        :type data: bytes|bytearray|memoryview
+        :param bool hold_while_busy: Whether code should be blocked until the Busy
+            line communicates the device is done receiving the last byte, default
+            behavior is blocking (True)
+        :param float|None timeout: (optional) How long to wait for the device to
+            be ready to receive each byte in seconds, or None to wait indefinitely,
+            default is 1 second
+        :return: The number of bytes sent
+        :rtype: int
+        :raises TransferTimeoutError: If the device stays busy for longer than the
+            timeout, with the number of bytes sent stored as ``bytes_transferred``
+        """
+
+        self.spp_handshake_control_reset()
+        if self._fifo_port is not None:
+            return self._write_spp_fifo(data, hold_while_busy, timeout)
+        sent, completed = self._port.spp_write_buffer(
+            self._spp_data_address,
+            self._spp_buffer_control(),
+            data,
+            timeout,
+            hold_while_busy,
+            *self._strobe_timing,
+        )
+        self._forget_shadows(control=False)
+        return self._check_spp_buffer_sent(sent, completed)
+
+    async def write_spp_buffer_async(
+        self,
+        data: Union[bytes, bytearray, memoryview],
+        hold_while_busy: bool = True,
+        timeout: Optional[float] = 1.0,
+    ) -> int:
+        """The ``asyncio`` variant of ``write_spp_buffer()``.  The handshake
+        runs on the completion thread, so the event loop is free while the
+        peripheral is busy.  If the port uses the Parallel Port FIFO, the
+        transfer instead runs in the event loop's default executor.  Other
+        threads should not use the port's registers until it finishes.
+
+        :param data: The data to be transmitted
+        :type data: bytes|bytearray|memoryview
+        :param bool hold_while_busy: Whether to wait until the Busy line
+            communicates the device is done receiving the last byte, default
+            behavior is to wait (True)
+        :param float|None timeout: (optional) How long to wait for the device to
+            be ready to receive each byte in seconds, or None to wait indefinitely,
+            default is 1 second
+        :return: The number of bytes sent
+        :rtype: int
+        :raises TransferTimeoutError: If the device stays busy for longer than the
+            timeout, with the number of bytes sent stored as ``bytes_transferred``
+        """
+
+        self.spp_handshake_control_reset()
+        if self._fifo_port is not None:
+            return await asyncio.get_running_loop().run_in_executor(
+                None, self._write_spp_fifo, data, hold_while_busy, timeout
+            )
+        try:
+            sent, completed = await complete_operation(
+                self._port,
+                "submit_spp_write",
+                self._spp_data_address,
+                self._spp_buffer_control(),
+                data,
+                timeout,
+                hold_while_busy,
+                *self._strobe_timing,
+            )
+        finally:
+            self._forget_shadows(control=False)
+        return self._check_spp_buffer_sent(sent, completed)
+
+    def _spp_buffer_control(self) -> int:
+        """Sets the port to the forward direction for a buffer transfer
+
+        :return: The Control register byte to use as the idle state
+        :rtype: int
+        """
+
+        control_byte = self.read_control_register()
+        if self.is_bidirectional:
+            control_byte &= 0b11011111
+            self.write_control_register(control_byte)
+        return control_byte
+
+    @staticmethod
+    def _check_spp_buffer_sent(sent: int, completed: bool) -> int:
+        """Checks the result of a buffer transfer
+
+        :param int sent: The number of bytes sent
+        :param bool completed: Whether the transfer completed
+        :return: The number of bytes sent
+        :rtype: int
+        :raises TransferTimeoutError: If the transfer did not complete
+        """
+
+        if not completed:
+            raise TransferTimeoutError(
+                f"Port stayed busy after {sent} bytes were sent", sent
+            )
+        return sent
+
+    def _write_spp_fifo(
+        self,
+        data: Union[bytes, bytearray, memoryview],
+        hold_while_busy: bool,
+        timeout: Optional[float],
+    ) -> int:
+        """Writes a buffer of data through the Parallel Port FIFO
+
+        :param data: The data to be transmitted
+        :type data: bytes|bytearray|memoryview
+        :param bool hold_while_busy: Whether to wait for the Busy line after the
+            FIFO drains
+        :param float|None timeout: How long the FIFO may stall in seconds, or
+            None to wait indefinitely
+        :return: The number of bytes sent
+        :rtype: int
+        :raises TransferTimeoutError: If the FIFO stalls, or the device stays
+            busy, for longer than the timeout
+        """
+
+        try:
+            sent = self._fifo_port.write_spp_fifo_buffer(data, timeout)
+        finally:
+            self._forget_shadows()
+        if hold_while_busy and not self._port.wait_port_bits(
+            self._status_address, 0b10000000, 0b10000000, timeout
+        ):
+            raise TransferTimeoutError(
+                f"Port stayed busy after {sent} bytes were sent", sent
+            )
+        return sent
+
+    def read_spp_data(self) -> int:
+        """Reads data on the SPP data register, while managing the SPP handshake
+        resources similar to a write operation
+
+        :return: The data on the Data pins
+        :rtype: int
+        :raises OSError: If the port is not bidirectional
+        """
+
+        if self.is_bidirectional:
+            self.spp_handshake_control_reset()
+            self.direction = Direction.REVERSE
+            return self.read_data_register()
+
+        raise OSError(
+            "This port was detected not to be bidirectional, data cannot be "
+            "read using the data register/pins"
+        )
+
+    def read_spp_data_into(self, buffer: Union[bytearray, memoryview]) -> int:
+        """Reads the SPP data register once for each byte of a buffer, with
+        the port reversed as in ``read_spp_data()``.  The reads are done in
+        one call to the backend, without creating an ``int`` for each byte.
+
+        :param buffer: The writable buffer to fill, such as a ``bytearray``,
+            ``memoryview`` or NumPy array
+        :type buffer: bytearray|memoryview
+        :return: The number of bytes read
+        :rtype: int
+        :raises OSError: If the port is not bidirectional
+        """
+
+        if not self.is_bidirectional:
+            raise OSError(
+                "This port was detected not to be bidirectional, data cannot be "
+                "read using the data register/pins"
+            )
+        self.spp_handshake_control_reset()
+        self.direction = Direction.REVERSE
+        self._port.read_port_into(self._spp_data_address, buffer)
+        return memoryview(buffer).nbytes
+
+    @property
+    def ieee1284_mode(self) -> Optional[Ieee1284Mode]:
+        """The IEEE 1284 reverse-channel mode negotiated with the peripheral,
+        or None if the peripheral is in compatibility mode
+        """
+
+        return self._ieee1284_mode
+
+    def negotiate_1284(
+        self, mode: Ieee1284Mode, timeout: Optional[float] = 1.0
+    ) -> bool:
+        """Negotiates an IEEE 1284 reverse-channel mode with the peripheral,
+        after which ``read_reverse()`` can be used.  Nibble mode reads the
+        data over the Status register, so it works on any port, while byte
+        mode needs the port to be bidirectional.  Any mode already negotiated
+        is terminated first.
+
+        :param Ieee1284Mode mode: The mode to negotiate
+        :param float|None timeout: (optional) How long to wait for each step of
+            the handshake in seconds, or None to wait indefinitely, default is
+            1 second
+        :return: Whether the peripheral has data available
+        :rtype: bool
+        :raises OSError: If byte mode is requested but the port is not
+            bidirectional, or the peripheral does not support the mode
+        :raises TransferTimeoutError: If the peripheral does not answer the
+            negotiation, such as when it is not IEEE 1284 compliant
+        """
+
+        mode = Ieee1284Mode(mode)
+        if mode == Ieee1284Mode.BYTE and not self._is_bidir:
+            raise OSError(
+                "This port was detected not to be bidirectional, byte mode cannot "
+                "be used to read data"
+            )
+        self.terminate_1284(timeout)
+        with self._lock_registers(self._register_locks):
+            try:
+                answered, status = self._port.ieee1284_negotiate(
+                    self._spp_data_address, mode.value, timeout
+                )
+            finally:
+                self._forget_shadows()
+        if not answered:
+            raise TransferTimeoutError(
+                "Peripheral did not answer the IEEE 1284 negotiation", 0
+            )
+        self._ieee1284_mode = mode
+        # The XFlag (Select) is always low for nibble mode, and set by the
+        # peripheral for the other modes it supports
+        if mode != Ieee1284Mode.NIBBLE and not status & 0b00010000:
+            self.terminate_1284(timeout)
+            raise OSError(f"The peripheral does not support {mode.name} mode")
+        return not status & 0b00001000
+
+    def terminate_1284(self, timeout: Optional[float] = 1.0) -> None:
+        """Returns the peripheral to compatibility mode after
+        ``negotiate_1284()``, doing nothing if no mode was negotiated
+
+        :param float|None timeout: (optional) How long to wait for each step of
+            the handshake in seconds, or None to wait indefinitely, default is
+            1 second
+        :raises TransferTimeoutError: If the peripheral does not follow the
+            termination handshake, in which case the port is still left in
+            compatibility mode
+        """
+
+        if self._ieee1284_mode is None:
+            return
+        self._ieee1284_mode = None
+        with self._lock_registers(self._register_locks):
+            try:
+                completed = self._port.ieee1284_terminate(
+                    self._spp_data_address, timeout
+                )
+            finally:
+                self._forget_shadows()
+        if not completed:
+            raise TransferTimeoutError(
+                "Peripheral did not follow the IEEE 1284 termination", 0
+            )
+
+    def read_reverse(self, length: int, timeout: Optional[float] = 1.0) -> bytes:
+        """Reads data from the peripheral in the IEEE 1284 mode negotiated
+        with ``negotiate_1284()``, with the handshake for the whole buffer
+        done in one call to the backend
+
+        :param int length: The maximum number of bytes to read
+        :param float|None timeout: (optional) How long to wait for each step of
+            the handshake in seconds, or None to wait indefinitely, default is
+            1 second
+        :return: The data read, which is shorter than ``length`` if the
+            peripheral ran out of data
+        :rtype: bytes
+        :raises OSError: If no mode has been negotiated
+        :raises TransferTimeoutError: If the peripheral stops following the
+            handshake for longer than the timeout, with the data read so far
+            stored as ``data``
+        """
+
+        buffer = bytearray(length)
+        received, completed = self._read_reverse(buffer, timeout)
+        del buffer[received:]
+        if not completed:
+            raise TransferTimeoutError(
+                f"Peripheral stopped responding after {received} bytes were read",
+                received,
+                bytes(buffer),
+            )
+        return bytes(buffer)
+
+    def read_reverse_into(
+        self, buffer: Union[bytearray, memoryview], timeout: Optional[float] = 1.0
+    ) -> int:
+        """Reads data from the peripheral into a buffer, as with
+        ``read_reverse()``
+
+        :param buffer: The writable buffer to fill, such as a ``bytearray``,
+            ``memoryview`` or NumPy array
+        :type buffer: bytearray|memoryview
+        :param float|None timeout: (optional) How long to wait for each step of
+            the handshake in seconds, or None to wait indefinitely, default is
+            1 second
+        :return: The number of bytes read, which is less than the size of the
+            buffer if the peripheral ran out of data
+        :rtype: int
+        :raises OSError: If no mode has been negotiated
+        :raises TransferTimeoutError: If the peripheral stops following the
+            handshake for longer than the timeout, with the number of bytes
+            read stored as ``bytes_transferred``
+        """
+
+        received, completed = self._read_reverse(buffer, timeout)
+        if not completed:
+            raise TransferTimeoutError(
+                f"Peripheral stopped responding after {received} bytes were read",
+                received,
+            )
+        return received
+
+    def _read_reverse(
+        self, buffer: Union[bytearray, memoryview], timeout: Optional[float]
+    ) -> Tuple[int, bool]:
+        """Runs the reverse-channel transfer of the negotiated mode
+
+        :return: The number of bytes read, and whether the transfer completed
+        :rtype: tuple
+        :raises OSError: If no mode has been negotiated
+        """
+
+        if self._ieee1284_mode is None:
+            raise OSError("No IEEE 1284 mode has been negotiated, use negotiate_1284()")
+        if self._ieee1284_mode == Ieee1284Mode.BYTE:
+            read_into = self._port.ieee1284_byte_read_into
+        else:
+            read_into = self._port.ieee1284_nibble_read_into
+        with self._lock_registers(self._register_locks):
+            try:
+                return read_into(self._spp_data_address, buffer, timeout)
+            finally:
+                self._forget_shadows()
+
+    def spp_handshake_control_reset(self) -> None:
+        """Resets the Control register for the SPP handshake"""
+
+        with self._register_locks[self._control_address]:
+            control_byte = self.read_control_register()
+            bidir_control_byte = 0b11110000 if self._is_bidir else 0b11010000
+            pre_control_byte = bidir_control_byte & control_byte
+            new_control_byte = 0b00000100 | pre_control_byte
+            self.write_control_register(new_control_byte)
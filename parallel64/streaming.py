@@ -0,0 +1,480 @@
+# SPDX-FileCopyrightText: 2022 Alec Delaney
+#
+# SPDX-License-Identifier: MIT
+
+"""
+`parallel64.streaming`
+
+Continuous output to the port from a background thread, which sends a ring
+of buffers filled from Python so that the peripheral keeps receiving data
+while the next chunk is prepared
+
+
+* Author(s): Alec Delaney
+
+"""
+
+import sys
+import threading
+import time
+from types import TracebackType
+from typing import Callable, List, NamedTuple, Optional, Tuple, Type, Union
+from parallel64.exceptions import TransferTimeoutError
+
+
+class StreamStats(NamedTuple):
+    """The throughput achieved by an ``OutputStream``
+
+    :param int bytes_sent: The number of bytes sent to the port
+    :param int buffers_sent: The number of buffers sent to the port
+    :param int underruns: The number of times the sending thread ran out of
+        buffers after the stream started, leaving the peripheral idle
+    :param int elapsed_ns: The time from the first buffer starting to send
+        to the last one finishing, in nanoseconds
+    :param int worst_stall_ns: The longest the sending thread waited for a
+        buffer during an underrun, in nanoseconds
+    """
+
+    bytes_sent: int
+    buffers_sent: int
+    underruns: int
+    elapsed_ns: int
+    worst_stall_ns: int
+
+    @property
+    def bytes_per_second(self) -> float:
+        """The number of bytes sent per second"""
+        return self.bytes_sent * 1e9 / self.elapsed_ns if self.elapsed_ns else 0.0
+
+
+class CtypesStreamer:
+    """
+    Sends a ring of buffers to the port from a background Python thread,
+    used when the native extension is unavailable.  It exposes the same
+    interface as ``parallel64._native.Streamer``, but the thread needs the
+    GIL, so the producer and the port share it.
+
+    :param send: The function sending a buffer, returning the number of
+        bytes sent and whether the peripheral took them before the timeout
+    :param finish: The function waiting for the peripheral to take the last
+        byte sent, returning whether it did before the timeout
+    :param int buffer_count: The number of buffers in the ring
+    :param int buffer_size: The size of each buffer in bytes
+    """
+
+    # pylint: disable=too-many-instance-attributes
+    def __init__(
+        self,
+        send: Callable[[memoryview], Tuple[int, bool]],
+        finish: Callable[[], bool],
+        buffer_count: int,
+        buffer_size: int,
+    ) -> None:
+        if buffer_count <= 0 or buffer_size <= 0:
+            raise ValueError("buffer_count and buffer_size must be positive")
+        if buffer_count > sys.maxsize // buffer_size:
+            raise MemoryError("buffer_count * buffer_size is too large")
+        self._send = send
+        self._finish = finish
+        self._buffers = [bytearray(buffer_size) for _ in range(buffer_count)]
+        self._lengths = [0] * buffer_count
+        self._condition = threading.Condition()
+        self._producer_lock = threading.Lock()
+        self._thread: Optional[threading.Thread] = None
+        self._head = 0
+        self._tail = 0
+        self._fill = 0
+        self._closing = False
+        self._aborted = False
+        self._failed = False
+        self._bytes_sent = 0
+        self._underruns = 0
+        self._start_ns = 0
+        self._end_ns = 0
+        self._worst_stall_ns = 0
+
+    @property
+    def running(self) -> bool:
+        """Whether the sending thread is running"""
+        with self._condition:
+            return self._thread is not None and not self._stopped()
+
+    @property
+    def failed(self) -> bool:
+        """Whether the peripheral stalled for longer than the timeout"""
+        with self._condition:
+            return self._failed
+
+    @property
+    def pending(self) -> int:
+        """Committed buffers waiting to be sent"""
+        with self._condition:
+            return self._head - self._tail
+
+    @property
+    def buffer_count(self) -> int:
+        """The number of buffers in the ring"""
+        return len(self._buffers)
+
+    @property
+    def buffer_size(self) -> int:
+        """The size of each buffer in bytes"""
+        return len(self._buffers[0])
+
+    def start(self) -> None:
+        """Start the sending thread"""
+
+        with self._condition:
+            if self._thread is not None:
+                raise RuntimeError("the stream is already running")
+            if self._closing or self._aborted:
+                raise ValueError("the stream is closed")
+            self._thread = threading.Thread(target=self._run, daemon=True)
+            self._thread.start()
+
+    def write(
+        self, data: Union[bytes, bytearray, memoryview], timeout: Optional[float] = None
+    ) -> int:
+        """Copy a bytes-like object into the ring, committing each buffer as
+        it fills and waiting whenever every buffer is waiting to be sent.
+        Starts the thread if it was not started and the data does not fit in
+        the ring.
+
+        :param data: The data to send
+        :param float|None timeout: How long to wait for a free buffer in
+            seconds, or None to wait indefinitely
+        :return: The number of bytes accepted
+        :rtype: int
+        """
+
+        view = memoryview(data).cast("B")
+        with self._condition:
+            if self._closing or self._aborted:
+                raise ValueError("the stream is closed")
+        # Nothing frees a buffer until the thread runs
+        if self._thread is None and len(view) > self._free_space():
+            self.start()
+        deadline = None if timeout is None else time.monotonic() + timeout
+        count = len(self._buffers)
+        size = len(self._buffers[0])
+        accepted = 0
+        with self._producer_lock:
+            while accepted < len(view):
+                with self._condition:
+                    remaining = None
+                    if deadline is not None:
+                        remaining = max(deadline - time.monotonic(), 0)
+                    if not self._condition.wait_for(
+                        lambda: self._stopped() or self._head - self._tail < count,
+                        remaining,
+                    ):
+                        break
+                    if self._stopped():
+                        break
+                chunk = min(size - self._fill, len(view) - accepted)
+                buffer = self._buffers[self._head % count]
+                end = accepted + chunk
+                buffer[self._fill : self._fill + chunk] = view[accepted:end]
+                self._fill += chunk
+                accepted += chunk
+                if self._fill == size:
+                    self._commit()
+        return accepted
+
+    def flush(self) -> None:
+        """Commit the partly filled buffer, if any"""
+
+        with self._producer_lock:
+            if self._fill:
+                self._commit()
+
+    def close(self) -> bool:
+        """Send the remaining buffers, starting the thread if it was not
+        started, wait for the peripheral to take the last byte and stop the
+        thread
+
+        :return: False if the stream failed
+        :rtype: bool
+        """
+
+        self.flush()
+        with self._condition:
+            queued = self._head != self._tail and not (self._closing or self._aborted)
+        if self._thread is None and queued:
+            self.start()
+        with self._condition:
+            self._closing = True
+            self._condition.notify_all()
+        self._join()
+        with self._condition:
+            return not self._failed
+
+    def abort(self) -> None:
+        """Stop the thread without sending the remaining buffers"""
+
+        with self._condition:
+            self._aborted = True
+            self._condition.notify_all()
+        self._join()
+
+    def stats(self) -> Tuple[int, int, int, int, int]:
+        """Return the bytes sent, buffers sent, underruns, elapsed time and
+        worst stall, with the times in nanoseconds
+
+        :rtype: tuple
+        """
+
+        with self._condition:
+            return (
+                self._bytes_sent,
+                self._tail,
+                self._underruns,
+                self._end_ns - self._start_ns,
+                self._worst_stall_ns,
+            )
+
+    def _free_space(self) -> int:
+        """The number of bytes that can be written before every buffer is
+        committed
+        """
+
+        with self._producer_lock, self._condition:
+            count = len(self._buffers)
+            free = count - (self._head - self._tail)
+            return free * len(self._buffers[0]) - self._fill
+
+    def _stopped(self) -> bool:
+        """Whether the producer should stop waiting for buffers"""
+        return self._failed or self._closing or self._aborted
+
+    def _commit(self) -> None:
+        """Hands the buffer being filled to the sending thread"""
+
+        with self._condition:
+            self._lengths[self._head % len(self._buffers)] = self._fill
+            self._head += 1
+            self._condition.notify_all()
+        self._fill = 0
+
+    def _join(self) -> None:
+        """Waits for the sending thread to finish"""
+
+        thread = self._thread
+        if thread is not None and thread is not threading.current_thread():
+            thread.join()
+
+    def _run(self) -> None:
+        """Sends committed buffers until the stream is closed or aborted"""
+
+        count = len(self._buffers)
+        started = False
+        with self._condition:
+            while not self._aborted:
+                if self._tail == self._head:
+                    if self._closing:
+                        self._condition.release()
+                        try:
+                            finished = not started or self._finish()
+                        finally:
+                            self._condition.acquire()
+                        self._failed = not finished
+                        break
+                    starved = time.perf_counter_ns()
+                    self._condition.wait_for(
+                        lambda: self._stopped() or self._tail != self._head
+                    )
+                    if started and self._tail != self._head:
+                        self._underruns += 1
+                        self._worst_stall_ns = max(
+                            self._worst_stall_ns, time.perf_counter_ns() - starved
+                        )
+                    continue
+                slot = self._tail % count
+                view = memoryview(self._buffers[slot])[: self._lengths[slot]]
+                if not started:
+                    started = True
+                    self._start_ns = self._end_ns = time.perf_counter_ns()
+                self._condition.release()
+                try:
+                    sent, completed = self._send(view)
+                finally:
+                    self._condition.acquire()
+                self._bytes_sent += sent
+                self._end_ns = time.perf_counter_ns()
+                if not completed:
+                    self._failed = True
+                    break
+                self._tail += 1
+                self._condition.notify_all()
+            self._condition.notify_all()
+
+
+class OutputStream:
+    """
+    Streams data to a port from a background thread, created with
+    ``StandardPort.open_stream()`` and the stream methods of
+    ``ExtendedPort``.  Writes fill a ring of preallocated buffers, each sent
+    to the port as soon as it is full, and block while every buffer is
+    waiting to be sent.  When the native extension is used, the thread does
+    not need the GIL, so pauses in Python (such as garbage collection) do
+    not stall the peripheral while buffers are queued.  Other threads should
+    not use the port's registers while the stream is open.
+
+    It can be used as a context manager that starts the stream, and closes
+    it when the block exits normally or aborts it when an exception is
+    raised:
+
+    .. code-block::
+
+        import parallel64
+        port = parallel64.StandardPort(0x1234)
+        with port.open_stream() as stream:
+            for chunk in job:
+                stream.write(chunk)
+        print(stream.stats().bytes_per_second)
+
+    :param backend_streamer: The streamer created by the port's backend
+    :param on_close: (optional) A function to call once the stream has
+        stopped, such as to restore the port's mode
+    """
+
+    def __init__(
+        self, backend_streamer, on_close: Optional[Callable[[], None]] = None
+    ) -> None:
+        self._streamer = backend_streamer
+        self._on_close: List[Callable[[], None]] = []
+        if on_close is not None:
+            self._on_close.append(on_close)
+
+    def __enter__(self) -> "OutputStream":
+        self.start()
+        return self
+
+    def __exit__(
+        self,
+        exc_type: Optional[Type[BaseException]],
+        exc_value: Optional[BaseException],
+        traceback: Optional[TracebackType],
+    ) -> None:
+        if exc_type is None:
+            self.close()
+        else:
+            self.abort()
+
+    def start(self) -> None:
+        """Starts sending buffers.  Data written beforehand is queued, so the
+        ring can be filled before the transfer starts.  A stream that is not
+        started starts by itself once a write does not fit in the ring, and
+        when it is closed with data queued.
+
+        :raises RuntimeError: If the stream is already running
+        :raises ValueError: If the stream is closed
+        """
+        self._streamer.start()
+
+    def write(
+        self, data: Union[bytes, bytearray, memoryview], timeout: Optional[float] = None
+    ) -> int:
+        """Copies data into the ring, waiting while every buffer is waiting to
+        be sent.  If the stream was not started and the data does not fit in
+        the ring, it is started.
+
+        :param data: The data to be transmitted
+        :type data: bytes|bytearray|memoryview
+        :param float|None timeout: (optional) How long to wait for a free
+            buffer in seconds, default is to wait indefinitely (None)
+        :return: The number of bytes accepted, which is less than the length
+            of the data if the timeout passed first
+        :rtype: int
+        :raises ValueError: If the stream is closed
+        :raises TransferTimeoutError: If the peripheral stalled for longer
+            than the timeout of the stream, with the number of bytes sent
+            stored as ``bytes_transferred``
+        """
+
+        accepted = self._streamer.write(data, timeout)
+        self._check_failed()
+        return accepted
+
+    def flush(self) -> None:
+        """Queues the partly filled buffer to be sent, if any"""
+        self._streamer.flush()
+
+    def close(self) -> StreamStats:
+        """Sends the remaining buffers, starting the stream if it was not
+        started, waits for the peripheral to take the last byte and stops the
+        thread
+
+        :return: The final statistics of the stream
+        :rtype: StreamStats
+        :raises TransferTimeoutError: If the peripheral stalled for longer
+            than the timeout of the stream, with the number of bytes sent
+            stored as ``bytes_transferred``
+        """
+
+        try:
+            self._streamer.close()
+        finally:
+            self._run_on_close()
+        self._check_failed()
+        return self.stats()
+
+    def abort(self) -> None:
+        """Stops the thread without sending the remaining buffers"""
+
+        try:
+            self._streamer.abort()
+        finally:
+            self._run_on_close()
+
+    def stats(self) -> StreamStats:
+        """Returns the throughput achieved so far
+
+        :rtype: StreamStats
+        """
+        return StreamStats(*self._streamer.stats())
+
+    @property
+    def running(self) -> bool:
+        """Whether the stream is sending buffers"""
+        return self._streamer.running
+
+    @property
+    def failed(self) -> bool:
+        """Whether the peripheral stalled for longer than the timeout of the
+        stream, which stops it
+        """
+        return self._streamer.failed
+
+    @property
+    def pending(self) -> int:
+        """The number of full buffers waiting to be sent"""
+        return self._streamer.pending
+
+    @property
+    def buffer_count(self) -> int:
+        """The number of buffers in the ring"""
+        return self._streamer.buffer_count
+
+    @property
+    def buffer_size(self) -> int:
+        """The size of each buffer in bytes"""
+        return self._streamer.buffer_size
+
+    def _check_failed(self) -> None:
+        """Raises an error if the peripheral stalled
+
+        :raises TransferTimeoutError: If the stream failed
+        """
+
+        if self._streamer.failed:
+            sent = self._streamer.stats()[0]
+            raise TransferTimeoutError(
+                f"Port stalled after {sent} bytes were sent", sent
+            )
+
+    def _run_on_close(self) -> None:
+        """Calls the close function the first time the stream stops"""
+
+        while self._on_close:
+            self._on_close.pop()()
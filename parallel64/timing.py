@@ -0,0 +1,170 @@
+# SPDX-FileCopyrightText: 2022 Alec Delaney
+#
+# SPDX-License-Identifier: MIT
+
+"""
+`parallel64.timing`
+
+Timing settings used for parallel port handshakes, and the policy used
+when waiting on the port
+
+
+* Author(s): Alec Delaney
+
+"""
+
+from typing import NamedTuple
+from parallel64.backend import CtypesBackend, native
+
+
+class StrobeTiming(NamedTuple):
+    """The timing of the STROBE pulse used for SPP transfers, in
+    nanoseconds.  The defaults meet the minimums of the IEEE 1284
+    compatibility mode.
+
+    Used with :class:`parallel64.StandardPort`
+
+    :param int setup_ns: How long data is held on the data lines before
+        STROBE is asserted, default is 500 ns
+    :param int pulse_ns: How long STROBE is asserted, default is 1000 ns
+    :param int hold_ns: How long data is held on the data lines after
+        STROBE is released, default is 500 ns
+    """
+
+    setup_ns: int = 500
+    pulse_ns: int = 1000
+    hold_ns: int = 500
+
+
+class PlaybackStats(NamedTuple):
+    """The timing achieved when playing a pattern with ``GPIOPort.play()``
+
+    :param int steps: The number of steps played
+    :param int elapsed_ns: The time taken, in nanoseconds
+    :param int max_late_ns: The latest any step started after it was due,
+        in nanoseconds
+    :param int total_late_ns: The total time the steps started late, in
+        nanoseconds
+    """
+
+    steps: int
+    elapsed_ns: int
+    max_late_ns: int
+    total_late_ns: int
+
+    @property
+    def mean_late_ns(self) -> float:
+        """The mean time each step started after it was due, in nanoseconds"""
+        return self.total_late_ns / self.steps if self.steps else 0.0
+
+    @property
+    def achieved_rate_hz(self) -> float:
+        """The number of steps played per second"""
+        return self.steps * 1e9 / self.elapsed_ns if self.elapsed_ns else 0.0
+
+
+class JitterStats(NamedTuple):
+    """The scheduling jitter measured with ``RealtimeScope.measure_jitter()``,
+    as how late the thread saw a series of spun-for deadlines
+
+    :param int samples: The number of deadlines
+    :param int max_late_ns: The latest any deadline was seen, in nanoseconds
+    :param int total_late_ns: The total time the deadlines were seen late,
+        in nanoseconds
+    """
+
+    samples: int
+    max_late_ns: int
+    total_late_ns: int
+
+    @property
+    def mean_late_ns(self) -> float:
+        """The mean time each deadline was seen late, in nanoseconds"""
+        return self.total_late_ns / self.samples if self.samples else 0.0
+
+
+class WaitPolicy(NamedTuple):
+    """How waits on the port back off, such as waiting for the BUSY line
+    during SPP transfers.  A wait polls the port continuously for
+    ``spin_ns``, then yields the rest of its time slice between polls for
+    ``yield_ns`` more, and then sleeps for a millisecond between polls
+    until it ends or times out.  Samplers pace themselves with it in
+    reverse, sleeping until only ``spin_ns`` and ``yield_ns`` of each period
+    are left, then yielding until only ``spin_ns`` is left.
+
+    :param int spin_ns: How long to poll without yielding, default is
+        50 microseconds
+    :param int yield_ns: How long to then poll while yielding, default is
+        1 millisecond
+    """
+
+    spin_ns: int = 50000
+    yield_ns: int = 1000000
+
+
+class WaitStats(NamedTuple):
+    """Counters for the waits on the port since they were last reset.  Waits
+    whose condition already held at the first poll are not counted, which
+    keeps the counters off the fast path of the transfers.
+
+    :param int waits: The number of waits
+    :param int timeouts: The number of waits that timed out
+    :param int total_ns: The total time spent waiting, in nanoseconds
+    :param int max_ns: The longest wait, in nanoseconds
+    """
+
+    waits: int = 0
+    timeouts: int = 0
+    total_ns: int = 0
+    max_ns: int = 0
+
+    @property
+    def mean_ns(self) -> float:
+        """The mean time spent per wait, in nanoseconds"""
+        return self.total_ns / self.waits if self.waits else 0.0
+
+
+def set_wait_policy(policy: WaitPolicy) -> None:
+    """Sets how all waits on the port back off
+
+    :param WaitPolicy policy: The policy to use
+    """
+
+    CtypesBackend.set_wait_policy(*policy)
+    if native is not None:
+        native.set_wait_policy(*policy)
+
+
+def get_wait_policy() -> WaitPolicy:
+    """Returns the policy used when waiting on the port
+
+    :rtype: WaitPolicy
+    """
+    return WaitPolicy(*CtypesBackend.get_wait_policy())
+
+
+def wait_stats() -> WaitStats:
+    """Returns the counters for all the waits on the port since they were
+    last reset
+
+    :rtype: WaitStats
+    """
+
+    stats = WaitStats(*CtypesBackend.wait_stats())
+    if native is None:
+        return stats
+    native_stats = WaitStats(*native.wait_stats())
+    return WaitStats(
+        stats.waits + native_stats.waits,
+        stats.timeouts + native_stats.timeouts,
+        stats.total_ns + native_stats.total_ns,
+        max(stats.max_ns, native_stats.max_ns),
+    )
+
+
+def reset_wait_stats() -> None:
+    """Resets the counters for the waits on the port"""
+
+    CtypesBackend.reset_wait_stats()
+    if native is not None:
+        native.reset_wait_stats()
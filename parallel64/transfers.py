@@ -0,0 +1,622 @@
+# SPDX-FileCopyrightText: 2022 Alec Delaney
+#
+# SPDX-License-Identifier: MIT
+
+"""
+`parallel64.transfers`
+
+The ECP FIFO, EPP block and IEEE 1284 reverse-channel transfers of
+``CtypesBackend``, used when the native extension is unavailable
+
+
+* Author(s): Alec Delaney
+
+"""
+
+import struct
+import time
+from typing import Callable, Optional, Tuple, Union
+
+
+class CtypesTransfers:
+    """
+    The ECP FIFO, EPP block and IEEE 1284 reverse-channel transfers of
+    ``CtypesBackend``.  They mirror the ``ecp_*``, ``epp_*`` and
+    ``ieee1284_*`` functions of ``parallel64._native``.
+    """
+
+    # Provided by CtypesBackend
+    DlPortReadPortUchar: Callable[[int], int]
+    DlPortWritePortUchar: Callable[[int, int], None]
+    DlPortReadPortUshort: Callable[[int], int]
+    DlPortWritePortUshort: Callable[[int, int], None]
+    DlPortReadPortUlong: Callable[[int], int]
+    DlPortWritePortUlong: Callable[[int, int], None]
+    write_port_buffer: Callable[..., None]
+    read_port_into: Callable[..., None]
+    wait_port_bits: Callable[[int, int, int, Optional[float]], bool]
+    delay_ns: Callable[[int], None]
+
+    @staticmethod
+    def _check_fifo_config(
+        fifo_depth: int, threshold: int, pword_size: int, length: int
+    ) -> None:
+        """Checks a FIFO configuration and transfer length as the native
+        module does
+
+        :param int fifo_depth: The depth of the FIFO in bytes
+        :param int threshold: The FIFO service threshold in bytes
+        :param int pword_size: The PWord size in bytes
+        :param int length: The length of the transfer in bytes
+        :raises ValueError: If the PWord size is not 1, 2 or 4, or the other
+            sizes are not whole numbers of PWords
+        """
+
+        if pword_size not in (1, 2, 4):
+            raise ValueError("the PWord size must be 1, 2 or 4 bytes")
+        if not 0 < threshold <= fifo_depth:
+            raise ValueError(
+                "FIFO depth and threshold must be positive, with threshold <= depth"
+            )
+        if fifo_depth % pword_size or threshold % pword_size:
+            raise ValueError("FIFO depth and threshold must be whole numbers of PWords")
+        if length % pword_size:
+            raise ValueError("the length must be a whole number of PWords")
+
+    def _write_pwords(self, fifo_port: int, chunk: memoryview, pword_size: int) -> None:
+        """Writes a whole number of PWords to the FIFO, one access per PWord
+
+        :param int fifo_port: The address of the FIFO
+        :param memoryview chunk: The bytes to write
+        :param int pword_size: The PWord size in bytes
+        """
+
+        if pword_size == 1:
+            self.write_port_buffer(fifo_port, chunk)
+            return
+        write_port = (
+            self.DlPortWritePortUlong if pword_size == 4 else self.DlPortWritePortUshort
+        )
+        for value in chunk.cast("I" if pword_size == 4 else "H"):
+            write_port(fifo_port, value)
+
+    def _read_pwords(self, fifo_port: int, chunk: memoryview, pword_size: int) -> None:
+        """Fills the buffer with whole PWords read from the FIFO
+
+        :param int fifo_port: The address of the FIFO
+        :param memoryview chunk: The bytes to fill
+        :param int pword_size: The PWord size in bytes
+        """
+
+        if pword_size == 1:
+            self.read_port_into(fifo_port, chunk)
+            return
+        read_port = (
+            self.DlPortReadPortUlong if pword_size == 4 else self.DlPortReadPortUshort
+        )
+        words = chunk.cast("I" if pword_size == 4 else "H")
+        for index in range(len(words)):
+            words[index] = read_port(fifo_port)
+
+    # pylint: disable=too-many-arguments
+    def _ecp_burst_size(
+        self,
+        ecr_port: int,
+        ready_bit: int,
+        blocked_bit: int,
+        threshold: int,
+        pword_size: int,
+    ) -> Tuple[int, bool]:
+        """Reads the ECR and determines how many bytes can be transferred
+        without checking it again, re-arming serviceIntr if it is set
+
+        :param int ecr_port: The address of the ECR
+        :param int ready_bit: The ECR bit indicating a whole FIFO can be
+            transferred (empty for writes, full for reads)
+        :param int blocked_bit: The ECR bit indicating nothing can be
+            transferred (full for writes, empty for reads)
+        :param int threshold: The FIFO service threshold
+        :param int pword_size: The PWord size, which can always be
+            transferred unless the blocked bit is set
+        :return: Whether a whole FIFO can be transferred, and otherwise the
+            number of bytes that can be
+        :rtype: tuple
+        """
+
+        ecr = self.DlPortReadPortUchar(ecr_port)
+        if ecr & 0b00000100:
+            self.DlPortWritePortUchar(ecr_port, ecr & 0b11110000)
+        if ecr & ready_bit:
+            return 0, True
+        if ecr & 0b00000100:
+            return threshold, False
+        return (0 if ecr & blocked_bit else pword_size), False
+
+    # pylint: disable=too-many-arguments
+    def ecp_write_fifo(
+        self,
+        ecp_base_address: int,
+        data: Union[bytes, bytearray, memoryview],
+        fifo_depth: int,
+        threshold: int,
+        pword_size: int,
+        timeout: Optional[float],
+    ) -> Tuple[int, bool]:
+        """Feed a bytes-like object, a whole number of PWords, into the ECP
+        FIFO in bursts and wait for it to drain
+
+        :param int ecp_base_address: The ECP base address
+        :param data: The data to send
+        :type data: bytes|bytearray|memoryview
+        :param int fifo_depth: The depth of the FIFO in bytes
+        :param int threshold: The FIFO service threshold in bytes
+        :param int pword_size: The PWord size in bytes, which each FIFO
+            access moves and the length must be a whole number of
+        :param float|None timeout: How long the FIFO may stall in seconds, or
+            None to wait indefinitely
+        :return: The number of bytes queued, and whether the transfer
+            completed before the timeout
+        :rtype: tuple
+        """
+
+        view = memoryview(data).cast("B")
+        self._check_fifo_config(fifo_depth, threshold, pword_size, len(view))
+        ecr_port = ecp_base_address + 2
+        self.DlPortWritePortUchar(
+            ecr_port, self.DlPortReadPortUchar(ecr_port) & 0b11110000
+        )
+        sent = 0
+        deadline = None if timeout is None else time.monotonic() + timeout
+        while sent < len(view):
+            burst, whole = self._ecp_burst_size(
+                ecr_port, 0b00000001, 0b00000010, threshold, pword_size
+            )
+            if whole:
+                burst = fifo_depth
+            if not burst:
+                if deadline is not None and time.monotonic() >= deadline:
+                    return sent, False
+                continue
+            chunk = view[sent : sent + burst]
+            self._write_pwords(ecp_base_address, chunk, pword_size)
+            sent += len(chunk)
+            deadline = None if timeout is None else time.monotonic() + timeout
+        while not self.DlPortReadPortUchar(ecr_port) & 0b00000001:
+            if deadline is not None and time.monotonic() >= deadline:
+                return sent, False
+        return sent, True
+
+    # pylint: disable=too-many-arguments
+    def ecp_read_fifo(
+        self,
+        ecp_base_address: int,
+        length: int,
+        fifo_depth: int,
+        threshold: int,
+        pword_size: int,
+        timeout: Optional[float],
+    ) -> Tuple[bytes, bool]:
+        """Read up to the given number of bytes, a whole number of PWords,
+        from the ECP FIFO in bursts
+
+        :param int ecp_base_address: The ECP base address
+        :param int length: The number of bytes to read
+        :param int fifo_depth: The depth of the FIFO in bytes
+        :param int threshold: The FIFO service threshold in bytes
+        :param int pword_size: The PWord size in bytes, which each FIFO
+            access moves and the length must be a whole number of
+        :param float|None timeout: How long the FIFO may stay empty in
+            seconds, or None to wait indefinitely
+        :return: The data read, and whether the transfer completed before
+            the timeout
+        :rtype: tuple
+        """
+
+        buffer = bytearray(length)
+        received, completed = self.ecp_read_fifo_into(
+            ecp_base_address, buffer, fifo_depth, threshold, pword_size, timeout
+        )
+        del buffer[received:]
+        return bytes(buffer), completed
+
+    # pylint: disable=too-many-arguments
+    def ecp_read_fifo_into(
+        self,
+        ecp_base_address: int,
+        buffer: Union[bytearray, memoryview],
+        fifo_depth: int,
+        threshold: int,
+        pword_size: int,
+        timeout: Optional[float],
+    ) -> Tuple[int, bool]:
+        """Fill a buffer, a whole number of PWords, from the ECP FIFO in
+        bursts
+
+        :param int ecp_base_address: The ECP base address
+        :param buffer: The buffer to fill
+        :type buffer: bytearray|memoryview
+        :param int fifo_depth: The depth of the FIFO in bytes
+        :param int threshold: The FIFO service threshold in bytes
+        :param int pword_size: The PWord size in bytes, which each FIFO
+            access moves and the length must be a whole number of
+        :param float|None timeout: How long the FIFO may stay empty in
+            seconds, or None to wait indefinitely
+        :return: The number of bytes read, and whether the transfer
+            completed before the timeout
+        :rtype: tuple
+        """
+
+        view = memoryview(buffer).cast("B")
+        self._check_fifo_config(fifo_depth, threshold, pword_size, len(view))
+        ecr_port = ecp_base_address + 2
+        self.DlPortWritePortUchar(
+            ecr_port, self.DlPortReadPortUchar(ecr_port) & 0b11110000
+        )
+        received = 0
+        deadline = None if timeout is None else time.monotonic() + timeout
+        while received < len(view):
+            burst, whole = self._ecp_burst_size(
+                ecr_port, 0b00000010, 0b00000001, threshold, pword_size
+            )
+            if whole:
+                burst = fifo_depth
+            if not burst:
+                if deadline is not None and time.monotonic() >= deadline:
+                    return received, False
+                continue
+            burst = min(burst, len(view) - received)
+            self._read_pwords(
+                ecp_base_address, view[received : received + burst], pword_size
+            )
+            received += burst
+            deadline = None if timeout is None else time.monotonic() + timeout
+        return received, True
+
+    def epp_write_block(
+        self,
+        epp_data_address: int,
+        data: Union[bytes, bytearray, memoryview],
+        width: int,
+    ) -> None:
+        """Write a bytes-like object to the EPP data register using I/O
+        accesses of up to the given width
+
+        :param int epp_data_address: The address of the EPP data register
+        :param data: The data to write
+        :type data: bytes|bytearray|memoryview
+        :param int width: The widest access to use in bytes (1, 2 or 4)
+        """
+
+        view = memoryview(data).cast("B")
+        offset = 0
+        if width >= 4:
+            for offset in range(0, len(view) - 3, 4):
+                (value,) = struct.unpack_from("<I", view, offset)
+                self.DlPortWritePortUlong(epp_data_address, value)
+            offset = len(view) - len(view) % 4
+        if width >= 2:
+            for offset in range(offset, len(view) - 1, 2):
+                (value,) = struct.unpack_from("<H", view, offset)
+                self.DlPortWritePortUshort(epp_data_address, value)
+            offset = len(view) - len(view) % 2
+        self.write_port_buffer(epp_data_address, view[offset:])
+
+    def epp_read_block(self, epp_data_address: int, length: int, width: int) -> bytes:
+        """Read bytes from the EPP data register using I/O accesses of up to
+        the given width
+
+        :param int epp_data_address: The address of the EPP data register
+        :param int length: The number of bytes to read
+        :param int width: The widest access to use in bytes (1, 2 or 4)
+        :return: The data read
+        :rtype: bytes
+        """
+
+        buffer = bytearray(length)
+        self.epp_read_block_into(epp_data_address, buffer, width)
+        return bytes(buffer)
+
+    def epp_read_block_into(
+        self, epp_data_address: int, buffer: Union[bytearray, memoryview], width: int
+    ) -> None:
+        """Fill a buffer from the EPP data register using I/O accesses of up
+        to the given width
+
+        :param int epp_data_address: The address of the EPP data register
+        :param buffer: The buffer to fill
+        :type buffer: bytearray|memoryview
+        :param int width: The widest access to use in bytes (1, 2 or 4)
+        """
+
+        view = memoryview(buffer).cast("B")
+        offset = 0
+        if width >= 4:
+            for offset in range(0, len(view) - 3, 4):
+                value = self.DlPortReadPortUlong(epp_data_address) & 0xFFFFFFFF
+                struct.pack_into("<I", view, offset, value)
+            offset = len(view) - len(view) % 4
+        if width >= 2:
+            for offset in range(offset, len(view) - 1, 2):
+                value = self.DlPortReadPortUshort(epp_data_address) & 0xFFFF
+                struct.pack_into("<H", view, offset, value)
+            offset = len(view) - len(view) % 2
+        self.read_port_into(epp_data_address, view[offset:])
+
+    def _check_epp_timeout(self, spp_base_address: int) -> bool:
+        """Checks the EPP timeout bit, clearing it if it is set
+
+        :param int spp_base_address: The SPP base address
+        :return: Whether the timeout bit was clear
+        :rtype: bool
+        """
+
+        status_port = spp_base_address + 1
+        status = self.DlPortReadPortUchar(status_port)
+        if not status & 0b00000001:
+            return True
+        self.DlPortWritePortUchar(status_port, status | 0b00000001)
+        self.DlPortWritePortUchar(status_port, status & 0b11111110)
+        return False
+
+    def epp_write_reg(self, spp_base_address: int, address: int, value: int) -> bool:
+        """Do an EPP address write cycle then a data write cycle
+
+        :param int spp_base_address: The SPP base address
+        :param int address: The EPP address
+        :param int value: The value to write
+        :return: Whether the EPP timeout bit stayed clear
+        :rtype: bool
+        """
+
+        self.DlPortWritePortUchar(spp_base_address + 3, address)
+        self.DlPortWritePortUchar(spp_base_address + 4, value)
+        return self._check_epp_timeout(spp_base_address)
+
+    def _epp_read_address(
+        self, spp_base_address: int, address: int, control: Optional[int]
+    ) -> None:
+        """Does the address cycle of an EPP read, then writes the Control
+        register for its data cycles
+
+        :param int spp_base_address: The SPP base address
+        :param int address: The EPP address
+        :param int|None control: The Control register value for the data
+            cycles, or None to leave the Control register alone
+        """
+
+        self.DlPortWritePortUchar(spp_base_address + 3, address)
+        if control is not None:
+            self.DlPortWritePortUchar(spp_base_address + 2, control)
+
+    def epp_read_reg(
+        self, spp_base_address: int, address: int, control: Optional[int]
+    ) -> Tuple[int, bool]:
+        """Do an EPP address write cycle then a data read cycle
+
+        :param int spp_base_address: The SPP base address
+        :param int address: The EPP address
+        :param int|None control: The Control register value to write between
+            the cycles, such as to reverse the port for the data cycle only,
+            or None to leave the Control register alone
+        :return: The value read, and whether the EPP timeout bit stayed clear
+        :rtype: tuple
+        """
+
+        self._epp_read_address(spp_base_address, address, control)
+        value = self.DlPortReadPortUchar(spp_base_address + 4)
+        return value, self._check_epp_timeout(spp_base_address)
+
+    def epp_write_regs(
+        self,
+        spp_base_address: int,
+        address: int,
+        data: Union[bytes, bytearray, memoryview],
+        width: int,
+    ) -> bool:
+        """Do an EPP address write cycle then write a bytes-like object with
+        data write cycles
+
+        :param int spp_base_address: The SPP base address
+        :param int address: The EPP address
+        :param data: The data to write
+        :type data: bytes|bytearray|memoryview
+        :param int width: The widest access to use in bytes (1, 2 or 4)
+        :return: Whether the EPP timeout bit stayed clear
+        :rtype: bool
+        """
+
+        self.DlPortWritePortUchar(spp_base_address + 3, address)
+        self.epp_write_block(spp_base_address + 4, data, width)
+        return self._check_epp_timeout(spp_base_address)
+
+    # pylint: disable=too-many-arguments
+    def epp_read_regs(
+        self,
+        spp_base_address: int,
+        address: int,
+        length: int,
+        width: int,
+        control: Optional[int],
+    ) -> Tuple[bytes, bool]:
+        """Do an EPP address write cycle then read bytes with data read cycles
+
+        :param int spp_base_address: The SPP base address
+        :param int address: The EPP address
+        :param int length: The number of bytes to read
+        :param int width: The widest access to use in bytes (1, 2 or 4)
+        :param int|None control: The Control register value to write between
+            the cycles, as for ``epp_read_reg()``
+        :return: The data read, and whether the EPP timeout bit stayed clear
+        :rtype: tuple
+        """
+
+        self._epp_read_address(spp_base_address, address, control)
+        data = self.epp_read_block(spp_base_address + 4, length, width)
+        return data, self._check_epp_timeout(spp_base_address)
+
+    def epp_read_regs_into(
+        self,
+        spp_base_address: int,
+        address: int,
+        buffer: Union[bytearray, memoryview],
+        width: int,
+        control: Optional[int],
+    ) -> bool:
+        """Do an EPP address write cycle then fill a buffer with data read
+        cycles
+
+        :param int spp_base_address: The SPP base address
+        :param int address: The EPP address
+        :param buffer: The buffer to fill
+        :type buffer: bytearray|memoryview
+        :param int width: The widest access to use in bytes (1, 2 or 4)
+        :param int|None control: The Control register value to write between
+            the cycles, as for ``epp_read_reg()``
+        :return: Whether the EPP timeout bit stayed clear
+        :rtype: bool
+        """
+
+        self._epp_read_address(spp_base_address, address, control)
+        self.epp_read_block_into(spp_base_address + 4, buffer, width)
+        return self._check_epp_timeout(spp_base_address)
+
+    def ieee1284_negotiate(
+        self, spp_base_address: int, extensibility: int, timeout: Optional[float]
+    ) -> Tuple[bool, int]:
+        """Request an IEEE 1284 mode with the extensibility byte
+
+        :param int spp_base_address: The SPP base address
+        :param int extensibility: The extensibility byte of the mode
+        :param float|None timeout: How long to wait for each step of the
+            handshake in seconds, or None to wait indefinitely
+        :return: Whether the peripheral answered before the timeout, and the
+            Status register once it did, whose Select bit is the XFlag
+        :rtype: tuple
+        """
+
+        status_port = spp_base_address + 1
+        control_port = spp_base_address + 2
+        self.DlPortWritePortUchar(spp_base_address, extensibility)
+        self.DlPortWritePortUchar(control_port, 0b00000110)
+        if not self.wait_port_bits(status_port, 0b01111000, 0b00111000, timeout):
+            status = self.DlPortReadPortUchar(status_port)
+            self.DlPortWritePortUchar(control_port, 0b00001100)
+            return False, status
+        self.DlPortWritePortUchar(control_port, 0b00000111)
+        self.delay_ns(1000)
+        self.DlPortWritePortUchar(control_port, 0b00000100)
+        answered = self.wait_port_bits(status_port, 0b01000000, 0b01000000, timeout)
+        status = self.DlPortReadPortUchar(status_port)
+        if not answered:
+            self.DlPortWritePortUchar(control_port, 0b00001100)
+        return answered, status
+
+    def ieee1284_terminate(
+        self, spp_base_address: int, timeout: Optional[float]
+    ) -> bool:
+        """Return the peripheral to compatibility mode
+
+        :param int spp_base_address: The SPP base address
+        :param float|None timeout: How long to wait for each step of the
+            handshake in seconds, or None to wait indefinitely
+        :return: Whether the peripheral followed the handshake before the
+            timeout
+        :rtype: bool
+        """
+
+        status_port = spp_base_address + 1
+        control_port = spp_base_address + 2
+        self.DlPortWritePortUchar(control_port, 0b00001100)
+        if not self.wait_port_bits(status_port, 0b01000000, 0, timeout):
+            return False
+        self.DlPortWritePortUchar(control_port, 0b00001110)
+        completed = self.wait_port_bits(status_port, 0b01000000, 0b01000000, timeout)
+        self.DlPortWritePortUchar(control_port, 0b00001100)
+        return completed
+
+    def ieee1284_nibble_read_into(
+        self,
+        spp_base_address: int,
+        buffer: Union[bytearray, memoryview],
+        timeout: Optional[float],
+    ) -> Tuple[int, bool]:
+        """Fill a buffer using nibble mode, stopping early if the peripheral
+        has no more data
+
+        :param int spp_base_address: The SPP base address
+        :param buffer: The buffer to fill
+        :type buffer: bytearray|memoryview
+        :param float|None timeout: How long to wait for each step of the
+            handshake in seconds, or None to wait indefinitely
+        :return: The number of bytes read, and whether the peripheral kept to
+            the handshake timeout
+        :rtype: tuple
+        """
+
+        return self._ieee1284_read_into(spp_base_address, buffer, timeout, False)
+
+    def ieee1284_byte_read_into(
+        self,
+        spp_base_address: int,
+        buffer: Union[bytearray, memoryview],
+        timeout: Optional[float],
+    ) -> Tuple[int, bool]:
+        """Fill a buffer using byte mode, stopping early if the peripheral has
+        no more data
+
+        :param int spp_base_address: The SPP base address
+        :param buffer: The buffer to fill
+        :type buffer: bytearray|memoryview
+        :param float|None timeout: How long to wait for each step of the
+            handshake in seconds, or None to wait indefinitely
+        :return: The number of bytes read, and whether the peripheral kept to
+            the handshake timeout
+        :rtype: tuple
+        """
+
+        return self._ieee1284_read_into(spp_base_address, buffer, timeout, True)
+
+    def _ieee1284_read_into(
+        self,
+        spp_base_address: int,
+        buffer: Union[bytearray, memoryview],
+        timeout: Optional[float],
+        byte_mode: bool,
+    ) -> Tuple[int, bool]:
+        """Runs the reverse-channel handshake for each byte of the buffer,
+        reading a byte from the data lines in byte mode or two nibbles from
+        the status lines (low nibble first) in nibble mode
+        """
+
+        read_port = self.DlPortReadPortUchar
+        write_port = self.DlPortWritePortUchar
+        wait = self.wait_port_bits
+        status_port = spp_base_address + 1
+        control_port = spp_base_address + 2
+        idle = 0b00100100 if byte_mode else 0b00000100
+        shifts = (0,) if byte_mode else (0, 4)
+        view = memoryview(buffer).cast("B")
+        write_port(control_port, idle)
+        for index in range(len(view)):
+            if read_port(status_port) & 0b00001000:
+                return index, True
+            value = 0
+            for shift in shifts:
+                write_port(control_port, idle | 0b00000010)
+                if not wait(status_port, 0b01000000, 0, timeout):
+                    write_port(control_port, idle)
+                    return index, False
+                if byte_mode:
+                    value = read_port(spp_base_address)
+                else:
+                    status = read_port(status_port)
+                    value |= ((status >> 3) & 0x07 | (~status >> 4) & 0x08) << shift
+                write_port(control_port, idle)
+                if not wait(status_port, 0b01000000, 0b01000000, timeout):
+                    return index, False
+            if byte_mode:
+                write_port(control_port, idle | 0b00000001)
+                self.delay_ns(1000)
+                write_port(control_port, idle)
+            view[index] = value
+        return len(view), True
@@ -0,0 +1,311 @@
+# SPDX-FileCopyrightText: 2022 Alec Delaney
+#
+# SPDX-License-Identifier: MIT
+
+"""
+`parallel64.watcher`
+
+Change notifications for the input pins of a port, served by a single
+sampler per port however many pins are watched
+
+
+* Author(s): Alec Delaney
+
+"""
+
+import struct
+import threading
+import traceback
+from typing import TYPE_CHECKING, Callable, Dict, List, Literal, Optional, Tuple
+from parallel64.pins import Pin
+from parallel64.sampler import SAMPLE_FORMAT, InputSampler, SamplerChannel
+
+if TYPE_CHECKING:
+    from parallel64.gpio import GPIOPort
+
+Edge = Literal["rising", "falling", "both"]
+
+PinCallback = Callable[[Pin, bool, int], None]
+
+# A worker thread and its sampler, detached by PinWatcher._stop()
+_Stopped = Tuple[threading.Thread, InputSampler]
+
+
+class Subscription:
+    """A callback registered with ``GPIOPort.on_change()``
+
+    :param PinWatcher watcher: The watcher serving the subscription
+    :param Pin pin: The pin being watched
+    :param callback: The function called with the pin, its new state and the
+        timestamp of the change in nanoseconds
+    :param str edge: Which changes to report: "rising", "falling" or "both"
+    :param int debounce_ns: How long a new state must be stable before it
+        is reported, in nanoseconds
+    :param bool state: The current state of the pin
+    """
+
+    # pylint: disable=too-many-arguments
+    def __init__(
+        self,
+        watcher: "PinWatcher",
+        pin: Pin,
+        callback: PinCallback,
+        edge: Edge,
+        debounce_ns: int,
+        state: bool,
+    ) -> None:
+        self._watcher = watcher
+        self.pin = pin
+        self.callback = callback
+        self._report_rising = edge in ("rising", "both")
+        self._report_falling = edge in ("falling", "both")
+        self._debounce_ns = debounce_ns
+        self._stable = state
+        self._candidate = state
+        self._candidate_since = 0
+
+    @property
+    def settling(self) -> bool:
+        """Whether the pin has changed but not yet been stable for the
+        debounce time
+        """
+        return self._candidate != self._stable
+
+    def _reset(self) -> None:
+        """Discards a change that is still settling, for when the timestamps
+        of the samples restart
+        """
+        self._candidate = self._stable
+
+    def cancel(self) -> None:
+        """Stops calling the callback"""
+        self._watcher.unsubscribe(self)
+
+    def _update(self, register_byte: int, timestamp_ns: int) -> None:
+        """Updates the subscription with a sample of its register, calling
+        the callback if an accepted change is reported
+
+        :param int register_byte: The sampled value of the pin's register
+        :param int timestamp_ns: The time of the sample in nanoseconds
+        """
+
+        pin = self.pin
+        value = bool((register_byte ^ pin.inversion_mask) & pin.bit_mask)
+        if value != self._candidate:
+            self._candidate = value
+            self._candidate_since = timestamp_ns
+        if self._candidate == self._stable:
+            return
+        if timestamp_ns - self._candidate_since < self._debounce_ns:
+            return
+        self._stable = self._candidate
+        if self._report_rising if self._stable else self._report_falling:
+            try:
+                self.callback(pin, self._stable, timestamp_ns)
+            except Exception:  # pylint: disable=broad-except
+                traceback.print_exc()
+
+
+class PinWatcher:
+    """
+    Serves the ``GPIOPort.on_change()`` subscriptions of a port.  A single
+    sampler reads each register that has a watched pin once per period, and
+    a worker thread drains it and calls the callbacks, so any number of
+    pins on a register cost one read per period.  The sampler paces itself
+    with the wait policy, so the CPU it uses grows as the period shrinks,
+    see ``GPIOPort.watch_period_us``.
+
+    :param GPIOPort port: The port to watch
+    :param int period_ns: The time between samples in nanoseconds
+    """
+
+    _DRAIN_INTERVAL = 0.001
+
+    def __init__(self, port: "GPIOPort", period_ns: int) -> None:
+        self._port = port
+        self._period_ns = period_ns
+        self._lock = threading.Lock()
+        self._subscriptions: Dict[int, List[Subscription]] = {}
+        self._watched: Tuple[Tuple[int, int, Tuple[Subscription, ...]], ...] = ()
+        self._sampler: Optional[InputSampler] = None
+        self._channels = SamplerChannel(0)
+        self._thread: Optional[threading.Thread] = None
+        self._stop_requested = threading.Event()
+        self._sample_indices = {
+            port._spp_data_address: 1,  # pylint: disable=protected-access
+            port._status_address: 2,  # pylint: disable=protected-access
+            port._control_address: 3,  # pylint: disable=protected-access
+        }
+        self._register_channels = dict(
+            zip(
+                self._sample_indices,
+                (SamplerChannel.DATA, SamplerChannel.STATUS, SamplerChannel.CONTROL),
+            )
+        )
+
+    @property
+    def running(self) -> bool:
+        """Whether the worker thread is running"""
+        return self._thread is not None
+
+    def subscribe(
+        self, pin: Pin, callback: PinCallback, edge: Edge, debounce_ns: int
+    ) -> Subscription:
+        """Registers a callback for changes of a pin, starting the worker
+        thread if needed
+
+        :param Pin pin: The pin to watch
+        :param callback: The function to call
+        :param str edge: Which changes to report
+        :param int debounce_ns: The debounce time in nanoseconds
+        :rtype: Subscription
+        """
+
+        state = self._port.read_pin(pin)
+        subscription = Subscription(self, pin, callback, edge, debounce_ns, state)
+        stopped = None
+        with self._lock:
+            self._subscriptions.setdefault(pin.register, []).append(subscription)
+            self._update_watched()
+            channels = self._channels | self._register_channels[pin.register]
+            if channels != self._channels or self._thread is None:
+                stopped = self._restart(channels)
+        self._join(stopped)
+        return subscription
+
+    def unsubscribe(self, subscription: Subscription) -> None:
+        """Removes a subscription, stopping the worker thread if it was the
+        last one
+
+        :param Subscription subscription: The subscription to remove
+        """
+
+        stopped = None
+        with self._lock:
+            register = subscription.pin.register
+            register_subscriptions = self._subscriptions.get(register, [])
+            if subscription in register_subscriptions:
+                register_subscriptions.remove(subscription)
+            if not register_subscriptions:
+                self._subscriptions.pop(register, None)
+            self._update_watched()
+            if not self._subscriptions:
+                stopped = self._stop()
+        self._join(stopped)
+
+    def set_period(self, period_ns: int) -> None:
+        """Changes the time between samples, restarting sampling if any pin
+        is watched
+
+        :param int period_ns: The time between samples in nanoseconds
+        """
+
+        stopped = None
+        with self._lock:
+            self._period_ns = period_ns
+            if self._thread is not None:
+                stopped = self._restart(self._channels)
+        self._join(stopped)
+
+    def stop(self) -> None:
+        """Removes every subscription and stops the worker thread"""
+
+        with self._lock:
+            self._subscriptions.clear()
+            self._update_watched()
+            stopped = self._stop()
+        self._join(stopped)
+
+    def _update_watched(self) -> None:
+        """Replaces the snapshot of the subscriptions the worker thread
+        dispatches to, which must be called with the lock held.  The worker
+        only reads the snapshot, so it never needs the lock.
+        """
+
+        self._watched = tuple(
+            (register, self._sample_indices[register], tuple(subscriptions))
+            for register, subscriptions in self._subscriptions.items()
+        )
+
+    def _restart(self, channels: SamplerChannel) -> Optional[_Stopped]:
+        """Restarts sampling with the given channels, which must be called
+        with the lock held
+
+        :param SamplerChannel channels: The registers to sample
+        :return: The previous worker thread and sampler, to pass to
+            ``_join()`` once the lock is released
+        """
+
+        stopped = self._stop()
+        for subscriptions in self._subscriptions.values():
+            for subscription in subscriptions:
+                subscription._reset()  # pylint: disable=protected-access
+        self._channels = channels
+        self._sampler = self._port.create_sampler(channels, period_ns=self._period_ns)
+        self._stop_requested = threading.Event()
+        self._sampler.start()
+        self._thread = threading.Thread(
+            target=self._run, args=(self._sampler, self._stop_requested), daemon=True
+        )
+        self._thread.start()
+        return stopped
+
+    def _stop(self) -> Optional[_Stopped]:
+        """Asks the worker thread to stop and detaches it and its sampler,
+        which must be called with the lock held
+
+        :return: The worker thread and sampler, to pass to ``_join()`` once
+            the lock is released, or None if there were none
+        """
+
+        if self._thread is None:
+            return None
+        self._stop_requested.set()
+        stopped = (self._thread, self._sampler)
+        self._thread = None
+        self._sampler = None
+        self._channels = SamplerChannel(0)
+        return stopped
+
+    @staticmethod
+    def _join(stopped: Optional[_Stopped]) -> None:
+        """Waits for a detached worker thread to finish, then stops its
+        sampler.  Must be called without the lock held, so a worker that
+        is running a callback which changes the subscriptions can finish.
+
+        :param stopped: The return value of ``_stop()`` or ``_restart()``
+        """
+
+        if stopped is None:
+            return
+        thread, sampler = stopped
+        if thread is not threading.current_thread():
+            thread.join()
+        sampler.stop()
+
+    def _run(self, sampler: InputSampler, stop_requested: threading.Event) -> None:
+        """Drains the sampler and dispatches changes until asked to stop
+
+        :param InputSampler sampler: The sampler to drain
+        :param threading.Event stop_requested: Set when the thread should stop
+        """
+
+        last_bytes: Dict[int, Optional[int]] = {}
+        while not stop_requested.wait(self._DRAIN_INTERVAL):
+            records = sampler.drain()
+            if not records or stop_requested.is_set():
+                continue
+            watched = self._watched
+            for record in struct.iter_unpack(SAMPLE_FORMAT, records):
+                timestamp_ns = record[0]
+                for register, index, subscriptions in watched:
+                    register_byte = record[index]
+                    if register_byte == last_bytes.get(register) and not any(
+                        subscription.settling for subscription in subscriptions
+                    ):
+                        continue
+                    last_bytes[register] = register_byte
+                    for subscription in subscriptions:
+                        subscription._update(  # pylint: disable=protected-access
+                            register_byte, timestamp_ns
+                        )
@@ -9,14 +9,61 @@ https://packaging.python.org/en/latest/distributing.html
 https://github.com/pypa/sampleproject
 """
 
-from setuptools import setup, find_packages
+import sys
+from setuptools import setup, find_packages, Extension
 
 # To use a consistent encoding
 from codecs import open
-from os import path
+from os import environ, path
 
 here = path.abspath(path.dirname(__file__))
 
+# The native extension links against the InpOut import library, so it can
+# only be built on Windows.  It is optional, and parallel64 falls back to
+# ctypes if it fails to build.
+ext_modules = []
+if sys.platform == "win32":
+    # Set PARALLEL64_METRICS to build with the register access metrics,
+    # which time every access
+    define_macros = []
+    if environ.get("PARALLEL64_METRICS"):
+        define_macros.append(("PARALLEL64_METRICS", "1"))
+    if sys.maxsize > 2**32:
+        inpout_arch, inpout_lib = "x64", "inpoutx64"
+    else:
+        inpout_arch, inpout_lib = "Win32", "inpout32"
+    ext_modules.append(
+        Extension(
+            "parallel64._native",
+            sources=[
+                "src/module.cpp",
+                "src/completer.cpp",
+                "src/direct.cpp",
+                "src/ecp.cpp",
+                "src/epp.cpp",
+                "src/ieee1284.cpp",
+                "src/metrics.cpp",
+                "src/mmio.cpp",
+                "src/pattern.cpp",
+                "src/program.cpp",
+                "src/sampler.cpp",
+                "src/shift.cpp",
+                "src/spp.cpp",
+                "src/stream.cpp",
+                "src/thread.cpp",
+                "src/timing.cpp",
+                "src/wait.cpp",
+            ],
+            include_dirs=["InpOutBinaries_1501/x64"],
+            library_dirs=[path.join("InpOutBinaries_1501", inpout_arch)],
+            libraries=[inpout_lib, "avrt", "winmm"],
+            define_macros=define_macros,
+            extra_compile_args=["/std:c++17", "/O2"],
+            language="c++",
+            optional=True,
+        )
+    )
+
 # Get the long description from the README file
 with open(path.join(here, "README.rst"), encoding="utf-8") as f:
     long_description = f.read()
@@ -48,4 +95,5 @@ setup(
     # You can just specify the packages manually here if your project is
     # simple. Or you can use find_packages().
     packages=["parallel64"],
+    ext_modules=ext_modules,
 )
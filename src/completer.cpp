@@ -0,0 +1,529 @@
+// SPDX-FileCopyrightText: 2022 Alec Delaney
+//
+// SPDX-License-Identifier: MIT
+
+// A single background thread that completes port operations for asyncio.
+//
+// Each operation is a small state machine that the thread advances without
+// blocking on the peripheral, so one thread can poll any number of ports.
+// When the thread has nothing to do it backs off as set by the wait policy.
+// Finished operations are handed back by taking the GIL and calling each
+// operation's callback with its result, or with None if it was cancelled.
+
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "epp.hpp"
+#include "io.hpp"
+#include "module.hpp"
+#include "pyutil.hpp"
+#include "registers.hpp"
+#include "spp.hpp"
+#include "wait.hpp"
+
+namespace parallel64 {
+
+namespace {
+
+// The most bytes an SPP write sends in one step, so that one fast
+// peripheral cannot starve the operations on other ports
+constexpr std::size_t SPP_BURST = 64;
+
+enum class Progress { WAITING, PROGRESSED, FINISHED };
+
+// Operations are created and destroyed with the GIL held, and stepped by the
+// completion thread without it
+class Operation {
+  public:
+    explicit Operation(PyObject *callback) : callback_(callback) {
+        Py_INCREF(callback_);
+    }
+
+    Operation(const Operation &) = delete;
+    Operation &operator=(const Operation &) = delete;
+
+    virtual ~Operation() {
+        Py_DECREF(callback_);
+    }
+
+    virtual Progress step() = 0;
+
+    // Returns a new reference to the result, called with the GIL held
+    virtual PyObject *result() = 0;
+
+    PyObject *callback() const {
+        return callback_;
+    }
+
+    std::uint64_t id = 0;
+    bool cancelled = false;
+
+  private:
+    PyObject *callback_;
+};
+
+class WaitBitsOperation : public Operation {
+  public:
+    WaitBitsOperation(PyObject *callback, std::uint16_t port, std::uint8_t mask,
+                      std::uint8_t value, double timeout)
+        : Operation(callback), port_(port), mask_(mask), value_(value), deadline_(timeout),
+          start_(Clock::now()) {}
+
+    Progress step() override {
+        const bool first_poll = first_poll_;
+        first_poll_ = false;
+        if ((io::read8(port_) & mask_) == value_) {
+            matched_ = true;
+        } else if (deadline_.expired()) {
+            matched_ = (io::read8(port_) & mask_) == value_;
+        } else {
+            return Progress::WAITING;
+        }
+        // As with wait_bits(), a wait its first poll satisfied is not counted
+        if (!first_poll) {
+            record_wait(Clock::now() - start_, matched_);
+        }
+        return Progress::FINISHED;
+    }
+
+    PyObject *result() override {
+        return PyBool_FromLong(matched_);
+    }
+
+  private:
+    std::uint16_t port_;
+    std::uint8_t mask_;
+    std::uint8_t value_;
+    Deadline deadline_;
+    Clock::time_point start_;
+    bool first_poll_ = true;
+    bool matched_ = false;
+};
+
+class SppWriteOperation : public Operation {
+  public:
+    SppWriteOperation(PyObject *callback, std::uint16_t base, std::uint8_t control,
+                      double timeout, bool hold_while_busy, const StrobeTiming &timing)
+        : Operation(callback), ports_(base), control_(control), timeout_(timeout),
+          hold_while_busy_(hold_while_busy), timing_(timing), deadline_(timeout) {}
+
+    Progress step() override {
+        bool progressed = false;
+        for (std::size_t burst = 0; burst < SPP_BURST; ++burst) {
+            if (sent_ == data.size() && !hold_while_busy_) {
+                completed_ = true;
+                return Progress::FINISHED;
+            }
+            if (!(io::read8(ports_.status) & reg::STATUS_NOT_BUSY)) {
+                if (deadline_.expired()) {
+                    return Progress::FINISHED;
+                }
+                return progressed ? Progress::PROGRESSED : Progress::WAITING;
+            }
+            if (sent_ == data.size()) {
+                completed_ = true;
+                return Progress::FINISHED;
+            }
+            strobe_byte(ports_, control_, data.data()[sent_], timing_);
+            ++sent_;
+            deadline_ = Deadline(timeout_);
+            progressed = true;
+        }
+        return Progress::PROGRESSED;
+    }
+
+    PyObject *result() override {
+        return Py_BuildValue("(nO)", static_cast<Py_ssize_t>(sent_),
+                             completed_ ? Py_True : Py_False);
+    }
+
+    py::Buffer data;
+
+  private:
+    SppPorts ports_;
+    std::uint8_t control_;
+    double timeout_;
+    bool hold_while_busy_;
+    StrobeTiming timing_;
+    Deadline deadline_;
+    std::size_t sent_ = 0;
+    bool completed_ = false;
+};
+
+class EppWriteRegsOperation : public Operation {
+  public:
+    EppWriteRegsOperation(PyObject *callback, std::uint16_t base, std::uint8_t address,
+                          std::size_t width)
+        : Operation(callback), ports_(base), address_(address), width_(width) {}
+
+    Progress step() override {
+        io::write8(ports_.address, address_);
+        write_block(ports_.data, data.data(), data.size(), width_);
+        completed_ = check_timeout(ports_);
+        return Progress::FINISHED;
+    }
+
+    PyObject *result() override {
+        return PyBool_FromLong(completed_);
+    }
+
+    py::Buffer data;
+
+  private:
+    EppPorts ports_;
+    std::uint8_t address_;
+    std::size_t width_;
+    bool completed_ = false;
+};
+
+class EppReadRegsOperation : public Operation {
+  public:
+    // Takes ownership of the reference to the bytes object to fill
+    EppReadRegsOperation(PyObject *callback, std::uint16_t base, std::uint8_t address,
+                         PyObject *data, std::size_t width, DataControl control)
+        : Operation(callback),
+          ports_(base),
+          address_(address),
+          data_(data),
+          width_(width),
+          control_(control) {}
+
+    ~EppReadRegsOperation() override {
+        Py_DECREF(data_);
+    }
+
+    // The bytes object is not visible to Python until the result is built,
+    // so it can be filled without the GIL
+    Progress step() override {
+        write_read_address(ports_, address_, control_);
+        read_block(ports_.data, reinterpret_cast<std::uint8_t *>(PyBytes_AS_STRING(data_)),
+                   static_cast<std::size_t>(PyBytes_GET_SIZE(data_)), width_);
+        completed_ = check_timeout(ports_);
+        return Progress::FINISHED;
+    }
+
+    PyObject *result() override {
+        return Py_BuildValue("(OO)", data_, completed_ ? Py_True : Py_False);
+    }
+
+  private:
+    EppPorts ports_;
+    std::uint8_t address_;
+    PyObject *data_;
+    std::size_t width_;
+    DataControl control_;
+    bool completed_ = false;
+};
+
+using OperationList = std::vector<std::unique_ptr<Operation>>;
+
+class Completer {
+  public:
+    // Called with the GIL held
+    std::uint64_t submit(std::unique_ptr<Operation> operation) {
+        std::uint64_t id;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!thread_.joinable()) {
+                stop_requested_ = false;
+                thread_ = std::thread(&Completer::run, this);
+            }
+            id = next_id_++;
+            operation->id = id;
+            incoming_.push_back(std::move(operation));
+            ++pending_;
+        }
+        wake_.notify_one();
+        return id;
+    }
+
+    void cancel(std::uint64_t id) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cancels_.push_back(id);
+        }
+        wake_.notify_one();
+    }
+
+    std::size_t pending() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pending_;
+    }
+
+    // Called with the GIL held, which is released while the thread finishes
+    // so it can hand back the operations it cancels
+    void shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!thread_.joinable()) {
+                return;
+            }
+            stop_requested_ = true;
+        }
+        wake_.notify_one();
+        Py_BEGIN_ALLOW_THREADS
+        thread_.join();
+        Py_END_ALLOW_THREADS
+    }
+
+  private:
+    void run() {
+        OperationList active;
+        OperationList finished;
+        std::vector<std::uint64_t> cancels;
+        auto idle_since = Clock::now();
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                if (active.empty()) {
+                    wake_.wait(lock, [this] { return stop_requested_ || !incoming_.empty(); });
+                }
+                if (!incoming_.empty()) {
+                    idle_since = Clock::now();
+                }
+                for (auto &operation : incoming_) {
+                    active.push_back(std::move(operation));
+                }
+                incoming_.clear();
+                cancels.swap(cancels_);
+                if (stop_requested_) {
+                    break;
+                }
+            }
+            bool progressed = false;
+            for (auto it = active.begin(); it != active.end();) {
+                Operation &operation = **it;
+                operation.cancelled =
+                    std::find(cancels.begin(), cancels.end(), operation.id) != cancels.end();
+                const Progress progress =
+                    operation.cancelled ? Progress::FINISHED : operation.step();
+                if (progress == Progress::FINISHED) {
+                    finished.push_back(std::move(*it));
+                    it = active.erase(it);
+                    progressed = true;
+                    continue;
+                }
+                progressed = progressed || progress == Progress::PROGRESSED;
+                ++it;
+            }
+            cancels.clear();
+            if (!finished.empty()) {
+                complete(finished);
+            }
+            if (progressed) {
+                idle_since = Clock::now();
+            } else if (!active.empty()) {
+                back_off(Clock::now() - idle_since);
+            }
+        }
+        for (auto &operation : active) {
+            operation->cancelled = true;
+        }
+        complete(active);
+    }
+
+    void back_off(Clock::duration idle) {
+        const WaitPolicy policy = wait_policy();
+        const auto spin = std::chrono::nanoseconds(policy.spin_ns);
+        if (idle < spin) {
+            return;
+        }
+        if (idle < spin + std::chrono::nanoseconds(policy.yield_ns)) {
+            SwitchToThread();
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait_for(lock, std::chrono::milliseconds(1), [this] {
+            return stop_requested_ || !incoming_.empty() || !cancels_.empty();
+        });
+    }
+
+    // Calls the callbacks of the finished operations and destroys them
+    void complete(OperationList &operations) {
+        if (operations.empty()) {
+            return;
+        }
+        const PyGILState_STATE state = PyGILState_Ensure();
+        for (auto &operation : operations) {
+            PyObject *result = nullptr;
+            if (operation->cancelled) {
+                Py_INCREF(Py_None);
+                result = Py_None;
+            } else {
+                result = operation->result();
+            }
+            PyObject *returned = nullptr;
+            if (result != nullptr) {
+                returned = PyObject_CallFunctionObjArgs(operation->callback(), result, nullptr);
+                Py_DECREF(result);
+            }
+            if (returned == nullptr) {
+                PyErr_WriteUnraisable(operation->callback());
+            }
+            Py_XDECREF(returned);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_ -= operations.size();
+        }
+        operations.clear();
+        PyGILState_Release(state);
+    }
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    OperationList incoming_;
+    std::vector<std::uint64_t> cancels_;
+    std::size_t pending_ = 0;
+    std::uint64_t next_id_ = 1;
+    bool stop_requested_ = false;
+    std::thread thread_;
+};
+
+// Never destroyed, since its thread must be shut down while Python is still
+// running rather than by a static destructor
+Completer &completer() {
+    static Completer *instance = new Completer();
+    return *instance;
+}
+
+bool check_callback(PyObject *callback) {
+    if (!PyCallable_Check(callback)) {
+        PyErr_SetString(PyExc_TypeError, "the callback must be callable");
+        return false;
+    }
+    return true;
+}
+
+PyObject *submit(std::unique_ptr<Operation> operation) {
+    return PyLong_FromUnsignedLongLong(completer().submit(std::move(operation)));
+}
+
+PyObject *submit_wait_bits(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t port;
+    std::uint8_t mask, value;
+    double timeout;
+    if (!py::check_nargs("submit_wait_bits", nargs, 5) || !py::to_u16(args[0], port) ||
+        !py::to_u8(args[1], mask) || !py::to_u8(args[2], value) ||
+        !py::to_timeout(args[3], timeout) || !check_callback(args[4])) {
+        return nullptr;
+    }
+    return submit(std::make_unique<WaitBitsOperation>(args[4], port, mask, value, timeout));
+}
+
+PyObject *submit_spp_write(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t base;
+    std::uint8_t control;
+    double timeout;
+    StrobeTiming timing;
+    if (!py::check_nargs("submit_spp_write", nargs, 9) || !py::to_u16(args[0], base) ||
+        !py::to_u8(args[1], control) || !py::to_timeout(args[3], timeout) ||
+        !parse_timing(args + 5, timing) || !check_callback(args[8])) {
+        return nullptr;
+    }
+    const int hold_while_busy = PyObject_IsTrue(args[4]);
+    if (hold_while_busy < 0) {
+        return nullptr;
+    }
+    auto operation = std::make_unique<SppWriteOperation>(
+        args[8], base, control & ~reg::CONTROL_STROBE, timeout, hold_while_busy != 0, timing);
+    if (!operation->data.acquire(args[2])) {
+        return nullptr;
+    }
+    return submit(std::move(operation));
+}
+
+PyObject *submit_epp_write_regs(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t base;
+    std::uint8_t address;
+    std::size_t width;
+    if (!py::check_nargs("submit_epp_write_regs", nargs, 5) || !py::to_u16(args[0], base) ||
+        !py::to_u8(args[1], address) || !parse_width(args[3], width) ||
+        !check_callback(args[4])) {
+        return nullptr;
+    }
+    auto operation = std::make_unique<EppWriteRegsOperation>(args[4], base, address, width);
+    if (!operation->data.acquire(args[2])) {
+        return nullptr;
+    }
+    return submit(std::move(operation));
+}
+
+PyObject *submit_epp_read_regs(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t base;
+    std::uint8_t address;
+    std::size_t length, width;
+    DataControl control;
+    if (!py::check_nargs("submit_epp_read_regs", nargs, 6) || !py::to_u16(args[0], base) ||
+        !py::to_u8(args[1], address) || !py::to_size(args[2], length) ||
+        !parse_width(args[3], width) || !parse_data_control(args[4], control) ||
+        !check_callback(args[5])) {
+        return nullptr;
+    }
+    PyObject *data = PyBytes_FromStringAndSize(nullptr, static_cast<Py_ssize_t>(length));
+    if (data == nullptr) {
+        return nullptr;
+    }
+    return submit(
+        std::make_unique<EppReadRegsOperation>(args[5], base, address, data, width, control));
+}
+
+PyObject *cancel_operation(PyObject *, PyObject *arg) {
+    const unsigned long long id = PyLong_AsUnsignedLongLong(arg);
+    if (id == static_cast<unsigned long long>(-1) && PyErr_Occurred()) {
+        return nullptr;
+    }
+    completer().cancel(id);
+    Py_RETURN_NONE;
+}
+
+PyObject *pending_operations(PyObject *, PyObject *) {
+    return PyLong_FromSize_t(completer().pending());
+}
+
+PyObject *shutdown_completer(PyObject *, PyObject *) {
+    completer().shutdown();
+    Py_RETURN_NONE;
+}
+
+}  // namespace
+
+PyMethodDef completer_methods[] = {
+    {"submit_wait_bits", reinterpret_cast<PyCFunction>(submit_wait_bits), METH_FASTCALL,
+     "submit_wait_bits(port, mask, value, timeout, callback)\n--\n\n"
+     "Poll the port on the completion thread until the masked bits equal the\n"
+     "value, then call callback with whether they did before the timeout.\n"
+     "Returns the operation's id."},
+    {"submit_spp_write", reinterpret_cast<PyCFunction>(submit_spp_write), METH_FASTCALL,
+     "submit_spp_write(base_address, control, data, timeout, hold_while_busy,\n"
+     "                 setup_ns, pulse_ns, hold_ns, callback)\n--\n\n"
+     "Send a bytes-like object using the SPP handshake on the completion\n"
+     "thread, then call callback with the result spp_write_buffer() returns.\n"
+     "Returns the operation's id."},
+    {"submit_epp_write_regs", reinterpret_cast<PyCFunction>(submit_epp_write_regs),
+     METH_FASTCALL,
+     "submit_epp_write_regs(base_address, address, data, width, callback)\n--\n\n"
+     "Run epp_write_regs() on the completion thread, then call callback with\n"
+     "its result.  Returns the operation's id."},
+    {"submit_epp_read_regs", reinterpret_cast<PyCFunction>(submit_epp_read_regs), METH_FASTCALL,
+     "submit_epp_read_regs(base_address, address, length, width, control, callback)\n--\n\n"
+     "Run epp_read_regs() on the completion thread, then call callback with\n"
+     "its result.  Returns the operation's id."},
+    {"cancel_operation", cancel_operation, METH_O,
+     "cancel_operation(id)\n--\n\n"
+     "Stop an operation, whose callback is then called with None.  Operations\n"
+     "that have already finished are unaffected."},
+    {"pending_operations", pending_operations, METH_NOARGS,
+     "pending_operations()\n--\n\nReturn the number of operations that have not finished."},
+    {"shutdown_completer", shutdown_completer, METH_NOARGS,
+     "shutdown_completer()\n--\n\n"
+     "Stop the completion thread, cancelling the operations still running.  It\n"
+     "is started again by the next operation."},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+}  // namespace parallel64
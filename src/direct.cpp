@@ -0,0 +1,82 @@
+// SPDX-FileCopyrightText: 2022 Alec Delaney
+//
+// SPDX-License-Identifier: MIT
+
+// Selection of direct port I/O, using the in and out instructions from user
+// space for ports the process has I/O privilege for, such as granted by a
+// helper driver setting the TSS I/O permission bitmap.  Ports without it
+// keep using the InpOut driver.
+
+#include "io.hpp"
+#include "module.hpp"
+#include "pyutil.hpp"
+
+namespace parallel64 {
+
+namespace {
+
+// Reads the port with the in instruction, returning false instead of
+// faulting if the process does not have I/O privilege for it.  Structured
+// exception handling cannot be mixed with objects needing unwinding, so
+// this is kept on its own.
+bool can_access_directly(std::uint16_t port) {
+    __try {
+        static_cast<void>(__inbyte(port));
+        return true;
+    } __except (EXCEPTION_EXECUTE_HANDLER) {
+        return false;
+    }
+}
+
+PyObject *enable_direct_io(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t base;
+    std::uint16_t count;
+    std::uint16_t probe_port;
+    if (!py::check_nargs("enable_direct_io", nargs, 3) || !py::to_u16(args[0], base) ||
+        !py::to_u16(args[1], count) || !py::to_u16(args[2], probe_port)) {
+        return nullptr;
+    }
+    if (!can_access_directly(probe_port)) {
+        Py_RETURN_FALSE;
+    }
+    io::set_direct(base, count, true);
+    Py_RETURN_TRUE;
+}
+
+PyObject *disable_direct_io(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t base;
+    std::uint16_t count;
+    if (!py::check_nargs("disable_direct_io", nargs, 2) || !py::to_u16(args[0], base) ||
+        !py::to_u16(args[1], count)) {
+        return nullptr;
+    }
+    io::set_direct(base, count, false);
+    Py_RETURN_NONE;
+}
+
+PyObject *direct_io_enabled(PyObject *, PyObject *arg) {
+    std::uint16_t port;
+    if (!py::to_u16(arg, port)) {
+        return nullptr;
+    }
+    return PyBool_FromLong(io::is_direct(port));
+}
+
+}  // namespace
+
+PyMethodDef direct_methods[] = {
+    {"enable_direct_io", reinterpret_cast<PyCFunction>(enable_direct_io), METH_FASTCALL,
+     "enable_direct_io(base, count, probe_port)\n--\n\n"
+     "Access count ports from base with the in and out instructions, if reading\n"
+     "probe_port that way shows the process has I/O privilege.  Returns whether\n"
+     "direct I/O was enabled; the ports keep using the driver otherwise."},
+    {"disable_direct_io", reinterpret_cast<PyCFunction>(disable_direct_io), METH_FASTCALL,
+     "disable_direct_io(base, count)\n--\n\n"
+     "Return count ports from base to access through the InpOut driver."},
+    {"direct_io_enabled", direct_io_enabled, METH_O,
+     "direct_io_enabled(port)\n--\n\n"
+     "Return whether the port is accessed with the in and out instructions."},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+}  // namespace parallel64
@@ -0,0 +1,158 @@
+// SPDX-FileCopyrightText: 2022 Alec Delaney
+//
+// SPDX-License-Identifier: MIT
+
+// FIFO transfers through the ECP data FIFO, with the ECR polled once per
+// burst rather than once per byte.
+//
+// A burst is sized from the ECR state: a whole FIFO when it is empty (for
+// writes) or full (for reads), the service threshold when serviceIntr is
+// set, and a single PWord otherwise.  Each FIFO access moves one PWord.
+
+#include <algorithm>
+
+#include "ecp.hpp"
+#include "io.hpp"
+#include "module.hpp"
+#include "pyutil.hpp"
+#include "registers.hpp"
+#include "wait.hpp"
+
+namespace parallel64 {
+
+namespace {
+
+// Feeds the buffer into the FIFO, then waits for it to drain.  Stores the
+// number of bytes queued in sent, and returns false if the FIFO stopped
+// accepting data (or draining) for longer than the timeout.
+bool fifo_write(const EcpPorts &ports, const std::uint8_t *data, std::size_t length,
+                const FifoConfig &config, double timeout, std::size_t &sent) {
+    return fifo_feed(ports, data, length, config, timeout, sent) &&
+           wait_fifo_empty(ports, timeout);
+}
+
+// Drains the FIFO into the buffer.  Stores the number of bytes read in
+// received, and returns false if no data arrived for longer than the timeout.
+bool fifo_read(const EcpPorts &ports, std::uint8_t *data, std::size_t length,
+               const FifoConfig &config, double timeout, std::size_t &received) {
+    const std::uint8_t arm = service_arm_value(ports);
+    io::write8(ports.ecr, arm);
+    Deadline deadline(timeout);
+    received = 0;
+    while (received < length) {
+        const std::uint8_t ecr = io::read8(ports.ecr);
+        std::size_t burst = 0;
+        if (ecr & reg::ECR_FIFO_FULL) {
+            burst = config.depth;
+        } else if (ecr & reg::ECR_SERVICE_INTR) {
+            burst = config.threshold;
+        } else if (!(ecr & reg::ECR_FIFO_EMPTY)) {
+            burst = config.pword;
+        }
+        if (ecr & reg::ECR_SERVICE_INTR) {
+            io::write8(ports.ecr, arm);
+        }
+        if (burst == 0) {
+            if (deadline.expired()) {
+                return false;
+            }
+            continue;
+        }
+        burst = std::min(burst, length - received);
+        read_pwords(ports.fifo, data + received, burst, config.pword);
+        received += burst;
+        deadline = Deadline(timeout);
+    }
+    return true;
+}
+
+PyObject *ecp_write_fifo(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t base;
+    py::Buffer buffer;
+    FifoConfig config;
+    double timeout;
+    if (!py::check_nargs("ecp_write_fifo", nargs, 6) || !py::to_u16(args[0], base) ||
+        !buffer.acquire(args[1]) || !parse_fifo_config(args + 2, config) ||
+        !py::to_timeout(args[5], timeout) || !check_pword_length(buffer.size(), config)) {
+        return nullptr;
+    }
+    std::size_t sent = 0;
+    bool completed;
+    Py_BEGIN_ALLOW_THREADS
+    completed = fifo_write(EcpPorts(base), buffer.data(), buffer.size(), config, timeout, sent);
+    Py_END_ALLOW_THREADS
+    return Py_BuildValue("(nO)", static_cast<Py_ssize_t>(sent), completed ? Py_True : Py_False);
+}
+
+PyObject *ecp_read_fifo(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t base;
+    std::size_t length;
+    FifoConfig config;
+    double timeout;
+    if (!py::check_nargs("ecp_read_fifo", nargs, 6) || !py::to_u16(args[0], base) ||
+        !py::to_size(args[1], length) || !parse_fifo_config(args + 2, config) ||
+        !py::to_timeout(args[5], timeout) || !check_pword_length(length, config)) {
+        return nullptr;
+    }
+    PyObject *result = PyBytes_FromStringAndSize(nullptr, static_cast<Py_ssize_t>(length));
+    if (result == nullptr) {
+        return nullptr;
+    }
+    auto *data = reinterpret_cast<std::uint8_t *>(PyBytes_AS_STRING(result));
+    std::size_t received = 0;
+    bool completed;
+    Py_BEGIN_ALLOW_THREADS
+    completed = fifo_read(EcpPorts(base), data, length, config, timeout, received);
+    Py_END_ALLOW_THREADS
+    if (received < length && _PyBytes_Resize(&result, static_cast<Py_ssize_t>(received)) != 0) {
+        return nullptr;
+    }
+    return Py_BuildValue("(NO)", result, completed ? Py_True : Py_False);
+}
+
+PyObject *ecp_read_fifo_into(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t base;
+    py::Buffer buffer;
+    FifoConfig config;
+    double timeout;
+    if (!py::check_nargs("ecp_read_fifo_into", nargs, 6) || !py::to_u16(args[0], base) ||
+        !buffer.acquire(args[1], true) || !parse_fifo_config(args + 2, config) ||
+        !py::to_timeout(args[5], timeout) || !check_pword_length(buffer.size(), config)) {
+        return nullptr;
+    }
+    std::size_t received = 0;
+    bool completed;
+    Py_BEGIN_ALLOW_THREADS
+    completed =
+        fifo_read(EcpPorts(base), buffer.data(), buffer.size(), config, timeout, received);
+    Py_END_ALLOW_THREADS
+    return Py_BuildValue("(nO)", static_cast<Py_ssize_t>(received),
+                         completed ? Py_True : Py_False);
+}
+
+}  // namespace
+
+PyMethodDef ecp_methods[] = {
+    {"ecp_write_fifo", reinterpret_cast<PyCFunction>(ecp_write_fifo), METH_FASTCALL,
+     "ecp_write_fifo(ecp_base_address, data, fifo_depth, threshold, pword_size, timeout)\n"
+     "--\n\n"
+     "Feed a bytes-like object, a whole number of PWords, into the ECP FIFO in\n"
+     "bursts and wait for it to drain.  Returns a tuple of the number of bytes\n"
+     "queued and whether the transfer completed before the FIFO stalled past\n"
+     "the timeout."},
+    {"ecp_read_fifo", reinterpret_cast<PyCFunction>(ecp_read_fifo), METH_FASTCALL,
+     "ecp_read_fifo(ecp_base_address, length, fifo_depth, threshold, pword_size, timeout)\n"
+     "--\n\n"
+     "Read up to length bytes, a whole number of PWords, from the ECP FIFO in\n"
+     "bursts.  Returns a tuple of the data read and whether the transfer\n"
+     "completed before the FIFO stayed empty past the timeout."},
+    {"ecp_read_fifo_into", reinterpret_cast<PyCFunction>(ecp_read_fifo_into), METH_FASTCALL,
+     "ecp_read_fifo_into(ecp_base_address, buffer, fifo_depth, threshold, pword_size,\n"
+     "timeout)\n--\n\n"
+     "Fill a writable bytes-like object, a whole number of PWords, from the ECP\n"
+     "FIFO in bursts.  Returns a tuple of the number of bytes read and whether\n"
+     "the transfer completed before the FIFO stayed empty past the timeout."},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+}  // namespace parallel64
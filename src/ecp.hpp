@@ -0,0 +1,154 @@
+// SPDX-FileCopyrightText: 2022 Alec Delaney
+//
+// SPDX-License-Identifier: MIT
+
+// ECP FIFO access, shared by the blocking transfers and the output streams.
+
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+
+#include "io.hpp"
+#include "pyutil.hpp"
+#include "registers.hpp"
+#include "wait.hpp"
+
+namespace parallel64 {
+
+// The depth and threshold are in bytes, and are whole numbers of PWords
+struct FifoConfig {
+    std::size_t depth;
+    std::size_t threshold;
+    std::size_t pword = 1;
+};
+
+struct EcpPorts {
+    explicit EcpPorts(std::uint16_t base) : fifo(base + reg::ECP_FIFO), ecr(base + reg::ECR) {}
+
+    std::uint16_t fifo;
+    std::uint16_t ecr;
+};
+
+// The ECR value that re-arms serviceIntr for programmed I/O in the current mode
+inline std::uint8_t service_arm_value(const EcpPorts &ports) {
+    return io::read8(ports.ecr) & ~(reg::ECR_SERVICE_INTR | reg::ECR_DMA_ENABLE |
+                                    reg::ECR_FIFO_FULL | reg::ECR_FIFO_EMPTY);
+}
+
+// Waits for the FIFO to drain after a write
+inline bool wait_fifo_empty(const EcpPorts &ports, double timeout) {
+    return wait_bits(ports.ecr, reg::ECR_FIFO_EMPTY, reg::ECR_FIFO_EMPTY, Deadline(timeout));
+}
+
+// Writes a whole number of PWords to the FIFO, one access per PWord, as the
+// FIFO only accepts accesses of its full width
+inline void write_pwords(std::uint16_t fifo, const std::uint8_t *data, std::size_t length,
+                         std::size_t pword) {
+    if (pword == 4) {
+        for (std::size_t i = 0; i < length; i += 4) {
+            std::uint32_t value;
+            std::memcpy(&value, data + i, 4);
+            io::write32(fifo, value);
+        }
+    } else if (pword == 2) {
+        for (std::size_t i = 0; i < length; i += 2) {
+            std::uint16_t value;
+            std::memcpy(&value, data + i, 2);
+            io::write16(fifo, value);
+        }
+    } else {
+        io::write8_repeat(fifo, data, length);
+    }
+}
+
+// Reads a whole number of PWords from the FIFO, one access per PWord
+inline void read_pwords(std::uint16_t fifo, std::uint8_t *data, std::size_t length,
+                        std::size_t pword) {
+    if (pword == 4) {
+        for (std::size_t i = 0; i < length; i += 4) {
+            const std::uint32_t value = io::read32(fifo);
+            std::memcpy(data + i, &value, 4);
+        }
+    } else if (pword == 2) {
+        for (std::size_t i = 0; i < length; i += 2) {
+            const std::uint16_t value = io::read16(fifo);
+            std::memcpy(data + i, &value, 2);
+        }
+    } else {
+        io::read8_repeat(fifo, data, length);
+    }
+}
+
+// Feeds the buffer, a whole number of PWords, into the FIFO without waiting
+// for it to drain.  Stores the number of bytes queued in sent, and returns
+// false if the FIFO stopped accepting data for longer than the timeout.
+inline bool fifo_feed(const EcpPorts &ports, const std::uint8_t *data, std::size_t length,
+                      const FifoConfig &config, double timeout, std::size_t &sent) {
+    const std::uint8_t arm = service_arm_value(ports);
+    io::write8(ports.ecr, arm);
+    Deadline deadline(timeout);
+    sent = 0;
+    while (sent < length) {
+        const std::uint8_t ecr = io::read8(ports.ecr);
+        std::size_t burst = 0;
+        if (ecr & reg::ECR_FIFO_EMPTY) {
+            burst = config.depth;
+        } else if (ecr & reg::ECR_SERVICE_INTR) {
+            burst = config.threshold;
+        } else if (!(ecr & reg::ECR_FIFO_FULL)) {
+            burst = config.pword;
+        }
+        if (ecr & reg::ECR_SERVICE_INTR) {
+            io::write8(ports.ecr, arm);
+        }
+        if (burst == 0) {
+            if (deadline.expired()) {
+                return false;
+            }
+            continue;
+        }
+        burst = std::min(burst, length - sent);
+        write_pwords(ports.fifo, data + sent, burst, config.pword);
+        sent += burst;
+        deadline = Deadline(timeout);
+    }
+    return true;
+}
+
+// Checks that the FIFO depth and service threshold are positive whole
+// numbers of PWords, with the threshold no deeper than the FIFO
+inline bool check_fifo_config(const FifoConfig &config) {
+    if (config.pword != 1 && config.pword != 2 && config.pword != 4) {
+        PyErr_SetString(PyExc_ValueError, "the PWord size must be 1, 2 or 4 bytes");
+        return false;
+    }
+    if (config.depth == 0 || config.threshold == 0 || config.threshold > config.depth) {
+        PyErr_SetString(PyExc_ValueError,
+                        "FIFO depth and threshold must be positive, with threshold <= depth");
+        return false;
+    }
+    if (config.depth % config.pword != 0 || config.threshold % config.pword != 0) {
+        PyErr_SetString(PyExc_ValueError,
+                        "FIFO depth and threshold must be whole numbers of PWords");
+        return false;
+    }
+    return true;
+}
+
+// Parses a FIFO depth, service threshold and PWord size from three arguments
+inline bool parse_fifo_config(PyObject *const *args, FifoConfig &config) {
+    return py::to_size(args[0], config.depth) && py::to_size(args[1], config.threshold) &&
+           py::to_size(args[2], config.pword) && check_fifo_config(config);
+}
+
+// Checks that a transfer is a whole number of PWords
+inline bool check_pword_length(std::size_t length, const FifoConfig &config) {
+    if (length % config.pword != 0) {
+        PyErr_SetString(PyExc_ValueError, "the length must be a whole number of PWords");
+        return false;
+    }
+    return true;
+}
+
+}  // namespace parallel64
@@ -0,0 +1,209 @@
+// SPDX-FileCopyrightText: 2022 Alec Delaney
+//
+// SPDX-License-Identifier: MIT
+
+// EPP block transfers using the widest I/O access the chipset supports.
+//
+// A 16-bit or 32-bit access to the EPP data register is split by the port
+// hardware into two or four EPP data cycles, so one I/O instruction moves
+// several bytes.  Any tail that does not fill a whole access is moved with
+// narrower ones.
+//
+// Register transfers do an address cycle followed by data cycles, and check
+// the EPP timeout bit once per block.  Reads can write the Control register
+// between the two, to reverse the port for the data cycles only.
+
+#include "epp.hpp"
+#include "io.hpp"
+#include "module.hpp"
+#include "pyutil.hpp"
+#include "registers.hpp"
+
+namespace parallel64 {
+
+namespace {
+
+PyObject *epp_write_block(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t port;
+    py::Buffer buffer;
+    std::size_t width;
+    if (!py::check_nargs("epp_write_block", nargs, 3) || !py::to_u16(args[0], port) ||
+        !buffer.acquire(args[1]) || !parse_width(args[2], width)) {
+        return nullptr;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    write_block(port, buffer.data(), buffer.size(), width);
+    Py_END_ALLOW_THREADS
+    Py_RETURN_NONE;
+}
+
+PyObject *epp_read_block(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t port;
+    std::size_t length, width;
+    if (!py::check_nargs("epp_read_block", nargs, 3) || !py::to_u16(args[0], port) ||
+        !py::to_size(args[1], length) || !parse_width(args[2], width)) {
+        return nullptr;
+    }
+    PyObject *result = PyBytes_FromStringAndSize(nullptr, static_cast<Py_ssize_t>(length));
+    if (result == nullptr) {
+        return nullptr;
+    }
+    auto *data = reinterpret_cast<std::uint8_t *>(PyBytes_AS_STRING(result));
+    Py_BEGIN_ALLOW_THREADS
+    read_block(port, data, length, width);
+    Py_END_ALLOW_THREADS
+    return result;
+}
+
+PyObject *epp_read_block_into(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t port;
+    py::Buffer buffer;
+    std::size_t width;
+    if (!py::check_nargs("epp_read_block_into", nargs, 3) || !py::to_u16(args[0], port) ||
+        !buffer.acquire(args[1], true) || !parse_width(args[2], width)) {
+        return nullptr;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    read_block(port, buffer.data(), buffer.size(), width);
+    Py_END_ALLOW_THREADS
+    Py_RETURN_NONE;
+}
+
+PyObject *epp_write_regs(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t base;
+    std::uint8_t address;
+    py::Buffer buffer;
+    std::size_t width;
+    if (!py::check_nargs("epp_write_regs", nargs, 4) || !py::to_u16(args[0], base) ||
+        !py::to_u8(args[1], address) || !buffer.acquire(args[2]) ||
+        !parse_width(args[3], width)) {
+        return nullptr;
+    }
+    const EppPorts ports(base);
+    bool completed;
+    Py_BEGIN_ALLOW_THREADS
+    io::write8(ports.address, address);
+    write_block(ports.data, buffer.data(), buffer.size(), width);
+    completed = check_timeout(ports);
+    Py_END_ALLOW_THREADS
+    return PyBool_FromLong(completed);
+}
+
+PyObject *epp_read_regs(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t base;
+    std::uint8_t address;
+    std::size_t length, width;
+    DataControl control;
+    if (!py::check_nargs("epp_read_regs", nargs, 5) || !py::to_u16(args[0], base) ||
+        !py::to_u8(args[1], address) || !py::to_size(args[2], length) ||
+        !parse_width(args[3], width) || !parse_data_control(args[4], control)) {
+        return nullptr;
+    }
+    PyObject *result = PyBytes_FromStringAndSize(nullptr, static_cast<Py_ssize_t>(length));
+    if (result == nullptr) {
+        return nullptr;
+    }
+    auto *data = reinterpret_cast<std::uint8_t *>(PyBytes_AS_STRING(result));
+    const EppPorts ports(base);
+    bool completed;
+    Py_BEGIN_ALLOW_THREADS
+    write_read_address(ports, address, control);
+    read_block(ports.data, data, length, width);
+    completed = check_timeout(ports);
+    Py_END_ALLOW_THREADS
+    return Py_BuildValue("(NO)", result, completed ? Py_True : Py_False);
+}
+
+PyObject *epp_read_regs_into(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t base;
+    std::uint8_t address;
+    py::Buffer buffer;
+    std::size_t width;
+    DataControl control;
+    if (!py::check_nargs("epp_read_regs_into", nargs, 5) || !py::to_u16(args[0], base) ||
+        !py::to_u8(args[1], address) || !buffer.acquire(args[2], true) ||
+        !parse_width(args[3], width) || !parse_data_control(args[4], control)) {
+        return nullptr;
+    }
+    const EppPorts ports(base);
+    bool completed;
+    Py_BEGIN_ALLOW_THREADS
+    write_read_address(ports, address, control);
+    read_block(ports.data, buffer.data(), buffer.size(), width);
+    completed = check_timeout(ports);
+    Py_END_ALLOW_THREADS
+    return PyBool_FromLong(completed);
+}
+
+PyObject *epp_write_reg(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t base;
+    std::uint8_t address, value;
+    if (!py::check_nargs("epp_write_reg", nargs, 3) || !py::to_u16(args[0], base) ||
+        !py::to_u8(args[1], address) || !py::to_u8(args[2], value)) {
+        return nullptr;
+    }
+    const EppPorts ports(base);
+    io::write8(ports.address, address);
+    io::write8(ports.data, value);
+    return PyBool_FromLong(check_timeout(ports));
+}
+
+PyObject *epp_read_reg(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t base;
+    std::uint8_t address;
+    DataControl control;
+    if (!py::check_nargs("epp_read_reg", nargs, 3) || !py::to_u16(args[0], base) ||
+        !py::to_u8(args[1], address) || !parse_data_control(args[2], control)) {
+        return nullptr;
+    }
+    const EppPorts ports(base);
+    write_read_address(ports, address, control);
+    const std::uint8_t value = io::read8(ports.data);
+    const bool completed = check_timeout(ports);
+    return Py_BuildValue("(BO)", value, completed ? Py_True : Py_False);
+}
+
+}  // namespace
+
+PyMethodDef epp_methods[] = {
+    {"epp_write_block", reinterpret_cast<PyCFunction>(epp_write_block), METH_FASTCALL,
+     "epp_write_block(epp_data_address, data, width)\n--\n\n"
+     "Write a bytes-like object to the EPP data register using I/O accesses of\n"
+     "up to width bytes."},
+    {"epp_read_block", reinterpret_cast<PyCFunction>(epp_read_block), METH_FASTCALL,
+     "epp_read_block(epp_data_address, length, width)\n--\n\n"
+     "Read length bytes from the EPP data register using I/O accesses of up to\n"
+     "width bytes."},
+    {"epp_read_block_into", reinterpret_cast<PyCFunction>(epp_read_block_into), METH_FASTCALL,
+     "epp_read_block_into(epp_data_address, buffer, width)\n--\n\n"
+     "Fill a writable bytes-like object from the EPP data register using I/O\n"
+     "accesses of up to width bytes."},
+    {"epp_write_reg", reinterpret_cast<PyCFunction>(epp_write_reg), METH_FASTCALL,
+     "epp_write_reg(spp_base_address, address, value)\n--\n\n"
+     "Do an EPP address write cycle then a data write cycle, returning whether\n"
+     "the EPP timeout bit stayed clear."},
+    {"epp_read_reg", reinterpret_cast<PyCFunction>(epp_read_reg), METH_FASTCALL,
+     "epp_read_reg(spp_base_address, address, control)\n--\n\n"
+     "Do an EPP address write cycle then a data read cycle, returning a tuple of\n"
+     "the value read and whether the EPP timeout bit stayed clear.  Unless\n"
+     "control is None, it is written to the Control register between the\n"
+     "cycles, such as to reverse the port for the data cycle only."},
+    {"epp_write_regs", reinterpret_cast<PyCFunction>(epp_write_regs), METH_FASTCALL,
+     "epp_write_regs(spp_base_address, address, data, width)\n--\n\n"
+     "Do an EPP address write cycle then write a bytes-like object with data\n"
+     "write cycles, returning whether the EPP timeout bit stayed clear."},
+    {"epp_read_regs", reinterpret_cast<PyCFunction>(epp_read_regs), METH_FASTCALL,
+     "epp_read_regs(spp_base_address, address, length, width, control)\n--\n\n"
+     "Do an EPP address write cycle then read length bytes with data read\n"
+     "cycles, returning a tuple of the data and whether the EPP timeout bit\n"
+     "stayed clear.  control is written between the cycles as for\n"
+     "epp_read_reg()."},
+    {"epp_read_regs_into", reinterpret_cast<PyCFunction>(epp_read_regs_into), METH_FASTCALL,
+     "epp_read_regs_into(spp_base_address, address, buffer, width, control)\n--\n\n"
+     "Do an EPP address write cycle then fill a writable bytes-like object with\n"
+     "data read cycles, returning whether the EPP timeout bit stayed clear.\n"
+     "control is written between the cycles as for epp_read_reg()."},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+}  // namespace parallel64
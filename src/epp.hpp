@@ -0,0 +1,126 @@
+// SPDX-FileCopyrightText: 2022 Alec Delaney
+//
+// SPDX-License-Identifier: MIT
+
+// EPP block and register cycles, shared by the blocking transfers and the
+// completion thread.
+
+#pragma once
+
+#include <cstring>
+
+#include "io.hpp"
+#include "pyutil.hpp"
+#include "registers.hpp"
+
+namespace parallel64 {
+
+// Writes the buffer to one port with accesses of up to width bytes
+inline void write_block(std::uint16_t port, const std::uint8_t *data, std::size_t length,
+                        std::size_t width) {
+    std::size_t offset = 0;
+    if (width >= 4) {
+        for (; length - offset >= 4; offset += 4) {
+            std::uint32_t value;
+            std::memcpy(&value, data + offset, sizeof(value));
+            io::write32(port, value);
+        }
+    }
+    if (width >= 2) {
+        for (; length - offset >= 2; offset += 2) {
+            std::uint16_t value;
+            std::memcpy(&value, data + offset, sizeof(value));
+            io::write16(port, value);
+        }
+    }
+    io::write8_repeat(port, data + offset, length - offset);
+}
+
+// Fills the buffer from one port with accesses of up to width bytes
+inline void read_block(std::uint16_t port, std::uint8_t *data, std::size_t length,
+                       std::size_t width) {
+    std::size_t offset = 0;
+    if (width >= 4) {
+        for (; length - offset >= 4; offset += 4) {
+            const std::uint32_t value = io::read32(port);
+            std::memcpy(data + offset, &value, sizeof(value));
+        }
+    }
+    if (width >= 2) {
+        for (; length - offset >= 2; offset += 2) {
+            const std::uint16_t value = io::read16(port);
+            std::memcpy(data + offset, &value, sizeof(value));
+        }
+    }
+    io::read8_repeat(port, data + offset, length - offset);
+}
+
+struct EppPorts {
+    explicit EppPorts(std::uint16_t base)
+        : status(base + reg::STATUS),
+          control(base + reg::CONTROL),
+          address(base + reg::EPP_ADDRESS),
+          data(base + reg::EPP_DATA) {}
+
+    std::uint16_t status;
+    std::uint16_t control;
+    std::uint16_t address;
+    std::uint16_t data;
+};
+
+// The Control register value written between the address cycle of a read
+// and its data cycles, so the address goes out with the data drivers on
+// and the data comes back with them off, or -1 to leave Control alone
+using DataControl = int;
+
+constexpr DataControl KEEP_CONTROL = -1;
+
+// Parses a Control register value to reverse the port with, or None for
+// KEEP_CONTROL
+inline bool parse_data_control(PyObject *obj, DataControl &control) {
+    if (obj == Py_None) {
+        control = KEEP_CONTROL;
+        return true;
+    }
+    std::uint8_t value;
+    if (!py::to_u8(obj, value)) {
+        return false;
+    }
+    control = value;
+    return true;
+}
+
+// Does the address cycle of a read, then sets up Control for its data cycles
+inline void write_read_address(const EppPorts &ports, std::uint8_t address,
+                               DataControl control) {
+    io::write8(ports.address, address);
+    if (control != KEEP_CONTROL) {
+        io::write8(ports.control, static_cast<std::uint8_t>(control));
+    }
+}
+
+// Returns whether the EPP timeout bit is clear, clearing it if it was set.
+// Chipsets clear it either by writing a one or a zero, so both are written.
+inline bool check_timeout(const EppPorts &ports) {
+    const std::uint8_t status = io::read8(ports.status);
+    if (!(status & reg::STATUS_EPP_TIMEOUT)) {
+        return true;
+    }
+    io::write8(ports.status, status | reg::STATUS_EPP_TIMEOUT);
+    io::write8(ports.status, status & ~reg::STATUS_EPP_TIMEOUT);
+    return false;
+}
+
+// Parses an I/O width of 1, 2 or 4 bytes
+inline bool parse_width(PyObject *obj, std::size_t &width) {
+    if (!py::to_size(obj, width)) {
+        return false;
+    }
+    if (width != 1 && width != 2 && width != 4) {
+        PyErr_SetString(PyExc_ValueError, "I/O width must be 1, 2 or 4 bytes");
+        return false;
+    }
+    return true;
+}
+
+}  // namespace parallel64
@@ -0,0 +1,248 @@
+// SPDX-FileCopyrightText: 2022 Alec Delaney
+//
+// SPDX-License-Identifier: MIT
+
+// IEEE 1284 negotiation and reverse-channel transfers, with the handshake
+// loops run in native code.
+//
+// The event numbers in the comments are those of the IEEE 1284 timing
+// diagrams.  In the 1284 modes nSelectIn is 1284Active, nAutoFd is HostBusy,
+// nStrobe is HostClk, nAck is PtrClk and nFault is nDataAvail.
+
+#include "io.hpp"
+#include "module.hpp"
+#include "pyutil.hpp"
+#include "registers.hpp"
+#include "spp.hpp"
+#include "timing.hpp"
+#include "wait.hpp"
+
+namespace parallel64 {
+
+namespace {
+
+// Compatibility mode, with 1284Active low and HostBusy high
+constexpr std::uint8_t COMPATIBILITY = reg::CONTROL_INITIALIZE | reg::CONTROL_SELECT_IN;
+
+// The reverse idle phase, with 1284Active high and HostBusy high
+constexpr std::uint8_t REVERSE_IDLE = reg::CONTROL_INITIALIZE;
+
+// The minimum HostClk pulse width, during negotiation and when
+// acknowledging a byte
+constexpr std::int64_t HOST_CLOCK_PULSE_NS = 1000;
+
+// The status bits the peripheral sets to acknowledge a negotiation request
+constexpr std::uint8_t NEGOTIATION_MASK =
+    reg::STATUS_ACK | reg::STATUS_PAPER_END | reg::STATUS_SELECT | reg::STATUS_NOT_FAULT;
+constexpr std::uint8_t NEGOTIATION_ACKNOWLEDGED =
+    reg::STATUS_PAPER_END | reg::STATUS_SELECT | reg::STATUS_NOT_FAULT;
+
+bool wait_ptr_clk(const SppPorts &ports, bool high, double timeout) {
+    return wait_bits(ports.status, reg::STATUS_ACK, high ? reg::STATUS_ACK : 0,
+                     Deadline(timeout));
+}
+
+// Decodes a nibble from the status lines nFault, Select, PError and Busy.
+// Busy is inverted in the register, so its bit reads as the inverted line.
+std::uint8_t status_nibble(std::uint8_t status) {
+    return static_cast<std::uint8_t>(((status >> 3) & 0x07) | ((~status >> 4) & 0x08));
+}
+
+// Requests a 1284 mode with the extensibility byte.  Returns false if the
+// peripheral did not respond before the timeout, leaving the port in
+// compatibility mode, and otherwise stores the status read once the
+// peripheral has answered (event 6).
+bool negotiate(const SppPorts &ports, std::uint8_t extensibility, double timeout,
+               std::uint8_t &status) {
+    // Events 0 to 2: the host raises 1284Active and lowers HostBusy, and the
+    // peripheral acknowledges with PtrClk low and PError, nFault and Select high
+    io::write8(ports.data, extensibility);
+    io::write8(ports.control, REVERSE_IDLE | reg::CONTROL_AUTO_FEED);
+    if (!wait_bits(ports.status, NEGOTIATION_MASK, NEGOTIATION_ACKNOWLEDGED,
+                   Deadline(timeout))) {
+        status = io::read8(ports.status);
+        io::write8(ports.control, COMPATIBILITY);
+        return false;
+    }
+    // Events 3 to 6: HostClk latches the extensibility byte, then the
+    // peripheral sets XFlag and nDataAvail and raises PtrClk
+    io::write8(ports.control, REVERSE_IDLE | reg::CONTROL_AUTO_FEED | reg::CONTROL_STROBE);
+    timing::delay_ns(HOST_CLOCK_PULSE_NS);
+    io::write8(ports.control, REVERSE_IDLE);
+    const bool answered = wait_ptr_clk(ports, true, timeout);
+    status = io::read8(ports.status);
+    if (!answered) {
+        io::write8(ports.control, COMPATIBILITY);
+    }
+    return answered;
+}
+
+// Returns the peripheral to compatibility mode, returning false if it did
+// not follow the handshake before the timeout
+bool terminate(const SppPorts &ports, double timeout) {
+    // Events 22 to 24: the host lowers 1284Active and the peripheral lowers
+    // PtrClk
+    io::write8(ports.control, COMPATIBILITY);
+    if (!wait_ptr_clk(ports, false, timeout)) {
+        return false;
+    }
+    // Events 25 to 28: a HostBusy pulse answered by PtrClk rising
+    io::write8(ports.control, COMPATIBILITY | reg::CONTROL_AUTO_FEED);
+    const bool completed = wait_ptr_clk(ports, true, timeout);
+    io::write8(ports.control, COMPATIBILITY);
+    return completed;
+}
+
+// Reads bytes as pairs of nibbles on the status lines, low nibble first,
+// until the buffer is full or the peripheral has no more data.  Stores the
+// number of bytes read in received, and returns false if the peripheral
+// stopped following the handshake for longer than the timeout.
+bool nibble_read(const SppPorts &ports, std::uint8_t *data, std::size_t length, double timeout,
+                 std::size_t &received) {
+    io::write8(ports.control, REVERSE_IDLE);
+    for (received = 0; received < length; ++received) {
+        if (io::read8(ports.status) & reg::STATUS_NOT_FAULT) {
+            return true;
+        }
+        std::uint8_t value = 0;
+        for (int shift = 0; shift < 8; shift += 4) {
+            // Events 7 to 9: HostBusy low, then the peripheral puts the
+            // nibble on the status lines and lowers PtrClk
+            io::write8(ports.control, REVERSE_IDLE | reg::CONTROL_AUTO_FEED);
+            if (!wait_ptr_clk(ports, false, timeout)) {
+                io::write8(ports.control, REVERSE_IDLE);
+                return false;
+            }
+            value |= static_cast<std::uint8_t>(status_nibble(io::read8(ports.status)) << shift);
+            // Events 10 and 11: HostBusy high, answered by PtrClk rising
+            io::write8(ports.control, REVERSE_IDLE);
+            if (!wait_ptr_clk(ports, true, timeout)) {
+                return false;
+            }
+        }
+        data[received] = value;
+    }
+    return true;
+}
+
+// Reads bytes on the data lines with the port reversed, acknowledging each
+// with a HostClk pulse, until the buffer is full or the peripheral has no
+// more data.  Stores the number of bytes read in received, and returns false
+// if the peripheral stopped following the handshake for longer than the
+// timeout.
+bool byte_read(const SppPorts &ports, std::uint8_t *data, std::size_t length, double timeout,
+               std::size_t &received) {
+    constexpr std::uint8_t idle = REVERSE_IDLE | reg::CONTROL_DIRECTION;
+    io::write8(ports.control, idle);
+    for (received = 0; received < length; ++received) {
+        if (io::read8(ports.status) & reg::STATUS_NOT_FAULT) {
+            return true;
+        }
+        // Events 7 to 9: HostBusy low, then the peripheral puts the byte on
+        // the data lines and lowers PtrClk
+        io::write8(ports.control, idle | reg::CONTROL_AUTO_FEED);
+        if (!wait_ptr_clk(ports, false, timeout)) {
+            io::write8(ports.control, idle);
+            return false;
+        }
+        data[received] = io::read8(ports.data);
+        // Events 10 and 11: HostBusy high, answered by PtrClk rising
+        io::write8(ports.control, idle);
+        if (!wait_ptr_clk(ports, true, timeout)) {
+            return false;
+        }
+        // Events 16 and 17: a HostClk pulse acknowledges the byte
+        io::write8(ports.control, idle | reg::CONTROL_STROBE);
+        timing::delay_ns(HOST_CLOCK_PULSE_NS);
+        io::write8(ports.control, idle);
+    }
+    return true;
+}
+
+using ReverseRead = bool (*)(const SppPorts &, std::uint8_t *, std::size_t, double,
+                             std::size_t &);
+
+PyObject *reverse_read_into(const char *name, ReverseRead read, PyObject *const *args,
+                            Py_ssize_t nargs) {
+    std::uint16_t base;
+    py::Buffer buffer;
+    double timeout;
+    if (!py::check_nargs(name, nargs, 3) || !py::to_u16(args[0], base) ||
+        !buffer.acquire(args[1], true) || !py::to_timeout(args[2], timeout)) {
+        return nullptr;
+    }
+    std::size_t received = 0;
+    bool completed;
+    Py_BEGIN_ALLOW_THREADS
+    completed = read(SppPorts(base), buffer.data(), buffer.size(), timeout, received);
+    Py_END_ALLOW_THREADS
+    return Py_BuildValue("(nO)", static_cast<Py_ssize_t>(received),
+                         completed ? Py_True : Py_False);
+}
+
+PyObject *ieee1284_negotiate(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t base;
+    std::uint8_t extensibility;
+    double timeout;
+    if (!py::check_nargs("ieee1284_negotiate", nargs, 3) || !py::to_u16(args[0], base) ||
+        !py::to_u8(args[1], extensibility) || !py::to_timeout(args[2], timeout)) {
+        return nullptr;
+    }
+    std::uint8_t status;
+    bool answered;
+    Py_BEGIN_ALLOW_THREADS
+    answered = negotiate(SppPorts(base), extensibility, timeout, status);
+    Py_END_ALLOW_THREADS
+    return Py_BuildValue("(OB)", answered ? Py_True : Py_False, status);
+}
+
+PyObject *ieee1284_terminate(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t base;
+    double timeout;
+    if (!py::check_nargs("ieee1284_terminate", nargs, 2) || !py::to_u16(args[0], base) ||
+        !py::to_timeout(args[1], timeout)) {
+        return nullptr;
+    }
+    bool completed;
+    Py_BEGIN_ALLOW_THREADS
+    completed = terminate(SppPorts(base), timeout);
+    Py_END_ALLOW_THREADS
+    return PyBool_FromLong(completed);
+}
+
+PyObject *ieee1284_nibble_read_into(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    return reverse_read_into("ieee1284_nibble_read_into", nibble_read, args, nargs);
+}
+
+PyObject *ieee1284_byte_read_into(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    return reverse_read_into("ieee1284_byte_read_into", byte_read, args, nargs);
+}
+
+}  // namespace
+
+PyMethodDef ieee1284_methods[] = {
+    {"ieee1284_negotiate", reinterpret_cast<PyCFunction>(ieee1284_negotiate), METH_FASTCALL,
+     "ieee1284_negotiate(spp_base_address, extensibility, timeout)\n--\n\n"
+     "Request an IEEE 1284 mode with the extensibility byte.  Returns a tuple of\n"
+     "whether the peripheral answered before the timeout and the Status register\n"
+     "once it did, whose Select bit is the XFlag."},
+    {"ieee1284_terminate", reinterpret_cast<PyCFunction>(ieee1284_terminate), METH_FASTCALL,
+     "ieee1284_terminate(spp_base_address, timeout)\n--\n\n"
+     "Return the peripheral to compatibility mode, returning whether it followed\n"
+     "the handshake before the timeout."},
+    {"ieee1284_nibble_read_into", reinterpret_cast<PyCFunction>(ieee1284_nibble_read_into),
+     METH_FASTCALL,
+     "ieee1284_nibble_read_into(spp_base_address, buffer, timeout)\n--\n\n"
+     "Fill a writable bytes-like object using nibble mode, stopping early if\n"
+     "the peripheral has no more data.  Returns a tuple of the number of bytes\n"
+     "read and whether the peripheral kept to the handshake timeout."},
+    {"ieee1284_byte_read_into", reinterpret_cast<PyCFunction>(ieee1284_byte_read_into),
+     METH_FASTCALL,
+     "ieee1284_byte_read_into(spp_base_address, buffer, timeout)\n--\n\n"
+     "Fill a writable bytes-like object using byte mode, stopping early if the\n"
+     "peripheral has no more data.  Returns a tuple of the number of bytes read\n"
+     "and whether the peripheral kept to the handshake timeout."},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+}  // namespace parallel64
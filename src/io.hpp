@@ -0,0 +1,208 @@
+// SPDX-FileCopyrightText: 2022 Alec Delaney
+//
+// SPDX-License-Identifier: MIT
+
+// Register-level port I/O primitives for the parallel64 native module.
+//
+// These are thin inline wrappers around the InpOut32/InpOutx64 exports so the
+// rest of the native code never has to touch the driver interface directly.
+// Each port address has a route: ports the process has been granted I/O
+// privilege for are accessed with the in and out instructions, and ports of
+// cards whose registers are memory mapped are accessed through a mapping of
+// the registers, both avoiding a kernel transition per access.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <intrin.h>
+#include <windows.h>
+
+extern "C" {
+#include "inpout32.h"
+}
+
+#include "metrics.hpp"
+
+namespace parallel64::io {
+
+constexpr std::size_t PORT_COUNT = 65536;
+
+// The routes a port address can take.  Routes from MMIO_ROUTE upwards select
+// one of the MMIO windows.
+constexpr std::uint8_t DRIVER_ROUTE = 0;
+constexpr std::uint8_t DIRECT_ROUTE = 1;
+constexpr std::uint8_t MMIO_ROUTE = 2;
+constexpr std::size_t MMIO_WINDOW_COUNT = 16;
+
+// A mapping of registers in physical memory, with the register of port base
+// at the start of the mapping
+struct MmioWindow {
+    volatile std::uint8_t *registers;
+    std::uint16_t base;
+    std::uint16_t count;
+    std::uintptr_t physical;
+    HANDLE handle;
+};
+
+// Windows are filled in before any route refers to them, and are only
+// unmapped at exit, after the routes to them are reset
+inline MmioWindow mmio_windows[MMIO_WINDOW_COUNT];
+
+inline std::atomic<std::uint8_t> routes[PORT_COUNT];
+
+inline std::uint8_t route(std::uint16_t port) {
+    return routes[port].load(std::memory_order_acquire);
+}
+
+// Wider accesses span several addresses, so they only leave the driver if
+// the last address takes the same route as the first
+inline std::uint8_t route(std::uint16_t port, std::uint16_t width) {
+    const std::uint8_t first = route(port);
+    return route(static_cast<std::uint16_t>(port + width - 1)) == first ? first : DRIVER_ROUTE;
+}
+
+inline bool is_direct(std::uint16_t port) {
+    return route(port) == DIRECT_ROUTE;
+}
+
+template <typename T>
+volatile T *mmio_register(std::uint8_t via, std::uint16_t port) {
+    const MmioWindow &window = mmio_windows[via - MMIO_ROUTE];
+    return reinterpret_cast<volatile T *>(window.registers + (port - window.base));
+}
+
+inline std::uint8_t read8(std::uint16_t port) {
+    const metrics::Access access(port, metrics::READ);
+    const std::uint8_t via = route(port);
+    if (via == DIRECT_ROUTE) {
+        return __inbyte(port);
+    }
+    if (via >= MMIO_ROUTE) {
+        return *mmio_register<std::uint8_t>(via, port);
+    }
+    return DlPortReadPortUchar(port);
+}
+
+inline void write8(std::uint16_t port, std::uint8_t value) {
+    const metrics::Access access(port, metrics::WRITE);
+    const std::uint8_t via = route(port);
+    if (via == DIRECT_ROUTE) {
+        __outbyte(port, value);
+    } else if (via >= MMIO_ROUTE) {
+        *mmio_register<std::uint8_t>(via, port) = value;
+    } else {
+        DlPortWritePortUchar(port, value);
+    }
+}
+
+inline std::uint16_t read16(std::uint16_t port) {
+    const metrics::Access access(port, metrics::READ);
+    const std::uint8_t via = route(port, 2);
+    if (via == DIRECT_ROUTE) {
+        return __inword(port);
+    }
+    if (via >= MMIO_ROUTE) {
+        return *mmio_register<std::uint16_t>(via, port);
+    }
+    return DlPortReadPortUshort(port);
+}
+
+inline void write16(std::uint16_t port, std::uint16_t value) {
+    const metrics::Access access(port, metrics::WRITE);
+    const std::uint8_t via = route(port, 2);
+    if (via == DIRECT_ROUTE) {
+        __outword(port, value);
+    } else if (via >= MMIO_ROUTE) {
+        *mmio_register<std::uint16_t>(via, port) = value;
+    } else {
+        DlPortWritePortUshort(port, value);
+    }
+}
+
+inline std::uint32_t read32(std::uint16_t port) {
+    const metrics::Access access(port, metrics::READ);
+    const std::uint8_t via = route(port, 4);
+    if (via == DIRECT_ROUTE) {
+        return static_cast<std::uint32_t>(__indword(port));
+    }
+    if (via >= MMIO_ROUTE) {
+        return *mmio_register<std::uint32_t>(via, port);
+    }
+    return static_cast<std::uint32_t>(DlPortReadPortUlong(port));
+}
+
+inline void write32(std::uint16_t port, std::uint32_t value) {
+    const metrics::Access access(port, metrics::WRITE);
+    const std::uint8_t via = route(port, 4);
+    if (via == DIRECT_ROUTE) {
+        __outdword(port, value);
+    } else if (via >= MMIO_ROUTE) {
+        *mmio_register<std::uint32_t>(via, port) = value;
+    } else {
+        DlPortWritePortUlong(port, value);
+    }
+}
+
+inline bool driver_open() {
+    return IsInpOutDriverOpen() != 0;
+}
+
+// Writes each byte of the buffer to the same port, in order
+inline void write8_repeat(std::uint16_t port, const std::uint8_t *data, std::size_t length) {
+    const std::uint8_t via = route(port);
+    if (via == DIRECT_ROUTE) {
+        for (std::size_t i = 0; i < length; ++i) {
+            const metrics::Access access(port, metrics::WRITE);
+            __outbyte(port, data[i]);
+        }
+    } else if (via >= MMIO_ROUTE) {
+        volatile std::uint8_t *target = mmio_register<std::uint8_t>(via, port);
+        for (std::size_t i = 0; i < length; ++i) {
+            const metrics::Access access(port, metrics::WRITE);
+            *target = data[i];
+        }
+    } else {
+        for (std::size_t i = 0; i < length; ++i) {
+            const metrics::Access access(port, metrics::WRITE);
+            DlPortWritePortUchar(port, data[i]);
+        }
+    }
+}
+
+// Fills the buffer with successive reads of the same port
+inline void read8_repeat(std::uint16_t port, std::uint8_t *data, std::size_t length) {
+    const std::uint8_t via = route(port);
+    if (via == DIRECT_ROUTE) {
+        for (std::size_t i = 0; i < length; ++i) {
+            const metrics::Access access(port, metrics::READ);
+            data[i] = __inbyte(port);
+        }
+    } else if (via >= MMIO_ROUTE) {
+        const volatile std::uint8_t *source = mmio_register<std::uint8_t>(via, port);
+        for (std::size_t i = 0; i < length; ++i) {
+            const metrics::Access access(port, metrics::READ);
+            data[i] = *source;
+        }
+    } else {
+        for (std::size_t i = 0; i < length; ++i) {
+            const metrics::Access access(port, metrics::READ);
+            data[i] = DlPortReadPortUchar(port);
+        }
+    }
+}
+
+// Switches count ports from base between direct I/O and the driver.  Ports
+// routed to an MMIO window are left alone.
+inline void set_direct(std::uint16_t base, std::size_t count, bool enabled) {
+    const std::uint8_t from = enabled ? DRIVER_ROUTE : DIRECT_ROUTE;
+    const std::uint8_t to = enabled ? DIRECT_ROUTE : DRIVER_ROUTE;
+    for (std::size_t port = base; port < base + count && port < PORT_COUNT; ++port) {
+        std::uint8_t expected = from;
+        routes[port].compare_exchange_strong(expected, to, std::memory_order_acq_rel);
+    }
+}
+
+}  // namespace parallel64::io
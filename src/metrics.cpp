@@ -0,0 +1,171 @@
+// SPDX-FileCopyrightText: 2022 Alec Delaney
+//
+// SPDX-License-Identifier: MIT
+
+// Python bindings for the register access metrics.  Without
+// PARALLEL64_METRICS they only report that the metrics are not compiled in.
+
+#include <mutex>
+
+#include "metrics.hpp"
+#include "module.hpp"
+#include "pyutil.hpp"
+
+namespace parallel64 {
+
+#ifdef PARALLEL64_METRICS
+
+namespace metrics {
+
+namespace {
+
+std::mutex slot_mutex;
+std::size_t slots_used = 0;
+
+}  // namespace
+
+std::uint8_t assign_slot(std::uint16_t port) {
+    std::lock_guard<std::mutex> lock(slot_mutex);
+    std::uint8_t index = slot_of[port].load(std::memory_order_acquire);
+    if (index == 0) {
+        const std::size_t next = slots_used + 1 < SLOT_COUNT - 1 ? ++slots_used : SLOT_COUNT - 1;
+        index = static_cast<std::uint8_t>(next);
+        slot_of[port].store(index, std::memory_order_release);
+    }
+    return index;
+}
+
+}  // namespace metrics
+
+namespace {
+
+PyObject *histogram_tuple(const metrics::Histogram &histogram) {
+    PyObject *result = PyTuple_New(metrics::BUCKET_COUNT);
+    if (result == nullptr) {
+        return nullptr;
+    }
+    for (std::size_t bucket = 0; bucket < metrics::BUCKET_COUNT; ++bucket) {
+        PyObject *count = PyLong_FromUnsignedLongLong(
+            histogram.buckets[bucket].load(std::memory_order_relaxed));
+        if (count == nullptr) {
+            Py_DECREF(result);
+            return nullptr;
+        }
+        PyTuple_SET_ITEM(result, bucket, count);
+    }
+    return result;
+}
+
+void clear(metrics::Histogram &histogram) {
+    for (auto &bucket : histogram.buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+void clear(metrics::Slot &slot) {
+    for (auto &count : slot.accesses) {
+        count.store(0, std::memory_order_relaxed);
+    }
+    slot.waits.store(0, std::memory_order_relaxed);
+    slot.wait_timeouts.store(0, std::memory_order_relaxed);
+    slot.wait_ns.store(0, std::memory_order_relaxed);
+    clear(slot.latency[metrics::READ]);
+    clear(slot.latency[metrics::WRITE]);
+    clear(slot.wait_time);
+}
+
+PyObject *register_metrics(PyObject *, PyObject *arg) {
+    std::uint16_t port;
+    if (!py::to_u16(arg, port)) {
+        return nullptr;
+    }
+    const std::uint8_t index = metrics::slot_of[port].load(std::memory_order_acquire);
+    if (index == 0) {
+        Py_RETURN_NONE;
+    }
+    const metrics::Slot &slot = metrics::slots[index];
+    return Py_BuildValue(
+        "(KKKKKNNNO)",
+        static_cast<unsigned long long>(slot.accesses[metrics::READ].load()),
+        static_cast<unsigned long long>(slot.accesses[metrics::WRITE].load()),
+        static_cast<unsigned long long>(slot.waits.load()),
+        static_cast<unsigned long long>(slot.wait_timeouts.load()),
+        static_cast<unsigned long long>(slot.wait_ns.load()),
+        histogram_tuple(slot.latency[metrics::READ]),
+        histogram_tuple(slot.latency[metrics::WRITE]), histogram_tuple(slot.wait_time),
+        index == metrics::SLOT_COUNT - 1 ? Py_True : Py_False);
+}
+
+PyObject *reset_register_metrics(PyObject *, PyObject *arg) {
+    std::uint16_t port;
+    if (!py::to_u16(arg, port)) {
+        return nullptr;
+    }
+    const std::uint8_t index = metrics::slot_of[port].load(std::memory_order_acquire);
+    if (index != 0) {
+        clear(metrics::slots[index]);
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject *reset_metrics(PyObject *, PyObject *) {
+    for (auto &slot : metrics::slots) {
+        clear(slot);
+    }
+    Py_RETURN_NONE;
+}
+
+}  // namespace
+
+#else
+
+namespace {
+
+PyObject *not_compiled_in() {
+    PyErr_SetString(PyExc_RuntimeError,
+                    "the native extension was built without PARALLEL64_METRICS");
+    return nullptr;
+}
+
+PyObject *register_metrics(PyObject *, PyObject *) {
+    return not_compiled_in();
+}
+
+PyObject *reset_register_metrics(PyObject *, PyObject *) {
+    return not_compiled_in();
+}
+
+PyObject *reset_metrics(PyObject *, PyObject *) {
+    return not_compiled_in();
+}
+
+}  // namespace
+
+#endif
+
+namespace {
+
+PyObject *metrics_enabled(PyObject *, PyObject *) {
+    return PyBool_FromLong(metrics::ENABLED);
+}
+
+}  // namespace
+
+PyMethodDef metrics_methods[] = {
+    {"metrics_enabled", metrics_enabled, METH_NOARGS,
+     "metrics_enabled()\n--\n\n"
+     "Return whether the register access metrics were compiled in."},
+    {"register_metrics", register_metrics, METH_O,
+     "register_metrics(port)\n--\n\n"
+     "Return (reads, writes, waits, wait_timeouts, wait_ns, read_latency,\n"
+     "write_latency, wait_time, shared) for the port, where the last three are\n"
+     "tuples of log2 nanosecond histogram buckets and shared is whether the\n"
+     "port shares its counters with others, or None if it has not been used."},
+    {"reset_register_metrics", reset_register_metrics, METH_O,
+     "reset_register_metrics(port)\n--\n\nReset the metrics of the port."},
+    {"reset_metrics", reset_metrics, METH_NOARGS,
+     "reset_metrics()\n--\n\nReset the metrics of every port."},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+}  // namespace parallel64
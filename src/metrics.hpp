@@ -0,0 +1,116 @@
+// SPDX-FileCopyrightText: 2022 Alec Delaney
+//
+// SPDX-License-Identifier: MIT
+
+// Instrumentation of register accesses and waits, compiled in when the
+// module is built with PARALLEL64_METRICS defined.
+//
+// Each register address gets a slot the first time it is used, holding its
+// access counts, wait totals and latency histograms as relaxed atomics.
+// Histogram bucket i counts durations from 2^i up to 2^(i+1) nanoseconds,
+// with bucket 0 also counting shorter ones and the last bucket longer ones.
+// When the flag is not defined the hooks are empty and compile to nothing.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#ifdef PARALLEL64_METRICS
+#include "timing.hpp"
+#endif
+
+namespace parallel64::metrics {
+
+constexpr std::size_t BUCKET_COUNT = 32;
+
+enum Kind { READ, WRITE };
+
+#ifdef PARALLEL64_METRICS
+
+constexpr bool ENABLED = true;
+
+// Slot 0 means no slot yet; the last slot is shared by every register once
+// the others have been taken
+constexpr std::size_t SLOT_COUNT = 256;
+
+struct Histogram {
+    std::atomic<std::uint64_t> buckets[BUCKET_COUNT];
+};
+
+struct Slot {
+    std::atomic<std::uint64_t> accesses[2];
+    std::atomic<std::uint64_t> waits;
+    std::atomic<std::uint64_t> wait_timeouts;
+    std::atomic<std::uint64_t> wait_ns;
+    Histogram latency[2];
+    Histogram wait_time;
+};
+
+inline std::atomic<std::uint8_t> slot_of[65536];
+inline Slot slots[SLOT_COUNT];
+
+// Gives the register a slot, in metrics.cpp
+std::uint8_t assign_slot(std::uint16_t port);
+
+inline Slot &slot(std::uint16_t port) {
+    std::uint8_t index = slot_of[port].load(std::memory_order_acquire);
+    if (index == 0) {
+        index = assign_slot(port);
+    }
+    return slots[index];
+}
+
+inline void record(Histogram &histogram, std::uint64_t ns) {
+    std::size_t bucket = 0;
+    while (bucket + 1 < BUCKET_COUNT && ns >> (bucket + 1) != 0) {
+        ++bucket;
+    }
+    histogram.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+// Times one register access from construction to destruction
+class Access {
+  public:
+    Access(std::uint16_t port, Kind kind) : port_(port), kind_(kind), start_(timing::ticks()) {}
+    Access(const Access &) = delete;
+    Access &operator=(const Access &) = delete;
+
+    ~Access() {
+        const auto ns = static_cast<std::uint64_t>(timing::ticks_to_ns(timing::ticks() - start_));
+        Slot &target = slot(port_);
+        target.accesses[kind_].fetch_add(1, std::memory_order_relaxed);
+        record(target.latency[kind_], ns);
+    }
+
+  private:
+    std::uint16_t port_;
+    Kind kind_;
+    std::int64_t start_;
+};
+
+inline void record_wait(std::uint16_t port, std::uint64_t ns, bool matched) {
+    Slot &target = slot(port);
+    target.waits.fetch_add(1, std::memory_order_relaxed);
+    if (!matched) {
+        target.wait_timeouts.fetch_add(1, std::memory_order_relaxed);
+    }
+    target.wait_ns.fetch_add(ns, std::memory_order_relaxed);
+    record(target.wait_time, ns);
+}
+
+#else
+
+constexpr bool ENABLED = false;
+
+class Access {
+  public:
+    constexpr Access(std::uint16_t, Kind) {}
+};
+
+inline void record_wait(std::uint16_t, std::uint64_t, bool) {}
+
+#endif
+
+}  // namespace parallel64::metrics
@@ -0,0 +1,145 @@
+// SPDX-FileCopyrightText: 2022 Alec Delaney
+//
+// SPDX-License-Identifier: MIT
+
+// Memory-mapped registers, for cards that expose their parallel port
+// registers through an MMIO BAR rather than legacy I/O space.  The registers
+// are mapped once with the InpOut driver and then routed to by port address,
+// so the rest of the native code accesses them like any other port.
+//
+// InpOut documents MapPhysToLin as untested and likely not to work,
+// especially on x64.  If the mapping fails, map_mmio raises OSError and the
+// port can be opened without an MMIO address to use I/O space instead.
+
+#include <mutex>
+
+#include "io.hpp"
+#include "module.hpp"
+#include "pyutil.hpp"
+
+namespace parallel64 {
+
+namespace {
+
+// Serialises changes to the MMIO windows
+std::mutex window_mutex;
+std::size_t window_count = 0;
+
+// Returns the physical address the port is mapped to, or 0 if it is not
+// routed to an MMIO window
+std::uintptr_t mapped_physical(std::uint16_t port) {
+    const std::uint8_t via = io::route(port);
+    if (via < io::MMIO_ROUTE) {
+        return 0;
+    }
+    const io::MmioWindow &window = io::mmio_windows[via - io::MMIO_ROUTE];
+    return window.physical + (port - window.base);
+}
+
+// Routes the mapped ports back to the driver, then unmaps every window.
+// Registered with Py_AtExit, so it runs once the interpreter has finalised.
+void unmap_windows() {
+    std::lock_guard<std::mutex> lock(window_mutex);
+    for (auto &route : io::routes) {
+        if (route.load(std::memory_order_relaxed) >= io::MMIO_ROUTE) {
+            route.store(io::DRIVER_ROUTE, std::memory_order_release);
+        }
+    }
+    for (std::size_t index = 0; index < window_count; ++index) {
+        io::MmioWindow &window = io::mmio_windows[index];
+        UnmapPhysicalMemory(window.handle, const_cast<PBYTE>(window.registers));
+        window = {};
+    }
+    window_count = 0;
+}
+
+PyObject *map_mmio(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t base;
+    std::uint16_t count;
+    if (!py::check_nargs("map_mmio", nargs, 3) || !py::to_u16(args[0], base) ||
+        !py::to_u16(args[1], count)) {
+        return nullptr;
+    }
+    const unsigned long long physical = PyLong_AsUnsignedLongLong(args[2]);
+    if (physical == static_cast<unsigned long long>(-1) && PyErr_Occurred()) {
+        return nullptr;
+    }
+    if (count == 0 || base + std::size_t{count} > io::PORT_COUNT || physical == 0 ||
+        physical > static_cast<std::uintptr_t>(-1) - count) {
+        PyErr_SetString(PyExc_ValueError, "the ports or physical address are out of range");
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(window_mutex);
+    // Ports already mapped to the same registers, such as by another port
+    // object for the same card, are left in their windows
+    bool mapped = true;
+    for (std::size_t offset = 0; offset < count; ++offset) {
+        const std::uintptr_t current = mapped_physical(static_cast<std::uint16_t>(base + offset));
+        if (current == 0) {
+            mapped = false;
+        } else if (current != physical + offset) {
+            PyErr_SetString(PyExc_ValueError,
+                            "the ports are already mapped to a different physical address");
+            return nullptr;
+        }
+    }
+    if (mapped) {
+        Py_RETURN_NONE;
+    }
+    static bool teardown_registered = false;
+    if (!teardown_registered) {
+        if (Py_AtExit(unmap_windows) != 0) {
+            PyErr_SetString(PyExc_OSError,
+                            "the MMIO windows could not be registered for unmapping");
+            return nullptr;
+        }
+        teardown_registered = true;
+    }
+    if (window_count == io::MMIO_WINDOW_COUNT) {
+        PyErr_SetString(PyExc_OSError, "too many register ranges are memory mapped");
+        return nullptr;
+    }
+    HANDLE handle = nullptr;
+    PBYTE registers = MapPhysToLin(reinterpret_cast<PBYTE>(static_cast<std::uintptr_t>(physical)),
+                                   count, &handle);
+    if (registers == nullptr) {
+        PyErr_SetString(PyExc_OSError, "the InpOut driver could not map the registers");
+        return nullptr;
+    }
+    const std::size_t index = window_count++;
+    io::mmio_windows[index] = {registers, base, count, static_cast<std::uintptr_t>(physical),
+                                handle};
+    const auto via = static_cast<std::uint8_t>(io::MMIO_ROUTE + index);
+    for (std::size_t offset = 0; offset < count; ++offset) {
+        const auto port = static_cast<std::uint16_t>(base + offset);
+        if (mapped_physical(port) == 0) {
+            io::routes[port].store(via, std::memory_order_release);
+        }
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject *mmio_mapped(PyObject *, PyObject *arg) {
+    std::uint16_t port;
+    if (!py::to_u16(arg, port)) {
+        return nullptr;
+    }
+    return PyBool_FromLong(io::route(port) >= io::MMIO_ROUTE);
+}
+
+}  // namespace
+
+PyMethodDef mmio_methods[] = {
+    {"map_mmio", reinterpret_cast<PyCFunction>(map_mmio), METH_FASTCALL,
+     "map_mmio(base, count, physical_address)\n--\n\n"
+     "Map count registers at the physical address and access them as the ports\n"
+     "from base, with volatile loads and stores instead of driver calls.  The\n"
+     "mapping is kept until the interpreter exits.  InpOut documents the\n"
+     "mapping as untested and likely not to work on x64, in which case\n"
+     "OSError is raised and the ports keep using the driver."},
+    {"mmio_mapped", mmio_mapped, METH_O,
+     "mmio_mapped(port)\n--\n\nReturn whether the port is accessed through a memory mapping."},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+}  // namespace parallel64
@@ -0,0 +1,207 @@
+// SPDX-FileCopyrightText: 2022 Alec Delaney
+//
+// SPDX-License-Identifier: MIT
+
+// Entry point for the ``parallel64._native`` extension module.
+//
+// The register primitives keep the DLLPortIO names used by the ctypes path
+// so the module can be dropped in wherever a ``ctypes.WinDLL`` handle was.
+
+#include "io.hpp"
+#include "module.hpp"
+#include "pyutil.hpp"
+#include "wait.hpp"
+
+namespace {
+
+using namespace parallel64;
+
+PyObject *read_port_uchar(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t port;
+    if (!py::check_nargs("DlPortReadPortUchar", nargs, 1) || !py::to_u16(args[0], port)) {
+        return nullptr;
+    }
+    return PyLong_FromUnsignedLong(io::read8(port));
+}
+
+PyObject *write_port_uchar(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t port;
+    std::uint8_t value;
+    if (!py::check_nargs("DlPortWritePortUchar", nargs, 2) || !py::to_u16(args[0], port) ||
+        !py::to_u8(args[1], value)) {
+        return nullptr;
+    }
+    io::write8(port, value);
+    Py_RETURN_NONE;
+}
+
+PyObject *read_port_ushort(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t port;
+    if (!py::check_nargs("DlPortReadPortUshort", nargs, 1) || !py::to_u16(args[0], port)) {
+        return nullptr;
+    }
+    return PyLong_FromUnsignedLong(io::read16(port));
+}
+
+PyObject *write_port_ushort(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t port;
+    std::uint16_t value;
+    if (!py::check_nargs("DlPortWritePortUshort", nargs, 2) || !py::to_u16(args[0], port) ||
+        !py::to_u16(args[1], value)) {
+        return nullptr;
+    }
+    io::write16(port, value);
+    Py_RETURN_NONE;
+}
+
+PyObject *read_port_ulong(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t port;
+    if (!py::check_nargs("DlPortReadPortUlong", nargs, 1) || !py::to_u16(args[0], port)) {
+        return nullptr;
+    }
+    return PyLong_FromUnsignedLong(io::read32(port));
+}
+
+PyObject *write_port_ulong(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t port;
+    std::uint32_t value;
+    if (!py::check_nargs("DlPortWritePortUlong", nargs, 2) || !py::to_u16(args[0], port) ||
+        !py::to_u32(args[1], value)) {
+        return nullptr;
+    }
+    io::write32(port, value);
+    Py_RETURN_NONE;
+}
+
+PyObject *is_driver_open(PyObject *, PyObject *) {
+    return PyBool_FromLong(io::driver_open());
+}
+
+PyObject *write_port_buffer(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t port;
+    py::Buffer buffer;
+    if (!py::check_nargs("write_port_buffer", nargs, 2) || !py::to_u16(args[0], port) ||
+        !buffer.acquire(args[1])) {
+        return nullptr;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    io::write8_repeat(port, buffer.data(), buffer.size());
+    Py_END_ALLOW_THREADS
+    Py_RETURN_NONE;
+}
+
+PyObject *read_port_buffer(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t port;
+    std::size_t length;
+    if (!py::check_nargs("read_port_buffer", nargs, 2) || !py::to_u16(args[0], port) ||
+        !py::to_size(args[1], length)) {
+        return nullptr;
+    }
+    PyObject *result = PyBytes_FromStringAndSize(nullptr, static_cast<Py_ssize_t>(length));
+    if (result == nullptr) {
+        return nullptr;
+    }
+    auto *data = reinterpret_cast<std::uint8_t *>(PyBytes_AS_STRING(result));
+    Py_BEGIN_ALLOW_THREADS
+    io::read8_repeat(port, data, length);
+    Py_END_ALLOW_THREADS
+    return result;
+}
+
+PyObject *read_port_into(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t port;
+    py::Buffer buffer;
+    if (!py::check_nargs("read_port_into", nargs, 2) || !py::to_u16(args[0], port) ||
+        !buffer.acquire(args[1], true)) {
+        return nullptr;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    io::read8_repeat(port, buffer.data(), buffer.size());
+    Py_END_ALLOW_THREADS
+    Py_RETURN_NONE;
+}
+
+PyObject *wait_port_bits(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t port;
+    std::uint8_t mask, value;
+    double timeout;
+    if (!py::check_nargs("wait_port_bits", nargs, 4) || !py::to_u16(args[0], port) ||
+        !py::to_u8(args[1], mask) || !py::to_u8(args[2], value) ||
+        !py::to_timeout(args[3], timeout)) {
+        return nullptr;
+    }
+    bool matched;
+    Py_BEGIN_ALLOW_THREADS
+    matched = wait_bits(port, mask, value, Deadline(timeout));
+    Py_END_ALLOW_THREADS
+    return PyBool_FromLong(matched);
+}
+
+PyMethodDef register_methods[] = {
+    {"DlPortReadPortUchar", reinterpret_cast<PyCFunction>(read_port_uchar), METH_FASTCALL,
+     "DlPortReadPortUchar(port)\n--\n\nRead a byte from the given port."},
+    {"DlPortWritePortUchar", reinterpret_cast<PyCFunction>(write_port_uchar), METH_FASTCALL,
+     "DlPortWritePortUchar(port, value)\n--\n\nWrite a byte to the given port."},
+    {"DlPortReadPortUshort", reinterpret_cast<PyCFunction>(read_port_ushort), METH_FASTCALL,
+     "DlPortReadPortUshort(port)\n--\n\nRead a 16-bit word from the given port."},
+    {"DlPortWritePortUshort", reinterpret_cast<PyCFunction>(write_port_ushort), METH_FASTCALL,
+     "DlPortWritePortUshort(port, value)\n--\n\nWrite a 16-bit word to the given port."},
+    {"DlPortReadPortUlong", reinterpret_cast<PyCFunction>(read_port_ulong), METH_FASTCALL,
+     "DlPortReadPortUlong(port)\n--\n\nRead a 32-bit word from the given port."},
+    {"DlPortWritePortUlong", reinterpret_cast<PyCFunction>(write_port_ulong), METH_FASTCALL,
+     "DlPortWritePortUlong(port, value)\n--\n\nWrite a 32-bit word to the given port."},
+    {"IsInpOutDriverOpen", is_driver_open, METH_NOARGS,
+     "IsInpOutDriverOpen()\n--\n\nReturn whether the InpOut driver was opened."},
+    {"write_port_buffer", reinterpret_cast<PyCFunction>(write_port_buffer), METH_FASTCALL,
+     "write_port_buffer(port, data)\n--\n\n"
+     "Write every byte of a bytes-like object to the given port, in order."},
+    {"read_port_buffer", reinterpret_cast<PyCFunction>(read_port_buffer), METH_FASTCALL,
+     "read_port_buffer(port, length)\n--\n\n"
+     "Read the given port length times, returning the results as bytes."},
+    {"read_port_into", reinterpret_cast<PyCFunction>(read_port_into), METH_FASTCALL,
+     "read_port_into(port, buffer)\n--\n\n"
+     "Read the given port once for each byte of a writable bytes-like object,\n"
+     "storing the results in it."},
+    {"wait_port_bits", reinterpret_cast<PyCFunction>(wait_port_bits), METH_FASTCALL,
+     "wait_port_bits(port, mask, value, timeout)\n--\n\n"
+     "Poll the given port until the masked bits equal the value, returning\n"
+     "whether they did before the timeout (in seconds, or None to wait\n"
+     "indefinitely)."},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+PyModuleDef native_module = {
+    PyModuleDef_HEAD_INIT,
+    "parallel64._native",
+    "Native register access for parallel64",
+    -1,
+    register_methods,
+};
+
+}  // namespace
+
+PyMODINIT_FUNC PyInit__native() {
+    PyObject *module = PyModule_Create(&native_module);
+    if (module == nullptr) {
+        return nullptr;
+    }
+    if (PyModule_AddFunctions(module, parallel64::completer_methods) != 0 ||
+        PyModule_AddFunctions(module, parallel64::direct_methods) != 0 ||
+        PyModule_AddFunctions(module, parallel64::ecp_methods) != 0 ||
+        PyModule_AddFunctions(module, parallel64::epp_methods) != 0 ||
+        PyModule_AddFunctions(module, parallel64::ieee1284_methods) != 0 ||
+        PyModule_AddFunctions(module, parallel64::metrics_methods) != 0 ||
+        PyModule_AddFunctions(module, parallel64::mmio_methods) != 0 ||
+        PyModule_AddFunctions(module, parallel64::pattern_methods) != 0 ||
+        PyModule_AddFunctions(module, parallel64::program_methods) != 0 ||
+        PyModule_AddFunctions(module, parallel64::shift_methods) != 0 ||
+        PyModule_AddFunctions(module, parallel64::spp_methods) != 0 ||
+        PyModule_AddFunctions(module, parallel64::thread_methods) != 0 ||
+        PyModule_AddFunctions(module, parallel64::timing_methods) != 0 ||
+        PyModule_AddFunctions(module, parallel64::wait_methods) != 0 ||
+        !parallel64::add_sampler_type(module) || !parallel64::add_streamer_type(module)) {
+        Py_DECREF(module);
+        return nullptr;
+    }
+    return module;
+}
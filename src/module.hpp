@@ -0,0 +1,34 @@
+// SPDX-FileCopyrightText: 2022 Alec Delaney
+//
+// SPDX-License-Identifier: MIT
+
+// Method tables and types contributed to ``parallel64._native`` by each source file.
+
+#pragma once
+
+#include "pyutil.hpp"
+
+namespace parallel64 {
+
+extern PyMethodDef completer_methods[];
+extern PyMethodDef direct_methods[];
+extern PyMethodDef ecp_methods[];
+extern PyMethodDef epp_methods[];
+extern PyMethodDef ieee1284_methods[];
+extern PyMethodDef metrics_methods[];
+extern PyMethodDef mmio_methods[];
+extern PyMethodDef pattern_methods[];
+extern PyMethodDef program_methods[];
+extern PyMethodDef shift_methods[];
+extern PyMethodDef spp_methods[];
+extern PyMethodDef thread_methods[];
+extern PyMethodDef timing_methods[];
+extern PyMethodDef wait_methods[];
+
+// Adds the ``Sampler`` type, returning false with an exception set on failure
+bool add_sampler_type(PyObject *module);
+
+// Adds the ``Streamer`` type, returning false with an exception set on failure
+bool add_streamer_type(PyObject *module);
+
+}  // namespace parallel64
@@ -0,0 +1,91 @@
+// SPDX-FileCopyrightText: 2022 Alec Delaney
+//
+// SPDX-License-Identifier: MIT
+
+// Replays precomputed register writes against a QueryPerformanceCounter
+// schedule, so bit-banged output keeps its timing without Python in the loop.
+
+#include <algorithm>
+#include <cstring>
+
+#include "io.hpp"
+#include "module.hpp"
+#include "pyutil.hpp"
+#include "timing.hpp"
+
+namespace parallel64 {
+
+namespace {
+
+struct PlaybackResult {
+    std::int64_t elapsed_ticks;
+    std::int64_t max_late_ticks;
+    std::int64_t total_late_ticks;
+};
+
+// Step i starts period_ticks * i after the first one; late steps are not
+// skipped, but the schedule does not move to absorb them
+PlaybackResult play(const std::uint8_t *addresses, const std::uint8_t *values,
+                    std::size_t steps, std::size_t writes_per_step, std::int64_t period_ticks) {
+    PlaybackResult result{0, 0, 0};
+    const std::int64_t start = timing::ticks();
+    for (std::size_t step = 0; step < steps; ++step) {
+        const std::int64_t due = start + period_ticks * static_cast<std::int64_t>(step);
+        std::int64_t now = timing::ticks();
+        while (now < due) {
+            now = timing::ticks();
+        }
+        const std::int64_t late = now - due;
+        result.max_late_ticks = std::max(result.max_late_ticks, late);
+        result.total_late_ticks += late;
+        for (std::size_t i = step * writes_per_step; i < (step + 1) * writes_per_step; ++i) {
+            std::uint16_t port;
+            std::memcpy(&port, addresses + i * sizeof(port), sizeof(port));
+            io::write8(port, values[i]);
+        }
+    }
+    result.elapsed_ticks = timing::ticks() - start;
+    return result;
+}
+
+PyObject *play_writes(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    py::Buffer addresses, values;
+    std::size_t writes_per_step;
+    std::int64_t period_ns;
+    if (!py::check_nargs("play_writes", nargs, 4) || !addresses.acquire(args[0]) ||
+        !values.acquire(args[1]) || !py::to_size(args[2], writes_per_step) ||
+        !py::to_ns(args[3], period_ns)) {
+        return nullptr;
+    }
+    if (addresses.size() != values.size() * sizeof(std::uint16_t)) {
+        PyErr_SetString(PyExc_ValueError, "there must be one 16-bit address for each value");
+        return nullptr;
+    }
+    if (writes_per_step == 0 || values.size() % writes_per_step != 0) {
+        PyErr_SetString(PyExc_ValueError, "the values must divide evenly into steps");
+        return nullptr;
+    }
+    const std::size_t steps = values.size() / writes_per_step;
+    PlaybackResult result;
+    Py_BEGIN_ALLOW_THREADS
+    result = play(addresses.data(), values.data(), steps, writes_per_step,
+                  timing::ns_to_ticks(period_ns));
+    Py_END_ALLOW_THREADS
+    return Py_BuildValue("(nLLL)", static_cast<Py_ssize_t>(steps),
+                         static_cast<long long>(timing::ticks_to_ns(result.elapsed_ticks)),
+                         static_cast<long long>(timing::ticks_to_ns(result.max_late_ticks)),
+                         static_cast<long long>(timing::ticks_to_ns(result.total_late_ticks)));
+}
+
+}  // namespace
+
+PyMethodDef pattern_methods[] = {
+    {"play_writes", reinterpret_cast<PyCFunction>(play_writes), METH_FASTCALL,
+     "play_writes(addresses, values, writes_per_step, period_ns)\n--\n\n"
+     "Write each value to the matching 16-bit port address, writes_per_step\n"
+     "writes per step, with steps period_ns apart.  Returns (steps,\n"
+     "elapsed_ns, max_late_ns, total_late_ns)."},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+}  // namespace parallel64
@@ -0,0 +1,198 @@
+// SPDX-FileCopyrightText: 2022 Alec Delaney
+//
+// SPDX-License-Identifier: MIT
+
+// Runs compiled port programs: fixed lists of writes, reads, waits, delays
+// and loops, executed in one call without the GIL.
+//
+// Each instruction is 16 bytes in the struct format "<BBHBBxxq": opcode,
+// reserved, port, a, b, then a signed 64-bit argument.
+
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "io.hpp"
+#include "module.hpp"
+#include "pyutil.hpp"
+#include "timing.hpp"
+#include "wait.hpp"
+
+namespace parallel64 {
+
+namespace {
+
+enum Opcode : std::uint8_t {
+    OP_WRITE = 1,  // write a to port
+    OP_READ = 2,   // read port into the results
+    OP_WAIT = 3,   // wait for (port & a) == b, timing out after arg ns (< 0 never)
+    OP_DELAY = 4,  // delay arg ns
+    OP_LOOP = 5,   // run instructions port..here arg times in total
+};
+
+struct Instruction {
+    std::uint8_t opcode;
+    std::uint8_t reserved;
+    std::uint16_t port;
+    std::uint8_t a;
+    std::uint8_t b;
+    std::uint8_t padding[2];
+    std::int64_t arg;
+};
+
+static_assert(sizeof(Instruction) == 16, "instructions must be 16 bytes");
+
+bool decode(const py::Buffer &buffer, std::vector<Instruction> &program) {
+    if (buffer.size() % sizeof(Instruction) != 0) {
+        PyErr_SetString(PyExc_ValueError, "programs must be a whole number of instructions");
+        return false;
+    }
+    program.resize(buffer.size() / sizeof(Instruction));
+    std::memcpy(program.data(), buffer.data(), buffer.size());
+    // The loops before pc that are not inside a later loop, whose ends are
+    // in increasing order.  A loop must contain every one of them that ends
+    // inside its body, or the counts of count_reads() would be wrong.
+    std::vector<std::size_t> loops;
+    for (std::size_t pc = 0; pc < program.size(); ++pc) {
+        const Instruction &instruction = program[pc];
+        switch (instruction.opcode) {
+        case OP_WRITE:
+        case OP_READ:
+        case OP_WAIT:
+            break;
+        case OP_DELAY:
+            if (instruction.arg < 0) {
+                PyErr_Format(PyExc_ValueError, "instruction %zu has a negative delay", pc);
+                return false;
+            }
+            break;
+        case OP_LOOP:
+            if (instruction.port > pc || instruction.arg < 1) {
+                PyErr_Format(PyExc_ValueError, "instruction %zu is not a valid loop", pc);
+                return false;
+            }
+            while (!loops.empty() && loops.back() >= instruction.port) {
+                if (program[loops.back()].port < instruction.port) {
+                    PyErr_Format(PyExc_ValueError,
+                                 "instruction %zu is a loop crossing the one at instruction %zu",
+                                 pc, loops.back());
+                    return false;
+                }
+                loops.pop_back();
+            }
+            loops.push_back(pc);
+            break;
+        default:
+            PyErr_Format(PyExc_ValueError, "instruction %zu has unknown opcode %u", pc,
+                         static_cast<unsigned>(instruction.opcode));
+            return false;
+        }
+    }
+    return true;
+}
+
+std::uint64_t saturating_multiply(std::uint64_t a, std::uint64_t b) {
+    return b != 0 && a > UINT64_MAX / b ? UINT64_MAX : a * b;
+}
+
+// Counts the reads a program does if it runs to the end, saturating at
+// UINT64_MAX.  Every instruction of a loop body runs once per iteration of
+// the loop, so nested loops multiply.
+std::uint64_t count_reads(const std::vector<Instruction> &program) {
+    std::vector<std::uint64_t> runs(program.size(), 1);
+    for (std::size_t pc = 0; pc < program.size(); ++pc) {
+        if (program[pc].opcode != OP_LOOP) {
+            continue;
+        }
+        const auto count = static_cast<std::uint64_t>(program[pc].arg);
+        for (std::size_t body = program[pc].port; body < pc; ++body) {
+            runs[body] = saturating_multiply(runs[body], count);
+        }
+    }
+    std::uint64_t reads = 0;
+    for (std::size_t pc = 0; pc < program.size(); ++pc) {
+        if (program[pc].opcode == OP_READ) {
+            reads = runs[pc] > UINT64_MAX - reads ? UINT64_MAX : reads + runs[pc];
+        }
+    }
+    return reads;
+}
+
+// Returns the index of the wait that timed out, or -1 if the program ran to
+// the end
+Py_ssize_t run(const std::vector<Instruction> &program, std::string &results) {
+    std::vector<std::int64_t> iterations(program.size(), 0);
+    std::size_t pc = 0;
+    while (pc < program.size()) {
+        const Instruction &instruction = program[pc];
+        switch (instruction.opcode) {
+        case OP_WRITE:
+            io::write8(instruction.port, instruction.a);
+            break;
+        case OP_READ:
+            results.push_back(static_cast<char>(io::read8(instruction.port)));
+            break;
+        case OP_WAIT:
+            if (!wait_bits(instruction.port, instruction.a, instruction.b,
+                           Deadline(instruction.arg < 0
+                                        ? -1.0
+                                        : static_cast<double>(instruction.arg) * 1e-9))) {
+                return static_cast<Py_ssize_t>(pc);
+            }
+            break;
+        case OP_DELAY:
+            timing::delay_ns(instruction.arg);
+            break;
+        case OP_LOOP:
+            if (++iterations[pc] < instruction.arg) {
+                pc = instruction.port;
+                continue;
+            }
+            iterations[pc] = 0;
+            break;
+        }
+        ++pc;
+    }
+    return -1;
+}
+
+PyObject *run_program(PyObject *, PyObject *arg) {
+    py::Buffer buffer;
+    std::vector<Instruction> program;
+    std::string results;
+    try {
+        if (!buffer.acquire(arg) || !decode(buffer, program)) {
+            return nullptr;
+        }
+        // The results are allocated up front, so the program never allocates
+        // while it runs without the GIL
+        const std::uint64_t reads = count_reads(program);
+        if (reads > static_cast<std::uint64_t>(PY_SSIZE_T_MAX)) {
+            PyErr_SetString(PyExc_MemoryError, "the program does too many reads");
+            return nullptr;
+        }
+        results.reserve(static_cast<std::size_t>(reads));
+    } catch (const std::bad_alloc &) {
+        return PyErr_NoMemory();
+    }
+    Py_ssize_t failed;
+    Py_BEGIN_ALLOW_THREADS
+    failed = run(program, results);
+    Py_END_ALLOW_THREADS
+    return Py_BuildValue("(y#n)", results.data(), static_cast<Py_ssize_t>(results.size()),
+                         failed);
+}
+
+}  // namespace
+
+PyMethodDef program_methods[] = {
+    {"run_program", run_program, METH_O,
+     "run_program(program)\n--\n\n"
+     "Run a compiled port program, returning (reads, failed) where reads\n"
+     "holds the value of each read and failed is the index of the wait that\n"
+     "timed out, or -1 if the program ran to the end."},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+}  // namespace parallel64
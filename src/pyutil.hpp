@@ -0,0 +1,146 @@
+// SPDX-FileCopyrightText: 2022 Alec Delaney
+//
+// SPDX-License-Identifier: MIT
+
+// Small helpers shared by the Python bindings: vectorcall argument checks,
+// integer conversion with range checking, and RAII ownership of buffers.
+
+#pragma once
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace parallel64::py {
+
+inline bool check_nargs(const char *name, Py_ssize_t nargs, Py_ssize_t expected) {
+    if (nargs != expected) {
+        PyErr_Format(PyExc_TypeError, "%s() takes exactly %zd arguments (%zd given)", name,
+                     expected, nargs);
+        return false;
+    }
+    return true;
+}
+
+inline bool to_unsigned(PyObject *obj, unsigned long max, unsigned long &out) {
+    unsigned long value = PyLong_AsUnsignedLong(obj);
+    if (value == static_cast<unsigned long>(-1) && PyErr_Occurred()) {
+        return false;
+    }
+    if (value > max) {
+        PyErr_Format(PyExc_OverflowError, "value %lu is out of range (maximum is %lu)", value,
+                     max);
+        return false;
+    }
+    out = value;
+    return true;
+}
+
+inline bool to_u8(PyObject *obj, std::uint8_t &out) {
+    unsigned long value;
+    if (!to_unsigned(obj, 0xFFUL, value)) {
+        return false;
+    }
+    out = static_cast<std::uint8_t>(value);
+    return true;
+}
+
+inline bool to_u16(PyObject *obj, std::uint16_t &out) {
+    unsigned long value;
+    if (!to_unsigned(obj, 0xFFFFUL, value)) {
+        return false;
+    }
+    out = static_cast<std::uint16_t>(value);
+    return true;
+}
+
+inline bool to_u32(PyObject *obj, std::uint32_t &out) {
+    unsigned long value;
+    if (!to_unsigned(obj, 0xFFFFFFFFUL, value)) {
+        return false;
+    }
+    out = static_cast<std::uint32_t>(value);
+    return true;
+}
+
+inline bool to_size(PyObject *obj, std::size_t &out) {
+    Py_ssize_t value = PyLong_AsSsize_t(obj);
+    if (value == -1 && PyErr_Occurred()) {
+        return false;
+    }
+    if (value < 0) {
+        PyErr_SetString(PyExc_ValueError, "size must be non-negative");
+        return false;
+    }
+    out = static_cast<std::size_t>(value);
+    return true;
+}
+
+// Converts a non-negative duration in nanoseconds
+inline bool to_ns(PyObject *obj, std::int64_t &out) {
+    long long value = PyLong_AsLongLong(obj);
+    if (value == -1 && PyErr_Occurred()) {
+        return false;
+    }
+    if (value < 0) {
+        PyErr_SetString(PyExc_ValueError, "durations must be non-negative");
+        return false;
+    }
+    out = static_cast<std::int64_t>(value);
+    return true;
+}
+
+// Converts a timeout in seconds, where None (or a negative value) means
+// waiting indefinitely
+inline bool to_timeout(PyObject *obj, double &out) {
+    if (obj == Py_None) {
+        out = -1.0;
+        return true;
+    }
+    double value = PyFloat_AsDouble(obj);
+    if (value == -1.0 && PyErr_Occurred()) {
+        return false;
+    }
+    out = value;
+    return true;
+}
+
+// Owns a Py_buffer view for the lifetime of the scope
+class Buffer {
+  public:
+    Buffer() = default;
+    Buffer(const Buffer &) = delete;
+    Buffer &operator=(const Buffer &) = delete;
+
+    ~Buffer() {
+        if (acquired_) {
+            PyBuffer_Release(&view_);
+        }
+    }
+
+    // Acquires a contiguous byte view; pass writable to request a mutable one
+    bool acquire(PyObject *obj, bool writable = false) {
+        int flags = writable ? PyBUF_WRITABLE | PyBUF_C_CONTIGUOUS : PyBUF_C_CONTIGUOUS;
+        if (PyObject_GetBuffer(obj, &view_, flags) != 0) {
+            return false;
+        }
+        acquired_ = true;
+        return true;
+    }
+
+    std::uint8_t *data() const {
+        return static_cast<std::uint8_t *>(view_.buf);
+    }
+
+    std::size_t size() const {
+        return static_cast<std::size_t>(view_.len);
+    }
+
+  private:
+    Py_buffer view_{};
+    bool acquired_ = false;
+};
+
+}  // namespace parallel64::py
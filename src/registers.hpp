@@ -0,0 +1,54 @@
+// SPDX-FileCopyrightText: 2022 Alec Delaney
+//
+// SPDX-License-Identifier: MIT
+
+// Register offsets and bit masks for the SPP, EPP and ECP register sets.
+//
+// Offsets are relative to the SPP base address, except for the ECP ones,
+// which are relative to the ECP base address.
+
+#pragma once
+
+#include <cstdint>
+
+namespace parallel64::reg {
+
+// SPP/EPP register offsets
+constexpr std::uint16_t DATA = 0;
+constexpr std::uint16_t STATUS = 1;
+constexpr std::uint16_t CONTROL = 2;
+constexpr std::uint16_t EPP_ADDRESS = 3;
+constexpr std::uint16_t EPP_DATA = 4;
+
+// ECP register offsets, relative to the ECP base address.  The FIFO and
+// configuration registers share addresses depending on the ECR mode.
+constexpr std::uint16_t ECP_FIFO = 0;
+constexpr std::uint16_t ECP_CONFIG_A = 0;
+constexpr std::uint16_t ECP_CONFIG_B = 1;
+constexpr std::uint16_t ECR = 2;
+
+// Status register bits; BUSY is inverted in hardware, so a set bit means
+// the peripheral is ready
+constexpr std::uint8_t STATUS_NOT_BUSY = 1 << 7;
+constexpr std::uint8_t STATUS_ACK = 1 << 6;
+constexpr std::uint8_t STATUS_PAPER_END = 1 << 5;
+constexpr std::uint8_t STATUS_SELECT = 1 << 4;
+constexpr std::uint8_t STATUS_NOT_FAULT = 1 << 3;
+constexpr std::uint8_t STATUS_EPP_TIMEOUT = 1 << 0;
+
+// Control register bits; STROBE, AUTO_FEED and SELECT_IN are inverted in
+// hardware, so a set bit drives the line low
+constexpr std::uint8_t CONTROL_STROBE = 1 << 0;
+constexpr std::uint8_t CONTROL_AUTO_FEED = 1 << 1;
+constexpr std::uint8_t CONTROL_INITIALIZE = 1 << 2;
+constexpr std::uint8_t CONTROL_SELECT_IN = 1 << 3;
+constexpr std::uint8_t CONTROL_DIRECTION = 1 << 5;
+
+// Extended Control Register bits
+constexpr std::uint8_t ECR_FIFO_EMPTY = 1 << 0;
+constexpr std::uint8_t ECR_FIFO_FULL = 1 << 1;
+constexpr std::uint8_t ECR_SERVICE_INTR = 1 << 2;
+constexpr std::uint8_t ECR_DMA_ENABLE = 1 << 3;
+constexpr std::uint8_t ECR_MODE_MASK = 0b11100000;
+
+}  // namespace parallel64::reg
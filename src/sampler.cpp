@@ -0,0 +1,384 @@
+// SPDX-FileCopyrightText: 2022 Alec Delaney
+//
+// SPDX-License-Identifier: MIT
+
+// A background sampler for the SPP registers.
+//
+// A dedicated thread reads the selected registers, either as fast as the bus
+// allows or at a fixed period (waiting between samples as set by the wait
+// policy, so long periods do not keep a core busy), and pushes timestamped samples into a
+// single-producer/single-consumer ring.  Python drains the ring in batches
+// while holding the GIL, which makes it the single consumer.
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <thread>
+
+#include "io.hpp"
+#include "module.hpp"
+#include "pyutil.hpp"
+#include "registers.hpp"
+#include "timing.hpp"
+#include "wait.hpp"
+
+namespace parallel64 {
+
+namespace {
+
+constexpr std::uint8_t CHANNEL_DATA = 0x01;
+constexpr std::uint8_t CHANNEL_STATUS = 0x02;
+constexpr std::uint8_t CHANNEL_CONTROL = 0x04;
+
+// One sample, laid out as the struct format "<QBBB5x"
+struct Sample {
+    std::uint64_t timestamp_ns;
+    std::uint8_t data;
+    std::uint8_t status;
+    std::uint8_t control;
+    std::uint8_t reserved[5];
+};
+
+static_assert(sizeof(Sample) == 16, "samples must be 16 bytes");
+
+// The largest ring, a power of two whose samples can all be drained into
+// one bytes object
+constexpr std::size_t MAX_CAPACITY =
+    ((static_cast<std::size_t>(PY_SSIZE_T_MAX) / sizeof(Sample)) >> 1) + 1;
+
+class SampleRing {
+  public:
+    // Throws std::bad_alloc if the samples cannot be allocated
+    explicit SampleRing(std::size_t capacity)
+        : mask_(capacity - 1), samples_(new Sample[capacity]) {}
+
+    // Called only from the sampling thread
+    bool push(const Sample &sample) {
+        const std::size_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) > mask_) {
+            return false;
+        }
+        samples_[head & mask_] = sample;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Called only while holding the GIL; out need not be aligned
+    std::size_t pop(std::uint8_t *out, std::size_t max_count) {
+        const std::size_t tail = tail_.load(std::memory_order_relaxed);
+        const std::size_t count =
+            std::min(head_.load(std::memory_order_acquire) - tail, max_count);
+        const std::size_t first = tail & mask_;
+        const std::size_t before_wrap = std::min(count, mask_ + 1 - first);
+        std::memcpy(out, &samples_[first], before_wrap * sizeof(Sample));
+        std::memcpy(out + before_wrap * sizeof(Sample), &samples_[0],
+                    (count - before_wrap) * sizeof(Sample));
+        tail_.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    std::size_t size() const {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+
+    std::size_t capacity() const {
+        return mask_ + 1;
+    }
+
+  private:
+    const std::size_t mask_;
+    std::unique_ptr<Sample[]> samples_;
+    alignas(64) std::atomic<std::size_t> head_{0};
+    alignas(64) std::atomic<std::size_t> tail_{0};
+};
+
+struct SamplerConfig {
+    std::uint16_t data;
+    std::uint16_t status;
+    std::uint16_t control;
+    std::uint8_t channels;
+    std::int64_t period_ticks;
+    std::uint8_t trigger_mask;
+    std::uint8_t trigger_value;
+};
+
+struct SamplerObject {
+    PyObject_HEAD
+    SamplerConfig config;
+    SampleRing *ring;
+    std::thread *thread;
+    std::atomic<bool> stop_requested;
+    std::atomic<bool> triggered;
+    std::atomic<std::uint64_t> dropped;
+    std::atomic<std::uint64_t> overruns;
+};
+
+void run_sampler(SamplerObject *self) {
+    const SamplerConfig &config = self->config;
+    const std::int64_t start = timing::ticks();
+    std::int64_t next = start;
+    while (!self->stop_requested.load(std::memory_order_relaxed)) {
+        if (config.period_ticks > 0) {
+            wait_until_ticks(next);
+            next += config.period_ticks;
+            const std::int64_t now = timing::ticks();
+            if (now >= next) {
+                self->overruns.fetch_add(1, std::memory_order_relaxed);
+                next = now + config.period_ticks;
+            }
+        }
+        Sample sample{};
+        sample.timestamp_ns = static_cast<std::uint64_t>(timing::ticks_to_ns(timing::ticks() - start));
+        if (config.channels & CHANNEL_STATUS) {
+            sample.status = io::read8(config.status);
+        }
+        if (config.channels & CHANNEL_DATA) {
+            sample.data = io::read8(config.data);
+        }
+        if (config.channels & CHANNEL_CONTROL) {
+            sample.control = io::read8(config.control);
+        }
+        if (!self->triggered.load(std::memory_order_relaxed)) {
+            if ((sample.status & config.trigger_mask) != config.trigger_value) {
+                continue;
+            }
+            self->triggered.store(true, std::memory_order_relaxed);
+        }
+        if (!self->ring->push(sample)) {
+            self->dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+void join_sampler(SamplerObject *self) {
+    if (self->thread == nullptr) {
+        return;
+    }
+    self->stop_requested.store(true, std::memory_order_relaxed);
+    Py_BEGIN_ALLOW_THREADS
+    self->thread->join();
+    Py_END_ALLOW_THREADS
+    delete self->thread;
+    self->thread = nullptr;
+}
+
+std::size_t round_up_pow2(std::size_t value) {
+    std::size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+PyObject *sampler_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+    static const char *keywords[] = {"spp_base_address", "channels",      "capacity",
+                                     "period_ns",        "trigger_mask", "trigger_value",
+                                     nullptr};
+    PyObject *base_obj, *channels_obj, *capacity_obj, *period_obj;
+    PyObject *trigger_mask_obj = nullptr, *trigger_value_obj = nullptr;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOOO|OO:Sampler",
+                                     const_cast<char **>(keywords), &base_obj, &channels_obj,
+                                     &capacity_obj, &period_obj, &trigger_mask_obj,
+                                     &trigger_value_obj)) {
+        return nullptr;
+    }
+    std::uint16_t base;
+    std::uint8_t channels, trigger_mask = 0, trigger_value = 0;
+    std::size_t capacity;
+    std::int64_t period_ns;
+    if (!py::to_u16(base_obj, base) || !py::to_u8(channels_obj, channels) ||
+        !py::to_size(capacity_obj, capacity) || !py::to_ns(period_obj, period_ns) ||
+        (trigger_mask_obj != nullptr && !py::to_u8(trigger_mask_obj, trigger_mask)) ||
+        (trigger_value_obj != nullptr && !py::to_u8(trigger_value_obj, trigger_value))) {
+        return nullptr;
+    }
+    if (capacity == 0) {
+        PyErr_SetString(PyExc_ValueError, "capacity must be positive");
+        return nullptr;
+    }
+    if (capacity > MAX_CAPACITY) {
+        PyErr_Format(PyExc_ValueError, "capacity must be at most %zu", MAX_CAPACITY);
+        return nullptr;
+    }
+    if (trigger_mask != 0 && !(channels & CHANNEL_STATUS)) {
+        PyErr_SetString(PyExc_ValueError, "triggers need the status channel");
+        return nullptr;
+    }
+
+    auto *self = reinterpret_cast<SamplerObject *>(type->tp_alloc(type, 0));
+    if (self == nullptr) {
+        return nullptr;
+    }
+    self->config = {base,
+                    static_cast<std::uint16_t>(base + reg::STATUS),
+                    static_cast<std::uint16_t>(base + reg::CONTROL),
+                    channels,
+                    timing::ns_to_ticks(period_ns),
+                    trigger_mask,
+                    static_cast<std::uint8_t>(trigger_value & trigger_mask)};
+    self->thread = nullptr;
+    new (&self->stop_requested) std::atomic<bool>(false);
+    new (&self->triggered) std::atomic<bool>(trigger_mask == 0);
+    new (&self->dropped) std::atomic<std::uint64_t>(0);
+    new (&self->overruns) std::atomic<std::uint64_t>(0);
+    try {
+        self->ring = new SampleRing(round_up_pow2(capacity));
+    } catch (const std::bad_alloc &) {
+        Py_DECREF(self);
+        return PyErr_NoMemory();
+    }
+    return reinterpret_cast<PyObject *>(self);
+}
+
+void sampler_dealloc(PyObject *obj) {
+    auto *self = reinterpret_cast<SamplerObject *>(obj);
+    join_sampler(self);
+    delete self->ring;
+    PyTypeObject *type = Py_TYPE(obj);
+    type->tp_free(obj);
+    Py_DECREF(type);
+}
+
+PyObject *sampler_start(PyObject *obj, PyObject *) {
+    auto *self = reinterpret_cast<SamplerObject *>(obj);
+    if (self->thread != nullptr) {
+        PyErr_SetString(PyExc_RuntimeError, "the sampler is already running");
+        return nullptr;
+    }
+    self->stop_requested.store(false, std::memory_order_relaxed);
+    try {
+        self->thread = new std::thread(run_sampler, self);
+    } catch (const std::exception &err) {
+        PyErr_SetString(PyExc_OSError, err.what());
+        return nullptr;
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject *sampler_stop(PyObject *obj, PyObject *) {
+    join_sampler(reinterpret_cast<SamplerObject *>(obj));
+    Py_RETURN_NONE;
+}
+
+PyObject *sampler_drain(PyObject *obj, PyObject *const *args, Py_ssize_t nargs) {
+    auto *self = reinterpret_cast<SamplerObject *>(obj);
+    std::size_t max_count = self->ring->capacity();
+    if (nargs > 1) {
+        PyErr_SetString(PyExc_TypeError, "drain() takes at most 1 argument");
+        return nullptr;
+    }
+    if (nargs == 1 && args[0] != Py_None && !py::to_size(args[0], max_count)) {
+        return nullptr;
+    }
+    max_count = std::min(max_count, self->ring->size());
+    PyObject *result =
+        PyBytes_FromStringAndSize(nullptr, static_cast<Py_ssize_t>(max_count * sizeof(Sample)));
+    if (result == nullptr) {
+        return nullptr;
+    }
+    auto *out = reinterpret_cast<std::uint8_t *>(PyBytes_AS_STRING(result));
+    const std::size_t count = self->ring->pop(out, max_count);
+    if (count != max_count &&
+        _PyBytes_Resize(&result, static_cast<Py_ssize_t>(count * sizeof(Sample))) != 0) {
+        return nullptr;
+    }
+    return result;
+}
+
+PyObject *sampler_drain_into(PyObject *obj, PyObject *const *args, Py_ssize_t nargs) {
+    auto *self = reinterpret_cast<SamplerObject *>(obj);
+    py::Buffer buffer;
+    if (!py::check_nargs("drain_into", nargs, 1) || !buffer.acquire(args[0], true)) {
+        return nullptr;
+    }
+    return PyLong_FromSize_t(self->ring->pop(buffer.data(), buffer.size() / sizeof(Sample)));
+}
+
+PyObject *sampler_get_running(PyObject *obj, void *) {
+    return PyBool_FromLong(reinterpret_cast<SamplerObject *>(obj)->thread != nullptr);
+}
+
+PyObject *sampler_get_triggered(PyObject *obj, void *) {
+    auto *self = reinterpret_cast<SamplerObject *>(obj);
+    return PyBool_FromLong(self->triggered.load(std::memory_order_relaxed));
+}
+
+PyObject *sampler_get_dropped(PyObject *obj, void *) {
+    auto *self = reinterpret_cast<SamplerObject *>(obj);
+    return PyLong_FromUnsignedLongLong(self->dropped.load(std::memory_order_relaxed));
+}
+
+PyObject *sampler_get_overruns(PyObject *obj, void *) {
+    auto *self = reinterpret_cast<SamplerObject *>(obj);
+    return PyLong_FromUnsignedLongLong(self->overruns.load(std::memory_order_relaxed));
+}
+
+PyObject *sampler_get_pending(PyObject *obj, void *) {
+    return PyLong_FromSize_t(reinterpret_cast<SamplerObject *>(obj)->ring->size());
+}
+
+PyMethodDef sampler_object_methods[] = {
+    {"start", sampler_start, METH_NOARGS, "start()\n--\n\nStart the sampling thread."},
+    {"stop", sampler_stop, METH_NOARGS,
+     "stop()\n--\n\nStop the sampling thread and wait for it to finish."},
+    {"drain", reinterpret_cast<PyCFunction>(sampler_drain), METH_FASTCALL,
+     "drain(max_samples=None)\n--\n\n"
+     "Remove up to max_samples samples from the ring, returning them as bytes\n"
+     "of 16-byte records in the struct format \"<QBBB5x\"."},
+    {"drain_into", reinterpret_cast<PyCFunction>(sampler_drain_into), METH_FASTCALL,
+     "drain_into(buffer)\n--\n\n"
+     "Remove as many samples as fit from the ring into a writable bytes-like\n"
+     "object, as 16-byte records, returning the number of samples removed."},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+PyGetSetDef sampler_getset[] = {
+    {"running", sampler_get_running, nullptr, "Whether the sampling thread is running.",
+     nullptr},
+    {"triggered", sampler_get_triggered, nullptr, "Whether the trigger condition was met.",
+     nullptr},
+    {"dropped", sampler_get_dropped, nullptr, "Samples lost because the ring was full.",
+     nullptr},
+    {"overruns", sampler_get_overruns, nullptr, "Sample periods missed by the thread.",
+     nullptr},
+    {"pending", sampler_get_pending, nullptr, "Samples waiting to be drained.", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr},
+};
+
+PyType_Slot sampler_slots[] = {
+    {Py_tp_new, reinterpret_cast<void *>(sampler_new)},
+    {Py_tp_dealloc, reinterpret_cast<void *>(sampler_dealloc)},
+    {Py_tp_methods, sampler_object_methods},
+    {Py_tp_getset, sampler_getset},
+    {Py_tp_doc,
+     const_cast<char *>("Sampler(spp_base_address, channels, capacity, period_ns, "
+                        "trigger_mask=0, trigger_value=0)\n--\n\n"
+                        "Sample the SPP registers from a background thread.")},
+    {0, nullptr},
+};
+
+PyType_Spec sampler_spec = {
+    "parallel64._native.Sampler",
+    sizeof(SamplerObject),
+    0,
+    Py_TPFLAGS_DEFAULT,
+    sampler_slots,
+};
+
+}  // namespace
+
+bool add_sampler_type(PyObject *module) {
+    PyObject *type = PyType_FromSpec(&sampler_spec);
+    if (type == nullptr) {
+        return false;
+    }
+    if (PyModule_AddObject(module, "Sampler", type) != 0) {
+        Py_DECREF(type);
+        return false;
+    }
+    return true;
+}
+
+}  // namespace parallel64
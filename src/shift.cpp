@@ -0,0 +1,184 @@
+// SPDX-FileCopyrightText: 2022 Alec Delaney
+//
+// SPDX-License-Identifier: MIT
+
+// A bit-banged synchronous shift engine used by the SPI, I2C and shift
+// register protocols.
+//
+// The clock and data out lines share one output register whose current value
+// is passed in, so each clock edge is a single port write with no read back.
+// I2C must not change the data line while the clock is high, so in its mode
+// the data changes in a write of its own, after the clock edge.
+// Masks are in raw register bits; the inversion masks undo the hardware
+// inversion of the Control register lines.
+
+#include "io.hpp"
+#include "module.hpp"
+#include "pyutil.hpp"
+#include "timing.hpp"
+
+namespace parallel64 {
+
+namespace {
+
+constexpr std::uint8_t MODE_CPOL = 0x01;
+constexpr std::uint8_t MODE_CPHA = 0x02;
+constexpr std::uint8_t MODE_LSB_FIRST = 0x04;
+constexpr std::uint8_t MODE_SEPARATE_DATA = 0x08;
+
+struct ShiftLines {
+    std::uint16_t out_port;
+    std::uint8_t clock_mask;
+    std::uint8_t clock_invert;
+    std::uint8_t data_out_mask;
+    std::uint8_t data_out_invert;
+    std::uint16_t in_port;
+    std::uint8_t data_in_mask;
+    std::uint8_t data_in_invert;
+};
+
+inline std::uint8_t line_bits(bool level, std::uint8_t mask, std::uint8_t invert) {
+    return static_cast<std::uint8_t>((level ? mask : 0) ^ invert);
+}
+
+class Shifter {
+  public:
+    Shifter(const ShiftLines &lines, std::uint8_t state, std::uint8_t mode,
+            std::int64_t half_period_ticks)
+        : lines_(lines), state_(state), cpol_(mode & MODE_CPOL), cpha_(mode & MODE_CPHA),
+          separate_data_(mode & MODE_SEPARATE_DATA), half_period_(half_period_ticks) {}
+
+    // Shifts the given number of bits of one byte, returning the bits read in
+    // the same positions
+    std::uint8_t shift(std::uint8_t out, int bits, bool lsb_first) {
+        std::uint8_t in = 0;
+        for (int i = 0; i < bits; ++i) {
+            const int position = lsb_first ? i : 7 - i;
+            const bool bit = (out >> position) & 1;
+            bool sampled;
+            if (cpha_) {
+                edge(!cpol_, bit);
+                edge(cpol_, bit);
+                sampled = sample();
+            } else {
+                edge(cpol_, bit);
+                edge(!cpol_, bit);
+                sampled = sample();
+            }
+            in |= static_cast<std::uint8_t>(sampled) << position;
+        }
+        return in;
+    }
+
+    // Returns the clock to its idle level
+    void idle() {
+        const std::uint8_t idle_state = with_clock(state_, cpol_);
+        if (idle_state != state_) {
+            write_and_wait(idle_state, half_period_);
+        }
+    }
+
+    std::uint8_t state() const {
+        return state_;
+    }
+
+  private:
+    std::uint8_t with_clock(std::uint8_t state, bool level) const {
+        return static_cast<std::uint8_t>((state & ~lines_.clock_mask) |
+                                         line_bits(level, lines_.clock_mask, lines_.clock_invert));
+    }
+
+    // Moves the clock to the given level and sets the data out line.  With
+    // a separate data write, the clock edge and the data change each take
+    // half of the edge's time.
+    void edge(bool clock, bool data) {
+        const std::uint8_t clocked = with_clock(state_, clock);
+        std::uint8_t next = clocked;
+        if (lines_.data_out_mask != 0) {
+            next = static_cast<std::uint8_t>(
+                (next & ~lines_.data_out_mask) |
+                line_bits(data, lines_.data_out_mask, lines_.data_out_invert));
+        }
+        if (separate_data_ && next != clocked) {
+            const std::int64_t clock_ticks = half_period_ / 2;
+            write_and_wait(clocked, clock_ticks);
+            write_and_wait(next, half_period_ - clock_ticks);
+        } else {
+            write_and_wait(next, half_period_);
+        }
+    }
+
+    void write_and_wait(std::uint8_t next, std::int64_t ticks) {
+        const std::int64_t start = timing::ticks();
+        io::write8(lines_.out_port, next);
+        state_ = next;
+        timing::spin_until(start, ticks);
+    }
+
+    bool sample() const {
+        if (lines_.data_in_mask == 0) {
+            return false;
+        }
+        return ((io::read8(lines_.in_port) ^ lines_.data_in_invert) & lines_.data_in_mask) != 0;
+    }
+
+    const ShiftLines &lines_;
+    std::uint8_t state_;
+    bool cpol_;
+    bool cpha_;
+    bool separate_data_;
+    std::int64_t half_period_;
+};
+
+PyObject *shift_bytes(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    ShiftLines lines;
+    std::uint8_t state, mode, bits;
+    std::int64_t half_period_ns;
+    py::Buffer data;
+    if (!py::check_nargs("shift_bytes", nargs, 13) || !py::to_u16(args[0], lines.out_port) ||
+        !py::to_u8(args[1], state) || !py::to_u8(args[2], lines.clock_mask) ||
+        !py::to_u8(args[3], lines.clock_invert) || !py::to_u8(args[4], lines.data_out_mask) ||
+        !py::to_u8(args[5], lines.data_out_invert) || !py::to_u16(args[6], lines.in_port) ||
+        !py::to_u8(args[7], lines.data_in_mask) || !py::to_u8(args[8], lines.data_in_invert) ||
+        !py::to_u8(args[9], mode) || !py::to_u8(args[10], bits) ||
+        !py::to_ns(args[11], half_period_ns) || !data.acquire(args[12])) {
+        return nullptr;
+    }
+    if (bits < 1 || bits > 8) {
+        PyErr_SetString(PyExc_ValueError, "bits must be 1-8");
+        return nullptr;
+    }
+    PyObject *received = PyBytes_FromStringAndSize(nullptr, static_cast<Py_ssize_t>(data.size()));
+    if (received == nullptr) {
+        return nullptr;
+    }
+    auto *in = reinterpret_cast<std::uint8_t *>(PyBytes_AS_STRING(received));
+    std::uint8_t final_state;
+    Py_BEGIN_ALLOW_THREADS
+    Shifter shifter(lines, state, mode, timing::ns_to_ticks(half_period_ns));
+    const bool lsb_first = mode & MODE_LSB_FIRST;
+    for (std::size_t i = 0; i < data.size(); ++i) {
+        in[i] = shifter.shift(data.data()[i], bits, lsb_first);
+    }
+    shifter.idle();
+    final_state = shifter.state();
+    Py_END_ALLOW_THREADS
+    return Py_BuildValue("(Ni)", received, final_state);
+}
+
+}  // namespace
+
+PyMethodDef shift_methods[] = {
+    {"shift_bytes", reinterpret_cast<PyCFunction>(shift_bytes), METH_FASTCALL,
+     "shift_bytes(out_port, state, clock_mask, clock_invert, data_out_mask,\n"
+     "            data_out_invert, in_port, data_in_mask, data_in_invert, mode,\n"
+     "            bits, half_period_ns, data)\n--\n\n"
+     "Clock bits of each byte out and in, with one port write per clock edge.\n"
+     "Mode bit 0 is CPOL, bit 1 is CPHA and bit 2 shifts LSB first.  Bit 3\n"
+     "changes the data out line in a write of its own after each clock edge,\n"
+     "as I2C needs.  Returns (received, state) where state is the final output\n"
+     "register value."},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+}  // namespace parallel64
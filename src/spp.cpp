@@ -0,0 +1,121 @@
+// SPDX-FileCopyrightText: 2022 Alec Delaney
+//
+// SPDX-License-Identifier: MIT
+
+// SPP (Centronics) transfers with the handshake loop run in native code.
+
+#include "io.hpp"
+#include "module.hpp"
+#include "pyutil.hpp"
+#include "registers.hpp"
+#include "spp.hpp"
+#include "timing.hpp"
+#include "wait.hpp"
+
+namespace parallel64 {
+
+namespace {
+
+// Runs the strobe sequence with every write replaced by rewriting the idle
+// control byte, so nothing is sent, and stores the mean achieved setup,
+// pulse and hold times in nanoseconds
+void measure_strobe(const SppPorts &ports, std::uint8_t control, const StrobeTiming &timing,
+                    std::size_t iterations, std::int64_t (&achieved)[3]) {
+    std::int64_t totals[3] = {0, 0, 0};
+    for (std::size_t i = 0; i < iterations; ++i) {
+        const std::int64_t data_start = timing::ticks();
+        io::write8(ports.control, control);
+        timing::spin_until(data_start, timing.setup);
+        const std::int64_t strobe_start = timing::ticks();
+        io::write8(ports.control, control);
+        timing::spin_until(strobe_start, timing.pulse);
+        const std::int64_t release_start = timing::ticks();
+        io::write8(ports.control, control);
+        timing::spin_until(release_start, timing.hold);
+        const std::int64_t end = timing::ticks();
+        totals[0] += strobe_start - data_start;
+        totals[1] += release_start - strobe_start;
+        totals[2] += end - release_start;
+    }
+    for (int i = 0; i < 3; ++i) {
+        achieved[i] = iterations ? timing::ticks_to_ns(totals[i]) / iterations : 0;
+    }
+}
+
+PyObject *spp_strobe_byte(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t base;
+    std::uint8_t control, value;
+    StrobeTiming timing;
+    if (!py::check_nargs("spp_strobe_byte", nargs, 6) || !py::to_u16(args[0], base) ||
+        !py::to_u8(args[1], control) || !py::to_u8(args[2], value) ||
+        !parse_timing(args + 3, timing)) {
+        return nullptr;
+    }
+    strobe_byte(SppPorts(base), control & ~reg::CONTROL_STROBE, value, timing);
+    Py_RETURN_NONE;
+}
+
+PyObject *spp_write_buffer(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t base;
+    std::uint8_t control;
+    py::Buffer buffer;
+    double timeout;
+    StrobeTiming timing;
+    if (!py::check_nargs("spp_write_buffer", nargs, 8) || !py::to_u16(args[0], base) ||
+        !py::to_u8(args[1], control) || !buffer.acquire(args[2]) ||
+        !py::to_timeout(args[3], timeout) || !parse_timing(args + 5, timing)) {
+        return nullptr;
+    }
+    int hold_while_busy = PyObject_IsTrue(args[4]);
+    if (hold_while_busy < 0) {
+        return nullptr;
+    }
+    std::size_t sent = 0;
+    bool completed;
+    Py_BEGIN_ALLOW_THREADS
+    completed = write_buffer(SppPorts(base), control & ~reg::CONTROL_STROBE, buffer.data(),
+                             buffer.size(), timing, timeout, hold_while_busy != 0, sent);
+    Py_END_ALLOW_THREADS
+    return Py_BuildValue("(nO)", static_cast<Py_ssize_t>(sent), completed ? Py_True : Py_False);
+}
+
+PyObject *spp_measure_strobe(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t base;
+    std::uint8_t control;
+    StrobeTiming timing;
+    std::size_t iterations;
+    if (!py::check_nargs("spp_measure_strobe", nargs, 6) || !py::to_u16(args[0], base) ||
+        !py::to_u8(args[1], control) || !parse_timing(args + 2, timing) ||
+        !py::to_size(args[5], iterations)) {
+        return nullptr;
+    }
+    std::int64_t achieved[3];
+    Py_BEGIN_ALLOW_THREADS
+    measure_strobe(SppPorts(base), control, timing, iterations, achieved);
+    Py_END_ALLOW_THREADS
+    return Py_BuildValue("(LLL)", static_cast<long long>(achieved[0]),
+                         static_cast<long long>(achieved[1]), static_cast<long long>(achieved[2]));
+}
+
+}  // namespace
+
+PyMethodDef spp_methods[] = {
+    {"spp_strobe_byte", reinterpret_cast<PyCFunction>(spp_strobe_byte), METH_FASTCALL,
+     "spp_strobe_byte(base_address, control, value, setup_ns, pulse_ns, hold_ns)\n--\n\n"
+     "Put a byte on the data lines and pulse STROBE with the given timing."},
+    {"spp_write_buffer", reinterpret_cast<PyCFunction>(spp_write_buffer), METH_FASTCALL,
+     "spp_write_buffer(base_address, control, data, timeout, hold_while_busy,\n"
+     "                 setup_ns, pulse_ns, hold_ns)\n--\n\n"
+     "Send a bytes-like object using the SPP handshake.  Returns a tuple of the\n"
+     "number of bytes sent and whether the transfer completed before the\n"
+     "peripheral stayed busy past the timeout (in seconds, or None to wait\n"
+     "indefinitely)."},
+    {"spp_measure_strobe", reinterpret_cast<PyCFunction>(spp_measure_strobe), METH_FASTCALL,
+     "spp_measure_strobe(base_address, control, setup_ns, pulse_ns, hold_ns, iterations)\n"
+     "--\n\n"
+     "Measure the mean achieved setup, pulse and hold times in nanoseconds by\n"
+     "running the strobe sequence without changing any lines."},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+}  // namespace parallel64
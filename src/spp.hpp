@@ -0,0 +1,78 @@
+// SPDX-FileCopyrightText: 2022 Alec Delaney
+//
+// SPDX-License-Identifier: MIT
+
+// The SPP strobe sequence and handshake, shared by the blocking transfers,
+// the completion thread and the output streams.
+
+#pragma once
+
+#include "io.hpp"
+#include "pyutil.hpp"
+#include "registers.hpp"
+#include "timing.hpp"
+#include "wait.hpp"
+
+namespace parallel64 {
+
+// Data setup, STROBE pulse width and data hold times, in timer ticks
+struct StrobeTiming {
+    std::int64_t setup;
+    std::int64_t pulse;
+    std::int64_t hold;
+};
+
+struct SppPorts {
+    explicit SppPorts(std::uint16_t base)
+        : data(base + reg::DATA), status(base + reg::STATUS), control(base + reg::CONTROL) {}
+
+    std::uint16_t data;
+    std::uint16_t status;
+    std::uint16_t control;
+};
+
+// Puts a byte on the data lines and pulses STROBE, using the given control
+// byte (which must have STROBE clear) as the idle control state
+inline void strobe_byte(const SppPorts &ports, std::uint8_t control, std::uint8_t value,
+                        const StrobeTiming &timing) {
+    std::int64_t start = timing::ticks();
+    io::write8(ports.data, value);
+    timing::spin_until(start, timing.setup);
+    start = timing::ticks();
+    io::write8(ports.control, control | reg::CONTROL_STROBE);
+    timing::spin_until(start, timing.pulse);
+    start = timing::ticks();
+    io::write8(ports.control, control);
+    timing::spin_until(start, timing.hold);
+}
+
+// Sends each byte with the data/STROBE/BUSY handshake.  Stores the number of
+// bytes strobed out in sent, and returns false if the peripheral stayed busy
+// for longer than the timeout.
+inline bool write_buffer(const SppPorts &ports, std::uint8_t control, const std::uint8_t *data,
+                         std::size_t length, const StrobeTiming &timing, double timeout,
+                         bool hold_while_busy, std::size_t &sent) {
+    for (sent = 0; sent < length; ++sent) {
+        if (!wait_bits(ports.status, reg::STATUS_NOT_BUSY, reg::STATUS_NOT_BUSY,
+                       Deadline(timeout))) {
+            return false;
+        }
+        strobe_byte(ports, control, data[sent], timing);
+    }
+    return !hold_while_busy ||
+           wait_bits(ports.status, reg::STATUS_NOT_BUSY, reg::STATUS_NOT_BUSY, Deadline(timeout));
+}
+
+// Parses the setup, pulse and hold times in nanoseconds from three arguments
+inline bool parse_timing(PyObject *const *args, StrobeTiming &timing) {
+    std::int64_t setup_ns, pulse_ns, hold_ns;
+    if (!py::to_ns(args[0], setup_ns) || !py::to_ns(args[1], pulse_ns) ||
+        !py::to_ns(args[2], hold_ns)) {
+        return false;
+    }
+    timing = {timing::ns_to_ticks(setup_ns), timing::ns_to_ticks(pulse_ns),
+              timing::ns_to_ticks(hold_ns)};
+    return true;
+}
+
+}  // namespace parallel64
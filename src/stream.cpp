@@ -0,0 +1,592 @@
+// SPDX-FileCopyrightText: 2022 Alec Delaney
+//
+// SPDX-License-Identifier: MIT
+
+// Continuous output streams.
+//
+// Python fills a bounded ring of preallocated buffers, and a dedicated thread
+// sends each committed buffer to the port, either with the SPP handshake or
+// through a hardware FIFO.  The producer blocks (without the GIL) while every
+// buffer is waiting to be sent, and the thread keeps the peripheral busy
+// while Python prepares the next buffer.  Whenever the thread runs out of
+// committed buffers after the stream has started, it counts an underrun and
+// how long it waited for the next one.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "ecp.hpp"
+#include "module.hpp"
+#include "pyutil.hpp"
+#include "registers.hpp"
+#include "spp.hpp"
+#include "timing.hpp"
+#include "wait.hpp"
+
+namespace parallel64 {
+
+namespace {
+
+enum class Engine { SPP, FIFO };
+
+struct StreamConfig {
+    Engine engine;
+    std::uint16_t address;
+    double timeout;
+    std::uint8_t control;
+    StrobeTiming timing;
+    FifoConfig fifo;
+};
+
+struct StreamStats {
+    std::uint64_t bytes_sent;
+    std::uint64_t buffers_sent;
+    std::uint64_t underruns;
+    std::int64_t elapsed_ticks;
+    std::int64_t worst_stall_ticks;
+};
+
+class Stream {
+  public:
+    // Throws std::bad_alloc if the ring cannot be allocated
+    Stream(const StreamConfig &config, std::size_t count, std::size_t size)
+        : config_(config), count_(count), size_(size), storage_(new std::uint8_t[count * size]),
+          lengths_(count, 0) {}
+
+    Stream(const Stream &) = delete;
+    Stream &operator=(const Stream &) = delete;
+
+    // Must be called with the GIL released
+    ~Stream() {
+        abort();
+    }
+
+    std::size_t buffer_count() const {
+        return count_;
+    }
+
+    std::size_t buffer_size() const {
+        return size_;
+    }
+
+    // Starts the sending thread; throws std::system_error if it cannot be
+    // created
+    void start() {
+        std::lock_guard<std::mutex> joiner(join_mutex_);
+        std::lock_guard<std::mutex> lock(mutex_);
+        thread_ = std::thread(&Stream::run, this);
+    }
+
+    bool started() const {
+        return thread_.joinable();
+    }
+
+    // The number of bytes that can be written before every buffer is
+    // committed
+    std::size_t free_space() {
+        std::lock_guard<std::mutex> producer(producer_mutex_);
+        std::lock_guard<std::mutex> lock(mutex_);
+        return (count_ - (head_ - tail_)) * size_ - fill_;
+    }
+
+    // Copies data into the ring, committing each buffer as it fills, and
+    // waits up to the timeout whenever every buffer is committed.  Returns
+    // the number of bytes accepted, which is short if the wait timed out or
+    // the stream stopped.  Must be called with the GIL released.
+    std::size_t write(const std::uint8_t *data, std::size_t length, double timeout) {
+        std::lock_guard<std::mutex> producer(producer_mutex_);
+        const auto until =
+            Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                               std::chrono::duration<double>(std::max(timeout, 0.0)));
+        std::size_t accepted = 0;
+        while (accepted < length) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                const auto has_space = [this] { return stopped() || head_ - tail_ < count_; };
+                if (timeout < 0) {
+                    space_.wait(lock, has_space);
+                } else if (!space_.wait_until(lock, until, has_space)) {
+                    break;
+                }
+                if (stopped()) {
+                    break;
+                }
+            }
+            // The consumer never touches the buffer at head_ until it is
+            // committed, so it is filled without the lock
+            const std::size_t count = std::min(size_ - fill_, length - accepted);
+            std::memcpy(slot(head_) + fill_, data + accepted, count);
+            fill_ += count;
+            accepted += count;
+            if (fill_ == size_) {
+                commit();
+            }
+        }
+        return accepted;
+    }
+
+    // Commits the partly filled buffer, if any.  Must be called with the GIL
+    // released.
+    void flush() {
+        std::lock_guard<std::mutex> producer(producer_mutex_);
+        if (fill_ > 0) {
+            commit();
+        }
+    }
+
+    // Sends every committed buffer, waits for the peripheral to take the last
+    // byte and stops the thread.  Returns false if the stream failed.  Must
+    // be called with the GIL released.
+    bool close() {
+        flush();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closing_ = true;
+        }
+        ready_.notify_one();
+        space_.notify_all();
+        join();
+        std::lock_guard<std::mutex> lock(mutex_);
+        return !failed_;
+    }
+
+    // Stops the thread without sending the buffers still waiting.  Must be
+    // called with the GIL released.
+    void abort() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            aborted_ = true;
+        }
+        ready_.notify_one();
+        space_.notify_all();
+        join();
+    }
+
+    bool failed() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return failed_;
+    }
+
+    bool closed() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return closing_ || aborted_;
+    }
+
+    // The number of committed buffers not yet sent
+    std::size_t pending() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return head_ - tail_;
+    }
+
+    StreamStats stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return {bytes_sent_, tail_, underruns_, end_ticks_ - start_ticks_, worst_stall_ticks_};
+    }
+
+  private:
+    std::uint8_t *slot(std::size_t index) {
+        return storage_.get() + (index % count_) * size_;
+    }
+
+    bool stopped() const {
+        return failed_ || closing_ || aborted_;
+    }
+
+    void commit() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            lengths_[head_ % count_] = fill_;
+            ++head_;
+        }
+        fill_ = 0;
+        ready_.notify_one();
+    }
+
+    void join() {
+        std::lock_guard<std::mutex> joiner(join_mutex_);
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    bool send(const std::uint8_t *data, std::size_t length, std::size_t &sent) const {
+        if (config_.engine == Engine::FIFO) {
+            return fifo_feed(EcpPorts(config_.address), data, length, config_.fifo,
+                             config_.timeout, sent);
+        }
+        return write_buffer(SppPorts(config_.address), config_.control, data, length,
+                            config_.timing, config_.timeout, false, sent);
+    }
+
+    // Waits for the peripheral to take the last byte sent
+    bool finish() const {
+        if (config_.engine == Engine::FIFO) {
+            return wait_fifo_empty(EcpPorts(config_.address), config_.timeout);
+        }
+        return wait_bits(SppPorts(config_.address).status, reg::STATUS_NOT_BUSY,
+                         reg::STATUS_NOT_BUSY, Deadline(config_.timeout));
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        bool started = false;
+        while (!aborted_) {
+            if (tail_ == head_) {
+                if (closing_) {
+                    lock.unlock();
+                    const bool finished = !started || finish();
+                    lock.lock();
+                    failed_ = !finished;
+                    break;
+                }
+                const std::int64_t starved = timing::ticks();
+                ready_.wait(lock, [this] { return aborted_ || closing_ || tail_ != head_; });
+                if (started && tail_ != head_) {
+                    ++underruns_;
+                    worst_stall_ticks_ = std::max(worst_stall_ticks_, timing::ticks() - starved);
+                }
+                continue;
+            }
+            const std::uint8_t *data = slot(tail_);
+            const std::size_t length = lengths_[tail_ % count_];
+            if (!started) {
+                started = true;
+                start_ticks_ = end_ticks_ = timing::ticks();
+            }
+            lock.unlock();
+            std::size_t sent = 0;
+            const bool completed = send(data, length, sent);
+            lock.lock();
+            bytes_sent_ += sent;
+            end_ticks_ = timing::ticks();
+            if (!completed) {
+                failed_ = true;
+                break;
+            }
+            ++tail_;
+            space_.notify_one();
+        }
+        lock.unlock();
+        space_.notify_all();
+    }
+
+    const StreamConfig config_;
+    const std::size_t count_;
+    const std::size_t size_;
+    std::unique_ptr<std::uint8_t[]> storage_;
+    std::vector<std::size_t> lengths_;
+
+    // Only used by the producer, under producer_mutex_
+    std::mutex producer_mutex_;
+    std::size_t fill_ = 0;
+
+    std::mutex join_mutex_;
+    std::thread thread_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable ready_;
+    std::condition_variable space_;
+    std::size_t head_ = 0;
+    std::size_t tail_ = 0;
+    bool closing_ = false;
+    bool aborted_ = false;
+    bool failed_ = false;
+    std::uint64_t bytes_sent_ = 0;
+    std::uint64_t underruns_ = 0;
+    std::int64_t start_ticks_ = 0;
+    std::int64_t end_ticks_ = 0;
+    std::int64_t worst_stall_ticks_ = 0;
+};
+
+struct StreamerObject {
+    PyObject_HEAD
+    Stream *stream;
+};
+
+Stream *get_stream(PyObject *obj) {
+    return reinterpret_cast<StreamerObject *>(obj)->stream;
+}
+
+bool parse_engine(PyObject *obj, Engine &engine) {
+    const char *name = PyUnicode_AsUTF8(obj);
+    if (name == nullptr) {
+        return false;
+    }
+    if (std::strcmp(name, "spp") == 0) {
+        engine = Engine::SPP;
+    } else if (std::strcmp(name, "fifo") == 0) {
+        engine = Engine::FIFO;
+    } else {
+        PyErr_Format(PyExc_ValueError, "unknown stream engine '%s'", name);
+        return false;
+    }
+    return true;
+}
+
+PyObject *streamer_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+    static const char *keywords[] = {"engine",   "address",    "buffer_count", "buffer_size",
+                                     "timeout",  "control",    "setup_ns",     "pulse_ns",
+                                     "hold_ns",  "fifo_depth", "threshold",    nullptr};
+    PyObject *engine_obj, *address_obj, *count_obj, *size_obj, *timeout_obj;
+    PyObject *control_obj = nullptr, *setup_obj = nullptr, *pulse_obj = nullptr;
+    PyObject *hold_obj = nullptr, *depth_obj = nullptr, *threshold_obj = nullptr;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOOOO|OOOOOO:Streamer",
+                                     const_cast<char **>(keywords), &engine_obj, &address_obj,
+                                     &count_obj, &size_obj, &timeout_obj, &control_obj,
+                                     &setup_obj, &pulse_obj, &hold_obj, &depth_obj,
+                                     &threshold_obj)) {
+        return nullptr;
+    }
+    StreamConfig config{Engine::SPP, 0, 0.0, 0, {0, 0, 0}, {16, 8, 1}};
+    std::size_t count, size;
+    std::int64_t timing_ns[3] = {0, 0, 0};
+    PyObject *timing_objs[3] = {setup_obj, pulse_obj, hold_obj};
+    if (!parse_engine(engine_obj, config.engine) || !py::to_u16(address_obj, config.address) ||
+        !py::to_size(count_obj, count) || !py::to_size(size_obj, size) ||
+        !py::to_timeout(timeout_obj, config.timeout) ||
+        (control_obj != nullptr && !py::to_u8(control_obj, config.control)) ||
+        (depth_obj != nullptr && !py::to_size(depth_obj, config.fifo.depth)) ||
+        (threshold_obj != nullptr && !py::to_size(threshold_obj, config.fifo.threshold))) {
+        return nullptr;
+    }
+    for (int i = 0; i < 3; ++i) {
+        if (timing_objs[i] != nullptr && !py::to_ns(timing_objs[i], timing_ns[i])) {
+            return nullptr;
+        }
+    }
+    if (count == 0 || size == 0) {
+        PyErr_SetString(PyExc_ValueError, "buffer_count and buffer_size must be positive");
+        return nullptr;
+    }
+    if (count > SIZE_MAX / size) {
+        PyErr_SetString(PyExc_MemoryError, "buffer_count * buffer_size is too large");
+        return nullptr;
+    }
+    // The engines feed the FIFO a byte at a time, so it has 8-bit PWords
+    if (!check_fifo_config(config.fifo)) {
+        return nullptr;
+    }
+    config.control &= ~reg::CONTROL_STROBE;
+    config.timing = {timing::ns_to_ticks(timing_ns[0]), timing::ns_to_ticks(timing_ns[1]),
+                     timing::ns_to_ticks(timing_ns[2])};
+
+    auto *self = reinterpret_cast<StreamerObject *>(type->tp_alloc(type, 0));
+    if (self == nullptr) {
+        return nullptr;
+    }
+    try {
+        self->stream = new Stream(config, count, size);
+    } catch (const std::bad_alloc &) {
+        Py_DECREF(self);
+        return PyErr_NoMemory();
+    }
+    return reinterpret_cast<PyObject *>(self);
+}
+
+void streamer_dealloc(PyObject *obj) {
+    Stream *stream = get_stream(obj);
+    Py_BEGIN_ALLOW_THREADS
+    delete stream;
+    Py_END_ALLOW_THREADS
+    PyTypeObject *type = Py_TYPE(obj);
+    type->tp_free(obj);
+    Py_DECREF(type);
+}
+
+bool start_stream(Stream *stream) {
+    try {
+        stream->start();
+    } catch (const std::exception &err) {
+        PyErr_SetString(PyExc_OSError, err.what());
+        return false;
+    }
+    return true;
+}
+
+PyObject *streamer_start(PyObject *obj, PyObject *) {
+    Stream *stream = get_stream(obj);
+    if (stream->started()) {
+        PyErr_SetString(PyExc_RuntimeError, "the stream is already running");
+        return nullptr;
+    }
+    if (stream->closed()) {
+        PyErr_SetString(PyExc_ValueError, "the stream is closed");
+        return nullptr;
+    }
+    if (!start_stream(stream)) {
+        return nullptr;
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject *streamer_write(PyObject *obj, PyObject *const *args, Py_ssize_t nargs) {
+    Stream *stream = get_stream(obj);
+    double timeout = -1.0;
+    if (nargs < 1 || nargs > 2) {
+        PyErr_SetString(PyExc_TypeError, "write() takes 1 or 2 arguments");
+        return nullptr;
+    }
+    py::Buffer buffer;
+    if (!buffer.acquire(args[0]) || (nargs == 2 && !py::to_timeout(args[1], timeout))) {
+        return nullptr;
+    }
+    if (stream->closed()) {
+        PyErr_SetString(PyExc_ValueError, "the stream is closed");
+        return nullptr;
+    }
+    // Nothing frees a buffer until the thread runs, so a stream that was not
+    // started is started once the data does not fit in the ring
+    if (!stream->started() && buffer.size() > stream->free_space() && !start_stream(stream)) {
+        return nullptr;
+    }
+    std::size_t accepted;
+    Py_BEGIN_ALLOW_THREADS
+    accepted = stream->write(buffer.data(), buffer.size(), timeout);
+    Py_END_ALLOW_THREADS
+    return PyLong_FromSize_t(accepted);
+}
+
+PyObject *streamer_flush(PyObject *obj, PyObject *) {
+    Stream *stream = get_stream(obj);
+    Py_BEGIN_ALLOW_THREADS
+    stream->flush();
+    Py_END_ALLOW_THREADS
+    Py_RETURN_NONE;
+}
+
+PyObject *streamer_close(PyObject *obj, PyObject *) {
+    Stream *stream = get_stream(obj);
+    // Data queued in a stream that was never started is sent before closing
+    if (!stream->started() && !stream->closed() &&
+        stream->free_space() < stream->buffer_count() * stream->buffer_size() &&
+        !start_stream(stream)) {
+        return nullptr;
+    }
+    bool completed;
+    Py_BEGIN_ALLOW_THREADS
+    completed = stream->close();
+    Py_END_ALLOW_THREADS
+    return PyBool_FromLong(completed);
+}
+
+PyObject *streamer_abort(PyObject *obj, PyObject *) {
+    Stream *stream = get_stream(obj);
+    Py_BEGIN_ALLOW_THREADS
+    stream->abort();
+    Py_END_ALLOW_THREADS
+    Py_RETURN_NONE;
+}
+
+PyObject *streamer_stats(PyObject *obj, PyObject *) {
+    const StreamStats stats = get_stream(obj)->stats();
+    return Py_BuildValue("(KKKLL)", static_cast<unsigned long long>(stats.bytes_sent),
+                         static_cast<unsigned long long>(stats.buffers_sent),
+                         static_cast<unsigned long long>(stats.underruns),
+                         static_cast<long long>(timing::ticks_to_ns(stats.elapsed_ticks)),
+                         static_cast<long long>(timing::ticks_to_ns(stats.worst_stall_ticks)));
+}
+
+PyObject *streamer_get_running(PyObject *obj, void *) {
+    Stream *stream = get_stream(obj);
+    return PyBool_FromLong(stream->started() && !stream->closed() && !stream->failed());
+}
+
+PyObject *streamer_get_failed(PyObject *obj, void *) {
+    return PyBool_FromLong(get_stream(obj)->failed());
+}
+
+PyObject *streamer_get_pending(PyObject *obj, void *) {
+    return PyLong_FromSize_t(get_stream(obj)->pending());
+}
+
+PyObject *streamer_get_buffer_count(PyObject *obj, void *) {
+    return PyLong_FromSize_t(get_stream(obj)->buffer_count());
+}
+
+PyObject *streamer_get_buffer_size(PyObject *obj, void *) {
+    return PyLong_FromSize_t(get_stream(obj)->buffer_size());
+}
+
+PyMethodDef streamer_object_methods[] = {
+    {"start", streamer_start, METH_NOARGS, "start()\n--\n\nStart the sending thread."},
+    {"write", reinterpret_cast<PyCFunction>(streamer_write), METH_FASTCALL,
+     "write(data, timeout=None)\n--\n\n"
+     "Copy a bytes-like object into the ring, committing each buffer as it fills\n"
+     "and waiting up to timeout seconds (or indefinitely for None) whenever every\n"
+     "buffer is waiting to be sent.  Starts the thread if it was not started and\n"
+     "the data does not fit in the ring.  Returns the number of bytes accepted."},
+    {"flush", streamer_flush, METH_NOARGS,
+     "flush()\n--\n\nCommit the partly filled buffer, if any."},
+    {"close", streamer_close, METH_NOARGS,
+     "close()\n--\n\n"
+     "Send the remaining buffers, starting the thread if it was not started, wait\n"
+     "for the peripheral to take the last byte and stop the thread.  Returns\n"
+     "False if the stream failed."},
+    {"abort", streamer_abort, METH_NOARGS,
+     "abort()\n--\n\nStop the thread without sending the remaining buffers."},
+    {"stats", streamer_stats, METH_NOARGS,
+     "stats()\n--\n\n"
+     "Return (bytes_sent, buffers_sent, underruns, elapsed_ns, worst_stall_ns)."},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+PyGetSetDef streamer_getset[] = {
+    {"running", streamer_get_running, nullptr, "Whether the sending thread is running.",
+     nullptr},
+    {"failed", streamer_get_failed, nullptr,
+     "Whether the peripheral stalled for longer than the timeout.", nullptr},
+    {"pending", streamer_get_pending, nullptr, "Committed buffers waiting to be sent.",
+     nullptr},
+    {"buffer_count", streamer_get_buffer_count, nullptr, "The number of buffers in the ring.",
+     nullptr},
+    {"buffer_size", streamer_get_buffer_size, nullptr, "The size of each buffer in bytes.",
+     nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr},
+};
+
+PyType_Slot streamer_slots[] = {
+    {Py_tp_new, reinterpret_cast<void *>(streamer_new)},
+    {Py_tp_dealloc, reinterpret_cast<void *>(streamer_dealloc)},
+    {Py_tp_methods, streamer_object_methods},
+    {Py_tp_getset, streamer_getset},
+    {Py_tp_doc,
+     const_cast<char *>("Streamer(engine, address, buffer_count, buffer_size, timeout, "
+                        "control=0, setup_ns=0, pulse_ns=0, hold_ns=0, fifo_depth=16, "
+                        "threshold=8)\n--\n\n"
+                        "Stream data to the port from a background thread, with the SPP\n"
+                        "handshake (engine \"spp\", at the SPP base address) or through a\n"
+                        "hardware FIFO (engine \"fifo\", at the ECP base address).")},
+    {0, nullptr},
+};
+
+PyType_Spec streamer_spec = {
+    "parallel64._native.Streamer",
+    sizeof(StreamerObject),
+    0,
+    Py_TPFLAGS_DEFAULT,
+    streamer_slots,
+};
+
+}  // namespace
+
+bool add_streamer_type(PyObject *module) {
+    PyObject *type = PyType_FromSpec(&streamer_spec);
+    if (type == nullptr) {
+        return false;
+    }
+    if (PyModule_AddObject(module, "Streamer", type) != 0) {
+        Py_DECREF(type);
+        return false;
+    }
+    return true;
+}
+
+}  // namespace parallel64
@@ -0,0 +1,137 @@
+// SPDX-FileCopyrightText: 2022 Alec Delaney
+//
+// SPDX-License-Identifier: MIT
+
+// Controls for the calling thread, used to pin the I/O worker threads of a
+// ``PortGroup`` to their own processors and by ``RealtimeScope`` to raise
+// the scheduling of a thread for timing-sensitive transfers.
+
+#include <windows.h>
+
+#include <avrt.h>
+#include <timeapi.h>
+
+#include "module.hpp"
+#include "pyutil.hpp"
+
+namespace parallel64 {
+
+namespace {
+
+PyObject *set_thread_affinity(PyObject *, PyObject *arg) {
+    unsigned long long mask = PyLong_AsUnsignedLongLong(arg);
+    if (mask == static_cast<unsigned long long>(-1) && PyErr_Occurred()) {
+        return nullptr;
+    }
+    if (mask == 0 || mask > static_cast<unsigned long long>(static_cast<DWORD_PTR>(-1))) {
+        PyErr_SetString(PyExc_ValueError, "the affinity mask must select at least one processor");
+        return nullptr;
+    }
+    const DWORD_PTR previous =
+        SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(mask));
+    if (previous == 0) {
+        return PyErr_SetFromWindowsErr(0);
+    }
+    return PyLong_FromUnsignedLongLong(previous);
+}
+
+PyObject *set_thread_priority(PyObject *, PyObject *arg) {
+    const long priority = PyLong_AsLong(arg);
+    if (priority == -1 && PyErr_Occurred()) {
+        return nullptr;
+    }
+    const HANDLE thread = GetCurrentThread();
+    const int previous = GetThreadPriority(thread);
+    if (previous == THREAD_PRIORITY_ERROR_RETURN ||
+        !SetThreadPriority(thread, static_cast<int>(priority))) {
+        return PyErr_SetFromWindowsErr(0);
+    }
+    return PyLong_FromLong(previous);
+}
+
+PyObject *join_mmcss_task(PyObject *, PyObject *arg) {
+    wchar_t *task = PyUnicode_AsWideCharString(arg, nullptr);
+    if (task == nullptr) {
+        return nullptr;
+    }
+    DWORD index = 0;
+    const HANDLE handle = AvSetMmThreadCharacteristicsW(task, &index);
+    PyMem_Free(task);
+    if (handle == nullptr) {
+        return PyErr_SetFromWindowsErr(0);
+    }
+    return PyLong_FromVoidPtr(handle);
+}
+
+PyObject *leave_mmcss_task(PyObject *, PyObject *arg) {
+    const HANDLE handle = PyLong_AsVoidPtr(arg);
+    if (handle == nullptr && PyErr_Occurred()) {
+        return nullptr;
+    }
+    if (!AvRevertMmThreadCharacteristics(handle)) {
+        return PyErr_SetFromWindowsErr(0);
+    }
+    Py_RETURN_NONE;
+}
+
+bool to_timer_period(PyObject *arg, UINT &period) {
+    const unsigned long value = PyLong_AsUnsignedLong(arg);
+    if (value == static_cast<unsigned long>(-1) && PyErr_Occurred()) {
+        return false;
+    }
+    period = static_cast<UINT>(value);
+    return true;
+}
+
+PyObject *begin_timer_period(PyObject *, PyObject *arg) {
+    UINT period;
+    if (!to_timer_period(arg, period)) {
+        return nullptr;
+    }
+    if (timeBeginPeriod(period) != TIMERR_NOERROR) {
+        return PyErr_Format(PyExc_ValueError, "a timer period of %u ms is not supported",
+                            static_cast<unsigned int>(period));
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject *end_timer_period(PyObject *, PyObject *arg) {
+    UINT period;
+    if (!to_timer_period(arg, period)) {
+        return nullptr;
+    }
+    if (timeEndPeriod(period) != TIMERR_NOERROR) {
+        return PyErr_Format(PyExc_ValueError, "a timer period of %u ms was not requested",
+                            static_cast<unsigned int>(period));
+    }
+    Py_RETURN_NONE;
+}
+
+}  // namespace
+
+PyMethodDef thread_methods[] = {
+    {"set_thread_affinity", set_thread_affinity, METH_O,
+     "set_thread_affinity(mask)\n--\n\n"
+     "Restrict the calling thread to the processors set in the mask, returning\n"
+     "its previous affinity mask."},
+    {"set_thread_priority", set_thread_priority, METH_O,
+     "set_thread_priority(priority)\n--\n\n"
+     "Set the priority of the calling thread to a THREAD_PRIORITY_* value,\n"
+     "returning its previous priority."},
+    {"join_mmcss_task", join_mmcss_task, METH_O,
+     "join_mmcss_task(task)\n--\n\n"
+     "Register the calling thread with the named MMCSS task, such as \"Pro Audio\",\n"
+     "returning the handle to pass to leave_mmcss_task()."},
+    {"leave_mmcss_task", leave_mmcss_task, METH_O,
+     "leave_mmcss_task(handle)\n--\n\n"
+     "Remove the calling thread from the MMCSS task it joined."},
+    {"begin_timer_period", begin_timer_period, METH_O,
+     "begin_timer_period(ms)\n--\n\n"
+     "Request a system timer resolution in milliseconds, which shortens sleeps."},
+    {"end_timer_period", end_timer_period, METH_O,
+     "end_timer_period(ms)\n--\n\n"
+     "Release a timer resolution requested with begin_timer_period()."},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+}  // namespace parallel64
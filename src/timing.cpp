@@ -0,0 +1,109 @@
+// SPDX-FileCopyrightText: 2022 Alec Delaney
+//
+// SPDX-License-Identifier: MIT
+
+// Python bindings for the high-resolution timing primitives.
+
+#include <algorithm>
+
+#include "io.hpp"
+#include "module.hpp"
+#include "pyutil.hpp"
+#include "timing.hpp"
+
+namespace parallel64 {
+
+namespace {
+
+PyObject *delay_ns(PyObject *, PyObject *arg) {
+    std::int64_t ns;
+    if (!py::to_ns(arg, ns)) {
+        return nullptr;
+    }
+    if (ns < 100000) {
+        timing::delay_ns(ns);
+    } else {
+        Py_BEGIN_ALLOW_THREADS
+        timing::delay_ns(ns);
+        Py_END_ALLOW_THREADS
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject *timer_resolution_ns(PyObject *, PyObject *) {
+    return PyLong_FromLongLong(std::max<std::int64_t>(timing::ticks_to_ns(1), 1));
+}
+
+// The release time is on the same clock as ``time.perf_counter_ns()``, which
+// is also based on QueryPerformanceCounter, so threads rendezvousing in
+// Python can agree on it
+PyObject *write_port_at(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::uint16_t port;
+    std::uint8_t value;
+    std::int64_t release_ns;
+    if (!py::check_nargs("write_port_at", nargs, 3) || !py::to_u16(args[0], port) ||
+        !py::to_u8(args[1], value) || !py::to_ns(args[2], release_ns)) {
+        return nullptr;
+    }
+    std::int64_t late_ns;
+    Py_BEGIN_ALLOW_THREADS
+    std::int64_t now;
+    do {
+        now = timing::ticks_to_ns(timing::ticks());
+    } while (now < release_ns);
+    io::write8(port, value);
+    late_ns = now - release_ns;
+    Py_END_ALLOW_THREADS
+    return PyLong_FromLongLong(late_ns);
+}
+
+// Spins until each of a series of deadlines period_ns apart and accumulates
+// how late the thread saw them, which is how late a strobe or pattern step
+// would start under the current scheduling.  Each deadline is counted from
+// when the previous one was seen, so one preemption is only counted once.
+PyObject *measure_jitter(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    std::size_t samples;
+    std::int64_t period_ns;
+    if (!py::check_nargs("measure_jitter", nargs, 2) || !py::to_size(args[0], samples) ||
+        !py::to_ns(args[1], period_ns)) {
+        return nullptr;
+    }
+    std::int64_t max_late = 0;
+    std::int64_t total_late = 0;
+    Py_BEGIN_ALLOW_THREADS
+    const std::int64_t period = timing::ns_to_ticks(period_ns);
+    std::int64_t seen = timing::ticks();
+    for (std::size_t sample = 0; sample < samples; ++sample) {
+        const std::int64_t due = seen + period;
+        do {
+            seen = timing::ticks();
+        } while (seen < due);
+        max_late = std::max(max_late, seen - due);
+        total_late += seen - due;
+    }
+    Py_END_ALLOW_THREADS
+    return Py_BuildValue("(nLL)", static_cast<Py_ssize_t>(samples),
+                         static_cast<long long>(timing::ticks_to_ns(max_late)),
+                         static_cast<long long>(timing::ticks_to_ns(total_late)));
+}
+
+}  // namespace
+
+PyMethodDef timing_methods[] = {
+    {"delay_ns", delay_ns, METH_O,
+     "delay_ns(ns)\n--\n\nSpin for at least the given number of nanoseconds."},
+    {"timer_resolution_ns", timer_resolution_ns, METH_NOARGS,
+     "timer_resolution_ns()\n--\n\nReturn the resolution of the delay timer in nanoseconds."},
+    {"write_port_at", reinterpret_cast<PyCFunction>(write_port_at), METH_FASTCALL,
+     "write_port_at(port, value, release_ns)\n--\n\n"
+     "Spin until time.perf_counter_ns() reaches release_ns, then write a byte to\n"
+     "the given port.  Returns how late the write started, in nanoseconds."},
+    {"measure_jitter", reinterpret_cast<PyCFunction>(measure_jitter), METH_FASTCALL,
+     "measure_jitter(samples, period_ns)\n--\n\n"
+     "Spin until each of a series of deadlines period_ns apart, returning a tuple\n"
+     "of the number of samples and the maximum and total time they were seen\n"
+     "late, in nanoseconds."},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+}  // namespace parallel64
@@ -0,0 +1,64 @@
+// SPDX-FileCopyrightText: 2022 Alec Delaney
+//
+// SPDX-License-Identifier: MIT
+
+// High-resolution delays based on QueryPerformanceCounter.
+//
+// Delays are anchored on a tick count taken before the I/O that starts an
+// interval, so the cost of the I/O itself counts towards the delay rather
+// than being added on top of it.
+
+#pragma once
+
+#include <cstdint>
+
+#include <windows.h>
+
+namespace parallel64::timing {
+
+constexpr std::int64_t NS_PER_SECOND = 1000000000;
+
+inline std::int64_t frequency() {
+    static const std::int64_t ticks_per_second = [] {
+        LARGE_INTEGER value;
+        QueryPerformanceFrequency(&value);
+        return static_cast<std::int64_t>(value.QuadPart);
+    }();
+    return ticks_per_second;
+}
+
+inline std::int64_t ticks() {
+    LARGE_INTEGER value;
+    QueryPerformanceCounter(&value);
+    return static_cast<std::int64_t>(value.QuadPart);
+}
+
+// Rounds up, so a delay is never shorter than requested
+inline std::int64_t ns_to_ticks(std::int64_t ns) {
+    if (ns <= 0) {
+        return 0;
+    }
+    const std::int64_t freq = frequency();
+    return (ns / NS_PER_SECOND) * freq + ((ns % NS_PER_SECOND) * freq + NS_PER_SECOND - 1) /
+                                             NS_PER_SECOND;
+}
+
+inline std::int64_t ticks_to_ns(std::int64_t count) {
+    const std::int64_t freq = frequency();
+    return (count / freq) * NS_PER_SECOND + (count % freq) * NS_PER_SECOND / freq;
+}
+
+// Spins until the given number of ticks have elapsed since start
+inline void spin_until(std::int64_t start, std::int64_t duration) {
+    if (duration <= 0) {
+        return;
+    }
+    while (ticks() - start < duration) {
+    }
+}
+
+inline void delay_ns(std::int64_t ns) {
+    spin_until(ticks(), ns_to_ticks(ns));
+}
+
+}  // namespace parallel64::timing
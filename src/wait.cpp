@@ -0,0 +1,178 @@
+// SPDX-FileCopyrightText: 2022 Alec Delaney
+//
+// SPDX-License-Identifier: MIT
+
+// The process-wide wait policy, the per-thread wait counters, and their
+// Python bindings.
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "module.hpp"
+#include "pyutil.hpp"
+#include "wait.hpp"
+
+namespace parallel64 {
+
+namespace {
+
+std::atomic<std::int64_t> policy_spin_ns{50000};
+std::atomic<std::int64_t> policy_yield_ns{1000000};
+
+// Each thread keeps its own wait counters, which only it updates, so waits
+// on different threads never contend for a cache line.  A reset starts a new
+// epoch: a thread whose counters are from an older epoch clears them at its
+// next wait, and wait_stats() skips them until then.
+struct ThreadWaitStats {
+    std::atomic<std::uint64_t> epoch{0};
+    std::atomic<std::uint64_t> waits{0};
+    std::atomic<std::uint64_t> timeouts{0};
+    std::atomic<std::uint64_t> total_ns{0};
+    std::atomic<std::uint64_t> max_ns{0};
+};
+
+std::atomic<std::uint64_t> stats_epoch{1};
+
+// The counters of the running threads, and the totals of the threads that
+// exited during the current epoch
+std::mutex registry_mutex;
+std::vector<ThreadWaitStats *> registry;
+WaitStats retired{0, 0, 0, 0};
+
+void add_stats(WaitStats &totals, const ThreadWaitStats &stats) {
+    totals.waits += stats.waits.load(std::memory_order_relaxed);
+    totals.timeouts += stats.timeouts.load(std::memory_order_relaxed);
+    totals.total_ns += stats.total_ns.load(std::memory_order_relaxed);
+    totals.max_ns = std::max(totals.max_ns, stats.max_ns.load(std::memory_order_relaxed));
+}
+
+// Only ever written by the owning thread, so a load and a store replace the
+// read-modify-write instructions
+void bump(std::atomic<std::uint64_t> &counter, std::uint64_t amount) {
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+class ThreadRegistration {
+  public:
+    ThreadRegistration() {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        registry.push_back(&stats);
+    }
+
+    ~ThreadRegistration() {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        if (stats.epoch.load(std::memory_order_relaxed) ==
+            stats_epoch.load(std::memory_order_relaxed)) {
+            add_stats(retired, stats);
+        }
+        registry.erase(std::find(registry.begin(), registry.end(), &stats));
+    }
+
+    ThreadWaitStats stats;
+};
+
+thread_local ThreadRegistration thread_registration;
+
+}  // namespace
+
+WaitPolicy wait_policy() {
+    return {policy_spin_ns.load(std::memory_order_relaxed),
+            policy_yield_ns.load(std::memory_order_relaxed)};
+}
+
+void set_wait_policy(const WaitPolicy &policy) {
+    policy_spin_ns.store(policy.spin_ns, std::memory_order_relaxed);
+    policy_yield_ns.store(policy.yield_ns, std::memory_order_relaxed);
+}
+
+WaitStats wait_stats() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    const std::uint64_t epoch = stats_epoch.load(std::memory_order_relaxed);
+    WaitStats totals = retired;
+    for (const ThreadWaitStats *stats : registry) {
+        if (stats->epoch.load(std::memory_order_acquire) == epoch) {
+            add_stats(totals, *stats);
+        }
+    }
+    return totals;
+}
+
+void reset_wait_stats() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    stats_epoch.fetch_add(1, std::memory_order_relaxed);
+    retired = {0, 0, 0, 0};
+}
+
+void record_wait(Clock::duration waited, bool matched) {
+    ThreadWaitStats &stats = thread_registration.stats;
+    const auto ns = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count());
+    const std::uint64_t epoch = stats_epoch.load(std::memory_order_relaxed);
+    if (stats.epoch.load(std::memory_order_relaxed) != epoch) {
+        stats.waits.store(0, std::memory_order_relaxed);
+        stats.timeouts.store(0, std::memory_order_relaxed);
+        stats.total_ns.store(0, std::memory_order_relaxed);
+        stats.max_ns.store(0, std::memory_order_relaxed);
+        stats.epoch.store(epoch, std::memory_order_release);
+    }
+    bump(stats.waits, 1);
+    if (!matched) {
+        bump(stats.timeouts, 1);
+    }
+    bump(stats.total_ns, ns);
+    if (ns > stats.max_ns.load(std::memory_order_relaxed)) {
+        stats.max_ns.store(ns, std::memory_order_relaxed);
+    }
+}
+
+namespace {
+
+PyObject *py_set_wait_policy(PyObject *, PyObject *const *args, Py_ssize_t nargs) {
+    WaitPolicy policy;
+    if (!py::check_nargs("set_wait_policy", nargs, 2) || !py::to_ns(args[0], policy.spin_ns) ||
+        !py::to_ns(args[1], policy.yield_ns)) {
+        return nullptr;
+    }
+    set_wait_policy(policy);
+    Py_RETURN_NONE;
+}
+
+PyObject *py_get_wait_policy(PyObject *, PyObject *) {
+    const WaitPolicy policy = wait_policy();
+    return Py_BuildValue("(LL)", static_cast<long long>(policy.spin_ns),
+                         static_cast<long long>(policy.yield_ns));
+}
+
+PyObject *py_wait_stats(PyObject *, PyObject *) {
+    const WaitStats stats = wait_stats();
+    return Py_BuildValue("(KKKK)", static_cast<unsigned long long>(stats.waits),
+                         static_cast<unsigned long long>(stats.timeouts),
+                         static_cast<unsigned long long>(stats.total_ns),
+                         static_cast<unsigned long long>(stats.max_ns));
+}
+
+PyObject *py_reset_wait_stats(PyObject *, PyObject *) {
+    reset_wait_stats();
+    Py_RETURN_NONE;
+}
+
+}  // namespace
+
+PyMethodDef wait_methods[] = {
+    {"set_wait_policy", reinterpret_cast<PyCFunction>(py_set_wait_policy), METH_FASTCALL,
+     "set_wait_policy(spin_ns, yield_ns)\n--\n\n"
+     "Set how long waits spin, then yield, before sleeping between polls."},
+    {"get_wait_policy", py_get_wait_policy, METH_NOARGS,
+     "get_wait_policy()\n--\n\nReturn the (spin_ns, yield_ns) wait policy."},
+    {"wait_stats", py_wait_stats, METH_NOARGS,
+     "wait_stats()\n--\n\n"
+     "Return (waits, timeouts, total_ns, max_ns) over every wait since the\n"
+     "counters were last reset."},
+    {"reset_wait_stats", py_reset_wait_stats, METH_NOARGS,
+     "reset_wait_stats()\n--\n\nReset the wait counters."},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+}  // namespace parallel64
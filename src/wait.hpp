@@ -0,0 +1,125 @@
+// SPDX-FileCopyrightText: 2022 Alec Delaney
+//
+// SPDX-License-Identifier: MIT
+
+// Deadlines and register polling used by the handshake loops.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#include "io.hpp"
+#include "timing.hpp"
+
+namespace parallel64 {
+
+using Clock = std::chrono::steady_clock;
+
+// A point in time after which a wait gives up; a negative timeout never expires
+class Deadline {
+  public:
+    explicit Deadline(double seconds)
+        : infinite_(seconds < 0),
+          when_(infinite_ ? Clock::time_point::max()
+                          : Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                                               std::chrono::duration<double>(seconds))) {}
+
+    bool expired() const {
+        return !infinite_ && Clock::now() >= when_;
+    }
+
+  private:
+    bool infinite_;
+    Clock::time_point when_;
+};
+
+// How a wait backs off: it spins for spin_ns, then yields the rest of its
+// time slice until yield_ns more have passed, then sleeps for a millisecond
+// at a time
+struct WaitPolicy {
+    std::int64_t spin_ns;
+    std::int64_t yield_ns;
+};
+
+// Totals over every wait that needed more than one poll since the counters
+// were last reset
+struct WaitStats {
+    std::uint64_t waits;
+    std::uint64_t timeouts;
+    std::uint64_t total_ns;
+    std::uint64_t max_ns;
+};
+
+WaitPolicy wait_policy();
+void set_wait_policy(const WaitPolicy &policy);
+WaitStats wait_stats();
+void reset_wait_stats();
+void record_wait(Clock::duration waited, bool matched);
+
+// Polls the port until the masked bits equal the value, backing off as set by
+// the wait policy, and returns false if the deadline passes first
+inline bool wait_bits(std::uint16_t port, std::uint8_t mask, std::uint8_t value,
+                      const Deadline &deadline) {
+    // A wait the first poll satisfies is not counted, which keeps the
+    // counters off the per-byte fast path of the transfers
+    if ((io::read8(port) & mask) == value) {
+        metrics::record_wait(port, 0, true);
+        return true;
+    }
+    const WaitPolicy policy = wait_policy();
+    const auto spin = std::chrono::nanoseconds(policy.spin_ns);
+    const auto yield = spin + std::chrono::nanoseconds(policy.yield_ns);
+    const auto start = Clock::now();
+    bool matched;
+    for (;;) {
+        if ((io::read8(port) & mask) == value) {
+            matched = true;
+            break;
+        }
+        if (deadline.expired()) {
+            matched = (io::read8(port) & mask) == value;
+            break;
+        }
+        const auto waited = Clock::now() - start;
+        if (waited < spin) {
+            continue;
+        }
+        if (waited < yield) {
+            SwitchToThread();
+        } else {
+            Sleep(1);
+        }
+    }
+    const auto waited = Clock::now() - start;
+    record_wait(waited, matched);
+    metrics::record_wait(
+        port,
+        static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count()),
+        matched);
+    return matched;
+}
+
+// Waits until the tick count reaches the target.  This is the wait policy in
+// reverse: it sleeps a millisecond at a time until only the spin and yield
+// windows are left, yields until only the spin window is left, and spins for
+// the rest, so a long wait does not keep a core busy
+inline void wait_until_ticks(std::int64_t target) {
+    const WaitPolicy policy = wait_policy();
+    const std::int64_t spin = timing::ns_to_ticks(policy.spin_ns);
+    const std::int64_t yield = spin + timing::ns_to_ticks(policy.yield_ns);
+    for (;;) {
+        const std::int64_t left = target - timing::ticks();
+        if (left <= 0) {
+            return;
+        }
+        if (left > yield) {
+            Sleep(1);
+        } else if (left > spin) {
+            SwitchToThread();
+        }
+    }
+}
+
+}  // namespace parallel64
@@ -0,0 +1,250 @@
+# SPDX-FileCopyrightText: 2022 Alec Delaney
+#
+# SPDX-License-Identifier: MIT
+
+"""Smoke tests of the ports against the simulator, which run on any system:
+
+.. code-block:: shell
+
+    PARALLEL64_SIMULATOR=1 python -m unittest discover tests
+"""
+
+import os
+import struct
+import threading
+import time
+import unittest
+from unittest import mock
+
+os.environ.setdefault("PARALLEL64_SIMULATOR", "1")
+
+# pylint: disable=wrong-import-position
+import parallel64
+from parallel64 import Register
+from parallel64.backend import native
+from parallel64.sampler import InputSampler
+
+SPP_BASE = 0x378
+ECP_BASE = 0x778
+
+
+class SimulatorTestCase(unittest.TestCase):
+    def setUp(self):
+        parallel64.clear_capability_cache()
+        self.simulator = parallel64.SimulatedBackend()
+        self.peripheral = parallel64.SimulatedPeripheral()
+        self.simulator.registers.add_port(SPP_BASE, ECP_BASE, self.peripheral)
+
+    def standard_port(self, **kwargs):
+        return parallel64.StandardPort(
+            SPP_BASE, self.simulator.windll_location, **kwargs
+        )
+
+
+class TestSppBuffers(SimulatorTestCase):
+    def test_write_spp_buffer(self):
+        port = self.standard_port()
+        port.write_spp_buffer(b"hello")
+        self.assertEqual(bytes(self.peripheral.received), b"hello")
+
+    def test_write_spp_buffer_through_fifo(self):
+        port = self.standard_port(ecp_base_address=ECP_BASE)
+        self.assertTrue(port.uses_hardware_fifo)
+        port.write_spp_buffer(bytes(range(100)))
+        self.assertEqual(bytes(self.peripheral.received), bytes(range(100)))
+
+    def test_read_spp_data_into(self):
+        port = self.standard_port()
+        self.peripheral.data_lines = 0x5A
+        buffer = bytearray(4)
+        self.assertEqual(port.read_spp_data_into(buffer), 4)
+        self.assertEqual(bytes(buffer), b"\x5a" * 4)
+
+
+class TestBidirectionalDetection(unittest.TestCase):
+    def setUp(self):
+        parallel64.clear_capability_cache()
+
+    def detect(self, bidirectional):
+        simulator = parallel64.SimulatedBackend()
+        simulator.registers.add_port(SPP_BASE, bidirectional=bidirectional)
+        return parallel64.StandardPort(SPP_BASE, simulator.windll_location, probe=True)
+
+    def test_bidirectional_port(self):
+        self.assertTrue(self.detect(True).is_bidirectional)
+
+    def test_unidirectional_port(self):
+        port = self.detect(False)
+        self.assertFalse(port.is_bidirectional)
+        with self.assertRaises(OSError):
+            port.read_spp_data()
+
+
+class TestPrograms(SimulatorTestCase):
+    def test_reads_and_writes(self):
+        port = self.standard_port()
+        program = parallel64.PortProgram()
+        program.write(Register.DATA, 0x42)
+        program.read(Register.DATA)
+        program.write(Register.CONTROL, 0b00000100)
+        program.read(Register.CONTROL)
+        self.assertEqual(port.execute(program).reads, b"\x42\x04")
+
+    def test_wait_timeout(self):
+        port = self.standard_port()
+        program = parallel64.PortProgram()
+        program.read(Register.DATA)
+        program.wait_bit(Register.STATUS, 0b00001000, 0, timeout=0.01)
+        program.read(Register.DATA)
+        with self.assertRaises(parallel64.TransferTimeoutError) as context:
+            port.execute(program)
+        self.assertEqual(context.exception.bytes_transferred, 1)
+
+    @staticmethod
+    def compile(*instructions):
+        return b"".join(
+            struct.pack("<BBHBBxxq", opcode, 0, port, 0, 0, arg)
+            for opcode, port, arg in instructions
+        )
+
+    def test_crossing_loops_rejected(self):
+        # The loop at 3 repeats 1..2, which holds the end of the loop at 2
+        # but not its start
+        program = self.compile((2, SPP_BASE, 0), (2, SPP_BASE, 0), (5, 0, 2), (5, 1, 2))
+        backends = [self.simulator] if native is None else [self.simulator, native]
+        for backend in backends:
+            with self.assertRaises(ValueError):
+                backend.run_program(program)
+
+    def test_nested_loops(self):
+        program = self.compile((2, SPP_BASE, 0), (2, SPP_BASE, 0), (5, 1, 3), (5, 0, 2))
+        reads, failed = self.simulator.run_program(program)
+        self.assertEqual((len(reads), failed), (8, -1))
+
+
+class TestStreams(SimulatorTestCase):
+    def test_spp_stream(self):
+        port = self.standard_port()
+        with port.open_stream(buffer_count=2, buffer_size=64) as stream:
+            stream.write(bytes(range(200)))
+        self.assertEqual(stream.stats().bytes_sent, 200)
+        self.assertEqual(bytes(self.peripheral.received), bytes(range(200)))
+
+    def test_stream_not_started(self):
+        port = self.standard_port()
+        stream = port.open_stream(buffer_count=2, buffer_size=64)
+        self.assertEqual(stream.write(b"a" * 1000), 1000)
+        self.assertEqual(stream.close().bytes_sent, 1000)
+        self.assertEqual(len(self.peripheral.received), 1000)
+
+    def test_ecp_stream(self):
+        port = parallel64.ExtendedPort(
+            ECP_BASE, self.simulator.windll_location, SPP_BASE
+        )
+        with port.open_ecp_stream(buffer_count=2, buffer_size=32) as stream:
+            stream.write(b"z" * 100)
+        self.assertEqual(bytes(self.peripheral.received), b"z" * 100)
+
+
+class TestFifoProbe(unittest.TestCase):
+    def setUp(self):
+        parallel64.clear_capability_cache()
+        self.simulator = parallel64.SimulatedBackend()
+
+    def probe(self, **ecp_options):
+        self.simulator.registers.add_port(SPP_BASE, ECP_BASE, **ecp_options)
+        return parallel64.ExtendedPort(
+            ECP_BASE, self.simulator.windll_location, SPP_BASE
+        )
+
+    def test_depth_and_thresholds(self):
+        port = self.probe(fifo_depth=32, write_threshold=12, read_threshold=4)
+        capabilities = port.ecp_capabilities
+        self.assertEqual(capabilities.fifo_depth, 32)
+        self.assertEqual(capabilities.write_threshold, 12)
+        self.assertEqual(capabilities.read_threshold, 4)
+        control = self.simulator.DlPortReadPortUchar(SPP_BASE + 2)
+        self.assertFalse(control & 0b00100000)
+
+    def test_wide_pwords(self):
+        port = self.probe(
+            fifo_depth=32, write_threshold=8, read_threshold=8, config_a=0
+        )
+        capabilities = port.ecp_capabilities
+        self.assertEqual(capabilities.pword_size, 2)
+        self.assertEqual(capabilities.fifo_depth, 32)
+        self.assertEqual(capabilities.write_threshold, 8)
+        self.assertEqual(capabilities.read_threshold, 8)
+
+
+class TestEppSession(SimulatorTestCase):
+    def test_read_reg_addresses_forward(self):
+        port = parallel64.EnhancedPort(SPP_BASE, self.simulator.windll_location)
+        self.peripheral.epp_registers[0x20] = 0x55
+        with port.epp_session() as epp:
+            epp.write_reg(0x10, 0xAA)
+            self.assertEqual(epp.read_reg(0x20), 0x55)
+            self.assertEqual(epp.read_regs(0x10, 1), b"\xaa")
+        self.assertEqual(port.direction, parallel64.Direction.FORWARD)
+
+
+class TestPinWatcher(SimulatorTestCase):
+    def gpio_port(self):
+        return parallel64.GPIOPort(SPP_BASE, self.simulator.windll_location)
+
+    def test_change_reported(self):
+        port = self.gpio_port()
+        changed = threading.Event()
+        subscription = port.on_change(port.pins.D0, lambda *_: changed.set(), "rising")
+        port.write_pin(port.pins.D0, True)
+        self.assertTrue(changed.wait(5))
+        subscription.cancel()
+
+    def test_cancel_while_dispatching(self):
+        port = self.gpio_port()
+        drain = InputSampler.drain
+
+        def slow_drain(sampler, *args):
+            records = drain(sampler, *args)
+            if records:
+                time.sleep(0.02)
+            return records
+
+        with mock.patch.object(InputSampler, "drain", slow_drain):
+            subscription = port.on_change(port.pins.D0, lambda *_: None)
+            time.sleep(0.1)
+            cancelled = threading.Thread(target=subscription.cancel, daemon=True)
+            cancelled.start()
+            cancelled.join(5)
+        self.assertFalse(cancelled.is_alive())
+
+
+class TestSoftI2C(SimulatorTestCase):
+    def test_sda_only_changes_with_scl_low(self):
+        gpio = parallel64.GPIOPort(SPP_BASE, self.simulator.windll_location)
+        pins = gpio.pins
+        i2c = parallel64.SoftI2C(gpio, pins.D0, pins.D1, pins.ACK)
+        writes = []
+        write_port = self.simulator.DlPortWritePortUchar
+
+        def record(port, value):
+            if port == SPP_BASE:
+                writes.append(value)
+            write_port(port, value)
+
+        with mock.patch.object(self.simulator, "DlPortWritePortUchar", record):
+            try:
+                i2c.writeto(0x55, b"\x0f")
+            except OSError:
+                pass
+        conditions = [
+            (previous, value)
+            for previous, value in zip(writes, writes[1:])
+            if previous & 0b01 and (previous ^ value) & 0b10
+        ]
+        # Only the start and stop conditions change SDA with SCL high
+        self.assertEqual(conditions, [(0b11, 0b01), (0b01, 0b11)])
+
+
+if __name__ == "__main__":
+    unittest.main()